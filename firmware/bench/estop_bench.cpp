@@ -0,0 +1,224 @@
+/**
+ * @file estop_bench.cpp
+ * @brief Time from the E-Stop's falling edge to the last step pulse, on the simulated Mega 2560.
+ *
+ * For a sweep of step rates, six-axis moves are queued two at a time and the E-Stop is
+ * pressed at a pseudo-random point of them, with the main loop running as on the board.
+ * Each row reports, over all the stops at that rate:
+ *
+ *   late pulses   step pulses that started after the edge: only a step ISR that read the
+ *                 pin released a few cycles before the edge puts one out
+ *   late max      latest start of such a pulse after the edge
+ *   latency       time from the edge to the step pins' last edge, the end of the last pulse
+ *                 (p50, p99, max)
+ *   latched       stops whose latched positions match the pulses counted on the pins
+ *   flushed       stops after which the queue was empty and the move cut short reported aborted
+ *   released      stops after which the engine took moves again once the E-Stop was released
+ *
+ * The E-Stop interrupt halts the step engine as soon as it runs, and the step ISR reads
+ * the pin before every tick's pulses, so the worst case is the longest time the E-Stop
+ * interrupt can wait, a step ISR already running or the main loop's longest stretch with
+ * interrupts disabled, plus the interrupt itself. The maximum latency is that bound as the
+ * simulator's cost model sees it.
+ *
+ * Pulses may still start after the edge. The step ISR reads the pin and then writes the
+ * step ports, and an edge between the two does not stop that tick's pulses. So at most one
+ * pulse per axis starts late, within the time from the read to the last port write.
+ *
+ * The program exits with 1 if the latency exceeds one interpolation tick, a pulse starts
+ * later than that read-to-write window, or a stop is not latched, flushed and released
+ * correctly.
+ *
+ * Build and run from `firmware/`:
+ *
+ *   pio run -e native_estop_bench
+ *   .pio/build/native_estop_bench/program [--trials N]
+ */
+#include <random>
+#include <Arduino.h>
+#include <sim.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "fastio.h"
+#include "main.h"
+#include "planner.h"
+#include "stepengine.h"
+
+const long STEPS_PER_MOVE = 2000;
+const long REQUESTED_RATES[] = {1000, 4000, 8000, 12000, 16000, 20000};
+const int DEFAULT_TRIALS = 200;
+const uint64_t SETTLE_CYCLES = sim::CPU_HZ / 100; // Main loop time after the edge before checking, 10 ms
+
+/**
+ * @brief Longest time from the step ISR's read of the E-Stop pin to its last step port
+ * write, in microseconds: the read, then a read-modify-write of each port with step pins.
+ */
+static double readToPulseMicroseconds()
+{
+  int ports = __builtin_popcount(usedPorts(stepPins, NUM_AXES));
+  return (double)(1 + 2 * ports) * sim::costs.portAccess / sim::CYCLES_PER_MICROSECOND;
+}
+
+struct Result
+{
+  long requestedRate;
+  int trials;
+  int latePulses;
+  double lateStart; // Latest start of a late pulse after the edge, microseconds
+  int latched;
+  int flushed;
+  int released;
+  std::vector<double> latencies; // Microseconds
+};
+
+/**
+ * @brief Runs the sketch's main loop until `cycle`, keeping what it prints.
+ */
+static void runLoopUntil(uint64_t cycle, std::string &output)
+{
+  while (sim::cycles() < cycle)
+  {
+    loop();
+    sim::charge(sim::costs.loopOverhead);
+    output += sim::serialTakeOutput();
+  }
+}
+
+/**
+ * @brief Whether `output` reports a stop at the positions the pins count.
+ */
+static bool reportsLatchedStop(const std::string &output, const long positions[NUM_AXES])
+{
+  std::string expected = "E-Stop activated at";
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    expected += " " + std::to_string(positions[i]);
+  }
+  return output.find(expected) != std::string::npos;
+}
+
+static size_t count(const std::string &text, const char *word)
+{
+  size_t found = 0;
+  for (size_t at = text.find(word); at != std::string::npos; at = text.find(word, at + 1))
+  {
+    found++;
+  }
+  return found;
+}
+
+static void benchStop(Result &result, std::mt19937 &random)
+{
+  long start[NUM_AXES];
+  int target[NUM_AXES];
+  int8_t direction[NUM_AXES];
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    // Alternate the direction so the joints stay around zero; give every axis its own distance.
+    start[i] = currentPosition[i];
+    direction[i] = currentPosition[i] > 0 ? -1 : 1;
+    target[i] = currentPosition[i] + direction[i] * STEPS_PER_MOVE * (NUM_AXES - i) / NUM_AXES;
+  }
+  int middle[NUM_AXES];
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    middle[i] = (start[i] + target[i]) / 2;
+  }
+
+  float halfSec = (float)STEPS_PER_MOVE / 2 / result.requestedRate;
+  sim::clearEdges();
+  uint64_t startCycle = sim::cycles();
+  moveMotorsBresenham(middle, halfSec, 0.2, 0, MOVE_REPLY_JOINTS, 0, 0);
+  moveMotorsBresenham(target, halfSec, 0.2, 0, MOVE_REPLY_JOINTS, 0, 0);
+  std::uniform_real_distribution<double> share(0.05, 0.95);
+  uint64_t edgeCycle = startCycle + (uint64_t)(share(random) * 2 * halfSec * sim::CPU_HZ);
+  sim::scheduleInput(edgeCycle, ESTOP_PIN, ESTOP_PRESSED);
+  std::string output;
+  runLoopUntil(edgeCycle + SETTLE_CYCLES, output);
+
+  long positions[NUM_AXES];
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    positions[i] = start[i];
+  }
+  uint64_t lastEdge = edgeCycle;
+  for (const sim::Edge &edge : sim::edges())
+  {
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      if (edge.pin != stepPins[i])
+        continue;
+      if (edge.level)
+        positions[i] += direction[i];
+      if (edge.cycle < edgeCycle)
+        continue;
+      lastEdge = max(lastEdge, edge.cycle);
+      if (edge.level)
+      {
+        result.latePulses++;
+        result.lateStart = max(result.lateStart, (double)(edge.cycle - edgeCycle) / sim::CYCLES_PER_MICROSECOND);
+      }
+    }
+  }
+  result.trials++;
+  result.latencies.push_back((double)(lastEdge - edgeCycle) / sim::CYCLES_PER_MICROSECOND);
+
+  bool latched = reportsLatchedStop(output, positions);
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    latched &= stepEngine.position(i) == positions[i] && currentPosition[i] == positions[i];
+  }
+  result.latched += latched;
+  result.flushed += !isMoveInProgress() && planner.currentBlock() == nullptr && count(output, " ABORTED ") >= 1 &&
+                    count(output, " ABORTED ") + count(output, " COMPLETE ") == 2;
+
+  // Release, and check the engine takes moves again.
+  sim::setInput(ESTOP_PIN, !ESTOP_PRESSED);
+  output.clear();
+  runLoopUntil(sim::cycles() + SETTLE_CYCLES, output);
+  result.released += !stepEngine.isHalted() && output.find("E-Stop released") != std::string::npos;
+}
+
+static double percentile(std::vector<double> values, int percent)
+{
+  std::sort(values.begin(), values.end());
+  return values[(values.size() - 1) * percent / 100];
+}
+
+int main(int argc, char *argv[])
+{
+  int trials = DEFAULT_TRIALS;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "--trials") == 0)
+      trials = max(atoi(argv[i + 1]), 1);
+  }
+
+  sim::reset();
+  setup();
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    isCalibrationDone[i] = true;
+    sim::tracePin(stepPins[i]);
+  }
+
+  std::mt19937 random(1);
+  bool passed = true;
+  printf("%8s %7s %12s %11s %9s %9s %9s %8s %8s %8s\n", "rate_hz", "trials", "late_pulses", "late_max_us", "p50_us", "p99_us", "max_us", "latched", "flushed", "released");
+  for (long rate : REQUESTED_RATES)
+  {
+    Result result = {};
+    result.requestedRate = rate;
+    for (int trial = 0; trial < trials; trial++)
+    {
+      benchStop(result, random);
+    }
+    printf("%8ld %7d %12d %11.2f %9.2f %9.2f %9.2f %8d %8d %8d\n", rate, result.trials, result.latePulses, result.lateStart, percentile(result.latencies, 50),
+           percentile(result.latencies, 99), percentile(result.latencies, 100), result.latched, result.flushed, result.released);
+    passed &= percentile(result.latencies, 100) <= STEP_TICK_MICROSECONDS && result.lateStart <= readToPulseMicroseconds() && result.latched == trials && result.flushed == trials && result.released == trials;
+  }
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file homing_check.cpp
+ * @brief Homes every joint at once on the simulated Mega 2560 and checks each ends up at its center.
+ *
+ * Each joint gets a limit switch a little way along its calibration direction, or one it
+ * already presses, driven from the step and direction pulses the firmware puts out: the
+ * switch reads pressed while the joint stands at or past it. `CALIBRATE_JOINTS` is sent for
+ * all joints and the main loop runs as on the board until every joint reports done. The
+ * whole sequence runs: seek fast, back off, seek slowly and move to the center. Each row
+ * reports, per start and joint:
+ *
+ *   homed       the joint reported its calibration complete, and none failed
+ *   steps       steps the joint made, on the pins
+ *   center_err  steps between where the joint stopped and its center, as the switch
+ *               position and `JOINT_NEGATIVE_LIMITS` / `JOINT_POSITIVE_LIMITS` place it
+ *   zeroed      the step engine reads the center as position 0
+ *
+ * The program exits with 1 if a joint does not home, or stops more than CENTER_TOLERANCE
+ * steps off its center.
+ *
+ * Build and run from `firmware/`:
+ *
+ *   pio run -e native_homing_check
+ *   .pio/build/native_homing_check/program
+ */
+#include <Arduino.h>
+#include <sim.h>
+#include <stdio.h>
+#include <string>
+#include "config.h"
+#include "stepengine.h"
+
+const double SWITCH_AHEAD_DEGREES = 10; // Off the switch: where it lies along the calibration direction
+const double SWITCH_BEHIND_DEGREES = 2; // On the switch: how far past it the joint starts
+const long CENTER_TOLERANCE = 2;
+const uint64_t TIMEOUT_CYCLES = 120ULL * sim::CPU_HZ;
+
+struct Joint
+{
+  long position;    // Where the pulses put the joint, in the step engine's direction and steps
+  long steps;       // Pulses counted
+  bool forward;     // Direction of the next pulse, read from the direction pin
+  long switchAt;    // Position the switch closes at
+  int seekDirection;
+};
+
+static Joint joints[NUM_AXES];
+static size_t edgesSeen;
+
+/**
+ * @brief Moves the joints by the pulses put out since the last call, and drives their limit switches.
+ */
+static void followPulses()
+{
+  const std::vector<sim::Edge> &edges = sim::edges();
+  for (; edgesSeen < edges.size(); edgesSeen++)
+  {
+    const sim::Edge &edge = edges[edgesSeen];
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      if (edge.pin == dirPins[i])
+      {
+        joints[i].forward = (edge.level != 0) == INVERT_DIRECTION[i];
+      }
+      else if (edge.pin == stepPins[i] && edge.level)
+      {
+        joints[i].position += joints[i].forward ? 1 : -1;
+        joints[i].steps++;
+      }
+    }
+  }
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    bool pressed = (joints[i].position - joints[i].switchAt) * joints[i].seekDirection >= 0;
+    sim::setInput(LIMIT_SWITCH_PINS[i], pressed ? LIMIT_SWITCH_PRESSED : !LIMIT_SWITCH_PRESSED);
+  }
+}
+
+/**
+ * @brief Steps from the switch to the center of a joint, against its calibration direction.
+ */
+static long stepsToCenter(int joint)
+{
+  int limit = CALIBRATION_DIRECTION[joint] ? JOINT_POSITIVE_LIMITS[joint] : JOINT_NEGATIVE_LIMITS[joint];
+  return (long)((abs(limit) + CALIBRATION_OFFSETS[joint]) * STEPS_PER_DEGREE[joint]);
+}
+
+/**
+ * @brief Homes every joint with the switches `switchDegrees` ahead along their calibration direction.
+ */
+static bool homeAll(const char *start, double switchDegrees)
+{
+  sim::clearEdges();
+  edgesSeen = 0;
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    Joint &joint = joints[i];
+    joint.position = 0;
+    joint.steps = 0;
+    joint.forward = (sim::pinLevel(dirPins[i]) != 0) == INVERT_DIRECTION[i];
+    joint.seekDirection = CALIBRATION_DIRECTION[i] ? 1 : -1;
+    joint.switchAt = joint.seekDirection * (long)(switchDegrees * STEPS_PER_DEGREE[i]);
+  }
+  followPulses();
+
+  sim::serialInject("04 1,2,3,4,5,6\n");
+  std::string output;
+  uint64_t startCycle = sim::cycles();
+  int homed = 0;
+  while (homed < NUM_AXES && output.find("failed") == std::string::npos && sim::cycles() - startCycle < TIMEOUT_CYCLES)
+  {
+    loop();
+    sim::charge(sim::costs.loopOverhead);
+    followPulses();
+    std::string printed = sim::serialTakeOutput();
+    for (size_t at = printed.find("Calibration complete"); at != std::string::npos; at = printed.find("Calibration complete", at + 1))
+    {
+      homed++;
+    }
+    output += printed;
+  }
+
+  bool passed = true;
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    const Joint &joint = joints[i];
+    bool done = output.find("Calibration complete for Joint " + std::to_string(i + 1) + "\r\n") != std::string::npos &&
+                output.find("failed") == std::string::npos;
+    long center = joint.switchAt - joint.seekDirection * stepsToCenter(i);
+    long error = joint.position - center;
+    bool zeroed = stepEngine.position(i) == 0;
+    printf("%-6s %5d %6s %8ld %11ld %7s\n", start, i + 1, done ? "yes" : "no", joint.steps, error, zeroed ? "yes" : "no");
+    passed &= done && zeroed && abs(error) <= CENTER_TOLERANCE;
+  }
+  return passed;
+}
+
+int main()
+{
+  sim::reset();
+  setup();
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    sim::tracePin(stepPins[i]);
+    sim::tracePin(dirPins[i]);
+  }
+
+  bool passed = true;
+  printf("%-6s %5s %6s %8s %11s %7s\n", "start", "joint", "homed", "steps", "center_err", "zeroed");
+  passed &= homeAll("off", SWITCH_AHEAD_DEGREES);
+  passed &= homeAll("on", -SWITCH_BEHIND_DEGREES);
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+/**
+ * @file kinematics_check.cpp
+ * @brief Round trips through the arm's forward and inverse kinematics, and MOVE_POSE on the simulated Mega 2560.
+ *
+ * Round trips: random joint angles within the limits are turned into a pose by
+ * `forwardKinematics()`, and `inverseKinematics()` solves that pose from other random joint
+ * angles, so that it may well pick another configuration. The pose of its solution is
+ * compared with the one asked for. The rows report, over all round trips:
+ *
+ *   solved      round trips the solver found joint angles for; it must for every one,
+ *               the angles the pose came from being one answer
+ *   pos_mm      distance between the flange positions (p50, p99, max)
+ *   rot_deg     angle of the rotation between the flange orientations (p50, p99, max)
+ *
+ * and, for the same joint angles, how far the sine table puts the flange from where a
+ * double-precision forward kinematics of the same DH table does (table_mm, max).
+ *
+ * MOVE_POSE: for MOVES random joint angles, `MOVE_POSE` is sent with the pose they give,
+ * each from where the move before ended, and the main loop runs as on the board until the
+ * move completes. The solver may well reach the pose in another configuration. Each row
+ * reports, per move:
+ *
+ *   steps_off   steps, over all joints, between where the joints ended and the solution
+ *               `inverseKinematics()` gives for the pose as the command reads, truncated
+ *               to whole steps as the firmware does
+ *   pos_mm      distance between the flange position asked for and the one the steps give
+ *   rot_deg     angle of the rotation between those orientations
+ *
+ * The program exits with 1 if a round trip is not solved or ends more than POSITION_TOLERANCE
+ * or ORIENTATION_TOLERANCE off its pose, or if a MOVE_POSE does not complete, ends off its
+ * solution's steps or more than MOVE_POSITION_TOLERANCE or MOVE_ORIENTATION_TOLERANCE off
+ * its pose.
+ *
+ * Build and run from `firmware/`:
+ *
+ *   pio run -e native_kinematics_check
+ *   .pio/build/native_kinematics_check/program [--trips N]
+ */
+#include <random>
+#include <Arduino.h>
+#include <sim.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "kinematics.h"
+#include "main.h"
+#include "stepengine.h"
+
+const int DEFAULT_TRIPS = 20000;
+const double POSITION_TOLERANCE = 0.06;    // Millimetres
+const double ORIENTATION_TOLERANCE = 0.05; // Degrees
+const int MOVES = 20;
+// Joints end on whole steps: a step of each joint at the arm's reach, joint 6's being 0.23 degrees.
+const double MOVE_POSITION_TOLERANCE = 0.4;    // Millimetres
+const double MOVE_ORIENTATION_TOLERANCE = 0.3; // Degrees
+const uint64_t TIMEOUT_CYCLES = 30ULL * sim::CPU_HZ;
+
+typedef double Matrix[3][3];
+
+/**
+ * @brief Rotation of a pose, R = Rz(yaw) * Ry(pitch) * Rx(roll), in double precision.
+ */
+static void rotationOf(const Pose &pose, Matrix r)
+{
+  double cr = cos(pose.roll * DEG_TO_RAD), sr = sin(pose.roll * DEG_TO_RAD);
+  double cp = cos(pose.pitch * DEG_TO_RAD), sp = sin(pose.pitch * DEG_TO_RAD);
+  double cy = cos(pose.yaw * DEG_TO_RAD), sy = sin(pose.yaw * DEG_TO_RAD);
+  double rotation[3][3] = {{cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr},
+                           {sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr},
+                           {-sp, cp * sr, cp * cr}};
+  memcpy(r, rotation, sizeof(rotation));
+}
+
+/**
+ * @brief Angle in degrees of the rotation that takes pose `a`'s orientation to `b`'s.
+ */
+static double rotationBetween(const Pose &a, const Pose &b)
+{
+  Matrix ra, rb;
+  rotationOf(a, ra);
+  rotationOf(b, rb);
+  double trace = 0; // Of ra^T * rb
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      trace += ra[j][i] * rb[j][i];
+    }
+  }
+  return acos(std::min(1.0, std::max(-1.0, (trace - 1) / 2))) * RAD_TO_DEG;
+}
+
+static double distanceBetween(const Pose &a, const Pose &b)
+{
+  return sqrt((double)(a.x - b.x) * (a.x - b.x) + (double)(a.y - b.y) * (a.y - b.y) + (double)(a.z - b.z) * (a.z - b.z));
+}
+
+/**
+ * @brief Flange position for `joints`, from config.h's DH table in double precision.
+ */
+static void exactPosition(const float joints[NUM_AXES], double position[3])
+{
+  double r[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  double p[3] = {0, 0, 0};
+  for (int link = 0; link < NUM_AXES; link++)
+  {
+    double theta = (joints[link] + DH_THETA_OFFSETS[link]) * DEG_TO_RAD;
+    double alpha = DH_ALPHAS[link] * DEG_TO_RAD;
+    double ct = cos(theta), st = sin(theta), ca = cos(alpha), sa = sin(alpha);
+    double t[3][3] = {{ct, -st * ca, st * sa}, {st, ct * ca, -ct * sa}, {0, sa, ca}};
+    double offset[3] = {DH_A[link] * ct, DH_A[link] * st, DH_D[link]};
+    double next[3][3];
+    for (int i = 0; i < 3; i++)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        next[i][j] = r[i][0] * t[0][j] + r[i][1] * t[1][j] + r[i][2] * t[2][j];
+      }
+      p[i] += r[i][0] * offset[0] + r[i][1] * offset[1] + r[i][2] * offset[2];
+    }
+    memcpy(r, next, sizeof(next));
+  }
+  memcpy(position, p, sizeof(p));
+}
+
+static void randomJoints(std::mt19937 &random, float joints[NUM_AXES])
+{
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    std::uniform_real_distribution<float> angle(JOINT_NEGATIVE_LIMITS[i], JOINT_POSITIVE_LIMITS[i]);
+    joints[i] = angle(random);
+  }
+}
+
+static double percentile(std::vector<double> values, int percent)
+{
+  std::sort(values.begin(), values.end());
+  return values.empty() ? 0 : values[(values.size() - 1) * percent / 100];
+}
+
+/**
+ * @brief Runs `trips` round trips and reports them.
+ */
+static bool checkRoundTrips(int trips, std::mt19937 &random)
+{
+  int solved = 0;
+  std::vector<double> positionErrors, rotationErrors;
+  double tableError = 0;
+  for (int trip = 0; trip < trips; trip++)
+  {
+    float joints[NUM_AXES], from[NUM_AXES], solution[NUM_AXES];
+    randomJoints(random, joints);
+    randomJoints(random, from);
+    Pose pose, reached;
+    forwardKinematics(joints, pose);
+
+    double exact[3];
+    exactPosition(joints, exact);
+    tableError = std::max(tableError, sqrt((pose.x - exact[0]) * (pose.x - exact[0]) + (pose.y - exact[1]) * (pose.y - exact[1]) +
+                                           (pose.z - exact[2]) * (pose.z - exact[2])));
+
+    if (!inverseKinematics(pose, from, solution))
+      continue;
+    solved++;
+    forwardKinematics(solution, reached);
+    positionErrors.push_back(distanceBetween(pose, reached));
+    rotationErrors.push_back(rotationBetween(pose, reached));
+  }
+
+  printf("%7s %7s %9s %9s %9s %9s %9s %9s %9s\n", "trips", "solved", "pos_p50", "pos_p99", "pos_max", "rot_p50", "rot_p99", "rot_max", "table_mm");
+  printf("%7d %7d %9.4f %9.4f %9.4f %9.4f %9.4f %9.4f %9.4f\n", trips, solved, percentile(positionErrors, 50), percentile(positionErrors, 99),
+         percentile(positionErrors, 100), percentile(rotationErrors, 50), percentile(rotationErrors, 99), percentile(rotationErrors, 100), tableError);
+  return solved == trips && percentile(positionErrors, 100) <= POSITION_TOLERANCE && percentile(rotationErrors, 100) <= ORIENTATION_TOLERANCE;
+}
+
+/**
+ * @brief Runs the sketch's main loop until `text` is printed, or for TIMEOUT_CYCLES.
+ */
+static bool runLoopUntilPrinted(const char *text)
+{
+  std::string output;
+  uint64_t startCycle = sim::cycles();
+  while (output.find(text) == std::string::npos && sim::cycles() - startCycle < TIMEOUT_CYCLES)
+  {
+    loop();
+    sim::charge(sim::costs.loopOverhead);
+    output += sim::serialTakeOutput();
+  }
+  return output.find(text) != std::string::npos;
+}
+
+/**
+ * @brief Sends MOVE_POSE for MOVES random poses and reports where the joints end.
+ */
+static bool checkMovePose(std::mt19937 &random)
+{
+  sim::reset();
+  setup();
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    isCalibrationDone[i] = true;
+  }
+
+  printf("\n%4s %9s %10s %9s %9s\n", "move", "complete", "steps_off", "pos_mm", "rot_deg");
+  bool passed = true;
+  for (int move = 0; move < MOVES; move++)
+  {
+    float joints[NUM_AXES], from[NUM_AXES], solution[NUM_AXES], reached[NUM_AXES];
+    randomJoints(random, joints);
+    Pose exact, pose, reachedPose;
+    forwardKinematics(joints, exact);
+    char command[128];
+    snprintf(command, sizeof(command), "0C %.4f,%.4f,%.4f,%.4f,%.4f,%.4f,2,20\n", exact.x, exact.y, exact.z, exact.roll, exact.pitch, exact.yaw);
+
+    // The pose as the firmware reads it from the command, and the joints it solves it for.
+    sscanf(command, "0C %f,%f,%f,%f,%f,%f", &pose.x, &pose.y, &pose.z, &pose.roll, &pose.pitch, &pose.yaw);
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      from[i] = currentPosition[i] / STEPS_PER_DEGREE[i];
+    }
+    bool solved = inverseKinematics(pose, from, solution);
+
+    sim::serialInject(command);
+    bool complete = runLoopUntilPrinted("MOVE_POSE COMPLETE");
+
+    long stepsOff = 0;
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      stepsOff += labs(stepEngine.position(i) - (long)(solution[i] * STEPS_PER_DEGREE[i]));
+      reached[i] = stepEngine.position(i) / STEPS_PER_DEGREE[i];
+    }
+    forwardKinematics(reached, reachedPose);
+    double positionError = distanceBetween(exact, reachedPose);
+    double rotationError = rotationBetween(exact, reachedPose);
+    bool ok = solved && complete && stepsOff == 0 && positionError <= MOVE_POSITION_TOLERANCE && rotationError <= MOVE_ORIENTATION_TOLERANCE;
+    printf("%4d %9s %10ld %9.4f %9.4f %s\n", move + 1, complete ? "yes" : "no", stepsOff, positionError, rotationError, ok ? "ok" : "FAILED");
+    passed &= ok;
+  }
+  return passed;
+}
+
+int main(int argc, char *argv[])
+{
+  int trips = DEFAULT_TRIPS;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "--trips") == 0)
+      trips = max(atoi(argv[i + 1]), 1);
+  }
+
+  std::mt19937 random(1);
+  bool passed = checkRoundTrips(trips, random);
+  passed &= checkMovePose(random);
+  return passed ? 0 : 1;
+}
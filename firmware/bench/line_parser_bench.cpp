@@ -0,0 +1,124 @@
+/**
+ * @file line_parser_bench.cpp
+ * @brief Host benchmark of the text command parser over recorded command streams.
+ *
+ * Feeds each stream to `LineReader` one byte at a time, the way `processSerialCommands()`
+ * does, and parses every complete line like the command handlers: hex code, then the
+ * arguments split in place and converted with `atof()`. Each line is timed over many
+ * passes and the fastest pass is kept, which filters out the host's scheduling noise and
+ * leaves the cost of the parser itself.
+ *
+ * Build and run from `firmware/`:
+ *
+ *   g++ -O2 -Isrc bench/line_parser_bench.cpp src/lineparser.cpp -o line_parser_bench
+ *   ./line_parser_bench bench/streams/frontend_session.txt bench/streams/jog_stress.txt
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "lineparser.h"
+
+static const int PASSES = 200;
+static const int MAX_FIELDS = 8; // MOVE_JOINTS has the most arguments
+
+static volatile float sink; // Keeps the conversions from being optimised away
+
+/**
+ * @brief What the sketch does with a complete line before dispatching it.
+ */
+static void parseCommand(char *line)
+{
+  if (strlen(line) < 2)
+    return;
+  char cmdHex[3] = {line[0], line[1], '\0'};
+  float total = strtol(cmdHex, nullptr, 16);
+  char *args = line[2] == ' ' ? &line[3] : &line[2] + strlen(&line[2]);
+
+  char *fields[MAX_FIELDS];
+  splitFields(args, ',', fields, MAX_FIELDS);
+  for (int i = 0; i < MAX_FIELDS; i++)
+  {
+    total += atof(fields[i]);
+  }
+  sink = total;
+}
+
+struct LineCost
+{
+  size_t length;
+  double bestNs;
+};
+
+static void benchStream(const char *path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    fprintf(stderr, "Cannot read %s\n", path);
+    return;
+  }
+  std::string stream((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  std::vector<LineCost> lines;
+  int overflows = 0;
+  double totalNs = 0;
+  for (int pass = 0; pass < PASSES; pass++)
+  {
+    LineReader reader;
+    size_t lineIndex = 0;
+    size_t lineLength = 0;
+    auto lineStart = std::chrono::steady_clock::now();
+    auto passStart = lineStart;
+    for (char c : stream)
+    {
+      lineLength++;
+      LineReader::Result result = reader.feed(c);
+      if (result == LineReader::LINE_INCOMPLETE)
+        continue;
+
+      if (result == LineReader::LINE_READY)
+        parseCommand(reader.line());
+      else if (pass == 0)
+        overflows++;
+
+      auto now = std::chrono::steady_clock::now();
+      double ns = std::chrono::duration<double, std::nano>(now - lineStart).count();
+      if (pass == 0)
+        lines.push_back({lineLength, ns});
+      else if (ns < lines[lineIndex].bestNs)
+        lines[lineIndex].bestNs = ns;
+      lineIndex++;
+      lineLength = 0;
+      lineStart = std::chrono::steady_clock::now();
+    }
+    totalNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - passStart).count();
+  }
+
+  LineCost worst = {0, 0};
+  for (const LineCost &line : lines)
+  {
+    if (line.bestNs > worst.bestNs)
+      worst = line;
+  }
+  printf("%-40s %8zu bytes %6zu lines %3d overflows  %6.2f ns/byte  worst line %7.0f ns (%zu bytes)\n",
+         path, stream.size(), lines.size(), overflows, totalNs / PASSES / stream.size(), worst.bestNs, worst.length);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: %s <recorded stream>...\n", argv[0]);
+    return 1;
+  }
+  for (int i = 1; i < argc; i++)
+  {
+    benchStream(argv[i]);
+  }
+  return 0;
+}
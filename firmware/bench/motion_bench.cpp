@@ -0,0 +1,582 @@
+/**
+ * @file motion_bench.cpp
+ * @brief Step timing and throughput of the motion paths on the simulated Mega 2560.
+ *
+ * For 1 to 6 axes and a sweep of requested step rates, every path moves each axis the
+ * same number of steps, ramping up and down over RAMP_PERCENT of the move where the path
+ * needs a ramp:
+ *
+ *   stepengine    `moveMotorsBresenham()`, executed by the Timer1 step engine
+ *   accelstepper  `MyAccelStepper::run()`, polled from the main loop
+ *   accelsched    `MyAccelStepper` attached to the `MyAccelStepperScheduler`, on Timer3
+ *   stepperbase   `TS4::StepperBase` ISRs, one step timer per axis, from a pool of as many
+ *                 timers as the board's: with Timer3 taken by the scheduler, two
+ *   steppergroup  `TS4::StepperGroup`, every axis chained behind one step timer
+ *
+ * and the pulses of the first axis are checked against the request. Each row reports the
+ * achieved cruise step rate, the jitter of the pulse intervals around their median (p50, p99,
+ * max), the requested and actual duration of the move and the CPU headroom: the share of
+ * the time the main loop still has once the step code has run. The highest requested
+ * rate each path sustains is summarised per axis count. It is the highest rate of the
+ * sweep up to which every rate emitted all its steps, with intervals no more than 1% longer
+ * than requested plus the 4 us resolution of `micros()`, which the polled path counts in.
+ * The polled main loop's passes vary by up to LOOP_JITTER_CYCLES, as a real loop's do.
+ * Last, the scheduler moves every joint at once, each at its own `JOINT_MAX_SPEEDS`, and
+ * the rate and jitter of each joint's pulses are reported.
+ *
+ * Timings come from the simulator's virtual clock and cost model (`sim::costs`), so they
+ * are repeatable from one run to the next; compare results between firmware revisions
+ * rather than reading them as exact board figures. The cost model charges pin and register
+ * access, the Arduino calls and the 32-bit division of each `StepRamp` step, at an estimated
+ * `sim::costs.division` cycles. It leaves out the rest of the arithmetic, such as the step
+ * engine's per-axis multiplications and the planner's floats, so the rates and the headroom
+ * are upper bounds.
+ *
+ *   pio run -e native_bench
+ *   .pio/build/native_bench/program [--label REV] [--csv FILE] [--json FILE]
+ *
+ * Without `--csv`, the CSV goes to standard output.
+ */
+#include <random>
+#include <Arduino.h>
+#include <sim.h>
+#include <MyAccelStepper.h>
+#include <MyAccelStepperScheduler.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "main.h"
+#include "planner.h"
+#include "stepperbase.h"
+#include "steppergroup.h"
+
+const long STEPS_PER_MOVE = 2000;
+const long REQUESTED_RATES[] = {500,   750,   1000,  1500,  2000,  3000,  4000,  5000,  6000,  8000,  10000, 12000,
+                                 14000, 16000, 18000, 20000, 22500, 25000, 30000, 35000, 40000, 45000, 50000};
+const double RATE_TOLERANCE = 0.99;
+const double TIMEBASE_TOLERANCE_US = 4; // micros() counts in 4 us on the Mega, whatever the rate
+const int RAMP_PERCENT = 5; // Steps left out of the rate and jitter figures at each end of a move
+const uint64_t TIMEOUT_FACTOR = 4; // A move taking this many times the requested duration is abandoned
+const char *const PATHS[] = {"stepengine", "accelstepper", "accelsched", "stepperbase", "steppergroup"};
+const uint32_t LOOP_JITTER_CYCLES = 64; // Spread of the polled main loop's pass time, see benchAccelStepper()
+const double JOINT_MOVE_SECONDS = 2; // Cruise time of each joint in the scheduler's joint run
+
+struct Result
+{
+  const char *path;
+  int axes;
+  long requestedRate;
+  double achievedRate;
+  bool allSteps;
+  double jitterP50;
+  double jitterP99;
+  double jitterMax;
+  double requestedSec;
+  double actualSec;
+  double headroom;
+
+  bool sustained() const
+  {
+    return allSteps && achievedRate > 0 && 1000000.0 / achievedRate <= 1000000.0 / (RATE_TOLERANCE * requestedRate) + TIMEBASE_TOLERANCE_US;
+  }
+};
+
+struct CruiseStats
+{
+  double rate;
+  double jitterP50;
+  double jitterP99;
+  double jitterMax;
+};
+
+/**
+ * @brief Rate and jitter of the pulses rising at `rising`, leaving out RAMP_PERCENT at each end.
+ */
+static CruiseStats cruiseStats(const std::vector<uint64_t> &rising)
+{
+  // Only the cruise counts: the ramps of the paths that have one are left out.
+  std::vector<uint64_t> cruise;
+  size_t skip = rising.size() / (100 / RAMP_PERCENT);
+  if (rising.size() > 2 * skip)
+    cruise.assign(rising.begin() + skip, rising.end() - skip);
+  if (cruise.size() < 3)
+    return {};
+  std::vector<double> intervals;
+  for (size_t i = 1; i < cruise.size(); i++)
+  {
+    intervals.push_back((double)(cruise[i] - cruise[i - 1]) / sim::CYCLES_PER_MICROSECOND);
+  }
+  std::vector<double> sorted = intervals;
+  std::sort(sorted.begin(), sorted.end());
+  double median = sorted[sorted.size() / 2];
+
+  std::vector<double> jitter;
+  for (double interval : intervals)
+  {
+    jitter.push_back(fabs(interval - median));
+  }
+  std::sort(jitter.begin(), jitter.end());
+  CruiseStats stats;
+  stats.rate = 1000000.0 * intervals.size() / ((double)(cruise.back() - cruise.front()) / sim::CYCLES_PER_MICROSECOND);
+  stats.jitterP50 = jitter[jitter.size() / 2];
+  stats.jitterP99 = jitter[(jitter.size() * 99) / 100];
+  stats.jitterMax = jitter.back();
+  return stats;
+}
+
+/**
+ * @brief Fills the rate, jitter and step count of `result` from the edges recorded since `startCycle`.
+ */
+static void analyseEdges(Result &result, uint64_t startCycle)
+{
+  std::vector<uint64_t> rising[NUM_AXES];
+  for (const sim::Edge &edge : sim::edges())
+  {
+    if (edge.cycle < startCycle || !edge.level)
+      continue;
+    for (int i = 0; i < result.axes; i++)
+    {
+      if (edge.pin == stepPins[i])
+        rising[i].push_back(edge.cycle);
+    }
+  }
+
+  result.allSteps = true;
+  for (int i = 0; i < result.axes; i++)
+  {
+    if ((long)rising[i].size() != STEPS_PER_MOVE)
+      result.allSteps = false;
+  }
+
+  CruiseStats stats = cruiseStats(rising[0]);
+  result.achievedRate = stats.rate;
+  result.jitterP50 = stats.jitterP50;
+  result.jitterP99 = stats.jitterP99;
+  result.jitterMax = stats.jitterMax;
+}
+
+static Result startResult(const char *path, int axes, long rate)
+{
+  Result result = {};
+  result.path = path;
+  result.axes = axes;
+  result.requestedRate = rate;
+  result.requestedSec = (double)STEPS_PER_MOVE / rate;
+  return result;
+}
+
+// --- Step engine, through moveMotorsBresenham() ---
+
+static Result benchStepEngine(int axes, long rate)
+{
+  Result result = startResult("stepengine", axes, rate);
+  int target[NUM_AXES];
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    // Alternate the direction so the joints stay around zero.
+    long direction = currentPosition[i] > 0 ? -1 : 1;
+    target[i] = currentPosition[i] + (i < axes ? direction * STEPS_PER_MOVE : 0);
+  }
+
+  sim::clearEdges();
+  uint64_t startCycle = sim::cycles();
+  uint64_t startIsr = sim::isrCycles();
+  moveMotorsBresenham(target, result.requestedSec, 0, 0, MOVE_REPLY_NONE, 0, 0);
+  uint64_t deadline = startCycle + (uint64_t)(result.requestedSec * TIMEOUT_FACTOR * sim::CPU_HZ);
+  while (isMoveInProgress() && sim::cycles() < deadline)
+  {
+    PlannerBlock *block = planner.finishedBlock();
+    if (block != nullptr)
+    {
+      // What the sketch prints as "Actual loop execution time".
+      result.actualSec = (block->endMicros - block->startMicros) / 1000000.0;
+      planner.discardFinishedBlock();
+    }
+    sim::charge(200);
+  }
+  uint64_t elapsed = sim::cycles() - startCycle;
+  result.headroom = 1.0 - (double)(sim::isrCycles() - startIsr) / elapsed;
+  sim::serialTakeOutput();
+  analyseEdges(result, startCycle);
+  return result;
+}
+
+// --- MyAccelStepper::run(), polled ---
+
+static Result benchAccelStepper(int axes, long rate)
+{
+  Result result = startResult("accelstepper", axes, rate);
+  static MyAccelStepper *steppers[NUM_AXES];
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    if (steppers[i] == nullptr)
+      steppers[i] = new MyAccelStepper(stepPins[i], dirPins[i]);
+  }
+
+  for (int i = 0; i < axes; i++)
+  {
+    steppers[i]->setCurrentPosition(0);
+    steppers[i]->setMaxSpeed(rate);
+    steppers[i]->setAcceleration((float)rate * rate * 100 / (2 * RAMP_PERCENT * STEPS_PER_MOVE));
+    steppers[i]->moveTo(STEPS_PER_MOVE);
+  }
+
+  sim::clearEdges();
+  uint64_t startCycle = sim::cycles();
+  uint64_t steppingCycles = 0;
+  uint64_t deadline = startCycle + (uint64_t)(result.requestedSec * TIMEOUT_FACTOR * sim::CPU_HZ);
+  // The passes of a real main loop vary in length. Were they all alike, each step would
+  // wait the same part of a pass, set by how the interval divides by the pass, and the
+  // achieved rate would swing from one requested rate to the next.
+  std::minstd_rand random(1);
+  std::uniform_int_distribution<uint32_t> jitter(0, LOOP_JITTER_CYCLES);
+  bool running = true;
+  while (running && sim::cycles() < deadline)
+  {
+    running = false;
+    for (int i = 0; i < axes; i++)
+    {
+      long before = steppers[i]->currentPosition();
+      uint64_t callStart = sim::cycles();
+      running |= steppers[i]->run();
+      if (steppers[i]->currentPosition() != before)
+        steppingCycles += sim::cycles() - callStart;
+    }
+    sim::charge(sim::costs.loopOverhead + jitter(random));
+  }
+  uint64_t elapsed = sim::cycles() - startCycle;
+  result.actualSec = (double)elapsed / sim::CPU_HZ;
+  // Calls that found no step due are time the loop could have spent elsewhere.
+  result.headroom = 1.0 - (double)steppingCycles / elapsed;
+  analyseEdges(result, startCycle);
+  return result;
+}
+
+// --- MyAccelStepper, stepped by the scheduler ---
+
+/**
+ * @brief Moves the scheduled motors, `axes` of them, by `distances` at `speeds`, ramping
+ * over RAMP_PERCENT of each move, and waits until they stop or `seconds` have passed.
+ * @return The cycles it took.
+ */
+static uint64_t moveScheduled(int axes, const long distances[], const float speeds[], double seconds)
+{
+  static MyAccelStepper *steppers[NUM_AXES];
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    if (steppers[i] == nullptr)
+    {
+      // They stay attached to the scheduler.
+      steppers[i] = new MyAccelStepper(stepPins[i], dirPins[i]);
+      stepperScheduler.attach(*steppers[i]);
+    }
+  }
+  for (int i = 0; i < axes; i++)
+  {
+    steppers[i]->setCurrentPosition(0);
+    steppers[i]->setMaxSpeed(speeds[i]);
+    steppers[i]->setAcceleration(speeds[i] * speeds[i] * 100 / (2 * RAMP_PERCENT * distances[i]));
+  }
+
+  uint64_t startCycle = sim::cycles();
+  uint64_t deadline = startCycle + (uint64_t)(seconds * sim::CPU_HZ);
+  for (int i = 0; i < axes; i++)
+  {
+    steppers[i]->moveTo(distances[i]);
+  }
+  bool running = true;
+  while (running && sim::cycles() < deadline)
+  {
+    sim::charge(200);
+    running = false;
+    for (int i = 0; i < axes; i++)
+    {
+      running |= steppers[i]->run();
+    }
+  }
+  for (int i = 0; i < axes; i++)
+  {
+    steppers[i]->eStop(); // If the move timed out
+  }
+  return sim::cycles() - startCycle;
+}
+
+static Result benchAccelScheduler(int axes, long rate)
+{
+  Result result = startResult("accelsched", axes, rate);
+  long distances[NUM_AXES];
+  float speeds[NUM_AXES];
+  for (int i = 0; i < axes; i++)
+  {
+    distances[i] = STEPS_PER_MOVE;
+    speeds[i] = rate;
+  }
+
+  sim::clearEdges();
+  uint64_t startCycle = sim::cycles();
+  uint64_t startIsr = sim::isrCycles();
+  uint64_t elapsed = moveScheduled(axes, distances, speeds, result.requestedSec * TIMEOUT_FACTOR);
+  result.actualSec = (double)elapsed / sim::CPU_HZ;
+  result.headroom = 1.0 - (double)(sim::isrCycles() - startIsr) / elapsed;
+  analyseEdges(result, startCycle);
+  return result;
+}
+
+/**
+ * @brief Moves every joint at once with the scheduler, each at its JOINT_MAX_SPEEDS, and
+ * prints the rate and jitter of each.
+ */
+static void benchSchedulerJoints()
+{
+  long distances[NUM_AXES];
+  float speeds[NUM_AXES];
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    speeds[i] = JOINT_MAX_SPEEDS[i];
+    distances[i] = speeds[i] * JOINT_MOVE_SECONDS;
+  }
+
+  sim::clearEdges();
+  uint64_t startCycle = sim::cycles();
+  uint64_t startIsr = sim::isrCycles();
+  uint64_t elapsed = moveScheduled(NUM_AXES, distances, speeds, JOINT_MOVE_SECONDS * TIMEOUT_FACTOR);
+  double headroom = 1.0 - (double)(sim::isrCycles() - startIsr) / elapsed;
+
+  fprintf(stderr, "\nScheduler, every joint at its JOINT_MAX_SPEEDS (headroom at most %.1f%%):\n", 100 * headroom);
+  fprintf(stderr, "%-6s %12s %12s %6s %9s %9s %9s\n", "joint", "requested_hz", "achieved_hz", "steps", "p50_us", "p99_us", "max_us");
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    std::vector<uint64_t> rising;
+    for (const sim::Edge &edge : sim::edges())
+    {
+      if (edge.cycle >= startCycle && edge.level && edge.pin == stepPins[i])
+        rising.push_back(edge.cycle);
+    }
+    CruiseStats stats = cruiseStats(rising);
+    fprintf(stderr, "J%-5d %12.1f %12.1f %6s %9.2f %9.2f %9.2f\n", i + 1, speeds[i], stats.rate,
+            (long)rising.size() == distances[i] ? "all" : "short", stats.jitterP50, stats.jitterP99, stats.jitterMax);
+  }
+}
+
+// --- TS4::StepperBase ISRs ---
+
+class BenchStepper : public TS4::StepperBase
+{
+public:
+  BenchStepper(int stepPin, int dirPin) : StepperBase(stepPin, dirPin) {}
+  // Ramps up over about RAMP_PERCENT of the move.
+  void start(int32_t target, uint32_t speed) { startMoveTo(target, 0, speed, rampAcceleration(target, speed)); }
+  void halt() { emergencyStop(); }
+  static uint32_t rampAcceleration(int32_t distance, uint32_t speed) { return (uint64_t)speed * speed * 100 / (2 * RAMP_PERCENT * distance); }
+};
+
+static Result benchStepperBase(int axes, long rate)
+{
+  Result result = startResult("stepperbase", axes, rate);
+  BenchStepper *steppers[NUM_AXES];
+  for (int i = 0; i < axes; i++)
+  {
+    steppers[i] = new BenchStepper(stepPins[i], dirPins[i]);
+  }
+
+  sim::clearEdges();
+  uint64_t startCycle = sim::cycles();
+  uint64_t startIsr = sim::isrCycles();
+  for (int i = 0; i < axes; i++)
+  {
+    steppers[i]->start(STEPS_PER_MOVE, rate);
+  }
+  uint64_t deadline = startCycle + (uint64_t)(result.requestedSec * TIMEOUT_FACTOR * sim::CPU_HZ);
+  bool moving = true;
+  while (moving && sim::cycles() < deadline)
+  {
+    sim::charge(200);
+    moving = false;
+    for (int i = 0; i < axes; i++)
+    {
+      moving |= steppers[i]->isMoving;
+    }
+  }
+  uint64_t elapsed = sim::cycles() - startCycle;
+  result.actualSec = (double)elapsed / sim::CPU_HZ;
+  result.headroom = 1.0 - (double)(sim::isrCycles() - startIsr) / elapsed;
+  for (int i = 0; i < axes; i++)
+  {
+    steppers[i]->halt(); // Hands the timer back if the move timed out
+    delete steppers[i];
+  }
+  analyseEdges(result, startCycle);
+  return result;
+}
+
+// --- TS4::StepperGroup ---
+
+static Result benchStepperGroup(int axes, long rate)
+{
+  Result result = startResult("steppergroup", axes, rate);
+  BenchStepper *steppers[NUM_AXES];
+  int32_t targets[NUM_AXES];
+  TS4::StepperGroup group;
+  for (int i = 0; i < axes; i++)
+  {
+    steppers[i] = new BenchStepper(stepPins[i], dirPins[i]);
+    group.add(*steppers[i]);
+    targets[i] = STEPS_PER_MOVE;
+  }
+
+  sim::clearEdges();
+  uint64_t startCycle = sim::cycles();
+  uint64_t startIsr = sim::isrCycles();
+  group.startMoveTo(targets, rate, BenchStepper::rampAcceleration(STEPS_PER_MOVE, rate));
+  uint64_t deadline = startCycle + (uint64_t)(result.requestedSec * TIMEOUT_FACTOR * sim::CPU_HZ);
+  while (group.isMoving() && sim::cycles() < deadline)
+  {
+    sim::charge(200);
+  }
+  uint64_t elapsed = sim::cycles() - startCycle;
+  result.actualSec = (double)elapsed / sim::CPU_HZ;
+  result.headroom = 1.0 - (double)(sim::isrCycles() - startIsr) / elapsed;
+  group.emergencyStop(); // Hands the timer back if the move timed out
+  for (int i = 0; i < axes; i++)
+  {
+    delete steppers[i];
+  }
+  analyseEdges(result, startCycle);
+  return result;
+}
+
+// --- Output ---
+
+static void writeCsv(FILE *out, const char *label, const std::vector<Result> &results)
+{
+  fprintf(out, "label,path,axes,requested_hz,achieved_hz,all_steps,jitter_p50_us,jitter_p99_us,jitter_max_us,requested_s,actual_s,headroom_pct\n");
+  for (const Result &r : results)
+  {
+    fprintf(out, "%s,%s,%d,%ld,%.1f,%d,%.3f,%.3f,%.3f,%.4f,%.4f,%.1f\n", label, r.path, r.axes, r.requestedRate, r.achievedRate, r.allSteps,
+            r.jitterP50, r.jitterP99, r.jitterMax, r.requestedSec, r.actualSec, 100 * r.headroom);
+  }
+}
+
+/**
+ * @brief The highest requested rate `path` sustains with `axes` axes, and every lower rate of the sweep too.
+ */
+static long maxSustainedRate(const std::vector<Result> &results, const char *path, int axes)
+{
+  long best = 0;
+  for (const Result &r : results)
+  {
+    if (strcmp(r.path, path) != 0 || r.axes != axes)
+      continue;
+    if (!r.sustained())
+      break;
+    best = r.requestedRate; // The results run up the sweep
+  }
+  return best;
+}
+
+static void writeJson(FILE *out, const char *label, const std::vector<Result> &results)
+{
+  fprintf(out, "{\n  \"label\": \"%s\",\n  \"steps_per_move\": %ld,\n  \"results\": [\n", label, STEPS_PER_MOVE);
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const Result &r = results[i];
+    fprintf(out, "    {\"path\": \"%s\", \"axes\": %d, \"requested_hz\": %ld, \"achieved_hz\": %.1f, \"all_steps\": %s, "
+                 "\"jitter_us\": {\"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}, \"requested_s\": %.4f, \"actual_s\": %.4f, \"headroom_pct\": %.1f}%s\n",
+            r.path, r.axes, r.requestedRate, r.achievedRate, r.allSteps ? "true" : "false", r.jitterP50, r.jitterP99, r.jitterMax,
+            r.requestedSec, r.actualSec, 100 * r.headroom, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"max_step_rate_hz\": {");
+  for (size_t p = 0; p < sizeof(PATHS) / sizeof(PATHS[0]); p++)
+  {
+    fprintf(out, "%s\n    \"%s\": [", p ? "," : "", PATHS[p]);
+    for (int axes = 1; axes <= NUM_AXES; axes++)
+    {
+      fprintf(out, "%s%ld", axes > 1 ? ", " : "", maxSustainedRate(results, PATHS[p], axes));
+    }
+    fprintf(out, "]");
+  }
+  fprintf(out, "\n  }\n}\n");
+}
+
+static void printSummary(const std::vector<Result> &results)
+{
+  fprintf(stderr, "Max sustained step rate (Hz) by axis count, arithmetic other than the ramp division not charged:\n%-14s", "");
+  for (int axes = 1; axes <= NUM_AXES; axes++)
+  {
+    fprintf(stderr, "%8d", axes);
+  }
+  fprintf(stderr, "\n");
+  for (const char *path : PATHS)
+  {
+    fprintf(stderr, "%-14s", path);
+    for (int axes = 1; axes <= NUM_AXES; axes++)
+    {
+      fprintf(stderr, "%8ld", maxSustainedRate(results, path, axes));
+    }
+    fprintf(stderr, "\n");
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  const char *label = "current";
+  const char *csvPath = nullptr;
+  const char *jsonPath = nullptr;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "--label") == 0)
+      label = argv[i + 1];
+    else if (strcmp(argv[i], "--csv") == 0)
+      csvPath = argv[i + 1];
+    else if (strcmp(argv[i], "--json") == 0)
+      jsonPath = argv[i + 1];
+  }
+
+  sim::reset();
+  setup();
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    isCalibrationDone[i] = true;
+    sim::tracePin(stepPins[i]);
+  }
+
+  std::vector<Result> results;
+  for (int axes = 1; axes <= NUM_AXES; axes++)
+  {
+    for (long rate : REQUESTED_RATES)
+    {
+      results.push_back(benchStepEngine(axes, rate));
+      results.push_back(benchAccelStepper(axes, rate));
+      results.push_back(benchAccelScheduler(axes, rate));
+      results.push_back(benchStepperBase(axes, rate));
+      results.push_back(benchStepperGroup(axes, rate));
+    }
+  }
+
+  FILE *csv = csvPath ? fopen(csvPath, "w") : stdout;
+  if (csv == nullptr)
+  {
+    perror(csvPath);
+    return 1;
+  }
+  writeCsv(csv, label, results);
+  if (csvPath)
+    fclose(csv);
+
+  if (jsonPath)
+  {
+    FILE *json = fopen(jsonPath, "w");
+    if (json == nullptr)
+    {
+      perror(jsonPath);
+      return 1;
+    }
+    writeJson(json, label, results);
+    fclose(json);
+  }
+  printSummary(results);
+  benchSchedulerJoints();
+  return 0;
+}
@@ -0,0 +1,218 @@
+/**
+ * @file profile_switch_bench.cpp
+ * @brief Switches `MyAccelStepper` profiles mid-move on the simulated Mega 2560 and checks the pulses stay smooth.
+ *
+ * Every ordered pair of the PROFILES is tried, the second swapped in with `setProfile()` at
+ * SWITCH_POINTS spread over a move of the first: while it speeds up, cruises and slows down.
+ * One more move swaps between two profiles every SWITCH_PERIOD_MS from start to end. Each
+ * move runs polled from the main loop and attached to the scheduler. Each row reports, over
+ * its moves:
+ *
+ *   arrived     moves that stopped at the target, the steps on the pins adding up to it
+ *   worst jump  the largest change of speed from one step to the next, as a share of what
+ *               the larger acceleration of the two allows (scheduler only, see below)
+ *
+ * The speed of a step is the inverse of the interval to the next one. From one step to the
+ * next it may change by the acceleration times the interval, half as much again for the
+ * approximation of the ramp, and by what rounding the intervals to the microsecond makes of
+ * it. A new profile that only took effect by jumping to its speed would change it by far
+ * more. The steps near rest at either end of a move are left out: the ramp's approximation
+ * is coarsest there, switch or not. A gentler deceleration swapped in near the target may no
+ * longer stop in time: the motor then overshoots and comes back, and each way is checked
+ * on its own. Polled steps wait for the main loop and for `micros()`,
+ * so only the scheduler's pulses are timed; both must arrive.
+ *
+ * The program exits with 1 if a move does not arrive or a jump exceeds its allowance.
+ *
+ * Build and run from `firmware/`:
+ *
+ *   pio run -e native_profile_switch_bench
+ *   .pio/build/native_profile_switch_bench/program
+ */
+#include <Arduino.h>
+#include <sim.h>
+#include <MyAccelStepper.h>
+#include <MyAccelStepperScheduler.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "config.h"
+
+const long DISTANCE = 3000;
+const int SWITCH_POINTS = 10;
+const int SWITCH_PERIOD_MS = 50;
+const int EDGE_STEPS = 3;            // Steps left out of the jump check at each end of a move
+const double APPROXIMATION = 1.5;    // Allowance for the ramp's approximation of constant acceleration
+const double ROUNDING_SECONDS = 2e-6; // Two intervals rounded to the microsecond
+const uint64_t TIMEOUT_CYCLES = 10ULL * sim::CPU_HZ;
+
+struct NamedProfile
+{
+  const char *name;
+  float maxSpeed;
+  float acceleration;
+};
+
+const NamedProfile PROFILES[] = {
+    {"fast", 4000, 40000},
+    {"slow", 1000, 8000},
+    {"gentle", 4000, 4000},
+    {"snappy", 2000, 80000},
+};
+const int PROFILE_COUNT = sizeof(PROFILES) / sizeof(PROFILES[0]);
+
+struct Result
+{
+  int moves = 0;
+  int arrived = 0;
+  double worstJump = 0; // Share of the allowance
+};
+
+/**
+ * @brief The largest change of speed from one step to the next among `rising`, as a share
+ * of what `acceleration` allows.
+ */
+static double worstJump(const std::vector<uint64_t> &rising, double acceleration)
+{
+  double worst = 0;
+  for (size_t i = EDGE_STEPS; i + 2 + EDGE_STEPS < rising.size(); i++)
+  {
+    double interval = (double)(rising[i + 1] - rising[i]) / sim::CPU_HZ;
+    double nextInterval = (double)(rising[i + 2] - rising[i + 1]) / sim::CPU_HZ;
+    double speed = 1 / interval;
+    double nextSpeed = 1 / nextInterval;
+    double fastest = max(speed, nextSpeed);
+    double allowed = APPROXIMATION * acceleration * max(interval, nextInterval) + ROUNDING_SECONDS * fastest * fastest;
+    worst = max(worst, fabs(nextSpeed - speed) / allowed);
+  }
+  return worst;
+}
+
+/**
+ * @brief Splits the rising edges of the step pin into runs in one direction, read from the
+ * direction pin, and adds up the steps they make.
+ */
+static long traceSteps(std::vector<std::vector<uint64_t>> &runs)
+{
+  long position = 0;
+  bool clockwise = true;
+  bool turned = true;
+  for (const sim::Edge &edge : sim::edges())
+  {
+    if (edge.pin == dirPins[0])
+    {
+      turned |= edge.level != clockwise;
+      clockwise = edge.level;
+    }
+    else if (edge.pin == stepPins[0] && edge.level)
+    {
+      if (turned)
+        runs.emplace_back();
+      turned = false;
+      runs.back().push_back(edge.cycle);
+      position += clockwise ? 1 : -1;
+    }
+  }
+  return position;
+}
+
+/**
+ * @brief Moves `stepper` by DISTANCE from `from`, swapping in `to` after `switchSeconds`
+ * and, if `periodSeconds` is set, back and forth every `periodSeconds` after that.
+ */
+static void runMove(MyAccelStepper &stepper, bool scheduled, const MyAccelStepper::Profile &from, const MyAccelStepper::Profile &to,
+                    double switchSeconds, double periodSeconds, Result &result)
+{
+  stepper.setCurrentPosition(0);
+  stepper.setProfile(from);
+  sim::clearEdges();
+  uint64_t startCycle = sim::cycles();
+  uint64_t switchCycle = startCycle + (uint64_t)(switchSeconds * sim::CPU_HZ);
+  bool switched = false;
+  stepper.moveTo(DISTANCE);
+  while (stepper.run() && sim::cycles() - startCycle < TIMEOUT_CYCLES)
+  {
+    if (sim::cycles() >= switchCycle)
+    {
+      stepper.setProfile(switched ? from : to);
+      switched = !switched;
+      switchCycle = periodSeconds > 0 ? switchCycle + (uint64_t)(periodSeconds * sim::CPU_HZ) : UINT64_MAX;
+    }
+    sim::charge(scheduled ? 200 : sim::costs.loopOverhead);
+  }
+
+  std::vector<std::vector<uint64_t>> runs;
+  long steps = traceSteps(runs);
+  result.moves++;
+  result.arrived += steps == DISTANCE && stepper.currentPosition() == DISTANCE && !stepper.run();
+  for (const std::vector<uint64_t> &rising : runs)
+  {
+    if (scheduled)
+      result.worstJump = max(result.worstJump, worstJump(rising, max(from.acceleration, to.acceleration)));
+  }
+  stepper.eStop(); // If the move timed out
+}
+
+/**
+ * @brief Seconds a move of DISTANCE takes with `profile`.
+ */
+static double moveSeconds(const NamedProfile &profile)
+{
+  double rampSteps = (double)profile.maxSpeed * profile.maxSpeed / (2 * profile.acceleration);
+  if (2 * rampSteps >= DISTANCE)
+    return 2 * sqrt(DISTANCE / profile.acceleration); // Never reaches the maximum speed
+  return 2 * profile.maxSpeed / profile.acceleration + (DISTANCE - 2 * rampSteps) / profile.maxSpeed;
+}
+
+static bool printResult(const char *mode, const char *from, const char *to, const Result &result, bool scheduled)
+{
+  bool passed = result.arrived == result.moves && result.worstJump <= 1;
+  if (scheduled)
+    printf("%-9s %-8s %-8s %5d/%-5d %10.2f\n", mode, from, to, result.arrived, result.moves, result.worstJump);
+  else
+    printf("%-9s %-8s %-8s %5d/%-5d %10s\n", mode, from, to, result.arrived, result.moves, "-");
+  return passed;
+}
+
+int main()
+{
+  sim::reset();
+  sim::tracePin(stepPins[0]);
+  sim::tracePin(dirPins[0]);
+  MyAccelStepper polled(stepPins[0], dirPins[0]);
+  MyAccelStepper scheduled(stepPins[0], dirPins[0]);
+  stepperScheduler.attach(scheduled);
+
+  bool passed = true;
+  printf("%-9s %-8s %-8s %11s %10s\n", "mode", "from", "to", "arrived", "worst_jump");
+  for (int mode = 0; mode < 2; mode++)
+  {
+    MyAccelStepper &stepper = mode ? scheduled : polled;
+    const char *modeName = mode ? "scheduled" : "polled";
+    for (int f = 0; f < PROFILE_COUNT; f++)
+    {
+      for (int t = 0; t < PROFILE_COUNT; t++)
+      {
+        if (f == t)
+          continue;
+        MyAccelStepper::Profile from(PROFILES[f].maxSpeed, PROFILES[f].acceleration);
+        MyAccelStepper::Profile to(PROFILES[t].maxSpeed, PROFILES[t].acceleration);
+        Result result;
+        for (int point = 0; point < SWITCH_POINTS; point++)
+        {
+          double share = (point + 0.5) / SWITCH_POINTS;
+          runMove(stepper, mode, from, to, share * moveSeconds(PROFILES[f]), 0, result);
+        }
+        passed &= printResult(modeName, PROFILES[f].name, PROFILES[t].name, result, mode);
+      }
+    }
+
+    // Back and forth all along the move, as a sequence of phases would.
+    MyAccelStepper::Profile fast(PROFILES[0].maxSpeed, PROFILES[0].acceleration);
+    MyAccelStepper::Profile slow(PROFILES[1].maxSpeed, PROFILES[1].acceleration);
+    Result result;
+    runMove(stepper, mode, fast, slow, SWITCH_PERIOD_MS / 1000.0, SWITCH_PERIOD_MS / 1000.0, result);
+    passed &= printResult(modeName, "fast", "slow/fast", result, mode);
+  }
+  return passed ? 0 : 1;
+}
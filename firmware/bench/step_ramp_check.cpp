@@ -0,0 +1,124 @@
+/**
+ * @file step_ramp_check.cpp
+ * @brief Host check of the integer `StepRamp` kernel against the same recurrence in double.
+ *
+ * Runs the ramps the three motion paths ask of the kernel, in the timer units each of them
+ * uses, and compares every step period with the double-precision reference of Austin's
+ * recurrence. The kernel must stay within one timer tick of it on every step; the
+ * single-precision float version the paths used to run is shown next to it for comparison.
+ * (On the host both are a few nanoseconds a step; the difference that matters is on the
+ * AVR, which has no FPU: see `bench/motion_bench.cpp` for timings on the simulated board.)
+ *
+ * The check needs neither the sketch nor the simulator; its env builds it with `StepRamp` alone.
+ *
+ * Build and run from `firmware/`:
+ *
+ *   pio run -e native_step_ramp_check
+ *   .pio/build/native_step_ramp_check/program
+ *
+ * Exits with 1 if any ramp strays by more than one tick.
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "StepRamp.h"
+
+static const double MAX_ERROR_TICKS = 1.0;
+
+struct RampCase
+{
+  const char *path;        // Motion path the ramp stands for
+  uint32_t ticksPerSecond; // Timer the path counts its periods in
+  float acceleration;      // Steps per second squared
+  int32_t fromStep;        // Ramp step the ramp joins at; negative to decelerate
+  int32_t steps;
+};
+
+static const RampCase CASES[] = {
+    // Step engine: Timer1 ticks, ramps joined at the entry speed of a block, up to 20 kHz.
+    {"stepengine", 2000000, 8000, 40, 2000},
+    {"stepengine", 2000000, 200000, 100, 900},
+    {"stepengine", 2000000, 8000, -2001, 2000},
+    {"stepengine", 2000000, 200000, -1001, 1000},
+    // MyAccelStepper: microseconds, from rest, including its default of 1 step/s^2.
+    {"accelstepper", 1000000, 1, 0, 200},
+    {"accelstepper", 1000000, 5000, 0, 50000},
+    {"accelstepper", 1000000, 5000, -801, 800},
+    // StepperBase: 0.5 us timer ticks, from the kick-start velocity.
+    {"stepperbase", 2000000, 20000, 1, 100},
+    {"stepperbase", 2000000, 50000, 0, 10000},
+    {"stepperbase", 2000000, 50000, -10001, 10000},
+};
+
+static uint32_t startPeriod(const RampCase &ramp)
+{
+  int32_t step = ramp.fromStep >= 0 ? ramp.fromStep : -ramp.fromStep - 1;
+  return StepRamp::periodOfStep(ramp.ticksPerSecond, ramp.acceleration, step);
+}
+
+/**
+ * @brief The recurrence as `StepRamp::next()` runs it, in floating point of type `Real`.
+ */
+template <typename Real>
+static void referenceRamp(const RampCase &ramp, std::vector<Real> &periods)
+{
+  Real period = startPeriod(ramp);
+  int32_t step = ramp.fromStep;
+  periods.clear();
+  for (int32_t i = 0; i < ramp.steps; i++)
+  {
+    if (step != -1)
+    {
+      step++;
+      period -= (2 * period) / (4 * (Real)step + 1);
+    }
+    periods.push_back(period);
+  }
+}
+
+static void kernelRamp(const RampCase &ramp, std::vector<uint32_t> &periods)
+{
+  StepRamp kernel;
+  kernel.start(startPeriod(ramp), ramp.fromStep);
+  periods.clear();
+  for (int32_t i = 0; i < ramp.steps; i++)
+  {
+    periods.push_back(kernel.next());
+  }
+}
+
+int main()
+{
+  bool passed = true;
+  std::vector<double> reference;
+  std::vector<float> single;
+  std::vector<uint32_t> kernel;
+
+  printf("%-13s %8s %9s %8s %7s %9s  %14s %14s\n", "path", "ticks/s", "accel", "from", "steps", "period",
+         "kernel err", "float err");
+  for (const RampCase &ramp : CASES)
+  {
+    referenceRamp(ramp, reference);
+    referenceRamp(ramp, single);
+    kernelRamp(ramp, kernel);
+
+    double kernelError = 0;
+    double floatError = 0;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+      kernelError = std::max(kernelError, std::fabs(kernel[i] - reference[i]));
+      floatError = std::max(floatError, std::fabs(single[i] - reference[i]));
+    }
+    bool ok = kernelError <= MAX_ERROR_TICKS;
+    passed = passed && ok;
+
+    printf("%-13s %8u %9.0f %8d %7d %9u  %8.3f ticks %8.3f ticks%s\n", ramp.path, ramp.ticksPerSecond,
+           ramp.acceleration, ramp.fromStep, ramp.steps, startPeriod(ramp), kernelError, floatError,
+           ok ? "" : "  FAILED");
+  }
+
+  printf("%s: the kernel %s within %.0f tick of the reference on every step\n", passed ? "PASS" : "FAIL",
+         passed ? "stays" : "does not stay", MAX_ERROR_TICKS);
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
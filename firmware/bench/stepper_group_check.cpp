@@ -0,0 +1,186 @@
+/**
+ * @file stepper_group_check.cpp
+ * @brief Moves a `TS4::StepperGroup` of six steppers on the simulated Mega 2560 and checks where each lands.
+ *
+ * The group's steppers have mixed distances in every move: the longest, one a step short of
+ * it, shorter ones, reversed ones, a single step and none at all, with the longest not added
+ * first. The rounds run in this order, each from where the one before left off:
+ *
+ *   out         a whole move from the origin
+ *   back        a whole move back to the origin, reversing every stepper that moved
+ *   stop        `stop()` while the group cruises, decelerating along its line
+ *   estop       `emergencyStop()` while the group cruises
+ *   home        a whole move back to the origin, on the timer the emergency stop handed back
+ *   none        a move to where the steppers already are, which starts nothing
+ *
+ * Each row reports, per round and stepper:
+ *
+ *   target      where the stepper is to end: the move's target for a whole move, and for a
+ *               stopped one the point of its line the master stopped at, rounded as
+ *               Bresenham rounds it
+ *   position    `current_position_steps` once the group stopped
+ *   pins        the position the step and direction pins put the stepper at
+ *   pulses      rising edges on the step pin
+ *
+ * and per round how often the `onFinished()` callback ran: once for a move that ended or
+ * was stopped, never for an emergency stop or a move that did not start.
+ *
+ * The program exits with 1 if a stepper's position or its pins are off its target, if it
+ * made other than as many pulses as steps, or if the callback ran other than expected.
+ *
+ * Build and run from `firmware/`:
+ *
+ *   pio run -e native_stepper_group_check
+ *   .pio/build/native_stepper_group_check/program
+ */
+#include <Arduino.h>
+#include <sim.h>
+#include <stdio.h>
+#include "config.h"
+#include "steppergroup.h"
+
+const int STEPPERS = NUM_AXES;
+const int32_t OUT_TARGETS[STEPPERS] = {1200, -3000, 700, 0, 2999, -1}; // Stepper 2 is the master
+const int32_t CRUISE_TARGETS[STEPPERS] = {-5000, 3000, 0, 8000, -7999, 1};
+const int32_t ORIGIN[STEPPERS] = {};
+const uint32_t SPEED = 6000;         // Steps per second of the master
+const uint32_t ACCELERATION = 40000; // Steps per second squared of the master
+const uint64_t STOP_AFTER_CYCLES = sim::CPU_HZ / 2;
+const uint64_t TIMEOUT_CYCLES = 5ULL * sim::CPU_HZ;
+
+class GroupStepper : public TS4::StepperBase
+{
+public:
+  GroupStepper(int stepPin, int dirPin) : StepperBase(stepPin, dirPin) {}
+  int32_t position() const { return current_position_steps; }
+};
+
+enum class Ending
+{
+  WHOLE,          // The move runs to its targets
+  STOP,           // stop() once the group cruises
+  EMERGENCY_STOP, // emergencyStop() once the group cruises
+  NOTHING         // The targets are where the steppers are
+};
+
+static GroupStepper *steppers[STEPPERS];
+static TS4::StepperGroup group;
+static long pinPositions[STEPPERS];
+static bool forward[STEPPERS]; // Direction of the next pulse, read from the direction pin
+static long pulses[STEPPERS];
+static size_t edgesSeen;
+static int finishedCalls;
+
+static void countFinished(void *context)
+{
+  (*static_cast<int *>(context))++;
+}
+
+/**
+ * @brief Moves the steppers' pin positions by the pulses put out since the last call.
+ */
+static void followPulses()
+{
+  const std::vector<sim::Edge> &edges = sim::edges();
+  for (; edgesSeen < edges.size(); edgesSeen++)
+  {
+    const sim::Edge &edge = edges[edgesSeen];
+    for (int i = 0; i < STEPPERS; i++)
+    {
+      if (edge.pin == dirPins[i])
+      {
+        forward[i] = edge.level != 0;
+      }
+      else if (edge.pin == stepPins[i] && edge.level)
+      {
+        pinPositions[i] += forward[i] ? 1 : -1;
+        pulses[i]++;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Runs the simulation until the group stops, or for `cycles` at most.
+ */
+static void runFor(uint64_t cycles)
+{
+  uint64_t startCycle = sim::cycles();
+  while (group.isMoving() && sim::cycles() - startCycle < cycles)
+  {
+    sim::charge(200);
+    followPulses();
+  }
+  followPulses();
+}
+
+/**
+ * @brief Moves the group towards `targets`, ends the move as `ending` says and checks every stepper.
+ */
+static bool runRound(const char *round, const int32_t targets[], Ending ending)
+{
+  int32_t from[STEPPERS];
+  int32_t distances[STEPPERS];
+  int master = 0;
+  for (int i = 0; i < STEPPERS; i++)
+  {
+    from[i] = steppers[i]->position();
+    distances[i] = labs((long)(targets[i] - from[i]));
+    pulses[i] = 0;
+    master = distances[i] > distances[master] ? i : master;
+  }
+  finishedCalls = 0;
+
+  bool started = group.startMoveTo(targets, SPEED, ACCELERATION);
+  if (ending == Ending::STOP || ending == Ending::EMERGENCY_STOP)
+  {
+    runFor(STOP_AFTER_CYCLES);
+    if (ending == Ending::STOP)
+      group.stop();
+    else
+      group.emergencyStop();
+  }
+  runFor(TIMEOUT_CYCLES);
+
+  // Bresenham steps a stepper as soon as its line reaches half a step past its last one.
+  long masterSteps = labs((long)(steppers[master]->position() - from[master]));
+  bool passed = started && !group.isMoving();
+  for (int i = 0; i < STEPPERS; i++)
+  {
+    long steps = distances[master] == 0 ? 0 : (2 * masterSteps * distances[i] + distances[master]) / (2 * distances[master]);
+    int32_t target = from[i] + (targets[i] < from[i] ? -steps : steps);
+    bool ok = steppers[i]->position() == target && pinPositions[i] == target && pulses[i] == steps;
+    printf("%-5s %7d %8ld %8ld %8ld %8ld %s\n", round, i + 1, (long)target, (long)steppers[i]->position(),
+           pinPositions[i], pulses[i], ok ? "ok" : "FAILED");
+    passed &= ok;
+  }
+
+  int expectedCalls = ending == Ending::WHOLE || ending == Ending::STOP ? 1 : 0;
+  bool stoppedShort = ending == Ending::WHOLE || ending == Ending::NOTHING || masterSteps < distances[master];
+  printf("%-5s finished %d time(s), expected %d%s\n", round, finishedCalls, expectedCalls,
+         stoppedShort ? "" : ", but the move was not cut short");
+  return passed && finishedCalls == expectedCalls && stoppedShort;
+}
+
+int main()
+{
+  sim::reset();
+  for (int i = 0; i < STEPPERS; i++)
+  {
+    steppers[i] = new GroupStepper(stepPins[i], dirPins[i]);
+    sim::tracePin(stepPins[i]);
+    sim::tracePin(dirPins[i]);
+    forward[i] = sim::pinLevel(dirPins[i]) != 0;
+    group.add(*steppers[i]);
+  }
+  group.onFinished(countFinished, &finishedCalls);
+
+  printf("%-5s %7s %8s %8s %8s %8s\n", "round", "stepper", "target", "position", "pins", "pulses");
+  bool passed = runRound("out", OUT_TARGETS, Ending::WHOLE);
+  passed &= runRound("back", ORIGIN, Ending::WHOLE);
+  passed &= runRound("stop", CRUISE_TARGETS, Ending::STOP);
+  passed &= runRound("estop", CRUISE_TARGETS, Ending::EMERGENCY_STOP);
+  passed &= runRound("home", ORIGIN, Ending::WHOLE);
+  passed &= runRound("none", ORIGIN, Ending::NOTHING);
+  return passed ? 0 : 1;
+}
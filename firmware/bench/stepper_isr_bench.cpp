@@ -0,0 +1,257 @@
+/**
+ * @file stepper_isr_bench.cpp
+ * @brief Work per step of `TS4::StepperBase`'s ISRs against the square-root versions they replaced.
+ *
+ * The old ISRs kept the velocity squared in 64 bits, took `sqrtf()` of it on every step (twice
+ * per cruise step in stepISR) and handed the velocity to `updateFrequency()`, which divides it
+ * into a period. The current ones run the integer `StepRamp` recurrence: one 32-bit division
+ * per ramp step, and nothing but the pulse at cruise speed. Both are run here on the same
+ * stepper, phase by phase, against a timer that only records the periods it is given.
+ *
+ * Host timings would say little: the host has an FPU and a hardware divider, the AVR has
+ * neither, and the simulated pin writes of the pulse outweigh the arithmetic. What carries
+ * over to the board is the work per step, counted here: the 32-bit divisions (each timer
+ * update is one, in `updateFrequency()` or in `StepRamp::next()`) and the square roots.
+ *
+ * Nothing here is measured. The simulator charges register and pin access, and only an
+ * estimate for the division of `StepRamp::next()` among the arithmetic; the cycle profiler
+ * (src/profiler.h) only times the sketch's own sections. Neither times these ISRs. The legacy ISRs are rewritten below from the code they
+ * replaced rather than built from it, and are only as faithful as that rewrite. The cycles
+ * column weighs the counts with rough costs of avr-gcc's runtime routines. It is an estimate
+ * of the AVR cycles each step spends beyond the pulse, good for orders of magnitude, not a
+ * measured speedup.
+ *
+ * The recording timer stands in for src/timers, which the env leaves out of the build.
+ *
+ * Build and run from `firmware/`:
+ *
+ *   pio run -e native_stepper_isr_bench
+ *   .pio/build/native_stepper_isr_bench/program
+ */
+#include <Arduino.h>
+#include <sim.h>
+#include <math.h>
+#include <stdio.h>
+#include "stepperbase.h"
+
+const int32_t STEPS_PER_MOVE = 20000;
+const uint32_t MAX_VELOCITY = 20000; // Steps per second
+const uint32_t ACCELERATION = 50000; // Steps per second squared
+const int32_t CRUISE_TICKS = 20000;  // Steps of a rotation at its target velocity
+
+// Rough AVR cost, in cycles, of avr-libc's sqrtf() with the conversions from and to integers
+// around it. A 32-bit division is weighed at the simulator's `sim::costs.division`.
+const double AVR_SQRT_CYCLES = 650;
+
+// --- A step timer that only takes note ---
+
+class RecordingTimer : public TS4::ITimer
+{
+public:
+  void attachCallbacks(TS4::TimerCallback, TS4::TimerCallback, void *) override {}
+  void setPulseParams(uint32_t, int) override {}
+  void updateFrequency(uint32_t frequency) override
+  {
+    if (frequency > 0)
+      updatePeriod(TS4::TIMER_TICKS_PER_SECOND / frequency);
+  }
+  void updatePeriod(uint32_t newPeriod) override
+  {
+    period = newPeriod;
+    updates++;
+  }
+  void start() override {}
+  void stop() override {}
+
+  volatile uint32_t period = 0;
+  uint64_t updates = 0;
+};
+
+static RecordingTimer timer;
+static bool timerTaken = false;
+
+TS4::ITimer *TS4::TimerFactory::makeTimer()
+{
+  if (timerTaken)
+    return nullptr;
+  timerTaken = true;
+  return &timer;
+}
+
+void TS4::TimerFactory::returnTimer(ITimer *)
+{
+  timerTaken = false;
+}
+
+// --- The ISRs, current and legacy (rewritten here, see above) ---
+
+enum Phase
+{
+  PHASE_RAMP_UP,
+  PHASE_CRUISE,
+  PHASE_RAMP_DOWN,
+  PHASE_COUNT
+};
+
+static const char *const PHASE_NAMES[PHASE_COUNT] = {"ramp up", "cruise", "ramp down"};
+
+struct PhaseCost
+{
+  uint64_t steps = 0;
+  uint64_t updates = 0;
+  uint64_t squareRoots = 0;
+};
+
+typedef PhaseCost Costs[PHASE_COUNT];
+
+class BenchStepper : public TS4::StepperBase
+{
+public:
+  BenchStepper() : StepperBase(54, 55) {}
+
+  /// Runs a move with the current stepISR.
+  void move(Costs &costs)
+  {
+    startMoveTo(current_position_steps + STEPS_PER_MOVE, 0, MAX_VELOCITY, ACCELERATION);
+    countPhase(costs[PHASE_RAMP_UP], [this] { return steps_traveled < acceleration_end_step; }, [this] { stepISR(); });
+    countPhase(costs[PHASE_CRUISE], [this] { return steps_traveled < deceleration_start_step; }, [this] { stepISR(); });
+    countPhase(costs[PHASE_RAMP_DOWN], [this] { return steps_traveled < total_steps_for_move; }, [this] { stepISR(); });
+    stepISR(); // Target reached
+  }
+
+  /// Runs the same move with the stepISR of before the `StepRamp` kernel.
+  void legacyMove(Costs &costs)
+  {
+    startMoveTo(current_position_steps + STEPS_PER_MOVE, 0, MAX_VELOCITY, ACCELERATION);
+    velocitySqr = 0;
+    targetVelocitySqr = (int64_t)MAX_VELOCITY * MAX_VELOCITY;
+    twoTimesAcceleration = 2 * ACCELERATION;
+    countPhase(costs[PHASE_RAMP_UP], [this] { return steps_traveled < acceleration_end_step; }, [this] { legacyStepISR(); });
+    countPhase(costs[PHASE_CRUISE], [this] { return steps_traveled < deceleration_start_step; }, [this] { legacyStepISR(); });
+    countPhase(costs[PHASE_RAMP_DOWN], [this] { return steps_traveled < total_steps_for_move; }, [this] { legacyStepISR(); });
+    emergencyStop();
+  }
+
+  /// Spins up to the velocity, holds it and stops, with the current rotISR.
+  void rotate(Costs &costs)
+  {
+    startRotate(MAX_VELOCITY, ACCELERATION);
+    countPhase(costs[PHASE_RAMP_UP], [this] { return speed_step < target_speed_step; }, [this] { rotISR(); });
+    int32_t ticks = 0;
+    countPhase(costs[PHASE_CRUISE], [&ticks] { return ticks++ < CRUISE_TICKS; }, [this] { rotISR(); });
+    startRotate(0, ACCELERATION);
+    countPhase(costs[PHASE_RAMP_DOWN], [this] { return isMoving; }, [this] { rotISR(); });
+  }
+
+  /// The same with the rotISR of before, velocity squared and `sqrtf()` on every step.
+  void legacyRotate(Costs &costs)
+  {
+    step_timer = TS4::TimerFactory::makeTimer();
+    twoTimesAcceleration = 2 * ACCELERATION;
+    targetVelocitySqr = (int64_t)MAX_VELOCITY * MAX_VELOCITY;
+    velocitySqr = (int64_t)TS4::KICK_START_VELOCITY * TS4::KICK_START_VELOCITY;
+    changeDirection = 1;
+    countPhase(costs[PHASE_RAMP_UP], [this] { return llabs(velocitySqr - targetVelocitySqr) > twoTimesAcceleration; }, [this] { legacyRotISR(); });
+    int32_t ticks = 0;
+    countPhase(costs[PHASE_CRUISE], [&ticks] { return ticks++ < CRUISE_TICKS; }, [this] { legacyRotISR(); });
+    targetVelocitySqr = 0;
+    changeDirection = -1;
+    countPhase(costs[PHASE_RAMP_DOWN], [this] { return llabs(velocitySqr) > twoTimesAcceleration; }, [this] { legacyRotISR(); });
+    emergencyStop();
+  }
+
+private:
+  /// Runs `isr` while `condition` holds, adding up the work it does.
+  template <typename WHILE, typename ISR>
+  void countPhase(PhaseCost &cost, WHILE condition, ISR isr)
+  {
+    uint64_t updatesBefore = timer.updates;
+    uint64_t squareRootsBefore = squareRoots;
+    uint64_t steps = 0;
+    while (condition())
+    {
+      isr();
+      resetISR();
+      steps++;
+    }
+    cost.steps += steps;
+    cost.updates += timer.updates - updatesBefore;
+    cost.squareRoots += squareRoots - squareRootsBefore;
+  }
+
+  void legacyStepISR()
+  {
+    if (steps_traveled < acceleration_end_step)
+    {
+      velocitySqr += twoTimesAcceleration;
+      int32_t velocity = TS4::signum(velocitySqr) * squareRoot(llabs(velocitySqr));
+      step_timer->updateFrequency(TS4::magnitude(velocity));
+    }
+    else if (steps_traveled < deceleration_start_step)
+    {
+      int32_t velocity = fminf(squareRoot(velocitySqr), squareRoot(targetVelocitySqr));
+      step_timer->updateFrequency(velocity);
+    }
+    else
+    {
+      velocitySqr -= twoTimesAcceleration;
+      int32_t velocity = TS4::signum(velocitySqr) * squareRoot(llabs(velocitySqr));
+      step_timer->updateFrequency(TS4::magnitude(velocity));
+    }
+    doStep();
+  }
+
+  void legacyRotISR()
+  {
+    if (llabs(velocitySqr - targetVelocitySqr) > twoTimesAcceleration)
+      velocitySqr += changeDirection * twoTimesAcceleration;
+    direction_multiplier = TS4::signum(velocitySqr);
+    step_timer->updateFrequency(squareRoot(llabs(velocitySqr)));
+    doStep();
+  }
+
+  float squareRoot(int64_t value)
+  {
+    squareRoots++;
+    return sqrtf(value);
+  }
+
+  uint64_t squareRoots = 0;
+  int64_t velocitySqr = 0;
+  int64_t targetVelocitySqr = 0;
+  int32_t twoTimesAcceleration = 0;
+  int32_t changeDirection = 0;
+};
+
+// --- Output ---
+
+static void printCosts(const char *isr, const char *version, const Costs &costs)
+{
+  for (int phase = 0; phase < PHASE_COUNT; phase++)
+  {
+    const PhaseCost &cost = costs[phase];
+    double steps = cost.steps > 0 ? cost.steps : 1;
+    double divisions = cost.updates / steps;
+    double squareRoots = cost.squareRoots / steps;
+    printf("%-8s %-8s %-10s %8llu %10.2f %8.2f %12.0f\n", isr, version, PHASE_NAMES[phase], (unsigned long long)cost.steps,
+           divisions, squareRoots, divisions * sim::costs.division + squareRoots * AVR_SQRT_CYCLES);
+  }
+}
+
+int main()
+{
+  BenchStepper stepper;
+  Costs moveBefore = {}, moveNow = {}, rotateBefore = {}, rotateNow = {};
+  stepper.legacyMove(moveBefore);
+  stepper.move(moveNow);
+  stepper.legacyRotate(rotateBefore);
+  stepper.rotate(rotateNow);
+
+  printf("Per step, beyond the pulse. Counted on the host; the AVR cycles are an estimate, not measured:\n\n");
+  printf("%-8s %-8s %-10s %8s %10s %8s %12s\n", "isr", "version", "phase", "steps", "divisions", "sqrtf", "est_avr_cy");
+  printCosts("stepISR", "legacy", moveBefore);
+  printCosts("stepISR", "current", moveNow);
+  printCosts("rotISR", "legacy", rotateBefore);
+  printCosts("rotISR", "current", rotateNow);
+  return 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file timer_pool_check.cpp
+ * @brief Runs `TS4::StepperBase` moves on every timer of the step timer pool at once, on the simulated Mega 2560.
+ *
+ * The pool has as many timers as `POOL_TIMERS` gives the board: Timer3, Timer4 and Timer5,
+ * less the one MY_ACCEL_STEPPER_TIMER or the profiler takes. Built with `-DAVR_TIMER_POOL`,
+ * the moves run on the register-level backend of src/timers/avrtimer.cpp, as on the board;
+ * without it, on the simulator's own timers. One stepper more than the pool has timers is
+ * started with them and must be refused. Each stepper moves a different distance, in
+ * either direction, at its own speed, and all of them are moved out and back, so that the
+ * second round runs on the timers the first handed back. Each row reports, per round and
+ * stepper:
+ *
+ *   started     whether `startMoveTo()` got a timer
+ *   position    `current_position_steps` once the move ended, against the target
+ *   pulses      rising edges on the step pin
+ *   width_us    shortest and longest step pulse
+ *
+ * The program exits with 1 if a started stepper does not end on its target with as many
+ * pulses as steps and every pulse at least PULSE_MICROSECONDS wide, or if the stepper the
+ * pool has no timer for starts.
+ *
+ * Build and run from `firmware/`:
+ *
+ *   pio run -e native_timer_pool_check
+ *   .pio/build/native_timer_pool_check/program
+ */
+#include <Arduino.h>
+#include <sim.h>
+#include <stdio.h>
+#include "config.h"
+#include "stepperbase.h"
+
+const int32_t TARGETS[] = {3000, -2000, 1200, -500};
+const uint32_t SPEEDS[] = {4000, 6000, 2500, 3000}; // Steps per second
+const uint32_t ACCELERATION = 40000;               // Steps per second squared
+const uint32_t PULSE_MICROSECONDS = 8;             // What StepperBase asks of its timer
+const uint64_t TIMEOUT_CYCLES = 5ULL * sim::CPU_HZ;
+const int STEPPERS = POOL_TIMERS + 1;
+
+static_assert(STEPPERS <= (int)(sizeof(TARGETS) / sizeof(TARGETS[0])) && STEPPERS <= NUM_AXES, "One target and one joint per stepper");
+
+class PoolStepper : public TS4::StepperBase
+{
+public:
+  PoolStepper(int stepPin, int dirPin) : StepperBase(stepPin, dirPin) {}
+  bool start(int32_t target, uint32_t speed) { return startMoveTo(target, 0, speed, ACCELERATION); }
+  int32_t position() const { return current_position_steps; }
+};
+
+struct PinPulses
+{
+  long pulses = 0;
+  double minWidth = 0;
+  double maxWidth = 0;
+};
+
+/**
+ * @brief Counts the pulses on `pin` since the edges were cleared, and how wide they were.
+ */
+static PinPulses pulsesOn(uint8_t pin)
+{
+  PinPulses result;
+  uint64_t rise = 0;
+  bool high = false;
+  for (const sim::Edge &edge : sim::edges())
+  {
+    if (edge.pin != pin)
+      continue;
+    if (edge.level)
+    {
+      rise = edge.cycle;
+      high = true;
+      result.pulses++;
+    }
+    else if (high)
+    {
+      double width = (double)(edge.cycle - rise) / sim::CYCLES_PER_MICROSECOND;
+      result.minWidth = result.pulses == 1 || width < result.minWidth ? width : result.minWidth;
+      result.maxWidth = width > result.maxWidth ? width : result.maxWidth;
+      high = false;
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief Starts every stepper towards its target at once and waits for the started ones to stop.
+ */
+static bool runRound(const char *round, PoolStepper *steppers[], const int32_t targets[])
+{
+  sim::clearEdges();
+  bool started[STEPPERS];
+  int32_t from[STEPPERS];
+  for (int i = 0; i < STEPPERS; i++)
+  {
+    from[i] = steppers[i]->position();
+    started[i] = steppers[i]->start(targets[i], SPEEDS[i]);
+  }
+
+  uint64_t startCycle = sim::cycles();
+  bool moving = true;
+  while (moving && sim::cycles() - startCycle < TIMEOUT_CYCLES)
+  {
+    sim::charge(200);
+    moving = false;
+    for (int i = 0; i < STEPPERS; i++)
+    {
+      moving |= steppers[i]->isMoving;
+    }
+  }
+
+  bool passed = true;
+  for (int i = 0; i < STEPPERS; i++)
+  {
+    PinPulses pulses = pulsesOn(stepPins[i]);
+    int32_t expected = started[i] ? targets[i] : from[i];
+    long steps = started[i] ? labs((long)(targets[i] - from[i])) : 0;
+    bool ok = started[i] == (i < POOL_TIMERS) && !steppers[i]->isMoving && steppers[i]->position() == expected &&
+              pulses.pulses == steps && (pulses.pulses == 0 || pulses.minWidth >= PULSE_MICROSECONDS);
+    printf("%-5s %7d %7s %8ld %8ld %8ld %7.2f-%-7.2f %s\n", round, i + 1, started[i] ? "yes" : "no", (long)expected,
+           (long)steppers[i]->position(), pulses.pulses, pulses.minWidth, pulses.maxWidth, ok ? "ok" : "FAILED");
+    passed &= ok;
+  }
+  return passed;
+}
+
+int main()
+{
+  sim::reset();
+  PoolStepper *steppers[STEPPERS];
+  for (int i = 0; i < STEPPERS; i++)
+  {
+    steppers[i] = new PoolStepper(stepPins[i], dirPins[i]);
+    sim::tracePin(stepPins[i]);
+  }
+
+#ifdef AVR_TIMER_POOL
+  printf("Step timer pool: %d AVR timers, register level\n", POOL_TIMERS);
+#else
+  printf("Step timer pool: %d simulator timers\n", POOL_TIMERS);
+#endif
+  printf("%-5s %7s %7s %8s %8s %8s %15s\n", "round", "stepper", "started", "target", "position", "pulses", "width_us");
+  const int32_t home[STEPPERS] = {};
+  bool passed = runRound("out", steppers, TARGETS);
+  passed &= runRound("back", steppers, home);
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+// Arduino core API for the host simulation of the Mega 2560 firmware.
+// Standard headers come first: the macros below would otherwise break them.
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include "HardwareSerial.h"
+#include "WString.h"
+
+#ifndef ARDUINO
+#define ARDUINO 10819
+#endif
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+#define ARDUINO_AVR_MEGA2560
+#define SIMULATION_HAL
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define NOT_AN_INTERRUPT -1
+#define NUM_DIGITAL_PINS 70
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define PROGMEM
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+// Like the AVR core, abs() is a macro; min/max/constrain are templates as in ArduinoCore-API.
+#define abs(x) ((x) > 0 ? (x) : -(x))
+#define round(x) ((x) >= 0 ? (long)((x) + 0.5) : (long)((x) - 0.5))
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define sq(x) ((x) * (x))
+
+template <class T, class L>
+auto min(const T &a, const L &b) -> decltype((b < a) ? b : a)
+{
+  return (b < a) ? b : a;
+}
+
+template <class T, class L>
+auto max(const T &a, const L &b) -> decltype((b < a) ? b : a)
+{
+  return (a < b) ? b : a;
+}
+
+template <class T, class L, class H>
+auto constrain(const T &x, const L &low, const H &high) -> decltype((x < low) ? low : ((x > high) ? high : x))
+{
+  return (x < low) ? low : ((x > high) ? high : x);
+}
+
+#define bit(b) (1UL << (b))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+
+#define interrupts() sei()
+#define noInterrupts() cli()
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+// Teensy-style single-instruction pin write, modelled as a direct port access.
+void digitalWriteFast(uint8_t pin, uint8_t value);
+
+// Direct port access, numbered as in the AVR core: port A is 1, port L 12, and I, which
+// the Mega does not have, 9.
+#define NOT_A_PORT 0
+uint8_t digitalPinToPort(uint8_t pin);
+uint8_t digitalPinToBitMask(uint8_t pin);
+::sim::RegisterPointer portOutputRegister(uint8_t port);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+// The sketch
+void setup();
+void loop();
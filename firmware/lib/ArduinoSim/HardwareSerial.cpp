@@ -0,0 +1,108 @@
+#include "HardwareSerial.h"
+#include "Arduino.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baud)
+{
+  sim::serialBegin(baud);
+}
+
+int HardwareSerial::available()
+{
+  sim::charge(sim::costs.serialPoll);
+  return sim::serialAvailable();
+}
+
+int HardwareSerial::availableForWrite()
+{
+  return sim::serialTxFree();
+}
+
+int HardwareSerial::peek()
+{
+  sim::charge(sim::costs.serialPoll);
+  return sim::serialPeek();
+}
+
+int HardwareSerial::read()
+{
+  sim::charge(sim::costs.serialRead);
+  return sim::serialRead();
+}
+
+void HardwareSerial::flush()
+{
+  sim::serialFlush();
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  sim::charge(sim::costs.serialWrite);
+  sim::serialWrite(c);
+  return 1;
+}
+
+int HardwareSerial::timedRead()
+{
+  uint64_t deadline = sim::cycles() + (uint64_t)timeout * 1000 * sim::CYCLES_PER_MICROSECOND;
+  while (true)
+  {
+    int c = read();
+    if (c >= 0)
+      return c;
+    uint64_t next = sim::serialNextArrival();
+    if (next > deadline)
+    {
+      sim::idleUntil(deadline);
+      return -1;
+    }
+    sim::idleUntil(next);
+  }
+}
+
+size_t HardwareSerial::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length)
+  {
+    int c = timedRead();
+    if (c < 0)
+      break;
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+size_t HardwareSerial::readBytesUntil(char terminator, char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length)
+  {
+    int c = timedRead();
+    if (c < 0 || c == terminator)
+      break;
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+String HardwareSerial::readString()
+{
+  String result;
+  int c;
+  while ((c = timedRead()) >= 0)
+    result += (char)c;
+  return result;
+}
+
+String HardwareSerial::readStringUntil(char terminator)
+{
+  String result;
+  int c;
+  while ((c = timedRead()) >= 0 && c != terminator)
+    result += (char)c;
+  return result;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Print.h"
+
+/**
+ * USART0 as seen through the AVR core's `HardwareSerial`.
+ *
+ * Bytes travel at the configured baud rate through the same 64-byte RX and TX ring
+ * buffers as on the board: writes block while the TX buffer is full, bytes that arrive
+ * while the RX buffer is full are dropped, and both directions cost one USART ISR per byte.
+ */
+class HardwareSerial : public Print
+{
+public:
+  void begin(unsigned long baud);
+  void end() {}
+  int available();
+  int availableForWrite();
+  int peek();
+  int read();
+  void flush() override;
+  size_t write(uint8_t c) override;
+  using Print::write;
+  operator bool() const { return true; }
+
+  void setTimeout(unsigned long timeoutMillis) { timeout = timeoutMillis; }
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytesUntil(char terminator, char *buffer, size_t length);
+  String readString();
+  String readStringUntil(char terminator);
+
+private:
+  int timedRead();
+
+  unsigned long timeout = 1000;
+};
+
+extern HardwareSerial Serial;
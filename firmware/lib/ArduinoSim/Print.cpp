@@ -0,0 +1,105 @@
+#include "Print.h"
+
+#include <math.h>
+#include <string.h>
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+  {
+    if (!write(*buffer++))
+      break;
+    n++;
+  }
+  return n;
+}
+
+size_t Print::write(const char *str)
+{
+  if (str == nullptr)
+    return 0;
+  return write((const uint8_t *)str, strlen(str));
+}
+
+size_t Print::print(long value, int base)
+{
+  if (base == 0)
+    return write((uint8_t)value);
+  if (base == 10 && value < 0)
+  {
+    size_t n = print('-');
+    return n + printNumber(-(unsigned long)value, 10);
+  }
+  return printNumber((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  if (base == 0)
+    return write((uint8_t)value);
+  return printNumber(value, base);
+}
+
+size_t Print::print(double value, int digits)
+{
+  return printFloat(value, digits);
+}
+
+size_t Print::println()
+{
+  return write("\r\n");
+}
+
+size_t Print::printNumber(unsigned long value, uint8_t base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if (base < 2)
+    base = 10;
+  do
+  {
+    char c = value % base;
+    value /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (value);
+  return write(str);
+}
+
+size_t Print::printFloat(double number, uint8_t digits)
+{
+  if (isnan(number))
+    return print("nan");
+  if (isinf(number))
+    return print("inf");
+  if (number > 4294967040.0 || number < -4294967040.0)
+    return print("ovf");
+
+  size_t n = 0;
+  if (number < 0.0)
+  {
+    n += print('-');
+    number = -number;
+  }
+
+  double rounding = 0.5;
+  for (uint8_t i = 0; i < digits; ++i)
+    rounding /= 10.0;
+  number += rounding;
+
+  unsigned long intPart = (unsigned long)number;
+  double remainder = number - (double)intPart;
+  n += print(intPart);
+
+  if (digits > 0)
+    n += print('.');
+  while (digits-- > 0)
+  {
+    remainder *= 10.0;
+    unsigned int toPrint = (unsigned int)remainder;
+    n += print(toPrint);
+    remainder -= toPrint;
+  }
+  return n;
+}
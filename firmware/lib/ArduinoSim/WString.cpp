@@ -0,0 +1,157 @@
+#include "WString.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static std::string formatInteger(unsigned long value, unsigned char base, bool negative)
+{
+  if (base < 2)
+    base = 10;
+  char digits[sizeof(unsigned long) * 8 + 2];
+  char *p = &digits[sizeof(digits) - 1];
+  *p = '\0';
+  do
+  {
+    unsigned digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value);
+  if (negative)
+    *--p = '-';
+  return p;
+}
+
+char *dtostrf(double value, signed char width, unsigned char precision, char *out)
+{
+  sprintf(out, "%*.*f", width, precision, value);
+  return out;
+}
+
+String::String(const char *cstr) : buffer(cstr ? cstr : "") {}
+
+String::String(char c) : buffer(1, c) {}
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base)
+{
+  if (base == 10 && value < 0)
+    buffer = formatInteger(-(unsigned long)value, base, true);
+  else
+    buffer = formatInteger((unsigned long)value, base, false);
+}
+
+String::String(unsigned long value, unsigned char base) : buffer(formatInteger(value, base, false)) {}
+
+String::String(float value, unsigned char decimalPlaces) : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned char decimalPlaces)
+{
+  char buf[64];
+  buffer = dtostrf(value, decimalPlaces + 2, decimalPlaces, buf);
+}
+
+char String::charAt(unsigned int index) const
+{
+  return index < buffer.length() ? buffer[index] : '\0';
+}
+
+int String::indexOf(char c, unsigned int fromIndex) const
+{
+  size_t pos = buffer.find(c, fromIndex);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String &str, unsigned int fromIndex) const
+{
+  size_t pos = buffer.find(str.buffer, fromIndex);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int beginIndex) const
+{
+  return substring(beginIndex, buffer.length());
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const
+{
+  if (beginIndex > endIndex)
+  {
+    unsigned int tmp = beginIndex;
+    beginIndex = endIndex;
+    endIndex = tmp;
+  }
+  if (beginIndex >= buffer.length())
+    return String();
+  if (endIndex > buffer.length())
+    endIndex = buffer.length();
+  return String(buffer.substr(beginIndex, endIndex - beginIndex));
+}
+
+bool String::startsWith(const String &prefix) const
+{
+  return buffer.compare(0, prefix.buffer.length(), prefix.buffer) == 0;
+}
+
+void String::trim()
+{
+  size_t begin = 0;
+  while (begin < buffer.length() && isspace((unsigned char)buffer[begin]))
+    begin++;
+  size_t end = buffer.length();
+  while (end > begin && isspace((unsigned char)buffer[end - 1]))
+    end--;
+  buffer = buffer.substr(begin, end - begin);
+}
+
+void String::toUpperCase()
+{
+  for (char &c : buffer)
+    c = toupper((unsigned char)c);
+}
+
+long String::toInt() const
+{
+  return atol(buffer.c_str());
+}
+
+float String::toFloat() const
+{
+  return (float)atof(buffer.c_str());
+}
+
+String &String::operator+=(const String &rhs)
+{
+  buffer += rhs.buffer;
+  return *this;
+}
+
+String &String::operator+=(const char *rhs)
+{
+  buffer += rhs;
+  return *this;
+}
+
+String &String::operator+=(char c)
+{
+  buffer += c;
+  return *this;
+}
+
+String operator+(const String &lhs, const String &rhs)
+{
+  return String(lhs.buffer + rhs.buffer);
+}
+
+String operator+(const String &lhs, const char *rhs)
+{
+  return String(lhs.buffer + rhs);
+}
+
+String operator+(const char *lhs, const String &rhs)
+{
+  return String(lhs + rhs.buffer);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+class __FlashStringHelper;
+
+/**
+ * The subset of the Arduino `String` API the firmware uses, backed by `std::string`.
+ * Number formatting follows the AVR core (`String(float)` prints two decimals).
+ */
+class String
+{
+public:
+  String(const char *cstr = "");
+  String(const std::string &str) : buffer(str) {}
+  String(const __FlashStringHelper *str) : String(reinterpret_cast<const char *>(str)) {}
+  explicit String(char c);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+
+  unsigned int length() const { return buffer.length(); }
+  const char *c_str() const { return buffer.c_str(); }
+  char charAt(unsigned int index) const;
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  int indexOf(char c, unsigned int fromIndex = 0) const;
+  int indexOf(const String &str, unsigned int fromIndex = 0) const;
+  String substring(unsigned int beginIndex) const;
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+  bool startsWith(const String &prefix) const;
+  bool equals(const String &other) const { return buffer == other.buffer; }
+  void trim();
+  void toUpperCase();
+  long toInt() const;
+  float toFloat() const;
+
+  String &operator+=(const String &rhs);
+  String &operator+=(const char *rhs);
+  String &operator+=(char c);
+  bool operator==(const String &rhs) const { return buffer == rhs.buffer; }
+  bool operator==(const char *rhs) const { return buffer == rhs; }
+  bool operator!=(const String &rhs) const { return buffer != rhs.buffer; }
+
+  friend String operator+(const String &lhs, const String &rhs);
+  friend String operator+(const String &lhs, const char *rhs);
+  friend String operator+(const char *lhs, const String &rhs);
+
+private:
+  std::string buffer;
+};
+
+char *dtostrf(double value, signed char width, unsigned char precision, char *out);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <avr/io.h>
+
+namespace sim
+{
+  void disableInterrupts();
+  void enableInterrupts();
+}
+
+#define cli() ::sim::disableInterrupts()
+#define sei() ::sim::enableInterrupts()
+
+// An ISR is a plain C function named after its vector; the simulator calls the ones that are defined.
+#define ISR(vector, ...) extern "C" void vector(void); extern "C" void vector(void)
+
+// Interrupt vectors used by the simulator, numbered as in the ATmega2560 vector table.
+#define INT0_vect __vector_1
+#define INT1_vect __vector_2
+#define INT2_vect __vector_3
+#define INT3_vect __vector_4
+#define INT4_vect __vector_5
+#define INT5_vect __vector_6
+#define INT6_vect __vector_7
+#define INT7_vect __vector_8
+#define PCINT0_vect __vector_9
+#define PCINT1_vect __vector_10
+#define PCINT2_vect __vector_11
+#define TIMER1_CAPT_vect __vector_16
+#define TIMER1_COMPA_vect __vector_17
+#define TIMER1_COMPB_vect __vector_18
+#define TIMER1_COMPC_vect __vector_19
+#define TIMER1_OVF_vect __vector_20
+#define TIMER3_CAPT_vect __vector_31
+#define TIMER3_COMPA_vect __vector_32
+#define TIMER3_COMPB_vect __vector_33
+#define TIMER3_COMPC_vect __vector_34
+#define TIMER3_OVF_vect __vector_35
+#define TIMER4_CAPT_vect __vector_41
+#define TIMER4_COMPA_vect __vector_42
+#define TIMER4_COMPB_vect __vector_43
+#define TIMER4_COMPC_vect __vector_44
+#define TIMER4_OVF_vect __vector_45
+#define TIMER5_CAPT_vect __vector_46
+#define TIMER5_COMPA_vect __vector_47
+#define TIMER5_COMPB_vect __vector_48
+#define TIMER5_COMPC_vect __vector_49
+#define TIMER5_OVF_vect __vector_50
@@ -0,0 +1,281 @@
+#pragma once
+
+// Register and bit names of the ATmega2560, mapped onto the simulator.
+
+#include "../sim_registers.h"
+
+#define _BV(bit) (1 << (bit))
+
+#define SREG (::sim::Register(::sim::REG_SREG))
+#define SREG_I 7
+
+// Timer/Counter1
+#define TCCR1A (::sim::Register(::sim::timerRegister(1, ::sim::TIMER_TCCRA)))
+#define TCCR1B (::sim::Register(::sim::timerRegister(1, ::sim::TIMER_TCCRB)))
+#define TCCR1C (::sim::Register(::sim::timerRegister(1, ::sim::TIMER_TCCRC)))
+#define TCNT1 (::sim::Register(::sim::timerRegister(1, ::sim::TIMER_TCNT)))
+#define OCR1A (::sim::Register(::sim::timerRegister(1, ::sim::TIMER_OCRA)))
+#define OCR1B (::sim::Register(::sim::timerRegister(1, ::sim::TIMER_OCRB)))
+#define OCR1C (::sim::Register(::sim::timerRegister(1, ::sim::TIMER_OCRC)))
+#define ICR1 (::sim::Register(::sim::timerRegister(1, ::sim::TIMER_ICR)))
+#define TIMSK1 (::sim::Register(::sim::timerRegister(1, ::sim::TIMER_TIMSK)))
+#define TIFR1 (::sim::Register(::sim::timerRegister(1, ::sim::TIMER_TIFR)))
+#define WGM10 0
+#define WGM11 1
+#define COM1C0 2
+#define COM1C1 3
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define ICES1 6
+#define ICNC1 7
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define OCIE1C 3
+#define ICIE1 5
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define OCF1C 3
+#define ICF1 5
+
+// Timer/Counter3
+#define TCCR3A (::sim::Register(::sim::timerRegister(3, ::sim::TIMER_TCCRA)))
+#define TCCR3B (::sim::Register(::sim::timerRegister(3, ::sim::TIMER_TCCRB)))
+#define TCCR3C (::sim::Register(::sim::timerRegister(3, ::sim::TIMER_TCCRC)))
+#define TCNT3 (::sim::Register(::sim::timerRegister(3, ::sim::TIMER_TCNT)))
+#define OCR3A (::sim::Register(::sim::timerRegister(3, ::sim::TIMER_OCRA)))
+#define OCR3B (::sim::Register(::sim::timerRegister(3, ::sim::TIMER_OCRB)))
+#define OCR3C (::sim::Register(::sim::timerRegister(3, ::sim::TIMER_OCRC)))
+#define ICR3 (::sim::Register(::sim::timerRegister(3, ::sim::TIMER_ICR)))
+#define TIMSK3 (::sim::Register(::sim::timerRegister(3, ::sim::TIMER_TIMSK)))
+#define TIFR3 (::sim::Register(::sim::timerRegister(3, ::sim::TIMER_TIFR)))
+#define WGM30 0
+#define WGM31 1
+#define COM3C0 2
+#define COM3C1 3
+#define COM3B0 4
+#define COM3B1 5
+#define COM3A0 6
+#define COM3A1 7
+#define CS30 0
+#define CS31 1
+#define CS32 2
+#define WGM32 3
+#define WGM33 4
+#define ICES3 6
+#define ICNC3 7
+#define TOIE3 0
+#define OCIE3A 1
+#define OCIE3B 2
+#define OCIE3C 3
+#define ICIE3 5
+#define TOV3 0
+#define OCF3A 1
+#define OCF3B 2
+#define OCF3C 3
+#define ICF3 5
+
+// Timer/Counter4
+#define TCCR4A (::sim::Register(::sim::timerRegister(4, ::sim::TIMER_TCCRA)))
+#define TCCR4B (::sim::Register(::sim::timerRegister(4, ::sim::TIMER_TCCRB)))
+#define TCCR4C (::sim::Register(::sim::timerRegister(4, ::sim::TIMER_TCCRC)))
+#define TCNT4 (::sim::Register(::sim::timerRegister(4, ::sim::TIMER_TCNT)))
+#define OCR4A (::sim::Register(::sim::timerRegister(4, ::sim::TIMER_OCRA)))
+#define OCR4B (::sim::Register(::sim::timerRegister(4, ::sim::TIMER_OCRB)))
+#define OCR4C (::sim::Register(::sim::timerRegister(4, ::sim::TIMER_OCRC)))
+#define ICR4 (::sim::Register(::sim::timerRegister(4, ::sim::TIMER_ICR)))
+#define TIMSK4 (::sim::Register(::sim::timerRegister(4, ::sim::TIMER_TIMSK)))
+#define TIFR4 (::sim::Register(::sim::timerRegister(4, ::sim::TIMER_TIFR)))
+#define WGM40 0
+#define WGM41 1
+#define COM4C0 2
+#define COM4C1 3
+#define COM4B0 4
+#define COM4B1 5
+#define COM4A0 6
+#define COM4A1 7
+#define CS40 0
+#define CS41 1
+#define CS42 2
+#define WGM42 3
+#define WGM43 4
+#define ICES4 6
+#define ICNC4 7
+#define TOIE4 0
+#define OCIE4A 1
+#define OCIE4B 2
+#define OCIE4C 3
+#define ICIE4 5
+#define TOV4 0
+#define OCF4A 1
+#define OCF4B 2
+#define OCF4C 3
+#define ICF4 5
+
+// Timer/Counter5
+#define TCCR5A (::sim::Register(::sim::timerRegister(5, ::sim::TIMER_TCCRA)))
+#define TCCR5B (::sim::Register(::sim::timerRegister(5, ::sim::TIMER_TCCRB)))
+#define TCCR5C (::sim::Register(::sim::timerRegister(5, ::sim::TIMER_TCCRC)))
+#define TCNT5 (::sim::Register(::sim::timerRegister(5, ::sim::TIMER_TCNT)))
+#define OCR5A (::sim::Register(::sim::timerRegister(5, ::sim::TIMER_OCRA)))
+#define OCR5B (::sim::Register(::sim::timerRegister(5, ::sim::TIMER_OCRB)))
+#define OCR5C (::sim::Register(::sim::timerRegister(5, ::sim::TIMER_OCRC)))
+#define ICR5 (::sim::Register(::sim::timerRegister(5, ::sim::TIMER_ICR)))
+#define TIMSK5 (::sim::Register(::sim::timerRegister(5, ::sim::TIMER_TIMSK)))
+#define TIFR5 (::sim::Register(::sim::timerRegister(5, ::sim::TIMER_TIFR)))
+#define WGM50 0
+#define WGM51 1
+#define COM5C0 2
+#define COM5C1 3
+#define COM5B0 4
+#define COM5B1 5
+#define COM5A0 6
+#define COM5A1 7
+#define CS50 0
+#define CS51 1
+#define CS52 2
+#define WGM52 3
+#define WGM53 4
+#define ICES5 6
+#define ICNC5 7
+#define TOIE5 0
+#define OCIE5A 1
+#define OCIE5B 2
+#define OCIE5C 3
+#define ICIE5 5
+#define TOV5 0
+#define OCF5A 1
+#define OCF5B 2
+#define OCF5C 3
+#define ICF5 5
+
+// Digital I/O ports
+#define PINA (::sim::Register(::sim::portRegister(0, ::sim::PORT_PIN)))
+#define DDRA (::sim::Register(::sim::portRegister(0, ::sim::PORT_DDR)))
+#define PORTA (::sim::Register(::sim::portRegister(0, ::sim::PORT_PORT)))
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+#define PINB (::sim::Register(::sim::portRegister(1, ::sim::PORT_PIN)))
+#define DDRB (::sim::Register(::sim::portRegister(1, ::sim::PORT_DDR)))
+#define PORTB (::sim::Register(::sim::portRegister(1, ::sim::PORT_PORT)))
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PINC (::sim::Register(::sim::portRegister(2, ::sim::PORT_PIN)))
+#define DDRC (::sim::Register(::sim::portRegister(2, ::sim::PORT_DDR)))
+#define PORTC (::sim::Register(::sim::portRegister(2, ::sim::PORT_PORT)))
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+#define PIND (::sim::Register(::sim::portRegister(3, ::sim::PORT_PIN)))
+#define DDRD (::sim::Register(::sim::portRegister(3, ::sim::PORT_DDR)))
+#define PORTD (::sim::Register(::sim::portRegister(3, ::sim::PORT_PORT)))
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+#define PINE (::sim::Register(::sim::portRegister(4, ::sim::PORT_PIN)))
+#define DDRE (::sim::Register(::sim::portRegister(4, ::sim::PORT_DDR)))
+#define PORTE (::sim::Register(::sim::portRegister(4, ::sim::PORT_PORT)))
+#define PE0 0
+#define PE1 1
+#define PE2 2
+#define PE3 3
+#define PE4 4
+#define PE5 5
+#define PE6 6
+#define PE7 7
+#define PINF (::sim::Register(::sim::portRegister(5, ::sim::PORT_PIN)))
+#define DDRF (::sim::Register(::sim::portRegister(5, ::sim::PORT_DDR)))
+#define PORTF (::sim::Register(::sim::portRegister(5, ::sim::PORT_PORT)))
+#define PF0 0
+#define PF1 1
+#define PF2 2
+#define PF3 3
+#define PF4 4
+#define PF5 5
+#define PF6 6
+#define PF7 7
+#define PING (::sim::Register(::sim::portRegister(6, ::sim::PORT_PIN)))
+#define DDRG (::sim::Register(::sim::portRegister(6, ::sim::PORT_DDR)))
+#define PORTG (::sim::Register(::sim::portRegister(6, ::sim::PORT_PORT)))
+#define PG0 0
+#define PG1 1
+#define PG2 2
+#define PG3 3
+#define PG4 4
+#define PG5 5
+#define PG6 6
+#define PG7 7
+#define PINH (::sim::Register(::sim::portRegister(7, ::sim::PORT_PIN)))
+#define DDRH (::sim::Register(::sim::portRegister(7, ::sim::PORT_DDR)))
+#define PORTH (::sim::Register(::sim::portRegister(7, ::sim::PORT_PORT)))
+#define PH0 0
+#define PH1 1
+#define PH2 2
+#define PH3 3
+#define PH4 4
+#define PH5 5
+#define PH6 6
+#define PH7 7
+#define PINJ (::sim::Register(::sim::portRegister(8, ::sim::PORT_PIN)))
+#define DDRJ (::sim::Register(::sim::portRegister(8, ::sim::PORT_DDR)))
+#define PORTJ (::sim::Register(::sim::portRegister(8, ::sim::PORT_PORT)))
+#define PJ0 0
+#define PJ1 1
+#define PJ2 2
+#define PJ3 3
+#define PJ4 4
+#define PJ5 5
+#define PJ6 6
+#define PJ7 7
+#define PINK (::sim::Register(::sim::portRegister(9, ::sim::PORT_PIN)))
+#define DDRK (::sim::Register(::sim::portRegister(9, ::sim::PORT_DDR)))
+#define PORTK (::sim::Register(::sim::portRegister(9, ::sim::PORT_PORT)))
+#define PK0 0
+#define PK1 1
+#define PK2 2
+#define PK3 3
+#define PK4 4
+#define PK5 5
+#define PK6 6
+#define PK7 7
+#define PINL (::sim::Register(::sim::portRegister(10, ::sim::PORT_PIN)))
+#define DDRL (::sim::Register(::sim::portRegister(10, ::sim::PORT_DDR)))
+#define PORTL (::sim::Register(::sim::portRegister(10, ::sim::PORT_PORT)))
+#define PL0 0
+#define PL1 1
+#define PL2 2
+#define PL3 3
+#define PL4 4
+#define PL5 5
+#define PL6 6
+#define PL7 7
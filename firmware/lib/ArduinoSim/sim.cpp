@@ -0,0 +1,900 @@
+#include "Arduino.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+#include <deque>
+
+// ISR vectors the firmware may define; the ones it does not define stay null.
+#define SIM_VECTOR(n) extern "C" void __vector_##n(void) __attribute__((weak));
+SIM_VECTOR(1)
+SIM_VECTOR(2)
+SIM_VECTOR(3)
+SIM_VECTOR(4)
+SIM_VECTOR(5)
+SIM_VECTOR(6)
+SIM_VECTOR(7)
+SIM_VECTOR(8)
+SIM_VECTOR(17)
+SIM_VECTOR(18)
+SIM_VECTOR(19)
+SIM_VECTOR(20)
+SIM_VECTOR(32)
+SIM_VECTOR(33)
+SIM_VECTOR(34)
+SIM_VECTOR(35)
+SIM_VECTOR(42)
+SIM_VECTOR(43)
+SIM_VECTOR(44)
+SIM_VECTOR(45)
+SIM_VECTOR(47)
+SIM_VECTOR(48)
+SIM_VECTOR(49)
+SIM_VECTOR(50)
+
+namespace sim
+{
+  CostModel costs;
+
+  namespace
+  {
+    const uint64_t NEVER = UINT64_MAX;
+    const int NUM_PORTS = 11; // A..L without I
+    const int SERIAL_BUFFER_SIZE = 64;
+
+    // Arduino Mega 2560 pin map: port index (A=0 .. L=10) and bit of every digital pin.
+    const uint8_t PIN_PORT[NUM_DIGITAL_PINS] = {
+        4, 4, 4, 4, 6, 4, 7, 7, 7, 7, 1, 1, 1, 1, 8, 8, 7, 7, 3, 3,     // 0-19
+        3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 3, 6,     // 20-39
+        6, 6, 10, 10, 10, 10, 10, 10, 10, 10, 1, 1, 1, 1, 5, 5, 5, 5,   // 40-57
+        5, 5, 5, 5, 9, 9, 9, 9, 9, 9, 9, 9};                            // 58-69
+    const uint8_t PIN_BIT[NUM_DIGITAL_PINS] = {
+        0, 1, 4, 5, 5, 3, 3, 4, 5, 6, 4, 5, 6, 7, 1, 0, 1, 0, 3, 2,     // 0-19
+        1, 0, 0, 1, 2, 3, 4, 5, 6, 7, 7, 6, 5, 4, 3, 2, 1, 0, 7, 2,     // 20-39
+        1, 0, 7, 6, 5, 4, 3, 2, 1, 0, 3, 2, 1, 0, 0, 1, 2, 3,           // 40-57
+        4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7};                            // 58-69
+
+    // External interrupt number (attachInterrupt numbering) -> pin and INTn line.
+    struct ExternalInterrupt
+    {
+      uint8_t pin;
+      uint8_t line;
+    };
+    const ExternalInterrupt EXTERNAL_INTERRUPTS[] = {{2, 4}, {3, 5}, {21, 0}, {20, 1}, {19, 2}, {18, 3}};
+    const int NUM_EXTERNAL_INTERRUPTS = sizeof(EXTERNAL_INTERRUPTS) / sizeof(EXTERNAL_INTERRUPTS[0]);
+
+    struct Timer
+    {
+      uint8_t tccrA, tccrB, tccrC;
+      uint16_t tcnt, ocrA, ocrB, ocrC, icr;
+      uint8_t timsk, tifr;
+      uint64_t lastSync;
+      uint32_t residual; // CPU cycles not yet turned into a timer tick
+    };
+
+    struct Port
+    {
+      uint8_t port, ddr;
+      uint8_t driven, drivenMask; // Levels forced from outside the chip
+    };
+
+    struct InputEvent
+    {
+      uint64_t cycle;
+      uint8_t pin, level;
+    };
+
+    struct AttachedInterrupt
+    {
+      void (*fn)(void);
+      int mode;
+    };
+
+    uint64_t now = 0;
+    bool interruptsEnabled = true;
+    bool insideIsr = false;
+    uint64_t isrTotal = 0;
+
+    Timer timers[6]; // Indexed by timer number; 1, 3, 4 and 5 are modelled
+    Port ports[NUM_PORTS];
+    uint8_t externalFlags = 0; // Pending INTn requests
+    AttachedInterrupt attached[NUM_EXTERNAL_INTERRUPTS];
+    std::deque<InputEvent> inputEvents;
+    std::vector<SoftInterrupt *> softInterrupts; // Every source ever armed, armed or not
+
+    bool traced[NUM_DIGITAL_PINS];
+    std::vector<Edge> edgeLog;
+
+    // Serial
+    unsigned long baud = 115200;
+    std::deque<std::pair<uint64_t, uint8_t>> rxLine; // Bytes on the wire with their arrival cycle
+    std::deque<uint8_t> rxBuffer;
+    uint32_t rxOverflows = 0;
+    int txQueued = 0;
+    uint64_t txNextDone = NEVER;
+    std::string output;
+
+    uint64_t byteCycles()
+    {
+      return (uint64_t)CPU_HZ * 10 / baud;
+    }
+
+    bool isModelledTimer(int n)
+    {
+      return n == 1 || n == 3 || n == 4 || n == 5;
+    }
+
+    uint32_t prescaler(const Timer &t)
+    {
+      static const uint32_t DIVIDERS[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+      return DIVIDERS[t.tccrB & 0x07];
+    }
+
+    bool isCtc(const Timer &t)
+    {
+      return (t.tccrB & 0x18) == 0x08 && (t.tccrA & 0x03) == 0;
+    }
+
+    uint16_t topOf(const Timer &t)
+    {
+      return (isCtc(t) && t.tcnt <= t.ocrA) ? t.ocrA : 0xFFFF;
+    }
+
+    // Ticks until the counter holds `value` during a tick, or 0 if it does not before wrapping.
+    uint32_t ticksUntil(const Timer &t, uint16_t value)
+    {
+      if (value < t.tcnt || value > topOf(t))
+        return 0;
+      return (uint32_t)(value - t.tcnt) + 1;
+    }
+
+    // Advances a timer by `ticks`, setting the flags it passes on the way.
+    void runTimer(Timer &t, uint64_t ticks)
+    {
+      while (ticks > 0)
+      {
+        uint16_t top = topOf(t);
+        uint32_t toWrap = (uint32_t)(top - t.tcnt) + 1;
+        uint32_t toA = ticksUntil(t, t.ocrA);
+        uint32_t toB = ticksUntil(t, t.ocrB);
+        uint32_t next = toWrap;
+        if (toA && toA < next)
+          next = toA;
+        if (toB && toB < next)
+          next = toB;
+        if (next > ticks)
+        {
+          t.tcnt += ticks;
+          return;
+        }
+        uint16_t value = t.tcnt + next - 1;
+        if (value == t.ocrA)
+          t.tifr |= _BV(1);
+        if (value == t.ocrB)
+          t.tifr |= _BV(2);
+        if (value == top)
+        {
+          t.tcnt = 0;
+          if (top == 0xFFFF)
+            t.tifr |= _BV(0);
+        }
+        else
+        {
+          t.tcnt = value + 1;
+        }
+        ticks -= next;
+      }
+    }
+
+    void syncTimer(Timer &t)
+    {
+      uint32_t divider = prescaler(t);
+      if (divider == 0)
+      {
+        t.lastSync = now;
+        t.residual = 0;
+        return;
+      }
+      uint64_t elapsed = now - t.lastSync + t.residual;
+      t.lastSync = now;
+      t.residual = elapsed % divider;
+      runTimer(t, elapsed / divider);
+    }
+
+    void syncTimers()
+    {
+      for (int n = 1; n <= 5; n++)
+      {
+        if (isModelledTimer(n))
+          syncTimer(timers[n]);
+      }
+    }
+
+    // Cycle at which the timer next raises a flag whose interrupt is enabled.
+    uint64_t nextTimerInterrupt(const Timer &t)
+    {
+      uint32_t divider = prescaler(t);
+      if (divider == 0 || (t.timsk & 0x07) == 0)
+        return NEVER;
+      Timer copy = t;
+      copy.tifr = 0;
+      uint64_t ticks = 0;
+      for (int i = 0; i < 8 && !(copy.tifr & copy.timsk & 0x07); i++)
+      {
+        uint16_t top = topOf(copy);
+        uint32_t toWrap = (uint32_t)(top - copy.tcnt) + 1;
+        uint32_t toA = ticksUntil(copy, copy.ocrA);
+        uint32_t toB = ticksUntil(copy, copy.ocrB);
+        uint32_t next = toWrap;
+        if ((copy.timsk & _BV(1)) && toA && toA < next)
+          next = toA;
+        if ((copy.timsk & _BV(2)) && toB && toB < next)
+          next = toB;
+        runTimer(copy, next);
+        ticks += next;
+      }
+      if (!(copy.tifr & copy.timsk & 0x07))
+        return NEVER;
+      return t.lastSync + ticks * divider - t.residual;
+    }
+
+    void recordEdges(int portIndex, uint8_t before, uint8_t after)
+    {
+      uint8_t changed = before ^ after;
+      if (!changed)
+        return;
+      for (int pin = 0; pin < NUM_DIGITAL_PINS; pin++)
+      {
+        if (PIN_PORT[pin] == portIndex && (changed & _BV(PIN_BIT[pin])) && traced[pin])
+          edgeLog.push_back({now, (uint8_t)pin, (uint8_t)((after >> PIN_BIT[pin]) & 1)});
+      }
+    }
+
+    uint8_t portLevels(const Port &p)
+    {
+      // Outputs read back their latch, undriven inputs read their pull-up.
+      uint8_t inputs = (p.driven & p.drivenMask) | (p.port & ~p.drivenMask);
+      return (p.port & p.ddr) | (inputs & ~p.ddr);
+    }
+
+    void writePort(int portIndex, uint8_t value)
+    {
+      Port &p = ports[portIndex];
+      uint8_t before = portLevels(p);
+      p.port = value;
+      recordEdges(portIndex, before, portLevels(p));
+    }
+
+    void applyInput(uint8_t pin, uint8_t level)
+    {
+      Port &p = ports[PIN_PORT[pin]];
+      uint8_t mask = _BV(PIN_BIT[pin]);
+      bool before = portLevels(p) & mask;
+      p.drivenMask |= mask;
+      if (level)
+        p.driven |= mask;
+      else
+        p.driven &= ~mask;
+      bool after = portLevels(p) & mask;
+      if (before == after)
+        return;
+      for (int i = 0; i < NUM_EXTERNAL_INTERRUPTS; i++)
+      {
+        if (EXTERNAL_INTERRUPTS[i].pin != pin || attached[i].fn == nullptr)
+          continue;
+        int mode = attached[i].mode;
+        if (mode == CHANGE || (mode == RISING && after) || (mode == FALLING && !after))
+          externalFlags |= _BV(EXTERNAL_INTERRUPTS[i].line);
+      }
+    }
+
+    void runIsr(void (*isr)(void))
+    {
+      uint64_t start = now;
+      insideIsr = true;
+      interruptsEnabled = false;
+      now += costs.isrOverhead;
+      isr();
+      insideIsr = false;
+      interruptsEnabled = true;
+      isrTotal += now - start;
+    }
+
+    void callAttached(int line)
+    {
+      for (int i = 0; i < NUM_EXTERNAL_INTERRUPTS; i++)
+      {
+        if (EXTERNAL_INTERRUPTS[i].line == line && attached[i].fn)
+        {
+          attached[i].fn();
+          return;
+        }
+      }
+    }
+
+    void (*const EXTERNAL_VECTORS[8])(void) = {__vector_1, __vector_2, __vector_3, __vector_4, __vector_5, __vector_6, __vector_7, __vector_8};
+    int isrLine;
+    void externalIsr()
+    {
+      if (EXTERNAL_VECTORS[isrLine])
+        EXTERNAL_VECTORS[isrLine]();
+      else
+        callAttached(isrLine);
+    }
+
+    SoftInterrupt *softIsr;
+    void runSoftInterrupt()
+    {
+      softIsr->handler(softIsr->context);
+    }
+
+    struct TimerVectors
+    {
+      int timer;
+      void (*compA)(void);
+      void (*compB)(void);
+      void (*overflow)(void);
+    };
+    const TimerVectors TIMER_VECTORS[] = {
+        {1, __vector_17, __vector_18, __vector_20},
+        {3, __vector_32, __vector_33, __vector_35},
+        {4, __vector_42, __vector_43, __vector_45},
+        {5, __vector_47, __vector_48, __vector_50},
+    };
+
+    void uartRxIsr()
+    {
+      now += costs.uartIsr - costs.isrOverhead;
+    }
+
+    // Runs the highest priority pending interrupt, if any. Returns false when none is pending.
+    bool servicePendingInterrupt()
+    {
+      if (!interruptsEnabled || insideIsr)
+        return false;
+
+      // INT0..INT7 come first in the vector table.
+      for (int line = 0; line < 8; line++)
+      {
+        if (externalFlags & _BV(line))
+        {
+          externalFlags &= ~_BV(line);
+          isrLine = line;
+          runIsr(externalIsr);
+          return true;
+        }
+      }
+
+      syncTimers();
+      for (const TimerVectors &v : TIMER_VECTORS)
+      {
+        Timer &t = timers[v.timer];
+        uint8_t pending = t.tifr & t.timsk;
+        void (*vector)(void) = nullptr;
+        uint8_t flag = 0;
+        if (pending & _BV(1))
+        {
+          flag = _BV(1);
+          vector = v.compA;
+        }
+        else if (pending & _BV(2))
+        {
+          flag = _BV(2);
+          vector = v.compB;
+        }
+        else if (pending & _BV(0))
+        {
+          flag = _BV(0);
+          vector = v.overflow;
+        }
+        if (flag)
+        {
+          t.tifr &= ~flag; // Cleared by hardware when the vector runs
+          if (vector)
+            runIsr(vector);
+          return true;
+        }
+      }
+
+      SoftInterrupt *due = nullptr;
+      for (SoftInterrupt *irq : softInterrupts)
+      {
+        if (irq->armed && irq->due <= now && (due == nullptr || irq->due < due->due))
+          due = irq;
+      }
+      if (due)
+      {
+        due->armed = false;
+        softIsr = due;
+        runIsr(runSoftInterrupt);
+        return true;
+      }
+      return false;
+    }
+
+    uint64_t nextEvent()
+    {
+      uint64_t next = NEVER;
+      if (!inputEvents.empty())
+        next = inputEvents.front().cycle;
+      if (!rxLine.empty() && rxLine.front().first < next)
+        next = rxLine.front().first;
+      if (txNextDone < next)
+        next = txNextDone;
+      if (interruptsEnabled)
+      {
+        for (int n = 1; n <= 5; n++)
+        {
+          if (isModelledTimer(n))
+            next = std::min(next, nextTimerInterrupt(timers[n]));
+        }
+        for (const SoftInterrupt *irq : softInterrupts)
+        {
+          if (irq->armed)
+            next = std::min(next, irq->due);
+        }
+      }
+      return next;
+    }
+
+    // Drives the input pins whose scheduled level falls due at `now`. Reading a pin does
+    // this too, so an ISR sees a level that changed since it was entered, as on the chip.
+    void applyDueInputs()
+    {
+      while (!inputEvents.empty() && inputEvents.front().cycle <= now)
+      {
+        applyInput(inputEvents.front().pin, inputEvents.front().level);
+        inputEvents.pop_front();
+      }
+    }
+
+    // Handles the peripheral events that fall due at `now`.
+    void processEvents()
+    {
+      applyDueInputs();
+      while (!rxLine.empty() && rxLine.front().first <= now)
+      {
+        if ((int)rxBuffer.size() < SERIAL_BUFFER_SIZE - 1)
+          rxBuffer.push_back(rxLine.front().second);
+        else
+          rxOverflows++;
+        rxLine.pop_front();
+        if (interruptsEnabled && !insideIsr)
+          runIsr(uartRxIsr);
+        else
+          isrTotal += costs.uartIsr; // Serviced later; charge it without moving the clock
+      }
+      while (txNextDone <= now)
+      {
+        txQueued--;
+        txNextDone = txQueued > 0 ? txNextDone + byteCycles() : NEVER;
+        if (interruptsEnabled && !insideIsr)
+          runIsr(uartRxIsr);
+      }
+    }
+
+    // Moves the clock to `target` in the main context, running every ISR that falls due.
+    // Time spent in ISRs pushes `target` back, exactly like it delays code on the chip.
+    void advanceMain(uint64_t target)
+    {
+      while (true)
+      {
+        uint64_t before = now;
+        processEvents();
+        while (servicePendingInterrupt())
+        {
+        }
+        target += now - before;
+        uint64_t next = nextEvent();
+        if (next > target)
+          break;
+        now = std::max(now, next);
+        syncTimers();
+      }
+      now = std::max(now, target);
+      syncTimers();
+    }
+  }
+
+  uint64_t cycles()
+  {
+    return now;
+  }
+
+  double seconds()
+  {
+    return (double)now / CPU_HZ;
+  }
+
+  bool inIsr()
+  {
+    return insideIsr;
+  }
+
+  uint64_t isrCycles()
+  {
+    return isrTotal;
+  }
+
+  void charge(uint64_t n)
+  {
+    if (insideIsr)
+      now += n;
+    else
+      advanceMain(now + n);
+  }
+
+  void idleUntil(uint64_t cycle)
+  {
+    if (cycle > now)
+      advanceMain(cycle);
+  }
+
+  void disableInterrupts()
+  {
+    interruptsEnabled = false;
+  }
+
+  void enableInterrupts()
+  {
+    if (insideIsr)
+      return; // Re-enabled by the RETI of the running ISR
+    interruptsEnabled = true;
+    advanceMain(now);
+  }
+
+  uint16_t readRegister(uint16_t id)
+  {
+    if (id == REG_SREG)
+      return interruptsEnabled ? _BV(SREG_I) : 0;
+
+    if ((id & 0xFF00) == REG_TIMER)
+    {
+      int n = (id >> 4) & 0x0F;
+      Timer &t = timers[n];
+      syncTimer(t);
+      switch (id & 0x0F)
+      {
+      case TIMER_TCCRA:
+        return t.tccrA;
+      case TIMER_TCCRB:
+        return t.tccrB;
+      case TIMER_TCCRC:
+        return t.tccrC;
+      case TIMER_TCNT:
+        return t.tcnt;
+      case TIMER_OCRA:
+        return t.ocrA;
+      case TIMER_OCRB:
+        return t.ocrB;
+      case TIMER_OCRC:
+        return t.ocrC;
+      case TIMER_ICR:
+        return t.icr;
+      case TIMER_TIMSK:
+        return t.timsk;
+      case TIMER_TIFR:
+        return t.tifr;
+      }
+    }
+
+    if ((id & 0xFF00) == REG_PORT)
+    {
+      if (insideIsr)
+        now += costs.portAccess;
+      Port &p = ports[(id >> 4) & 0x0F];
+      switch (id & 0x0F)
+      {
+      case PORT_PIN:
+        applyDueInputs();
+        return portLevels(p);
+      case PORT_DDR:
+        return p.ddr;
+      case PORT_PORT:
+        return p.port;
+      }
+    }
+    return 0;
+  }
+
+  void writeRegister(uint16_t id, uint16_t value)
+  {
+    if (id == REG_SREG)
+    {
+      if (value & _BV(SREG_I))
+        enableInterrupts();
+      else
+        disableInterrupts();
+      return;
+    }
+
+    if ((id & 0xFF00) == REG_TIMER)
+    {
+      int n = (id >> 4) & 0x0F;
+      Timer &t = timers[n];
+      syncTimer(t);
+      switch (id & 0x0F)
+      {
+      case TIMER_TCCRA:
+        t.tccrA = value;
+        break;
+      case TIMER_TCCRB:
+        t.tccrB = value;
+        t.residual = 0;
+        break;
+      case TIMER_TCCRC:
+        t.tccrC = value;
+        break;
+      case TIMER_TCNT:
+        t.tcnt = value;
+        break;
+      case TIMER_OCRA:
+        t.ocrA = value;
+        break;
+      case TIMER_OCRB:
+        t.ocrB = value;
+        break;
+      case TIMER_OCRC:
+        t.ocrC = value;
+        break;
+      case TIMER_ICR:
+        t.icr = value;
+        break;
+      case TIMER_TIMSK:
+        t.timsk = value;
+        break;
+      case TIMER_TIFR:
+        t.tifr &= ~value; // Writing a one clears the flag
+        break;
+      }
+      return;
+    }
+
+    if ((id & 0xFF00) == REG_PORT)
+    {
+      int portIndex = (id >> 4) & 0x0F;
+      Port &p = ports[portIndex];
+      if (insideIsr)
+        now += costs.portAccess;
+      switch (id & 0x0F)
+      {
+      case PORT_PIN:
+        writePort(portIndex, p.port ^ value); // Writing a one toggles the output
+        break;
+      case PORT_DDR:
+      {
+        uint8_t before = portLevels(p);
+        p.ddr = value;
+        recordEdges(portIndex, before, portLevels(p));
+        break;
+      }
+      case PORT_PORT:
+        writePort(portIndex, value);
+        break;
+      }
+      if (!insideIsr)
+        charge(costs.portAccess);
+    }
+  }
+
+  void armInterrupt(SoftInterrupt &irq, uint64_t cycle)
+  {
+    if (std::find(softInterrupts.begin(), softInterrupts.end(), &irq) == softInterrupts.end())
+      softInterrupts.push_back(&irq);
+    irq.due = cycle;
+    irq.armed = true;
+  }
+
+  void disarmInterrupt(SoftInterrupt &irq)
+  {
+    irq.armed = false;
+  }
+
+  void setInput(uint8_t pin, uint8_t level)
+  {
+    if (pin >= NUM_DIGITAL_PINS)
+      return;
+    applyInput(pin, level);
+    if (!insideIsr)
+      advanceMain(now);
+  }
+
+  void scheduleInput(uint64_t cycle, uint8_t pin, uint8_t level)
+  {
+    auto it = inputEvents.begin();
+    while (it != inputEvents.end() && it->cycle <= cycle)
+      ++it;
+    inputEvents.insert(it, {cycle, pin, level});
+  }
+
+  uint8_t pinLevel(uint8_t pin)
+  {
+    if (pin >= NUM_DIGITAL_PINS)
+      return LOW;
+    applyDueInputs();
+    return (portLevels(ports[PIN_PORT[pin]]) >> PIN_BIT[pin]) & 1;
+  }
+
+  void tracePin(uint8_t pin, bool enabled)
+  {
+    if (pin < NUM_DIGITAL_PINS)
+      traced[pin] = enabled;
+  }
+
+  const std::vector<Edge> &edges()
+  {
+    return edgeLog;
+  }
+
+  void clearEdges()
+  {
+    edgeLog.clear();
+  }
+
+  void serialInject(const std::string &text, uint64_t cycle)
+  {
+    if (!rxLine.empty() && rxLine.back().first + byteCycles() > cycle)
+      cycle = rxLine.back().first + byteCycles();
+    for (char c : text)
+    {
+      rxLine.push_back({cycle, (uint8_t)c});
+      cycle += byteCycles();
+    }
+  }
+
+  void serialInject(const std::string &text)
+  {
+    serialInject(text, now);
+  }
+
+  std::string serialTakeOutput()
+  {
+    std::string out;
+    out.swap(output);
+    return out;
+  }
+
+  uint32_t serialRxOverflows()
+  {
+    return rxOverflows;
+  }
+
+  void reset()
+  {
+    now = 0;
+    interruptsEnabled = true;
+    insideIsr = false;
+    isrTotal = 0;
+    for (Timer &t : timers)
+      t = Timer();
+    for (Port &p : ports)
+      p = Port();
+    externalFlags = 0;
+    for (AttachedInterrupt &a : attached)
+      a = AttachedInterrupt();
+    inputEvents.clear();
+    for (SoftInterrupt *irq : softInterrupts)
+      irq->armed = false;
+    softInterrupts.clear();
+    for (bool &t : traced)
+      t = false;
+    edgeLog.clear();
+    rxLine.clear();
+    rxBuffer.clear();
+    rxOverflows = 0;
+    txQueued = 0;
+    txNextDone = NEVER;
+    output.clear();
+  }
+
+  // --- Serial internals used by HardwareSerial ---
+  void serialBegin(unsigned long newBaud)
+  {
+    baud = newBaud;
+  }
+
+  int serialAvailable()
+  {
+    return rxBuffer.size();
+  }
+
+  int serialPeek()
+  {
+    return rxBuffer.empty() ? -1 : rxBuffer.front();
+  }
+
+  int serialRead()
+  {
+    if (rxBuffer.empty())
+      return -1;
+    int c = rxBuffer.front();
+    rxBuffer.pop_front();
+    return c;
+  }
+
+  uint64_t serialNextArrival()
+  {
+    return rxLine.empty() ? NEVER : rxLine.front().first;
+  }
+
+  int serialTxFree()
+  {
+    return SERIAL_BUFFER_SIZE - 1 - txQueued;
+  }
+
+  void serialWrite(uint8_t c)
+  {
+    // A full TX buffer blocks the caller until the UART has shifted a byte out.
+    while (txQueued >= SERIAL_BUFFER_SIZE - 1)
+    {
+      if (insideIsr)
+      {
+        now = txNextDone;
+        txQueued--;
+        txNextDone = txQueued > 0 ? now + byteCycles() : NEVER;
+      }
+      else
+      {
+        advanceMain(txNextDone);
+      }
+    }
+    output.push_back((char)c);
+    if (txQueued++ == 0)
+      txNextDone = now + byteCycles();
+  }
+
+  void serialFlush()
+  {
+    while (txQueued > 0)
+      idleUntil(txNextDone);
+  }
+
+  // --- Pin internals used by the Arduino API ---
+  bool validPin(uint8_t pin)
+  {
+    return pin < NUM_DIGITAL_PINS;
+  }
+
+  void pinSetMode(uint8_t pin, uint8_t mode)
+  {
+    Port &p = ports[PIN_PORT[pin]];
+    int portIndex = PIN_PORT[pin];
+    uint8_t mask = _BV(PIN_BIT[pin]);
+    uint8_t before = portLevels(p);
+    if (mode == OUTPUT)
+    {
+      p.ddr |= mask;
+    }
+    else
+    {
+      p.ddr &= ~mask;
+      if (mode == INPUT_PULLUP)
+        p.port |= mask;
+      else
+        p.port &= ~mask;
+    }
+    recordEdges(portIndex, before, portLevels(p));
+  }
+
+  void pinWrite(uint8_t pin, uint8_t value)
+  {
+    int portIndex = PIN_PORT[pin];
+    uint8_t mask = _BV(PIN_BIT[pin]);
+    writePort(portIndex, value ? (ports[portIndex].port | mask) : (ports[portIndex].port & ~mask));
+  }
+
+  uint8_t pinPortIndex(uint8_t pin)
+  {
+    return PIN_PORT[pin];
+  }
+
+  uint8_t pinBit(uint8_t pin)
+  {
+    return PIN_BIT[pin];
+  }
+
+  void attach(uint8_t interruptNum, void (*fn)(void), int mode)
+  {
+    if (interruptNum < NUM_EXTERNAL_INTERRUPTS)
+      attached[interruptNum] = {fn, mode};
+  }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Host-side model of the ATmega2560 the firmware runs on.
+ *
+ * Time is a deterministic virtual clock counted in CPU cycles at 16 MHz. It only moves
+ * when the firmware spends time: Arduino API calls are charged a fixed cost from
+ * `sim::costs`, `delayMicroseconds()` burns the requested time and the driver charges
+ * the cost of each `loop()` pass. Whenever the main context spends time, the 16-bit
+ * timers, the external interrupts and the UART are advanced and their ISRs run at the
+ * cycle the hardware would have fired them, charging their own cost on top.
+ */
+namespace sim
+{
+  const uint32_t CPU_HZ = 16000000UL;
+  const uint32_t CYCLES_PER_MICROSECOND = CPU_HZ / 1000000UL;
+
+  /**
+   * @brief Cycles charged for each Arduino API call.
+   *
+   * The defaults are measured figures for the AVR core; override them to model a
+   * different core or to see how sensitive a benchmark is to the HAL cost. Arithmetic is
+   * not charged, except the division of the step ramp, which runs on every ramp step and
+   * costs about as much as the rest of a step.
+   */
+  struct CostModel
+  {
+    uint32_t digitalWrite = 56;
+    uint32_t digitalRead = 48;
+    uint32_t pinMode = 64;
+    uint32_t micros = 56;
+    uint32_t portAccess = 2;   // One in/out or sbi/cbi on an I/O register
+    uint32_t isrOverhead = 72; // Vectoring, prologue and epilogue of an ISR that calls a function
+    uint32_t uartIsr = 90;     // USART RX complete / UDRE ISR of HardwareSerial
+    uint32_t serialPoll = 20;  // Serial.available() / Serial.peek()
+    uint32_t serialRead = 30;
+    uint32_t serialWrite = 40; // Serial.write() of one byte with room in the TX buffer
+    uint32_t loopOverhead = 20; // main() calling loop() and serialEventRun()
+    uint32_t division = 600;    // Estimate of libgcc's 32-bit division, charged by `StepRamp::next()`
+  };
+  extern CostModel costs;
+
+  /// One level change on an output pin.
+  struct Edge
+  {
+    uint64_t cycle;
+    uint8_t pin;
+    uint8_t level;
+  };
+
+  // --- Clock ---
+  uint64_t cycles();
+  double seconds();
+  /// Spends `n` cycles in the current context (main or ISR).
+  void charge(uint64_t n);
+  /// Lets the main context idle until `cycle`, servicing interrupts on the way.
+  void idleUntil(uint64_t cycle);
+  bool inIsr();
+  /// Total cycles spent inside ISRs since the last reset.
+  uint64_t isrCycles();
+
+  // --- Pins ---
+  /// Drives an input pin from outside the chip, at the current cycle.
+  void setInput(uint8_t pin, uint8_t level);
+  /// Drives an input pin from outside the chip at a future cycle.
+  void scheduleInput(uint64_t cycle, uint8_t pin, uint8_t level);
+  uint8_t pinLevel(uint8_t pin);
+  /// Records every level change of `pin` in `edges()`.
+  void tracePin(uint8_t pin, bool enabled = true);
+  const std::vector<Edge> &edges();
+  void clearEdges();
+
+  /**
+   * @brief An interrupt source that is not one of the modelled peripherals.
+   *
+   * Host backends of the firmware (a timer the simulator does not model at register
+   * level, for instance) arm it for a cycle; the handler then runs as an ISR at that
+   * cycle, after the hardware interrupts, and may arm it again.
+   */
+  struct SoftInterrupt
+  {
+    void (*handler)(void *context);
+    void *context;
+    uint64_t due;
+    bool armed;
+  };
+  void armInterrupt(SoftInterrupt &irq, uint64_t cycle);
+  void disarmInterrupt(SoftInterrupt &irq);
+
+  // --- Serial ---
+  /// Queues text on the RX line, starting at `cycle` and paced at the configured baud rate.
+  void serialInject(const std::string &text, uint64_t cycle);
+  void serialInject(const std::string &text);
+  /// Returns and clears everything the firmware has written so far.
+  std::string serialTakeOutput();
+  uint32_t serialRxOverflows();
+
+  /// Restores the power-on state: clock at zero, registers, pins and serial cleared.
+  void reset();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+// Hooks between the simulator core and the Arduino API implemented on top of it.
+namespace sim
+{
+  void serialBegin(unsigned long baud);
+  int serialAvailable();
+  int serialPeek();
+  int serialRead();
+  uint64_t serialNextArrival();
+  int serialTxFree();
+  void serialWrite(uint8_t c);
+  void serialFlush();
+
+  bool validPin(uint8_t pin);
+  void pinSetMode(uint8_t pin, uint8_t mode);
+  void pinWrite(uint8_t pin, uint8_t value);
+  /// Port index of `pin`, A = 0 to L = 10, and its bit in the port.
+  uint8_t pinPortIndex(uint8_t pin);
+  uint8_t pinBit(uint8_t pin);
+  void attach(uint8_t interruptNum, void (*fn)(void), int mode);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Memory-mapped I/O registers of the simulated ATmega2560.
+ *
+ * Each register name expands to a small proxy that forwards reads and writes to the
+ * simulator, so timer, port and status register accesses keep their side effects:
+ * reading TCNTn returns the count at the current cycle, writing 1 to a TIFRn bit clears
+ * it and writing PORTx records the resulting pin edges.
+ */
+namespace sim
+{
+  enum RegisterId : uint16_t
+  {
+    REG_SREG = 0x0000,
+    REG_TIMER = 0x0100, // | timer number << 4 | field
+    REG_PORT = 0x0200,  // | port index << 4 | field
+  };
+
+  enum TimerField : uint8_t
+  {
+    TIMER_TCCRA,
+    TIMER_TCCRB,
+    TIMER_TCCRC,
+    TIMER_TCNT,
+    TIMER_OCRA,
+    TIMER_OCRB,
+    TIMER_OCRC,
+    TIMER_ICR,
+    TIMER_TIMSK,
+    TIMER_TIFR,
+  };
+
+  enum PortField : uint8_t
+  {
+    PORT_PIN,
+    PORT_DDR,
+    PORT_PORT,
+  };
+
+  uint16_t readRegister(uint16_t id);
+  void writeRegister(uint16_t id, uint16_t value);
+
+  class Register
+  {
+  public:
+    constexpr explicit Register(uint16_t id) : id(id) {}
+    operator uint16_t() const { return readRegister(id); }
+    const Register &operator=(uint16_t value) const
+    {
+      writeRegister(id, value);
+      return *this;
+    }
+    const Register &operator=(const Register &other) const { return *this = (uint16_t)other; }
+    const Register &operator|=(uint16_t value) const { return *this = (uint16_t)(*this | value); }
+    const Register &operator&=(uint16_t value) const { return *this = (uint16_t)(*this & value); }
+    const Register &operator^=(uint16_t value) const { return *this = (uint16_t)(*this ^ value); }
+    const Register &operator+=(uint16_t value) const { return *this = (uint16_t)(*this + value); }
+    const Register &operator-=(uint16_t value) const { return *this = (uint16_t)(*this - value); }
+
+  private:
+    uint16_t id;
+  };
+
+  /**
+   * @brief What `portOutputRegister()` returns: the address of a port register, which
+   * dereferences to its proxy, so `*port |= mask` reads as on the board.
+   */
+  class RegisterPointer
+  {
+  public:
+    constexpr RegisterPointer(uint16_t id = 0) : id(id) {}
+    Register operator*() const { return Register(id); }
+    bool operator==(const RegisterPointer &other) const { return id == other.id; }
+    bool operator!=(const RegisterPointer &other) const { return id != other.id; }
+
+  private:
+    uint16_t id;
+  };
+
+  constexpr uint16_t timerRegister(uint8_t timer, TimerField field) { return REG_TIMER | (timer << 4) | field; }
+  constexpr uint16_t portRegister(uint8_t port, PortField field) { return REG_PORT | (port << 4) | field; }
+}
@@ -0,0 +1,102 @@
+#include "Arduino.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <iostream>
+#include <iterator>
+
+/**
+ * Default entry point of the native build: runs the sketch on the virtual clock.
+ *
+ *   program [--seconds S] [--input SECONDS,PIN,LEVEL]... [--trace FILE] < commands.txt
+ *
+ * Standard input is sent to `Serial` from the start, at the configured baud rate, and
+ * whatever the sketch prints goes to standard output. `--input` drives a pin from outside
+ * at the given time (a limit switch or the E-Stop, for instance). Every edge of every
+ * pin is recorded; `--trace` writes them as CSV and a per-pin summary goes to
+ * standard error.
+ *
+ * Programs that drive the simulator themselves (benchmarks) define their own `main()`.
+ */
+__attribute__((weak)) int main(int argc, char *argv[])
+{
+  double runSeconds = 5;
+  const char *tracePath = nullptr;
+
+  sim::reset();
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+    {
+      runSeconds = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+    {
+      tracePath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+    {
+      double at;
+      int pin, level;
+      if (sscanf(argv[++i], "%lf,%d,%d", &at, &pin, &level) != 3)
+      {
+        fprintf(stderr, "Bad --input %s, expected SECONDS,PIN,LEVEL\n", argv[i]);
+        return 2;
+      }
+      sim::scheduleInput((uint64_t)(at * sim::CPU_HZ), pin, level);
+    }
+    else
+    {
+      fprintf(stderr, "Usage: %s [--seconds S] [--input SECONDS,PIN,LEVEL]... [--trace FILE] < commands\n", argv[0]);
+      return 2;
+    }
+  }
+
+  for (uint8_t pin = 0; pin < NUM_DIGITAL_PINS; pin++)
+  {
+    sim::tracePin(pin);
+  }
+  std::string commands((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+  sim::serialInject(commands, 0);
+
+  setup();
+  uint64_t end = (uint64_t)(runSeconds * sim::CPU_HZ);
+  while (sim::cycles() < end)
+  {
+    loop();
+    sim::charge(sim::costs.loopOverhead);
+    std::string output = sim::serialTakeOutput();
+    fwrite(output.data(), 1, output.size(), stdout);
+  }
+  fflush(stdout);
+
+  unsigned long rising[NUM_DIGITAL_PINS] = {0};
+  for (const sim::Edge &edge : sim::edges())
+  {
+    if (edge.level)
+      rising[edge.pin]++;
+  }
+  for (uint8_t pin = 0; pin < NUM_DIGITAL_PINS; pin++)
+  {
+    if (rising[pin])
+      fprintf(stderr, "pin %u: %lu rising edges\n", pin, rising[pin]);
+  }
+  fprintf(stderr, "%.3f s simulated, %.1f%% in ISRs\n", sim::seconds(), 100.0 * sim::isrCycles() / sim::cycles());
+
+  if (tracePath)
+  {
+    FILE *trace = fopen(tracePath, "w");
+    if (trace == nullptr)
+    {
+      perror(tracePath);
+      return 1;
+    }
+    fprintf(trace, "cycle,microseconds,pin,level\n");
+    for (const sim::Edge &edge : sim::edges())
+    {
+      fprintf(trace, "%llu,%.3f,%u,%u\n", (unsigned long long)edge.cycle, (double)edge.cycle / sim::CYCLES_PER_MICROSECOND, edge.pin, edge.level);
+    }
+    fclose(trace);
+  }
+  return 0;
+}
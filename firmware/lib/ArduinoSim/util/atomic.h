@@ -0,0 +1,31 @@
+#pragma once
+
+#include <avr/interrupt.h>
+
+// Same contract as avr-libc: the body runs with interrupts disabled and SREG is put back
+// (ATOMIC_RESTORESTATE) or interrupts are re-enabled (ATOMIC_FORCEON) on every exit path.
+
+namespace sim
+{
+  class AtomicGuard
+  {
+  public:
+    explicit AtomicGuard(bool forceOn) : saved(SREG), forceOn(forceOn) { cli(); }
+    ~AtomicGuard()
+    {
+      if (forceOn)
+        sei();
+      else
+        SREG = saved;
+    }
+    bool once = true;
+
+  private:
+    uint8_t saved;
+    bool forceOn;
+  };
+}
+
+#define ATOMIC_RESTORESTATE false
+#define ATOMIC_FORCEON true
+#define ATOMIC_BLOCK(type) for (::sim::AtomicGuard _atomicGuard(type); _atomicGuard.once; _atomicGuard.once = false)
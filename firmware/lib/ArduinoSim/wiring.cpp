@@ -0,0 +1,112 @@
+#include "Arduino.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  sim::charge(sim::costs.pinMode);
+  if (sim::validPin(pin))
+    sim::pinSetMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  sim::charge(sim::costs.digitalWrite);
+  if (sim::validPin(pin))
+    sim::pinWrite(pin, value);
+}
+
+void digitalWriteFast(uint8_t pin, uint8_t value)
+{
+  sim::charge(sim::costs.portAccess);
+  if (sim::validPin(pin))
+    sim::pinWrite(pin, value);
+}
+
+uint8_t digitalPinToPort(uint8_t pin)
+{
+  if (!sim::validPin(pin))
+    return NOT_A_PORT;
+  uint8_t index = sim::pinPortIndex(pin);
+  return index < 8 ? index + 1 : index + 2; // No port I
+}
+
+uint8_t digitalPinToBitMask(uint8_t pin)
+{
+  return sim::validPin(pin) ? _BV(sim::pinBit(pin)) : 0;
+}
+
+sim::RegisterPointer portOutputRegister(uint8_t port)
+{
+  uint8_t index = port <= 8 ? port - 1 : port - 2;
+  return sim::portRegister(index, sim::PORT_PORT);
+}
+
+int digitalRead(uint8_t pin)
+{
+  sim::charge(sim::costs.digitalRead);
+  return sim::pinLevel(pin);
+}
+
+unsigned long micros()
+{
+  sim::charge(sim::costs.micros);
+  // Timer0 ticks every 4 us, so micros() has the same 4 us resolution as on the board.
+  return (unsigned long)(sim::cycles() / (4 * sim::CYCLES_PER_MICROSECOND)) * 4;
+}
+
+unsigned long millis()
+{
+  sim::charge(sim::costs.micros);
+  return (unsigned long)(sim::cycles() / (1000 * sim::CYCLES_PER_MICROSECOND));
+}
+
+void delay(unsigned long ms)
+{
+  sim::charge((uint64_t)ms * 1000 * sim::CYCLES_PER_MICROSECOND);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  sim::charge((uint64_t)us * sim::CYCLES_PER_MICROSECOND);
+}
+
+void yield()
+{
+}
+
+int digitalPinToInterrupt(uint8_t pin)
+{
+  switch (pin)
+  {
+  case 2:
+    return 0;
+  case 3:
+    return 1;
+  case 21:
+    return 2;
+  case 20:
+    return 3;
+  case 19:
+    return 4;
+  case 18:
+    return 5;
+  default:
+    return NOT_AN_INTERRUPT;
+  }
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
+{
+  sim::attach(interruptNum, userFunc, mode);
+}
+
+void detachInterrupt(uint8_t interruptNum)
+{
+  sim::attach(interruptNum, nullptr, 0);
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
@@ -1,153 +1,220 @@
 #include <Arduino.h>
+#include <util/atomic.h>
 #include "MyAccelStepper.h"
+#include "MyAccelStepperScheduler.h"
+
+/// @brief Sets or clears `mask` in the port register `port`, with interrupts off as
+/// digitalWrite() does: the ports above G are not bit addressable, and a write from an
+/// interrupt between the read and the write back would be undone.
+template <typename PORT>
+static inline void writePort(PORT port, uint8_t mask, uint8_t level)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (level == HIGH)
+            *port |= mask;
+        else
+            *port &= ~mask;
+    }
+}
+
+MyAccelStepper::Profile::Profile(float maxSpeed, float acceleration)
+{
+    this->maxSpeed = fabs(maxSpeed);
+    this->acceleration = fabs(acceleration);
+    minStepInterval = 1000000.0 / this->maxSpeed; // Convert steps per <second> to microseconds per <step>
+    // initial step interval per Equation 7, with correction per Equation 15
+    initialStepInterval = StepRamp::firstPeriod(1000000, this->acceleration);
+    periodScale = StepRamp::periodScale(1000000, this->acceleration);
+}
 
 MyAccelStepper::MyAccelStepper(uint8_t stepPin, uint8_t dirPin)
 {
     _directionPin = dirPin;
     _stepPin = stepPin;
+    _directionPort = portOutputRegister(digitalPinToPort(dirPin));
+    _stepPort = portOutputRegister(digitalPinToPort(stepPin));
+    _directionMask = digitalPinToBitMask(dirPin);
+    _stepMask = digitalPinToBitMask(stepPin);
     pinMode(_directionPin, OUTPUT);
     pinMode(_stepPin, OUTPUT);
 
-    _speed = 0;
-    _currentStep = 0;
-    _initialStepInterval = 0;
+    _currentPosition = 0;
+    _targetPosition = 0;
+    _ramp.start(0, 0);
     _currentStepInterval = 0;
-    _minStepInterval = 0;
     _direction = DIRECTION_CCW;
-
-    setAcceleration(1);
-    setMaxSpeed(1);
+    _directionPinLevel = DIRECTION_CCW;
+    writePort(_directionPort, _directionMask, LOW);
+    _scheduler = nullptr;
+    _heapIndex = NOT_SCHEDULED;
+    _pulseHigh = false;
 }
 
 void MyAccelStepper::setMaxSpeed(float newMaxSpeed)
 {
-    if (newMaxSpeed < 0.0)
+    if (fabs(newMaxSpeed) != _profile.maxSpeed)
     {
-        newMaxSpeed = -newMaxSpeed;
-    }
-
-    if (_maxSpeed != newMaxSpeed)
-    {
-        _maxSpeed = newMaxSpeed;
-        _minStepInterval = 1000000.0 / _maxSpeed; // Convert steps per <second> to microseconds per <step>
-
-        // Recompute _currentStep from current speed and adjust speed if accelerating or cruising
-        if (_currentStep > 0)
-        {
-            _currentStep = (long)((_speed * _speed) / (2 * _acceleration)); // equation 16
-            calculateNextStepInterval();
-        }
+        setProfile(Profile(newMaxSpeed, _profile.acceleration));
     }
 }
 
 void MyAccelStepper::setAcceleration(float acceleration)
 {
-    if (acceleration == 0.0)
-        return;
-
-    if (acceleration < 0.0)
+    if (acceleration != 0.0 && fabs(acceleration) != _profile.acceleration)
     {
-        acceleration = -acceleration;
+        setProfile(Profile(_profile.maxSpeed, acceleration));
     }
+}
 
-    if (_acceleration != acceleration)
+void MyAccelStepper::setProfile(const Profile &profile)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        // recompute current step per Equation 17
-        _currentStep = _currentStep * (_acceleration / acceleration);
-        // new initial step interval per Equation 7, with correction per Equation 15
-        _initialStepInterval = 0.676 * sqrt(2.0 / acceleration) * 1000000.0; // Equation 15
-
-        _acceleration = acceleration;
-        calculateNextStepInterval();
+        _profile = profile;
+        if (_currentStepInterval != 0 && _ramp.step() != -1)
+        {
+            // Carry on from the current speed: its step index under the new acceleration (Equations 16 and 17).
+            // The next step keeps the interval already worked out; calculateNextStepInterval() then ramps
+            // to the new maximum speed.
+            long steps = StepRamp::stepsAtPeriod(_profile.periodScale, _currentStepInterval);
+            _ramp.start(_currentStepInterval, _ramp.step() >= 0 ? steps : -steps - 1);
+        }
     }
 }
 
 long MyAccelStepper::distanceToGo()
 {
-    return _targetPosition - _currentPosition;
+    long distance;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        distance = _targetPosition - _currentPosition;
+    }
+    return distance;
 }
 
 long MyAccelStepper::currentPosition()
 {
-    return _currentPosition;
+    long position;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        position = _currentPosition;
+    }
+    return position;
+}
+
+long MyAccelStepper::stepsToStop()
+{
+    if (_currentStepInterval == 0)
+    {
+        return 0;
+    }
+    // steps = speed^2 / (2 * acceleration) // equation 16
+    // The ramp's step index n is that number while accelerating, and counts down to -1 while decelerating.
+    long stepIndex = _ramp.step();
+    return stepIndex >= 0 ? stepIndex : -stepIndex - 1;
 }
 
 unsigned long MyAccelStepper::calculateNextStepInterval()
 {
-    long distanceRemaining = distanceToGo();
+    long distanceRemaining = _targetPosition - _currentPosition;
 
     // steps required to stop
-    // steps = speed^2 / (2 * acceleration) // equation 16
-    long stepsToStop = (_speed * _speed) / (2 * _acceleration);
+    long stepsToStop = this->stepsToStop();
 
     // Check if we are at the target position and should stop
     if (distanceRemaining == 0 && stepsToStop <= 1)
     {
         _currentStepInterval = 0;
-        _speed = 0;
-        _currentStep = 0;
         return _currentStepInterval;
     }
 
-    // Check if we need to start decelerating
-    if (distanceRemaining > 0)
+    if (_currentStepInterval == 0 || _ramp.step() == -1)
     {
-        if (_currentStep > 0 && (stepsToStop >= distanceRemaining || _direction == DIRECTION_CCW))
-        {
-            _currentStep = -stepsToStop;
-        }
+        // first step, start from standstill (or from the end of a deceleration)
+        _ramp.start(_profile.initialStepInterval, 0);
+        _direction = (distanceRemaining > 0) ? DIRECTION_CW : DIRECTION_CCW;
+        updateDirectionPin();
     }
-    else if (distanceRemaining < 0)
+    else
     {
-        if (_currentStep > 0 && (stepsToStop > -distanceRemaining || _direction == DIRECTION_CW))
+        // Steps left before the target in the direction of travel; negative when it lies behind
+        long stepsAhead = _direction == DIRECTION_CW ? distanceRemaining : -distanceRemaining;
+        boolean isDecelerating = _ramp.step() < 0;
+        if (stepsToStop >= stepsAhead)
         {
-            _currentStep = -stepsToStop;
+            // Slow down to stop at the target, or to turn round
+            if (!isDecelerating)
+            {
+                _ramp.start(_currentStepInterval, -stepsToStop - 1);
+            }
+            _ramp.next();
         }
+        else if (_currentStepInterval < _profile.minStepInterval)
+        {
+            // Slow down to a maximum speed lowered since, and cruise once there
+            if (!isDecelerating)
+            {
+                _ramp.start(_currentStepInterval, -stepsToStop - 1);
+            }
+            if (_ramp.next() >= _profile.minStepInterval)
+            {
+                _ramp.start(_profile.minStepInterval, StepRamp::stepsAtPeriod(_profile.periodScale, _profile.minStepInterval));
+            }
+        }
+        else if (isDecelerating || _currentStepInterval > _profile.minStepInterval)
+        {
+            // Speed up, also out of a deceleration no longer needed, from the current speed
+            if (isDecelerating)
+            {
+                _ramp.start(_currentStepInterval, StepRamp::stepsAtPeriod(_profile.periodScale, _currentStepInterval));
+            }
+            // interval_n = interval_n-1 - (2 * interval_n-1 ) / (4*n + 1)
+            _ramp.next();
+        }
+        // Otherwise cruise at the maximum speed. The ramp holds, so that its step index still gives the steps to stop.
     }
 
-    // Calculate the Step Interval
-    if (_currentStep == 0)
-    {
-        // first step, start from standstill
-        _currentStepInterval = _initialStepInterval;
-        _direction = (distanceRemaining > 0) ? DIRECTION_CW : DIRECTION_CCW;
-    }
-    else
-    {
-        // Subsequent steps
-        // interval_n = interval_n-1 - (2 * interval_n-1 ) / (4*currentStep + 1)
-        _currentStepInterval = _currentStepInterval - (2 * _currentStepInterval) / (4 * _currentStep + 1);
-
-        // Ensure the step interval does not go below the minimum
-        // Make sure it satisfies the max speed constraint
-        _currentStepInterval = max(_currentStepInterval, _minStepInterval);
-    }
+    // Ensure the step interval does not go below the minimum
+    // Make sure it satisfies the max speed constraint, unless slowing down to it
+    _currentStepInterval = _ramp.step() < 0 ? _ramp.period() : max(_ramp.period(), _profile.minStepInterval);
+    return _currentStepInterval;
+}
 
-    _currentStep++;
-    _speed = 1000000.0 / _currentStepInterval; // Convert microseconds to steps per second
-    if (_direction == DIRECTION_CCW)
+void MyAccelStepper::updateDirectionPin()
+{
+    // Set the direction pin when the direction changes, at least one step interval before the step
+    if (_direction != _directionPinLevel && !_pulseHigh)
     {
-        _speed = -_speed; // If the direction is counter-clockwise, make the speed negative
+        writePort(_directionPort, _directionMask, _direction ? HIGH : LOW);
+        _directionPinLevel = _direction;
     }
-    return _currentStepInterval;
 }
 
 void MyAccelStepper::step()
 {
-    // Set the direction based on the current direction
-    digitalWrite(_directionPin, _direction ? HIGH : LOW);
     // Set the step pin high
-    digitalWrite(_stepPin, HIGH);
+    writePort(_stepPort, _stepMask, HIGH);
     delayMicroseconds(MIN_PULSE_WIDTH); // Minimum pulse width
     // Set the step pin low
-    digitalWrite(_stepPin, LOW);
+    writePort(_stepPort, _stepMask, LOW);
+}
+
+void MyAccelStepper::startStepping()
+{
+#ifdef MY_ACCEL_STEPPER_TIMER
+    if (_scheduler != nullptr && _currentStepInterval != 0)
+    {
+        _scheduler->schedule(*this);
+    }
+#endif
 }
 
 boolean MyAccelStepper::runWithCurrentStepInterval()
 {
-    if (!_currentStepInterval)
+    if (!_currentStepInterval || _scheduler != nullptr)
     {
-        return false; // No step interval set, nothing to run
+        return false; // No step interval set, or the scheduler steps the motor
     }
 
     unsigned long currentTime = micros();
@@ -173,56 +240,85 @@ boolean MyAccelStepper::runWithCurrentStepInterval()
 
 boolean MyAccelStepper::run()
 {
+    if (_scheduler != nullptr)
+    {
+        boolean moving;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            moving = _currentStepInterval != 0 || _targetPosition != _currentPosition;
+        }
+        return moving;
+    }
+
     if (runWithCurrentStepInterval())
     {
         calculateNextStepInterval(); // Update the step interval for the next run
     }
 
-    return _speed != 0 || distanceToGo() != 0;
+    return _currentStepInterval != 0 || distanceToGo() != 0;
 }
 
 void MyAccelStepper::eStop()
 {
-    _speed = 0.0;
-    _targetPosition = _currentPosition; // Stop at the current position
+    // A scheduled step still pending finds the interval cleared and is dropped.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _currentStepInterval = 0;
+        _targetPosition = _currentPosition; // Stop at the current position
+    }
 }
 
 void MyAccelStepper::stop()
 {
-    if (_speed != 0.0)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        long stepsToStop = (long)((_speed * _speed) / (2.0 * _acceleration)) + 1;
-
-        if (_speed > 0)
-        {
-            moveBy(stepsToStop);
-        }
-        else
+        if (_currentStepInterval != 0)
         {
-            moveBy(-stepsToStop);
+            long stepsToStop = this->stepsToStop() + 1;
+
+            if (_direction == DIRECTION_CW)
+            {
+                moveBy(stepsToStop);
+            }
+            else
+            {
+                moveBy(-stepsToStop);
+            }
         }
     }
 }
 
 void MyAccelStepper::setCurrentPosition(long position)
 {
-    _targetPosition = position;
-    _currentPosition = position;
-    _currentStep = 0; // Reset the step count
-    _currentStepInterval = 0;
-    _speed = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _targetPosition = position;
+        _currentPosition = position;
+        _currentStepInterval = 0; // Standing still, the next move starts from the initial step interval
+    }
 }
 
 void MyAccelStepper::moveTo(long absolute)
 {
-    if (_targetPosition != absolute)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        _targetPosition = absolute;
-        calculateNextStepInterval();
+        if (_targetPosition != absolute)
+        {
+            boolean standing = _currentStepInterval == 0;
+            _targetPosition = absolute;
+            calculateNextStepInterval();
+            if (standing)
+            {
+                startStepping();
+            }
+        }
     }
 }
 
 void MyAccelStepper::moveBy(long relative)
 {
-    moveTo(_currentPosition + relative);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        moveTo(_currentPosition + relative);
+    }
 }
@@ -2,24 +2,64 @@
 #define MyAccelStepper_h
 
 #include <Arduino.h>
+#include <StepRamp.h>
 
 constexpr unsigned int MIN_PULSE_WIDTH = 1; // Minimum pulse width in microseconds
 
+class MyAccelStepperScheduler;
+
+/// @brief Stepper with a constant acceleration ramp, stepped either by polling `run()` from
+/// the main loop or, once attached to the `MyAccelStepperScheduler`, from its timer interrupt.
+///
+/// The step and direction pins are written straight to their port registers, and the
+/// direction pin only when the direction changes. While attached, every method may be
+/// called from the main loop at any time: the state the interrupt shares is read and
+/// written with interrupts off.
+///
+/// Speed and acceleration make up a `Profile`, which works out the step intervals they
+/// take in advance. Switching profiles, mid-move too, is then integer arithmetic only:
+/// the ramp carries on from the current speed, speeding up or slowing down at the new
+/// acceleration to the new maximum speed.
 class MyAccelStepper
 {
 public:
+    /// @brief A maximum speed and an acceleration, with what the step loop needs of them precomputed.
+    ///
+    /// Making one takes float arithmetic and square roots; make them once and switch
+    /// between them with `setProfile()`.
+    struct Profile
+    {
+        /// @param maxSpeed In steps per second.
+        /// @param acceleration In steps per second squared, greater than 0.
+        Profile(float maxSpeed = 1, float acceleration = 1);
+
+        float maxSpeed;
+        float acceleration;
+        unsigned long minStepInterval;     // Step interval at the maximum speed, in microseconds
+        unsigned long initialStepInterval; // First step interval from rest, in microseconds (Equation 15)
+        uint32_t periodScale;              // Turns a step interval into the ramp's step index, see StepRamp::stepsAtPeriod()
+    };
+
     MyAccelStepper(uint8_t stepPin, uint8_t dirPin);
 
     void moveTo(long absolute);
     void moveBy(long relative);
-    /// @brief Sets the maximum speed in steps per second.
+    /// @brief Sets the maximum speed in steps per second, making a new profile.
     /// @param speed steps per second
     void setMaxSpeed(float speed);
 
-    /// @brief Sets the acceleration/deceleration rate in steps per second squared.
+    /// @brief Sets the acceleration/deceleration rate in steps per second squared, making a new profile.
     /// @param acceleration acceleration in steps per second squared
     void setAcceleration(float acceleration);
 
+    /// @brief Switches to `profile`, in constant time and without float arithmetic.
+    ///
+    /// A moving motor keeps its speed for the step already timed, then rejoins the ramp of
+    /// the new acceleration at that speed.
+    void setProfile(const Profile &profile);
+
+    const Profile &profile() const { return _profile; }
+
     /// @brief The distance from the current position to the target position.
     /// @return In steps. positive is clockwise, negative is counter-clockwise from the current position.
     long distanceToGo();
@@ -32,13 +72,30 @@ public:
 
     void eStop();
 
+    /// @brief Steps the motor if a step is due, when polled; attached to the scheduler, it
+    /// only reports.
+    /// @return Whether the motor is still moving or has somewhere to go.
     boolean run();
 
     boolean runWithCurrentStepInterval();
 
 private:
+    friend class MyAccelStepperScheduler;
+
+    static const uint8_t NOT_SCHEDULED = 0xFF;
+
+#ifdef SIMULATION_HAL
+    typedef sim::RegisterPointer PortRegister;
+#else
+    typedef volatile uint8_t *PortRegister;
+#endif
+
     uint8_t _directionPin; // Pin to control the direction of the stepper motor
     uint8_t _stepPin;      // Pin to send step pulses to the stepper
+    PortRegister _directionPort;
+    PortRegister _stepPort;
+    uint8_t _directionMask;
+    uint8_t _stepMask;
     typedef enum
     {
         DIRECTION_CCW = 0,
@@ -47,26 +104,37 @@ private:
 
     /// @brief The current direction of the stepper motor. true == CW
     boolean _direction;
+    /// @brief The direction the pin was last set to, written again only when `_direction` differs.
+    boolean _directionPinLevel;
 
-    unsigned long _stepInterval; // The time between steps in microseconds
-    float _minStepInterval;      // The minimum step interval in microseconds, calculated from the maximum speed
+    Profile _profile; // The maximum speed and acceleration
 
     long _currentPosition; // The current position in steps
     long _targetPosition;  // The target position in steps
-    float _speed;          // The current speed in steps per second
-    float _maxSpeed;       // The maximum speed in steps per second
-    float _acceleration;   // The acceleration in steps per second squared
 
-    long _currentStep;
-    float _initialStepInterval;  // The initial step interval in microseconds
-    float _currentStepInterval;  // The current step interval in microseconds
-    unsigned long _lastStepTime; // The last time a step was made in microseconds
+    StepRamp _ramp;                     // Step intervals in microseconds; its step index is the "n" of the equations
+    unsigned long _currentStepInterval; // The current step interval in microseconds, 0 when standing still
+    unsigned long _lastStepTime;        // The last time a step was made in microseconds
+
+    MyAccelStepperScheduler *_scheduler; // The scheduler stepping this motor, nullptr when polled
+    uint8_t _heapIndex;                  // Place in the scheduler's deadline heap, NOT_SCHEDULED when not in it
+    boolean _pulseHigh;                  // The scheduler raised the step pin and has not lowered it yet
 
-    /// @brief Computes the next step interval based on the current speed and acceleration. And updates the current speed.
-    /// @return
+    /// @brief Computes the next step interval based on the current speed and acceleration, in integer arithmetic.
+    /// @return The new step interval in microseconds, 0 once the motor has stopped.
     unsigned long calculateNextStepInterval();
 
+    /// @brief Steps needed to stop from the current speed (equation 16), read from the ramp's step index.
+    long stepsToStop();
+
+    /// @brief Writes the direction pin if `_direction` changed since it was last written,
+    /// unless the scheduler's pulse is still high: the pulse end writes it then.
+    void updateDirectionPin();
+
+    /// @brief Hands a motor that has just started moving to the scheduler, if it is attached.
+    void startStepping();
+
     void step();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,239 @@
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "MyAccelStepperScheduler.h"
+
+#ifdef MY_ACCEL_STEPPER_TIMER
+
+// Registers of Timer`MY_ACCEL_STEPPER_TIMER`. Timers 1, 3, 4 and 5 share their layout and bit positions.
+#define SCHEDULER_PASTE(prefix, timer, suffix) prefix##timer##suffix
+#define SCHEDULER_NAME(prefix, timer, suffix) SCHEDULER_PASTE(prefix, timer, suffix)
+#define SCHEDULER_REGISTER(prefix, suffix) SCHEDULER_NAME(prefix, MY_ACCEL_STEPPER_TIMER, suffix)
+
+#define SCHEDULER_TCCRA SCHEDULER_REGISTER(TCCR, A)
+#define SCHEDULER_TCCRB SCHEDULER_REGISTER(TCCR, B)
+#define SCHEDULER_TCNT SCHEDULER_REGISTER(TCNT, )
+#define SCHEDULER_OCRA SCHEDULER_REGISTER(OCR, A)
+#define SCHEDULER_OCRB SCHEDULER_REGISTER(OCR, B)
+#define SCHEDULER_TIMSK SCHEDULER_REGISTER(TIMSK, )
+#define SCHEDULER_TIFR SCHEDULER_REGISTER(TIFR, )
+
+namespace
+{
+    /// Timer ticks per microsecond at the /8 prescaler.
+    const uint32_t TICKS_PER_MICROSECOND = F_CPU / 8 / 1000000;
+
+    /// Width of the step pulses, one tick more for the count moving on while compare match B is armed.
+    const uint16_t PULSE_TICKS = MIN_PULSE_WIDTH * TICKS_PER_MICROSECOND + 1;
+
+    /// From a motor starting to its first step, time to arm the timer for it.
+    const uint32_t START_TICKS = 20 * TICKS_PER_MICROSECOND;
+
+    /// Steps due this soon are taken in the same interrupt, rather than in one that could
+    /// not start any sooner.
+    const int32_t EARLY_TICKS = 4 * TICKS_PER_MICROSECOND;
+
+    /// Longest wait between two compare matches, well within one turn of the count.
+    const uint32_t MAX_WAIT = 0x4000;
+
+    /// Whether deadline `a` comes before `b`, the clock wrapping round.
+    inline bool before(uint32_t a, uint32_t b)
+    {
+        return (int32_t)(a - b) < 0;
+    }
+}
+
+MyAccelStepperScheduler stepperScheduler;
+
+bool MyAccelStepperScheduler::attach(MyAccelStepper &stepper)
+{
+    bool attached = true;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (stepper._scheduler == this)
+        {
+            // Already attached
+        }
+        else if (_stepperCount == MAX_STEPPERS)
+        {
+            attached = false;
+        }
+        else
+        {
+            if (_stepperCount == 0)
+            {
+                SCHEDULER_TIMSK = 0;
+                SCHEDULER_TCCRA = 0;
+                SCHEDULER_TCCRB = _BV(SCHEDULER_REGISTER(CS, 1)); // Normal mode, /8
+                _clock = SCHEDULER_TCNT;
+            }
+            _steppers[_stepperCount++] = &stepper;
+            stepper._scheduler = this;
+            stepper._heapIndex = MyAccelStepper::NOT_SCHEDULED;
+            stepper.startStepping();
+        }
+    }
+    return attached;
+}
+
+uint32_t MyAccelStepperScheduler::now()
+{
+    uint16_t count = SCHEDULER_TCNT;
+    _clock += (uint16_t)(count - (uint16_t)_clock);
+    return _clock;
+}
+
+void MyAccelStepperScheduler::schedule(MyAccelStepper &stepper)
+{
+    uint32_t time = now();
+    uint8_t index = stepper._heapIndex;
+    if (index == MyAccelStepper::NOT_SCHEDULED)
+    {
+        // A motor stopped from the main loop keeps its place until its deadline, and takes it back here.
+        index = _heapSize++;
+    }
+    place(index, {time + START_TICKS, &stepper});
+    siftDown(siftUp(index));
+    if (_heap[0].stepper == &stepper)
+        arm(time);
+}
+
+bool MyAccelStepperScheduler::arm(uint32_t time)
+{
+    uint32_t wait = _heap[0].tick - time;
+    if ((int32_t)wait <= EARLY_TICKS)
+        return false;
+    if (wait > MAX_WAIT)
+        wait = MAX_WAIT;
+    SCHEDULER_TIFR = _BV(SCHEDULER_REGISTER(OCF, A));
+    SCHEDULER_OCRA = (uint16_t)(time + wait);
+    SCHEDULER_TIMSK |= _BV(SCHEDULER_REGISTER(OCIE, A));
+    // The count must not have reached the match while it was written.
+    uint16_t elapsed = SCHEDULER_TCNT - (uint16_t)time;
+    return elapsed + EARLY_TICKS < (int32_t)wait;
+}
+
+void MyAccelStepperScheduler::onCompareA()
+{
+    for (;;)
+    {
+        uint32_t time = now();
+        bool stepped = false;
+        while (_heapSize > 0 && !before(time + EARLY_TICKS, _heap[0].tick))
+        {
+            MyAccelStepper &stepper = *_heap[0].stepper;
+            if (stepper._currentStepInterval == 0)
+            {
+                removeFirst(); // Stopped from the main loop
+                continue;
+            }
+            *stepper._stepPort |= stepper._stepMask;
+            stepper._pulseHigh = true;
+            stepper._currentPosition += stepper._direction == MyAccelStepper::DIRECTION_CW ? 1 : -1;
+            stepped = true;
+
+            unsigned long interval = stepper.calculateNextStepInterval();
+            if (interval == 0)
+            {
+                removeFirst();
+            }
+            else
+            {
+                _heap[0].tick += interval * TICKS_PER_MICROSECOND;
+                siftDown(0);
+            }
+        }
+
+        if (stepped)
+        {
+            // The pulses end a pulse width from now, however long the steps above took.
+            SCHEDULER_OCRB = SCHEDULER_TCNT + PULSE_TICKS;
+            SCHEDULER_TIFR = _BV(SCHEDULER_REGISTER(OCF, B));
+            SCHEDULER_TIMSK |= _BV(SCHEDULER_REGISTER(OCIE, B));
+        }
+
+        if (_heapSize == 0)
+        {
+            SCHEDULER_TIMSK &= ~_BV(SCHEDULER_REGISTER(OCIE, A));
+            return;
+        }
+        if (arm(now()))
+            return;
+        // The next one fell due while these were stepped.
+    }
+}
+
+void MyAccelStepperScheduler::onCompareB()
+{
+    SCHEDULER_TIMSK &= ~_BV(SCHEDULER_REGISTER(OCIE, B));
+    for (uint8_t i = 0; i < _stepperCount; i++)
+    {
+        MyAccelStepper &stepper = *_steppers[i];
+        if (stepper._pulseHigh)
+        {
+            *stepper._stepPort &= ~stepper._stepMask;
+            stepper._pulseHigh = false;
+            stepper.updateDirectionPin();
+        }
+    }
+}
+
+void MyAccelStepperScheduler::place(uint8_t index, const Deadline &deadline)
+{
+    _heap[index] = deadline;
+    deadline.stepper->_heapIndex = index;
+}
+
+uint8_t MyAccelStepperScheduler::siftUp(uint8_t index)
+{
+    Deadline moving = _heap[index];
+    while (index > 0)
+    {
+        uint8_t parent = (index - 1) / 2;
+        if (!before(moving.tick, _heap[parent].tick))
+            break;
+        place(index, _heap[parent]);
+        index = parent;
+    }
+    place(index, moving);
+    return index;
+}
+
+void MyAccelStepperScheduler::siftDown(uint8_t index)
+{
+    Deadline moving = _heap[index];
+    for (;;)
+    {
+        uint8_t child = 2 * index + 1;
+        if (child >= _heapSize)
+            break;
+        if (child + 1 < _heapSize && before(_heap[child + 1].tick, _heap[child].tick))
+            child++;
+        if (!before(_heap[child].tick, moving.tick))
+            break;
+        place(index, _heap[child]);
+        index = child;
+    }
+    place(index, moving);
+}
+
+void MyAccelStepperScheduler::removeFirst()
+{
+    _heap[0].stepper->_heapIndex = MyAccelStepper::NOT_SCHEDULED;
+    if (--_heapSize > 0)
+    {
+        place(0, _heap[_heapSize]);
+        siftDown(0);
+    }
+}
+
+ISR(SCHEDULER_REGISTER(TIMER, _COMPA_vect))
+{
+    stepperScheduler.onCompareA();
+}
+
+ISR(SCHEDULER_REGISTER(TIMER, _COMPB_vect))
+{
+    stepperScheduler.onCompareB();
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef MyAccelStepperScheduler_h
+#define MyAccelStepperScheduler_h
+
+#include <Arduino.h>
+#include "MyAccelStepper.h"
+
+// Built with -DMY_ACCEL_STEPPER_TIMER=3, 4 or 5, the scheduler takes that 16-bit timer.
+// On the board it is then no longer one of the TS4 step timers.
+#ifdef MY_ACCEL_STEPPER_TIMER
+
+/// @brief Steps up to MAX_STEPPERS motors from the interrupts of one timer, each at its own rate.
+///
+/// Every moving motor has a deadline, the timer tick of its next step, in a min-heap.
+/// Compare match A is armed for the earliest one. When it fires, it raises the step pins
+/// of every motor that is due, moves each deadline on by that motor's next step interval
+/// and arms itself for the new earliest. Deadlines add up the intervals instead of counting
+/// from when the interrupt ran, so its latency is never added to a motor's speed. Compare
+/// match B lowers the pins a pulse width after the last one went up, and writes the
+/// direction pins of the motors that turned round.
+///
+/// The timer counts freely at 0.5 microseconds per tick. Its 16-bit count is extended to
+/// 32 bits each time it is read, and compare match A fires at least every MAX_WAIT ticks
+/// so that no wrap goes unseen.
+class MyAccelStepperScheduler
+{
+public:
+    static const uint8_t MAX_STEPPERS = 6;
+
+    /// @brief Steps `stepper` from the timer from now on. Its `run()` then only reports.
+    /// @return false if MAX_STEPPERS motors are attached already.
+    bool attach(MyAccelStepper &stepper);
+
+    /// @brief Runs from the compare match interrupts.
+    void onCompareA();
+    void onCompareB();
+
+private:
+    friend class MyAccelStepper;
+
+    struct Deadline
+    {
+        uint32_t tick;
+        MyAccelStepper *stepper;
+    };
+
+    /// @brief Makes the next step of `stepper`, which has just started moving, due shortly.
+    /// Interrupts must be off.
+    void schedule(MyAccelStepper &stepper);
+
+    /// @brief The timer count, extended to 32 bits. Interrupts must be off.
+    uint32_t now();
+
+    /// @brief Arms compare match A for the earliest deadline, MAX_WAIT ticks ahead at most.
+    /// @return false if the count may pass it before it is armed: the motor is due now.
+    bool arm(uint32_t time);
+
+    void place(uint8_t index, const Deadline &deadline);
+    uint8_t siftUp(uint8_t index);
+    void siftDown(uint8_t index);
+    void removeFirst();
+
+    MyAccelStepper *_steppers[MAX_STEPPERS];
+    uint8_t _stepperCount = 0;
+    Deadline _heap[MAX_STEPPERS]; // Earliest deadline first
+    uint8_t _heapSize = 0;
+    uint32_t _clock = 0; // Timer count at the last read, extended to 32 bits
+};
+
+extern MyAccelStepperScheduler stepperScheduler;
+
+#endif
+
+#endif
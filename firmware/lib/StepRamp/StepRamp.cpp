@@ -0,0 +1,48 @@
+#include <math.h>
+#include "StepRamp.h"
+
+// Keeps 4n + 1 well inside 32 bits for the slowest accelerations.
+const int32_t MAX_RAMP_STEPS = 0x10000000;
+// Longest period `next()` can double without overflowing its Q24.8 arithmetic.
+const uint32_t MAX_RAMP_PERIOD = 0x7FFFFF;
+
+uint32_t StepRamp::firstPeriod(uint32_t ticksPerSecond, float acceleration)
+{
+    float period = 0.676 * sqrt(2.0 / acceleration) * ticksPerSecond;
+    return period < MAX_RAMP_PERIOD ? (uint32_t)period : MAX_RAMP_PERIOD;
+}
+
+uint32_t StepRamp::periodOfStep(uint32_t ticksPerSecond, float acceleration, int32_t step)
+{
+    if (step <= 0)
+        return firstPeriod(ticksPerSecond, acceleration);
+    float period = ticksPerSecond / sqrt(2.0 * acceleration * (step + 0.5));
+    return period < MAX_RAMP_PERIOD ? (uint32_t)period : MAX_RAMP_PERIOD;
+}
+
+int32_t StepRamp::stepsFromRest(float speed, float acceleration)
+{
+    float steps = (speed * speed) / (2 * acceleration);
+    return steps < MAX_RAMP_STEPS ? (int32_t)steps : MAX_RAMP_STEPS;
+}
+
+uint32_t StepRamp::periodScale(uint32_t ticksPerSecond, float acceleration)
+{
+    float scale = 256.0 * ticksPerSecond / sqrt(2.0 * acceleration);
+    return scale < 0xFFFFFFFF ? (uint32_t)scale : 0xFFFFFFFF;
+}
+
+int32_t StepRamp::stepsAtPeriod(uint32_t scale, uint32_t period)
+{
+    // speed^2 / (2 * acceleration) = (scale / period)^2, with the root in Q24.8.
+    uint32_t root = period > 0 ? scale / period : 0xFFFFFFFF;
+    uint64_t steps = ((uint64_t)root * root) >> 16;
+    return steps < (uint64_t)MAX_RAMP_STEPS ? (int32_t)steps : MAX_RAMP_STEPS;
+}
+
+void StepRamp::start(uint32_t period, int32_t step)
+{
+    _periodQ8 = period << 8;
+    _remainder = 0;
+    _step = step;
+}
@@ -0,0 +1,93 @@
+#ifndef StepRamp_h
+#define StepRamp_h
+
+#include <stdint.h>
+#ifdef SIMULATION_HAL
+#include <sim.h>
+#endif
+
+/// @brief Integer step period generator for constant acceleration ramps.
+///
+/// Step n of a ramp from rest follows Austin's recurrence (Equation 13):
+///
+///     c_n = c_n-1 - 2 * c_n-1 / (4n + 1)
+///
+/// With n > 0 the steps speed up; with n < 0 they slow down, n counting the steps left
+/// before rest. Periods are kept in Q24.8 timer ticks, and the remainder of each division
+/// is carried into the next one, so the periods do not drift from the exact recurrence
+/// however long the ramp. A step costs one 32-bit integer division and no float. Periods
+/// must stay below 2^23 ticks.
+///
+/// The float parts, the first period and the step index of a speed, are computed once per
+/// move by the static helpers, outside the step loop.
+class StepRamp
+{
+public:
+    /// @brief Period of the first step from rest, with Austin's correction (Equation 15).
+    /// @param ticksPerSecond Frequency of the timer the periods are counted in.
+    /// @param acceleration In steps per second squared.
+    static uint32_t firstPeriod(uint32_t ticksPerSecond, float acceleration);
+
+    /// @brief Period of step `step` of a ramp from rest, which runs at about sqrt(2a * (step + 0.5)).
+    ///
+    /// Use it to join a ramp part way, so that the period and the step index agree.
+    static uint32_t periodOfStep(uint32_t ticksPerSecond, float acceleration, int32_t step);
+
+    /// @brief Number of steps to reach `speed` from rest, rounded down (Equation 16).
+    ///
+    /// A ramp accelerating from `speed` continues from step `stepsFromRest()`; one
+    /// decelerating from `speed` starts from step `-stepsFromRest() - 1`.
+    /// @param speed In steps per second.
+    /// @param acceleration In steps per second squared.
+    static int32_t stepsFromRest(float speed, float acceleration);
+
+    /// @brief Scale of `stepsAtPeriod()` for an acceleration: ticksPerSecond / sqrt(2 * acceleration), in Q24.8.
+    static uint32_t periodScale(uint32_t ticksPerSecond, float acceleration);
+
+    /// @brief `stepsFromRest()` of the speed of a step of period `period`, in integer arithmetic.
+    ///
+    /// One 32-bit division, for rejoining a ramp at the current speed when its acceleration changes.
+    /// @param scale `periodScale()` of the acceleration.
+    static int32_t stepsAtPeriod(uint32_t scale, uint32_t period);
+
+    /// @brief Continues a ramp from a step of period `period` that is step `step` of it.
+    ///
+    /// `step` > 0 accelerates; `step` < 0 decelerates with `-step` steps left before rest.
+    /// `step` == 0 is the first step from rest, `period` then being `firstPeriod()`.
+    void start(uint32_t period, int32_t step);
+
+    /// @brief Advances to the next step and returns its period, rounded to the nearest tick.
+    ///
+    /// After a deceleration has reached rest, the period no longer changes.
+    inline uint32_t next();
+
+    uint32_t period() const { return (_periodQ8 + 0x80) >> 8; }
+    int32_t step() const { return _step; }
+
+private:
+    uint32_t _periodQ8;  // Period of the current step, in Q24.8 ticks
+    uint32_t _remainder; // Remainder of the last division, carried into the next one
+    int32_t _step;       // Index of the current step, negative while decelerating
+};
+
+uint32_t StepRamp::next()
+{
+    if (_step == -1)
+        return period(); // c_0 of a deceleration would be rest itself
+
+    _step++;
+    uint32_t divisor = _step > 0 ? 4 * (uint32_t)_step + 1 : 4 * (uint32_t)(-_step) - 1;
+    uint32_t numerator = 2 * _periodQ8 + _remainder;
+    uint32_t change = numerator / divisor;
+#ifdef SIMULATION_HAL
+    sim::charge(sim::costs.division); // The simulator charges no arithmetic of its own
+#endif
+    _remainder = numerator - change * divisor;
+    if (_step > 0)
+        _periodQ8 -= change;
+    else
+        _periodQ8 += change;
+    return period();
+}
+
+#endif
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <Arduino.h>
+
+// --- Pin Definitions ---
+// Update these pin numbers to match your hardware setup.
+const int NUM_AXES = 6;
+const int ESTOP_PIN = 3; // Emergency Stop pin
+const uint8_t ESTOP_PRESSED = LOW; // Level of the E-Stop pin while the E-Stop is pressed
+
+const int J1_STEP_PIN = 25;
+const int J1_DIR_PIN = 24;
+const int J2_STEP_PIN = 21;
+const int J2_DIR_PIN = 20;
+const int J3_STEP_PIN = 18;
+const int J3_DIR_PIN = 17;
+const int J4_STEP_PIN = 15;
+const int J4_DIR_PIN = 14;
+const int J5_STEP_PIN = 47;
+const int J5_DIR_PIN = 46;
+const int J6_STEP_PIN = 44;
+const int J6_DIR_PIN = 43;
+
+// Limit switch pin, used for homing
+const int J1_LIMIT_PIN = 23;
+const int J2_LIMIT_PIN = 19;
+const int J3_LIMIT_PIN = 16;
+const int J4_LIMIT_PIN = 2;
+const int J5_LIMIT_PIN = 45;
+const int J6_LIMIT_PIN = 42;
+const uint8_t LIMIT_SWITCH_PRESSED = HIGH; // Level of a limit switch pin while the switch is pressed
+// Joint steps per degree configuration
+const float J1_STEPS_PER_DEGREE = 88.88;  // (800 * 10 * 4) / 360;
+const float J2_STEPS_PER_DEGREE = 111.11; // (800 * 50) / 360;
+const float J3_STEPS_PER_DEGREE = 111.11; // (800 * 50) / 360;
+const float J4_STEPS_PER_DEGREE = 44.44;  // (800 * 10 * 2) / 360;
+const float J5_STEPS_PER_DEGREE = 42.33;  // 15240 / 360;
+const float J6_STEPS_PER_DEGREE = 4.44;   // 1600 / 360;
+
+// Joint limits in degrees
+const int J1_NEGATIVE_LIMIT = -170;
+const int J1_POSITIVE_LIMIT = 115;
+
+const int J2_NEGATIVE_LIMIT = -20;
+const int J2_POSITIVE_LIMIT = 108;
+
+const int J3_NEGATIVE_LIMIT = -102;
+const int J3_POSITIVE_LIMIT = 38;
+
+const int J4_NEGATIVE_LIMIT = -209;
+const int J4_POSITIVE_LIMIT = 145;
+
+const int J5_NEGATIVE_LIMIT = -100.9;
+const int J5_POSITIVE_LIMIT = 106;
+
+const int J6_NEGATIVE_LIMIT = -173;
+const int J6_POSITIVE_LIMIT = 157;
+
+// --- Motor Direction Configuration ---
+
+// `true` means flip the direction of the motor
+// `false` means keep the direction as is
+const bool INVERT_DIRECTION[NUM_AXES] = {true, true, true, true, true, true};
+
+// `false` means the motor moves towards negative direction during calibration
+// `true` means the motor moves towards positive direction during calibration
+const bool CALIBRATION_DIRECTION[NUM_AXES] = {true, false, true, false, false, false};
+
+// --- Joint Tables ---
+const int stepPins[NUM_AXES] = {J1_STEP_PIN, J2_STEP_PIN, J3_STEP_PIN, J4_STEP_PIN, J5_STEP_PIN, J6_STEP_PIN};
+const int dirPins[NUM_AXES] = {J1_DIR_PIN, J2_DIR_PIN, J3_DIR_PIN, J4_DIR_PIN, J5_DIR_PIN, J6_DIR_PIN};
+const float STEPS_PER_DEGREE[NUM_AXES] = {J1_STEPS_PER_DEGREE, J2_STEPS_PER_DEGREE, J3_STEPS_PER_DEGREE, J4_STEPS_PER_DEGREE, J5_STEPS_PER_DEGREE, J6_STEPS_PER_DEGREE};
+const int JOINT_NEGATIVE_LIMITS[NUM_AXES] = {J1_NEGATIVE_LIMIT, J2_NEGATIVE_LIMIT, J3_NEGATIVE_LIMIT, J4_NEGATIVE_LIMIT, J5_NEGATIVE_LIMIT, J6_NEGATIVE_LIMIT};
+const int JOINT_POSITIVE_LIMITS[NUM_AXES] = {J1_POSITIVE_LIMIT, J2_POSITIVE_LIMIT, J3_POSITIVE_LIMIT, J4_POSITIVE_LIMIT, J5_POSITIVE_LIMIT, J6_POSITIVE_LIMIT};
+const int LIMIT_SWITCH_PINS[NUM_AXES] = {J1_LIMIT_PIN, J2_LIMIT_PIN, J3_LIMIT_PIN, J4_LIMIT_PIN, J5_LIMIT_PIN, J6_LIMIT_PIN};
+
+// --- Geometry ---
+// Denavit-Hartenberg parameters of the links (classic convention: rotate `theta` about z,
+// move `d` along z, move `a` along x, rotate `alpha` about x), in millimetres and degrees.
+// A link's `theta` is its joint angle plus `DH_THETA_OFFSETS`. The inverse kinematics
+// solve a spherical wrist in closed form: keep alpha at -90, 0, 90, -90, 90, 0 and
+// a4 = a5 = a6 = d2 = d3 = d5 = 0. The lengths are nominal; measure them on the arm.
+const float DH_A[NUM_AXES] = {64.2, 305.0, 0, 0, 0, 0};
+const float DH_D[NUM_AXES] = {169.77, 0, 0, 222.63, 0, 36.25};
+const float DH_ALPHAS[NUM_AXES] = {-90, 0, 90, -90, 90, 0};
+const float DH_THETA_OFFSETS[NUM_AXES] = {0, -90, 180, 0, 0, 180};
+
+// Calibration speeds (steps per second) for each joint.
+const float CALIBRATION_SPEEDS[NUM_AXES] = {(5 * STEPS_PER_DEGREE[0]),
+                                            (4 * STEPS_PER_DEGREE[1]),
+                                            (4 * STEPS_PER_DEGREE[2]),
+                                            (20 * STEPS_PER_DEGREE[3]),
+                                            (10 * STEPS_PER_DEGREE[4]),
+                                            (10 * STEPS_PER_DEGREE[5])};
+// Speeds (steps per second) at which the joints first seek their limit switches. Where the
+// switch closes is latched by the step engine, so this does not change the home position:
+// the joints then back off and find the switch again at a fifth of `CALIBRATION_SPEEDS`.
+const float CALIBRATION_SEEK_SPEEDS[NUM_AXES] = {(10 * STEPS_PER_DEGREE[0]),
+                                                 (8 * STEPS_PER_DEGREE[1]),
+                                                 (8 * STEPS_PER_DEGREE[2]),
+                                                 (40 * STEPS_PER_DEGREE[3]),
+                                                 (20 * STEPS_PER_DEGREE[4]),
+                                                 (20 * STEPS_PER_DEGREE[5])};
+const float JOINT_MAX_SPEEDS[NUM_AXES] = {(15 * STEPS_PER_DEGREE[0]),
+                                          (15 * STEPS_PER_DEGREE[1]),
+                                          (30 * STEPS_PER_DEGREE[2]),
+                                          (60 * STEPS_PER_DEGREE[3]),
+                                          (60 * STEPS_PER_DEGREE[4]),
+                                          (100 * STEPS_PER_DEGREE[5])};
+// Accelerations (steps per second squared) the joints may ramp at in the fastest moves,
+// the ones requested without a duration. Each joint reaches its maximum speed in half a second.
+const float JOINT_MAX_ACCELERATIONS[NUM_AXES] = {(30 * STEPS_PER_DEGREE[0]),
+                                                 (30 * STEPS_PER_DEGREE[1]),
+                                                 (60 * STEPS_PER_DEGREE[2]),
+                                                 (120 * STEPS_PER_DEGREE[3]),
+                                                 (120 * STEPS_PER_DEGREE[4]),
+                                                 (200 * STEPS_PER_DEGREE[5])};
+const float CALIBRATION_OFFSETS[NUM_AXES] = {0, 0, 0, 0, 0, 0}; // Calibration offsets for each joint
+
+// Joints home in stages: the joints of a stage seek their limits together, and a joint
+// only starts once the joints of the earlier stages it was calibrated with are done.
+// Give a joint a later stage when it could hit another joint on its way to the limit.
+const uint8_t CALIBRATION_STAGES[NUM_AXES] = {0, 0, 0, 0, 0, 0};
+
+// --- Limit Switches ---
+// A seeking joint's switch is sampled on every step engine tick. The position at the first
+// pressed sample is kept and becomes the switch position once this many samples in a row
+// read pressed; as many released samples in a row drop it as noise.
+const uint8_t LIMIT_DEBOUNCE_SAMPLES = 5;
+// How far (degrees) a seeking joint may run past the point its switch closed while it stops.
+const float LIMIT_OVERTRAVEL_DEGREES = 1.0;
+
+// Minimum and maximum allowable speed delays (in microseconds).
+// These act as safety limits.
+const int MIN_SPEED_DELAY = 50;    // Corresponds to the absolute fastest speed
+const int MAX_SPEED_DELAY = 10000; // Corresponds to a very slow start/end speed
+
+// --- Motion Planner ---
+// Number of moves that can be queued ahead of the one being executed. Must be a power of two.
+const uint8_t BLOCK_BUFFER_SIZE = 16;
+
+// Largest instantaneous speed change (degrees per second) each joint may see where two
+// queued moves meet. Consecutive moves are blended through the junction at the highest
+// speed that keeps every joint within its limit.
+const float JOINT_JUNCTION_JERK[NUM_AXES] = {2, 2, 4, 8, 8, 12};
+
+// Range (percent) of the feed override, which scales the cruise speed of the queued moves
+// while they run. Above 100%, no joint is driven faster than its `JOINT_MAX_SPEEDS`.
+const uint8_t FEED_OVERRIDE_MIN = 10;
+const uint8_t FEED_OVERRIDE_MAX = 200;
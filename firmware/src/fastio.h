@@ -0,0 +1,182 @@
+#pragma once
+
+#include <Arduino.h>
+
+// =================================================================
+//   DIRECT PORT I/O
+// =================================================================
+//
+// `digitalWrite()` looks the pin up in program memory and turns PWM off on every call,
+// which costs a few microseconds per pin. Pins that are known at compile time can be
+// resolved to their port and bit instead, and a group of them written with one access
+// per port. The tables below are the Arduino Mega 2560 variant's wiring.
+
+enum IoPort : uint8_t
+{
+  IO_PORT_A,
+  IO_PORT_B,
+  IO_PORT_C,
+  IO_PORT_D,
+  IO_PORT_E,
+  IO_PORT_F,
+  IO_PORT_G,
+  IO_PORT_H,
+  IO_PORT_J, // The ATmega2560 has no port I
+  IO_PORT_K,
+  IO_PORT_L,
+  IO_PORT_COUNT
+};
+
+constexpr uint8_t MEGA_PIN_PORTS[] = {
+    IO_PORT_E, IO_PORT_E, IO_PORT_E, IO_PORT_E, IO_PORT_G, IO_PORT_E, IO_PORT_H, IO_PORT_H, // 0-7
+    IO_PORT_H, IO_PORT_H, IO_PORT_B, IO_PORT_B, IO_PORT_B, IO_PORT_B, IO_PORT_J, IO_PORT_J, // 8-15
+    IO_PORT_H, IO_PORT_H, IO_PORT_D, IO_PORT_D, IO_PORT_D, IO_PORT_D, IO_PORT_A, IO_PORT_A, // 16-23
+    IO_PORT_A, IO_PORT_A, IO_PORT_A, IO_PORT_A, IO_PORT_A, IO_PORT_A, IO_PORT_C, IO_PORT_C, // 24-31
+    IO_PORT_C, IO_PORT_C, IO_PORT_C, IO_PORT_C, IO_PORT_C, IO_PORT_C, IO_PORT_D, IO_PORT_G, // 32-39
+    IO_PORT_G, IO_PORT_G, IO_PORT_L, IO_PORT_L, IO_PORT_L, IO_PORT_L, IO_PORT_L, IO_PORT_L, // 40-47
+    IO_PORT_L, IO_PORT_L, IO_PORT_B, IO_PORT_B, IO_PORT_B, IO_PORT_B, IO_PORT_F, IO_PORT_F, // 48-55
+    IO_PORT_F, IO_PORT_F, IO_PORT_F, IO_PORT_F, IO_PORT_F, IO_PORT_F, IO_PORT_K, IO_PORT_K, // 56-63
+    IO_PORT_K, IO_PORT_K, IO_PORT_K, IO_PORT_K, IO_PORT_K, IO_PORT_K};                      // 64-69
+constexpr uint8_t MEGA_PIN_BITS[] = {
+    0, 1, 4, 5, 5, 3, 3, 4, 5, 6, 4, 5, 6, 7, 1, 0, 1, 0, 3, 2, // 0-19
+    1, 0, 0, 1, 2, 3, 4, 5, 6, 7, 7, 6, 5, 4, 3, 2, 1, 0, 7, 2, // 20-39
+    1, 0, 7, 6, 5, 4, 3, 2, 1, 0, 3, 2, 1, 0, 0, 1, 2, 3, 4, 5, // 40-59
+    6, 7, 0, 1, 2, 3, 4, 5, 6, 7};                              // 60-69
+
+constexpr uint8_t pinPort(int pin) { return MEGA_PIN_PORTS[pin]; }
+constexpr uint8_t pinMask(int pin) { return 1 << MEGA_PIN_BITS[pin]; }
+
+#ifndef SIMULATION_HAL // The simulator has its own
+/**
+ * @brief Drives an output pin known only at run time, without `digitalWrite()`'s PWM check.
+ *
+ * Safe from an ISR and against ISRs writing the same port.
+ */
+inline void digitalWriteFast(uint8_t pin, uint8_t value)
+{
+  volatile uint8_t *out = portOutputRegister(digitalPinToPort(pin));
+  uint8_t mask = digitalPinToBitMask(pin);
+  uint8_t oldSREG = SREG;
+  cli();
+  if (value == LOW)
+    *out &= ~mask;
+  else
+    *out |= mask;
+  SREG = oldSREG;
+}
+#endif
+
+/**
+ * @brief Bit `port` is set for every port one of the `count` pins is on.
+ */
+constexpr uint16_t usedPorts(const int *pins, int count)
+{
+  return count == 0 ? 0 : (1 << pinPort(pins[0])) | usedPorts(pins + 1, count - 1);
+}
+
+/**
+ * @brief Bits of `port` the `count` pins are on.
+ */
+constexpr uint8_t portMask(const int *pins, int count, uint8_t port)
+{
+  return count == 0 ? 0 : (pinPort(pins[0]) == port ? pinMask(pins[0]) : 0) | portMask(pins + 1, count - 1, port);
+}
+
+/**
+ * @brief One byte per port, each bit standing for the pin of that port and bit.
+ */
+struct PortBits
+{
+  uint8_t bits[IO_PORT_COUNT];
+};
+
+// Initialiser of a `PortBits` holding the bits of a pin table.
+#define PORT_BITS_OF(pins, count)                                         \
+  {                                                                       \
+    {                                                                     \
+      portMask(pins, count, IO_PORT_A), portMask(pins, count, IO_PORT_B), \
+      portMask(pins, count, IO_PORT_C), portMask(pins, count, IO_PORT_D), \
+      portMask(pins, count, IO_PORT_E), portMask(pins, count, IO_PORT_F), \
+      portMask(pins, count, IO_PORT_G), portMask(pins, count, IO_PORT_H), \
+      portMask(pins, count, IO_PORT_J), portMask(pins, count, IO_PORT_K), \
+      portMask(pins, count, IO_PORT_L)                                    \
+    }                                                                     \
+  }
+
+// Applies `STATEMENT(x, index)` to every port whose bit is set in the constant `PORTS`, `x`
+// being the port's letter (`PORT##x`, `PIN##x`); the other ports compile to nothing.
+#define FOR_EACH_USED_PORT(PORTS, STATEMENT) \
+  do                                         \
+  {                                          \
+    if ((PORTS) & (1 << IO_PORT_A))          \
+      STATEMENT(A, IO_PORT_A);               \
+    if ((PORTS) & (1 << IO_PORT_B))          \
+      STATEMENT(B, IO_PORT_B);               \
+    if ((PORTS) & (1 << IO_PORT_C))          \
+      STATEMENT(C, IO_PORT_C);               \
+    if ((PORTS) & (1 << IO_PORT_D))          \
+      STATEMENT(D, IO_PORT_D);               \
+    if ((PORTS) & (1 << IO_PORT_E))          \
+      STATEMENT(E, IO_PORT_E);               \
+    if ((PORTS) & (1 << IO_PORT_F))          \
+      STATEMENT(F, IO_PORT_F);               \
+    if ((PORTS) & (1 << IO_PORT_G))          \
+      STATEMENT(G, IO_PORT_G);               \
+    if ((PORTS) & (1 << IO_PORT_H))          \
+      STATEMENT(H, IO_PORT_H);               \
+    if ((PORTS) & (1 << IO_PORT_J))          \
+      STATEMENT(J, IO_PORT_J);               \
+    if ((PORTS) & (1 << IO_PORT_K))          \
+      STATEMENT(K, IO_PORT_K);               \
+    if ((PORTS) & (1 << IO_PORT_L))          \
+      STATEMENT(L, IO_PORT_L);               \
+  } while (0)
+
+/**
+ * @brief Drives HIGH the pins of `pins`, with one read-modify-write per port of `PORTS`.
+ *
+ * Not atomic: call with interrupts disabled, or from an ISR, when other code may write
+ * the same ports.
+ */
+template <uint16_t PORTS>
+inline void setPortBits(const PortBits &pins)
+{
+#define SET_PORT_BITS(LETTER, INDEX) PORT##LETTER |= pins.bits[INDEX]
+  FOR_EACH_USED_PORT(PORTS, SET_PORT_BITS);
+#undef SET_PORT_BITS
+}
+
+/**
+ * @brief Drives LOW the pins of `pins`, with one read-modify-write per port of `PORTS`.
+ */
+template <uint16_t PORTS>
+inline void clearPortBits(const PortBits &pins)
+{
+#define CLEAR_PORT_BITS(LETTER, INDEX) PORT##LETTER &= (uint8_t)~pins.bits[INDEX]
+  FOR_EACH_USED_PORT(PORTS, CLEAR_PORT_BITS);
+#undef CLEAR_PORT_BITS
+}
+
+/**
+ * @brief Drives the pins of `mask` to their level in `levels`, one read-modify-write per port.
+ */
+template <uint16_t PORTS>
+inline void writePortBits(const PortBits &mask, const PortBits &levels)
+{
+#define WRITE_PORT_BITS(LETTER, INDEX) PORT##LETTER = (PORT##LETTER & (uint8_t)~mask.bits[INDEX]) | levels.bits[INDEX]
+  FOR_EACH_USED_PORT(PORTS, WRITE_PORT_BITS);
+#undef WRITE_PORT_BITS
+}
+
+/**
+ * @brief Reads the input levels of the ports of `PORTS`, one access per port.
+ */
+template <uint16_t PORTS>
+inline PortBits readPortBits()
+{
+  PortBits levels = {};
+#define READ_PORT_BITS(LETTER, INDEX) levels.bits[INDEX] = PIN##LETTER
+  FOR_EACH_USED_PORT(PORTS, READ_PORT_BITS);
+#undef READ_PORT_BITS
+  return levels;
+}
@@ -0,0 +1,251 @@
+#include <Arduino.h>
+#include "kinematics.h"
+
+// sin() of 0 to 90 degrees in steps of one degree, in 65535ths.
+static const uint16_t SINE_TABLE[91] PROGMEM = {
+    0, 1144, 2287, 3430, 4571, 5712, 6850, 7987, 9121, 10252,
+    11380, 12505, 13625, 14742, 15854, 16962, 18064, 19161, 20251, 21336,
+    22414, 23486, 24550, 25607, 26655, 27696, 28729, 29752, 30767, 31772,
+    32767, 33753, 34728, 35693, 36647, 37589, 38521, 39440, 40347, 41243,
+    42125, 42995, 43851, 44695, 45524, 46340, 47142, 47929, 48702, 49460,
+    50203, 50930, 51642, 52339, 53019, 53683, 54331, 54962, 55577, 56174,
+    56755, 57318, 57864, 58392, 58902, 59395, 59869, 60325, 60763, 61182,
+    61583, 61965, 62327, 62671, 62996, 63302, 63588, 63855, 64103, 64331,
+    64539, 64728, 64897, 65047, 65176, 65286, 65375, 65445, 65495, 65525,
+    65535};
+
+// Below this sin(theta5) the wrist is straight: joints 4 and 6 turn about the same axis,
+// and only their sum is defined.
+const float WRIST_SINGULARITY = 0.001;
+
+/**
+ * @struct Transform
+ * @brief A rotation and a translation, the pose of one frame in another.
+ */
+struct Transform
+{
+  float r[3][3];
+  float p[3];
+};
+
+float sinDegrees(float degrees)
+{
+  float angle = fmod(degrees, 360);
+  if (angle < 0)
+    angle += 360;
+  bool negative = angle >= 180;
+  if (negative)
+    angle -= 180;
+  if (angle > 90)
+    angle = 180 - angle;
+
+  uint8_t index = angle;
+  float fraction = angle - index;
+  float low = pgm_read_word(&SINE_TABLE[index]);
+  float high = index < 90 ? pgm_read_word(&SINE_TABLE[index + 1]) : low;
+  float value = (low + (high - low) * fraction) / 65535.0;
+  return negative ? -value : value;
+}
+
+float cosDegrees(float degrees)
+{
+  return sinDegrees(degrees + 90);
+}
+
+/**
+ * @brief `a` followed by `b`: the pose in `a`'s outer frame of a frame given in `a`.
+ */
+static Transform compose(const Transform &a, const Transform &b)
+{
+  Transform result;
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    for (uint8_t j = 0; j < 3; j++)
+    {
+      result.r[i][j] = a.r[i][0] * b.r[0][j] + a.r[i][1] * b.r[1][j] + a.r[i][2] * b.r[2][j];
+    }
+    result.p[i] = a.r[i][0] * b.p[0] + a.r[i][1] * b.p[1] + a.r[i][2] * b.p[2] + a.p[i];
+  }
+  return result;
+}
+
+/**
+ * @brief Pose of link `link`'s frame in the previous link's, with its joint at `joint` degrees.
+ */
+static Transform linkTransform(uint8_t link, float joint)
+{
+  float theta = joint + DH_THETA_OFFSETS[link];
+  float ct = cosDegrees(theta);
+  float st = sinDegrees(theta);
+  float ca = cosDegrees(DH_ALPHAS[link]);
+  float sa = sinDegrees(DH_ALPHAS[link]);
+  return {{{ct, -st * ca, st * sa},
+           {st, ct * ca, -ct * sa},
+           {0, sa, ca}},
+          {DH_A[link] * ct, DH_A[link] * st, DH_D[link]}};
+}
+
+/**
+ * @brief Pose of the frame of link `links - 1` in the base's, from the first `links` joints.
+ */
+static Transform chain(const float joints[NUM_AXES], uint8_t links)
+{
+  Transform transform = linkTransform(0, joints[0]);
+  for (uint8_t link = 1; link < links; link++)
+  {
+    transform = compose(transform, linkTransform(link, joints[link]));
+  }
+  return transform;
+}
+
+void forwardKinematics(const float joints[NUM_AXES], Pose &pose)
+{
+  Transform flange = chain(joints, NUM_AXES);
+  pose.x = flange.p[0];
+  pose.y = flange.p[1];
+  pose.z = flange.p[2];
+  // R = Rz(yaw) * Ry(pitch) * Rx(roll)
+  float cosPitch = sqrt(flange.r[0][0] * flange.r[0][0] + flange.r[1][0] * flange.r[1][0]);
+  pose.pitch = atan2(-flange.r[2][0], cosPitch) * RAD_TO_DEG;
+  // Roll is what Rz(yaw)^T * R leaves about x, rather than atan2(r21, r22): near a pitch of
+  // +-90 degrees those shrink with cos(pitch), and so would the precision of roll against yaw.
+  float cy = 1, sy = 0;
+  if (cosPitch > 0) // Else yaw is undefined, and roll takes all the turn about z
+  {
+    cy = flange.r[0][0] / cosPitch;
+    sy = flange.r[1][0] / cosPitch;
+  }
+  pose.yaw = atan2(sy, cy) * RAD_TO_DEG;
+  pose.roll = atan2(sy * flange.r[0][2] - cy * flange.r[1][2], cy * flange.r[1][1] - sy * flange.r[0][1]) * RAD_TO_DEG;
+}
+
+/**
+ * @brief Turns `theta`, a link angle in degrees, into the joint angle nearest `current`
+ * that is within the joint's limits.
+ * @return false if no turn of it is.
+ */
+static bool toJointAngle(uint8_t joint, float theta, float current, float &angle)
+{
+  float base = theta - DH_THETA_OFFSETS[joint];
+  base -= 360 * round(base / 360);
+  bool found = false;
+  for (int8_t turn = -1; turn <= 1; turn++)
+  {
+    float candidate = base + 360 * turn;
+    if (candidate < JOINT_NEGATIVE_LIMITS[joint] || candidate > JOINT_POSITIVE_LIMITS[joint])
+      continue;
+    if (!found || fabs(candidate - current) < fabs(angle - current))
+      angle = candidate;
+    found = true;
+  }
+  return found;
+}
+
+/**
+ * @brief Solves the arm for the position of the wrist centre and the wrist for the
+ * remaining rotation, for each combination of shoulder, elbow and wrist configuration.
+ *
+ * With the links of config.h, joints 1 to 3 place the wrist centre, `d6` behind the
+ * flange along the tool axis: joint 1 turns the arm's plane towards it, or away from it
+ * to reach back over the base, and joints 2 and 3 reach it as a planar two-link arm, the second link running from the elbow to the
+ * wrist centre. The rotation left for the wrist, `R36 = R03^T * R`, is a ZYZ Euler
+ * rotation by joints 4, 5 and 6.
+ */
+bool inverseKinematics(const Pose &pose, const float currentJoints[NUM_AXES], float joints[NUM_AXES])
+{
+  // --- Orientation of the flange, R = Rz(yaw) * Ry(pitch) * Rx(roll) ---
+  float cr = cosDegrees(pose.roll), sr = sinDegrees(pose.roll);
+  float cp = cosDegrees(pose.pitch), sp = sinDegrees(pose.pitch);
+  float cy = cosDegrees(pose.yaw), sy = sinDegrees(pose.yaw);
+  float r[3][3] = {{cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr},
+                   {sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr},
+                   {-sp, cp * sr, cp * cr}};
+
+  // --- Wrist centre and joint 1 ---
+  float wx = pose.x - DH_D[5] * r[0][2];
+  float wy = pose.y - DH_D[5] * r[1][2];
+  float wz = pose.z - DH_D[5] * r[2][2];
+  float radius = sqrt(wx * wx + wy * wy);
+  float heading = radius > WRIST_SINGULARITY ? atan2(wy, wx) * RAD_TO_DEG : currentJoints[0] + DH_THETA_OFFSETS[0];
+
+  // --- Joints 2 and 3: a planar two-link arm in the frame of link 1 ---
+  float upperArm = DH_A[1];
+  float forearm = sqrt(DH_A[2] * DH_A[2] + DH_D[3] * DH_D[3]);
+  float forearmAngle = atan2(DH_D[3], DH_A[2]) * RAD_TO_DEG;
+  float uy = DH_D[0] - wz; // Link 1's y axis points down
+
+  float solution[NUM_AXES];
+  float bestDistance = 0;
+  bool found = false;
+  for (uint8_t configuration = 0; configuration < 4; configuration++)
+  {
+    // Facing the wrist centre or reaching back over the base, elbow one way or the other.
+    bool reachBack = configuration & 2;
+    int8_t elbow = (configuration & 1) ? 1 : -1;
+    float theta1 = reachBack ? heading + 180 : heading;
+    float ux = (reachBack ? -radius : radius) - DH_A[0];
+    float elbowCos = (ux * ux + uy * uy - upperArm * upperArm - forearm * forearm) / (2 * upperArm * forearm);
+    if (elbowCos < -1 || elbowCos > 1)
+      continue; // Out of reach
+    float gamma = elbow * acos(elbowCos) * RAD_TO_DEG;
+    float theta2 = atan2(uy, ux) * RAD_TO_DEG - atan2(forearm * sinDegrees(gamma), upperArm + forearm * cosDegrees(gamma)) * RAD_TO_DEG;
+    float theta3 = gamma + forearmAngle;
+    if (!toJointAngle(0, theta1, currentJoints[0], solution[0]) ||
+        !toJointAngle(1, theta2, currentJoints[1], solution[1]) ||
+        !toJointAngle(2, theta3, currentJoints[2], solution[2]))
+      continue;
+
+    // --- Joints 4 to 6: what is left of the rotation ---
+    Transform arm = chain(solution, 3);
+    float w[3][3]; // R36 = R03^T * R
+    for (uint8_t i = 0; i < 3; i++)
+    {
+      for (uint8_t j = 0; j < 3; j++)
+      {
+        w[i][j] = arm.r[0][i] * r[0][j] + arm.r[1][i] * r[1][j] + arm.r[2][i] * r[2][j];
+      }
+    }
+    float wristSin = sqrt(w[0][2] * w[0][2] + w[1][2] * w[1][2]);
+    for (int8_t flip = -1; flip <= 1; flip += 2)
+    {
+      float theta4, theta5;
+      if (wristSin < WRIST_SINGULARITY)
+      {
+        // Straight wrist: keep joint 4 and let joint 6 make up the rest.
+        theta4 = currentJoints[3] + DH_THETA_OFFSETS[3];
+        theta5 = w[2][2] > 0 ? 0 : 180;
+      }
+      else
+      {
+        theta5 = atan2(flip * wristSin, w[2][2]) * RAD_TO_DEG;
+        theta4 = atan2(flip * w[1][2], flip * w[0][2]) * RAD_TO_DEG;
+      }
+      if (!toJointAngle(3, theta4, currentJoints[3], solution[3]) ||
+          !toJointAngle(4, theta5, currentJoints[4], solution[4]))
+        continue;
+
+      // Joint 6 turns the flange by whatever rotation joints 4 and 5 leave, R56 = R05^T * R.
+      // Near a straight wrist, joint 4 is ill-conditioned, and solving joint 6 on its own
+      // from R36 would put the error of joint 4 into the flange's orientation.
+      Transform wrist = compose(compose(arm, linkTransform(3, solution[3])), linkTransform(4, solution[4]));
+      float c6 = wrist.r[0][0] * r[0][0] + wrist.r[1][0] * r[1][0] + wrist.r[2][0] * r[2][0];
+      float s6 = wrist.r[0][1] * r[0][0] + wrist.r[1][1] * r[1][0] + wrist.r[2][1] * r[2][0];
+      float theta6 = atan2(s6, c6) * RAD_TO_DEG;
+      if (!toJointAngle(5, theta6, currentJoints[5], solution[5]))
+        continue;
+
+      float distance = 0;
+      for (uint8_t i = 0; i < NUM_AXES; i++)
+      {
+        distance += fabs(solution[i] - currentJoints[i]);
+      }
+      if (!found || distance < bestDistance)
+      {
+        memcpy(joints, solution, sizeof(solution));
+        bestDistance = distance;
+        found = true;
+      }
+    }
+  }
+  return found;
+}
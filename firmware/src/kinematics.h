@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+
+// =================================================================
+//   KINEMATICS
+// =================================================================
+//
+// Forward and inverse kinematics of the arm, from the Denavit-Hartenberg table in
+// config.h. Joint angles are in degrees, as the move commands take them; poses are the
+// tool flange's position in millimetres and its orientation as roll, pitch and yaw in
+// degrees, about the base's fixed x, y and z axes in that order.
+//
+// The Mega has no FPU and avr-libc's sin() and cos() take over a thousand cycles each,
+// so angles go through a quarter-wave sine table in flash, interpolated linearly: under
+// 0.0001 off, a few hundredths of a millimetre at the end of the arm.
+
+struct Pose
+{
+  float x, y, z;          // Millimetres
+  float roll, pitch, yaw; // Degrees
+};
+
+/**
+ * @brief Sine and cosine of an angle in degrees, from the table.
+ */
+float sinDegrees(float degrees);
+float cosDegrees(float degrees);
+
+/**
+ * @brief Pose of the tool flange with the joints at `joints`.
+ */
+void forwardKinematics(const float joints[NUM_AXES], Pose &pose);
+
+/**
+ * @brief Joint angles that put the tool flange at `pose`.
+ *
+ * Of the solutions facing the target or reaching back over the base, with the elbow up
+ * or down and the wrist flipped or not, the one within every joint's limits that is
+ * closest to `currentJoints` wins, so a path of nearby poses does not jump between
+ * configurations. A joint that may turn past +-180 degrees takes whichever turn is nearer.
+ * @return false if the pose is out of reach or no solution keeps the joints within limits.
+ */
+bool inverseKinematics(const Pose &pose, const float currentJoints[NUM_AXES], float joints[NUM_AXES]);
@@ -0,0 +1,70 @@
+#include <ctype.h>
+#include <string.h>
+#include "lineparser.h"
+
+LineReader::Result LineReader::feed(char c)
+{
+  if (lineReady)
+  {
+    // The previous line has been handled: start the next one.
+    lineReady = false;
+    length = 0;
+  }
+
+  if (c == '\r')
+    return LINE_INCOMPLETE;
+
+  if (c != '\n')
+  {
+    if (length < LINE_BUFFER_SIZE)
+      buffer[length++] = c;
+    else
+      overflowed = true;
+    return LINE_INCOMPLETE;
+  }
+
+  if (overflowed)
+  {
+    overflowed = false;
+    length = 0;
+    return LINE_OVERFLOW;
+  }
+
+  // Trim in place, like `String::trim()`.
+  while (length > 0 && isspace((unsigned char)buffer[length - 1]))
+    length--;
+  buffer[length] = '\0';
+  start = buffer;
+  while (isspace((unsigned char)*start))
+    start++;
+
+  lineReady = true;
+  return LINE_READY;
+}
+
+int splitFields(char *input, char delimiter, char *fields[], int maxFields)
+{
+  int count = 0;
+  char *cursor = input;
+  while (count < maxFields && *cursor != '\0')
+  {
+    fields[count++] = cursor;
+    char *end = strchr(cursor, delimiter);
+    if (end == nullptr)
+    {
+      cursor += strlen(cursor);
+      break;
+    }
+    *end = '\0';
+    cursor = end + 1;
+  }
+
+  // `cursor` ends on a null terminator, which doubles as the empty string.
+  while (*cursor != '\0')
+    cursor++;
+  for (int i = count; i < maxFields; i++)
+  {
+    fields[i] = cursor;
+  }
+  return count;
+}
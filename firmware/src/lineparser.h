@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+// Longest text command accepted, without the line ending. Longer lines are dropped whole.
+const uint8_t LINE_BUFFER_SIZE = 128;
+
+/**
+ * @class LineReader
+ * @brief Assembles a text command one byte at a time in a fixed buffer.
+ *
+ * The main loop hands over whatever bytes `Serial` has and goes back to the motion code;
+ * nothing waits for the end of the line and nothing is allocated, so the time spent per
+ * byte is constant and a whole command costs at most `LINE_BUFFER_SIZE` feeds.
+ * Only depends on the C library, so it also builds on the host.
+ */
+class LineReader
+{
+public:
+  enum Result
+  {
+    LINE_INCOMPLETE,
+    LINE_READY,   // `line()` holds the command, trimmed and null-terminated
+    LINE_OVERFLOW // The line was longer than `LINE_BUFFER_SIZE` and has been discarded
+  };
+
+  /**
+   * @brief Consumes one received byte. `\n` ends the line, `\r` is ignored.
+   */
+  Result feed(char c);
+
+  /**
+   * @brief The last complete line. Valid until the next call to `feed()`.
+   */
+  char *line() { return start; }
+
+private:
+  char buffer[LINE_BUFFER_SIZE + 1];
+  char *start = buffer;
+  uint8_t length = 0;
+  bool overflowed = false;
+  bool lineReady = false;
+};
+
+/**
+ * @brief Splits `input` in place at each `delimiter`, without copying.
+ *
+ * Each delimiter is replaced with a null terminator and `fields` points into `input`.
+ * Empty fields between two delimiters are kept; unused entries of `fields` point to an
+ * empty string, so they can be parsed like the others.
+ *
+ * @return The number of fields found, at most `maxFields`.
+ */
+int splitFields(char *input, char delimiter, char *fields[], int maxFields);
@@ -1,150 +1,31 @@
 #include <Arduino.h>
-#include <Bounce2.h>
-#include "AccelStepper.h"
-
-// --- Pin Definitions ---
-// Update these pin numbers to match your hardware setup.
-const int NUM_AXES = 6;
-const int ESTOP_PIN = 3;   // Emergency Stop pin
-bool ESTOP_ACTIVE = false; // Set to true if the E-Stop is active low, false if active high
-
-const int J1_STEP_PIN = 25;
-const int J1_DIR_PIN = 24;
-const int J2_STEP_PIN = 21;
-const int J2_DIR_PIN = 20;
-const int J3_STEP_PIN = 18;
-const int J3_DIR_PIN = 17;
-const int J4_STEP_PIN = 15;
-const int J4_DIR_PIN = 14;
-const int J5_STEP_PIN = 47;
-const int J5_DIR_PIN = 46;
-const int J6_STEP_PIN = 44;
-const int J6_DIR_PIN = 43;
-
-// Limit switch pin, used for homing
-const int J1_LIMIT_PIN = 23;
-const int J2_LIMIT_PIN = 19;
-const int J3_LIMIT_PIN = 16;
-const int J4_LIMIT_PIN = 2;
-const int J5_LIMIT_PIN = 45;
-const int J6_LIMIT_PIN = 42;
-// Joint steps per degree configuration
-const float J1_STEPS_PER_DEGREE = 88.88;  // (800 * 10 * 4) / 360;
-const float J2_STEPS_PER_DEGREE = 111.11; // (800 * 50) / 360;
-const float J3_STEPS_PER_DEGREE = 111.11; // (800 * 50) / 360;
-const float J4_STEPS_PER_DEGREE = 44.44;  // (800 * 10 * 2) / 360;
-const float J5_STEPS_PER_DEGREE = 42.33;  // 15240 / 360;
-const float J6_STEPS_PER_DEGREE = 4.44;   // 1600 / 360;
-
-// Joint limits in degrees
-const int J1_NEGATIVE_LIMIT = -170;
-const int J1_POSITIVE_LIMIT = 115;
-
-const int J2_NEGATIVE_LIMIT = -20;
-const int J2_POSITIVE_LIMIT = 108;
-
-const int J3_NEGATIVE_LIMIT = -102;
-const int J3_POSITIVE_LIMIT = 38;
-
-const int J4_NEGATIVE_LIMIT = -209;
-const int J4_POSITIVE_LIMIT = 145;
-
-const int J5_NEGATIVE_LIMIT = -100.9;
-const int J5_POSITIVE_LIMIT = 106;
-
-const int J6_NEGATIVE_LIMIT = -173;
-const int J6_POSITIVE_LIMIT = 157;
-
-// --- Motor Direction Configuration ---
-
-// `true` means flip the direction of the motor
-// `false` means keep the direction as is
-const bool INVERT_DIRECTION[NUM_AXES] = {true, true, true, true, true, true};
-
-// `false` means the motor moves towards negative direction during calibration
-// `true` means the motor moves towards positive direction during calibration
-const bool CALIBRATION_DIRECTION[NUM_AXES] = {true, false, true, false, false, false};
+#include "config.h"
+#include "kinematics.h"
+#include "lineparser.h"
+#include "main.h"
+#include "planner.h"
+#include "profiler.h"
+#include "protocol.h"
+#include "stepengine.h"
+#include "telemetry.h"
+
+volatile bool ESTOP_ACTIVE = false; // The E-Stop is pressed, as of its last interrupt
 
 // --- Global Variables ---
-const int stepPins[NUM_AXES] = {J1_STEP_PIN, J2_STEP_PIN, J3_STEP_PIN, J4_STEP_PIN, J5_STEP_PIN, J6_STEP_PIN};
-const int dirPins[NUM_AXES] = {J1_DIR_PIN, J2_DIR_PIN, J3_DIR_PIN, J4_DIR_PIN, J5_DIR_PIN, J6_DIR_PIN};
-const float STEPS_PER_DEGREE[NUM_AXES] = {J1_STEPS_PER_DEGREE, J2_STEPS_PER_DEGREE, J3_STEPS_PER_DEGREE, J4_STEPS_PER_DEGREE, J5_STEPS_PER_DEGREE, J6_STEPS_PER_DEGREE};
-const int JOINT_NEGATIVE_LIMITS[NUM_AXES] = {J1_NEGATIVE_LIMIT, J2_NEGATIVE_LIMIT, J3_NEGATIVE_LIMIT, J4_NEGATIVE_LIMIT, J5_NEGATIVE_LIMIT, J6_NEGATIVE_LIMIT};
-const int JOINT_POSITIVE_LIMITS[NUM_AXES] = {J1_POSITIVE_LIMIT, J2_POSITIVE_LIMIT, J3_POSITIVE_LIMIT, J4_POSITIVE_LIMIT, J5_POSITIVE_LIMIT, J6_POSITIVE_LIMIT};
-const int LIMIT_SWITCH_PINS[NUM_AXES] = {J1_LIMIT_PIN, J2_LIMIT_PIN, J3_LIMIT_PIN, J4_LIMIT_PIN, J5_LIMIT_PIN, J6_LIMIT_PIN};
-Bounce2 ::Button limitSwitches[NUM_AXES] = {
-    Bounce2::Button(),
-    Bounce2::Button(),
-    Bounce2::Button(),
-    Bounce2::Button(),
-    Bounce2::Button(),
-    Bounce2::Button()};
 bool isCalibrationDone[NUM_AXES] = {false}; // To indicate if calibration is complete for a joint
-
-AccelStepper steppers[6] = {
-    AccelStepper(AccelStepper::DRIVER, stepPins[0], dirPins[0]),
-    AccelStepper(AccelStepper::DRIVER, stepPins[1], dirPins[1]),
-    AccelStepper(AccelStepper::DRIVER, stepPins[2], dirPins[2]),
-    AccelStepper(AccelStepper::DRIVER, stepPins[3], dirPins[3]),
-    AccelStepper(AccelStepper::DRIVER, stepPins[4], dirPins[4]),
-    AccelStepper(AccelStepper::DRIVER, stepPins[5], dirPins[5])};
-
-// Calibration speeds (steps per second) for each joint.
-const float CALIBRATION_SPEEDS[NUM_AXES] = {(5 * STEPS_PER_DEGREE[0]),
-                                            (4 * STEPS_PER_DEGREE[1]),
-                                            (4 * STEPS_PER_DEGREE[2]),
-                                            (20 * STEPS_PER_DEGREE[3]),
-                                            (10 * STEPS_PER_DEGREE[4]),
-                                            (10 * STEPS_PER_DEGREE[5])};
-const float JOINT_MAX_SPEEDS[NUM_AXES] = {(15 * STEPS_PER_DEGREE[0]),
-                                          (15 * STEPS_PER_DEGREE[1]),
-                                          (30 * STEPS_PER_DEGREE[2]),
-                                          (60 * STEPS_PER_DEGREE[3]),
-                                          (60 * STEPS_PER_DEGREE[4]),
-                                          (100 * STEPS_PER_DEGREE[5])};
-const float CALIBRATION_OFFSETS[NUM_AXES] = {0, 0, 0, 0, 0, 0}; // Calibration offsets for each joint
 int currentPosition[NUM_AXES] = {0, 0, 0, 0, 0, 0};
 
-// Minimum and maximum allowable speed delays (in microseconds).
-// These act as safety limits.
-const int MIN_SPEED_DELAY = 50;    // Corresponds to the absolute fastest speed
-const int MAX_SPEED_DELAY = 10000; // Corresponds to a very slow start/end speed
-
 // =================================================================
 //   UTILITY FUNCTIONS
 // =================================================================
-Bounce2::Button button = Bounce2::Button();
-
 void setupLimitSwitches()
 {
   for (int i = 0; i < NUM_AXES; i++)
   {
-
-    limitSwitches[i].attach(LIMIT_SWITCH_PINS[i], INPUT_PULLUP);
-    limitSwitches[i].setPressedState(HIGH); // Assuming high means pressed
-    limitSwitches[i].interval(5);           // Set debounce interval to 5ms
-  }
-}
-
-void updateLimitSwitches()
-{
-  for (int i = 0; i < NUM_AXES; i++)
-  {
-    limitSwitches[i].update();
+    pinMode(LIMIT_SWITCH_PINS[i], INPUT_PULLUP);
   }
 }
 
-/**
- * @brief Pulses the STEP pin for a given motor axis.
- * @param axisIndex The index of the motor to step (0-5).
- */
-void stepMotor(int axisIndex)
-{
-  digitalWrite(stepPins[axisIndex], HIGH);
-  delayMicroseconds(2); // A short pulse width is sufficient
-  digitalWrite(stepPins[axisIndex], LOW);
-}
-
 /**
  * @brief Prints the current position of all motors to the Serial Monitor.
  */
@@ -153,7 +34,7 @@ void printCurrentPosition()
   Serial.print("CURRENT POSITIONS: [");
   for (int i = 0; i < NUM_AXES; i++)
   {
-    Serial.print(currentPosition[i]);
+    Serial.print(stepEngine.position(i));
     if (i < NUM_AXES - 1)
     {
       Serial.print(", ");
@@ -162,213 +43,334 @@ void printCurrentPosition()
   Serial.println("]");
 }
 
+/**
+ * @brief Stops a joint that moves on its own, such as a joint being homed. Queued moves are not affected.
+ */
 void stopMotor(int jointIndex)
 {
-  steppers[jointIndex].setSpeed(0);
-  steppers[jointIndex].moveTo(steppers[jointIndex].currentPosition());             // Stop the motor immediately
-  steppers[jointIndex].setCurrentPosition(steppers[jointIndex].currentPosition()); // Reset current position to avoid overshoot
+  if (jointIndex < 0 || jointIndex >= NUM_AXES)
+    return;
+  stepEngine.stopJog(jointIndex);
+}
+
+/**
+ * @brief Sets both the planned and the live position of a joint that is not moving.
+ */
+void setJointPosition(int jointIndex, int steps)
+{
+  currentPosition[jointIndex] = steps;
+  stepEngine.setPosition(jointIndex, steps);
+}
+
+/**
+ * @brief Halts the step engine, drops the queued moves and re-syncs the planned positions
+ * with where the joints are.
+ */
+void abortMotion()
+{
+  stepEngine.abort();
+  planner.flush();
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    currentPosition[i] = stepEngine.position(i);
+  }
 }
 
+// ID of the next queued move. 0 stands for "not queued".
+uint16_t nextMoveId = 1;
+
 // =================================================================
 //   CORE MOVEMENT FUNCTION with ACCELERATION/DECELERATION
 // =================================================================
 
 /**
- * @brief Moves motors in a coordinated line with acceleration and deceleration.
+ * @brief Works out the fastest move the joints' limits allow, all of them arriving together.
+ *
+ * The joints move along a straight line in joint space, so each one's share of the path
+ * bounds the speed and the acceleration along it: the joint that reaches its
+ * `JOINT_MAX_SPEEDS` or `JOINT_MAX_ACCELERATIONS` first sets the pace for all. The move
+ * then ramps at that acceleration, from the speed of the first step off rest, to that
+ * speed or, when the move is too short, until it has to slow down again. With an S-curve
+ * the peak acceleration is higher than the average one by `1 / (1 - sCurvePercent / 2)`,
+ * so the average one is lowered to keep the peak within the limits.
+ *
+ * @param delta Absolute number of steps for each axis.
+ * @param masterSteps Steps of the axis that travels the furthest.
+ * @param startDelay Set to the step delay (microseconds) of the master at either end.
+ * @param cruiseDelay Set to the step delay of the master at its top speed.
+ * @param accelSteps Set to the master steps of the ramp up to that speed.
+ * @return The duration of the move in seconds.
+ */
+float fastestMove(const int32_t delta[NUM_AXES], long masterSteps, float sCurvePercent, float &startDelay, float &cruiseDelay, int32_t &accelSteps)
+{
+  // Fractions of the move per second, and per second squared.
+  float pathSpeed = 1000000.0 / ((float)MIN_SPEED_DELAY * masterSteps);
+  float pathAcceleration = pathSpeed * 1000000.0; // Unbounded until a joint says otherwise
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    if (delta[i] == 0)
+      continue;
+    pathSpeed = min(pathSpeed, JOINT_MAX_SPEEDS[i] / delta[i]);
+    pathAcceleration = min(pathAcceleration, JOINT_MAX_ACCELERATIONS[i] / delta[i]);
+  }
+  pathAcceleration *= 1 - sCurvePercent / 2;
+
+  float cruiseSpeed = pathSpeed * masterSteps;
+  float acceleration = pathAcceleration * masterSteps;
+  cruiseDelay = constrain(1000000.0 / cruiseSpeed, MIN_SPEED_DELAY, MAX_SPEED_DELAY);
+  cruiseSpeed = 1000000.0 / cruiseDelay;
+  startDelay = constrain(1000000.0 / sqrt(2 * acceleration), cruiseDelay, MAX_SPEED_DELAY);
+  float startSpeed = 1000000.0 / startDelay;
+
+  float rampSteps = (cruiseSpeed * cruiseSpeed - startSpeed * startSpeed) / (2 * acceleration);
+  accelSteps = rampSteps + 0.5;
+  if (2 * rampSteps > masterSteps)
+  {
+    // Triangle: the planner turns back at half way, at the speed reached there.
+    float topSpeed = sqrt(startSpeed * startSpeed + acceleration * masterSteps);
+    return 2 * (topSpeed - startSpeed) / acceleration;
+  }
+  return 2 * (cruiseSpeed - startSpeed) / acceleration + (masterSteps - 2 * rampSteps) / cruiseSpeed;
+}
+
+/**
+ * @brief Plans a coordinated line with acceleration and deceleration and queues it.
+ *
+ * The function returns as soon as the move is queued; the pulses are emitted from the
+ * Timer1 interrupts. The planner blends the move with the ones queued before it, so the
+ * joints only come to rest after the last queued move. `currentPosition` is advanced to
+ * the target straight away.
+ *
  * @param target The array of target positions in absolute steps.
- * @param moveDurationSec The total desired duration for the move in seconds.
+ * @param moveDurationSec The total desired duration for the move in seconds, or 0 for the
+ * fastest move the joints' limits allow (see `fastestMove()`).
  * @param accelDecelPercent The percentage of the move used for accel/decel (0.0 to 1.0).
  * For example, 0.2 means 10% accel and 10% decel.
+ * @param sCurvePercent The share of each ramp spent building up and easing off the
+ * acceleration (0.0 to 1.0), for a jerk-limited S-curve. 0 keeps the trapezoid.
+ * @param reply How to report the start and the end of the move.
+ * @param replyArg Joint number printed in the reports, or sequence number of the event frames.
+ * @param replyCmd Command the move was queued by.
+ * @return The ID of the move, or 0 if the queue is full and the move was dropped.
  */
-void moveMotorsBresenham(int target[NUM_AXES], float moveDurationSec, float accelDecelPercent)
+uint16_t moveMotorsBresenham(int target[NUM_AXES], float moveDurationSec, float accelDecelPercent, float sCurvePercent, MoveReply reply, uint8_t replyArg, uint8_t replyCmd)
 {
+  PlannerBlock *block = planner.nextFreeBlock();
+  if (block == nullptr)
+    return 0;
+
   // filter out the axes that are not calibrated
   for (int i = 0; i < NUM_AXES; i++)
   {
     if (!isCalibrationDone[i])
     {
-      currentPosition[i] = 0;
-      target[i] = 0; // If not calibrated, set target to 0. No operation will be performed on this axis.
+      target[i] = currentPosition[i]; // No operation will be performed on this axis; it may be homing.
     }
   }
   // --- 1. Calculate Deltas and Directions ---
-  int delta[NUM_AXES];
-  int direction[NUM_AXES];
   for (int i = 0; i < NUM_AXES; i++)
   {
-    delta[i] = target[i] - currentPosition[i];
-    if (delta[i] > 0)
-      direction[i] = 1;
-    else if (delta[i] < 0)
-      direction[i] = -1;
+    long delta = (long)target[i] - currentPosition[i];
+    block->delta[i] = abs(delta);
+    if (delta > 0)
+      block->direction[i] = 1;
+    else if (delta < 0)
+      block->direction[i] = -1;
     else
-      direction[i] = 0;
-  }
-
-  // --- 2. Set Physical Motor Directions ---
-  for (int i = 0; i < NUM_AXES; i++)
-  {
-    if (delta[i] != 0)
-    {
-      bool isPositive = (direction[i] > 0);
-      uint8_t directionToNeg = HIGH;
-      uint8_t directionToPos = LOW;
-      if (INVERT_DIRECTION[i])
-      {
-        directionToNeg = directionToNeg == HIGH ? LOW : HIGH;
-        directionToPos = directionToPos == HIGH ? LOW : HIGH;
-      }
-      digitalWrite(dirPins[i], isPositive ? directionToPos : directionToNeg);
-    }
+      block->direction[i] = 0;
   }
 
-  // --- 3. Find Master Axis and Total Steps ---
-  int masterSteps = 0;
-  int masterAxis = 0;
+  // --- 2. Find Master Axis and Total Steps ---
+  long masterSteps = 0;
   for (int i = 0; i < NUM_AXES; i++)
   {
-    if (abs(delta[i]) > masterSteps)
+    if (block->delta[i] > masterSteps)
     {
-      masterSteps = abs(delta[i]);
-      masterAxis = i;
+      masterSteps = block->delta[i];
     }
   }
+  block->masterSteps = masterSteps;
+  block->durationSec = moveDurationSec;
+  block->reply = reply;
+  block->replyArg = replyArg;
+  block->replyCmd = replyCmd;
+  block->moveId = nextMoveId++;
+  if (nextMoveId == 0)
+    nextMoveId = 1;
 
   if (masterSteps == 0)
   {
-    // Serial.println("Target is the same as current. No move needed."); // Removed for performance
-    return;
-  }
-
-  // --- 4. Initialize Bresenham's Decision Parameters ---
-  int decisionParams[NUM_AXES];
-  for (int i = 0; i < NUM_AXES; i++)
-  {
-    decisionParams[i] = 2 * abs(delta[i]) - masterSteps;
+    // Nothing to move, but the reports still have to come after the moves queued before.
+    planner.pushBlock(MAX_SPEED_DELAY, MAX_SPEED_DELAY, 0, 0);
+    stepEngine.wake();
+    return block->moveId;
   }
 
-  // --- 5. Acceleration Profile Calculation (Trapezoidal) ---
+  // --- 3. Acceleration Profile Calculation (Trapezoidal) ---
 
   // Sanitize input
   accelDecelPercent = constrain(accelDecelPercent, 0.0, 1.0);
+  sCurvePercent = constrain(sCurvePercent, 0.0, 1.0);
 
-  // Calculate the number of steps for acceleration and deceleration
-  int accelSteps = masterSteps * (accelDecelPercent / 2.0);
-  int decelStartStep = masterSteps - accelSteps;
-
-  // Calculate the average delay per step to meet the duration goal.
-  // This is the target delay for the constant speed (cruise) phase.
-  float avgDelayMicroSec = (moveDurationSec * 1000000.0) / masterSteps;
-
-  // The delay at the start and end of the move. Must be slower than avg.
-  // For a trapezoidal profile, this is essentially the initial delay before ramping up.
-  float initialDelay = avgDelayMicroSec * (1.0 + accelDecelPercent);
-
-  // Clamp the calculated delays to sensible, safe hardware limits.
-  float cruiseDelay = constrain(avgDelayMicroSec, MIN_SPEED_DELAY, MAX_SPEED_DELAY);
-  float startDelay = constrain(initialDelay, cruiseDelay, MAX_SPEED_DELAY);
-
-  Serial.println("start, cruise " + String(startDelay) + ", " + String(cruiseDelay));
-  // --- 6. The Main Bresenham Loop with Ramping ---
-  unsigned long loopStartTime = micros(); // Start timing
-
-  float currentDelay = startDelay;
-
-  for (int step = 0; step < masterSteps; step++)
+  float startDelay;
+  float cruiseDelay;
+  int32_t accelSteps;
+  if (moveDurationSec <= 0)
   {
-    // --- Check E-Stop ---
-    if (ESTOP_ACTIVE)
-      return; // If E-Stop is active, exit the function immediately
-
-    // --- RAMPING LOGIC (Trapezoidal) ---
-    if (step < accelSteps && accelSteps > 0)
-    {
-      // ACCELERATION PHASE (Linear ramp)
-      // Calculate progress through the acceleration phase (0.0 to 1.0)
-      float accelProgress = (float)step / accelSteps;
-      // Linearly interpolate the delay between the start delay and the cruise delay
-      currentDelay = startDelay - (startDelay - cruiseDelay) * accelProgress;
-    }
-    else if (step >= decelStartStep && accelSteps > 0)
-    {
-      // DECELERATION PHASE (Linear ramp)
-      // Calculate progress through the deceleration phase (0.0 to 1.0)
-      float decelProgress = (float)(step - decelStartStep) / accelSteps;
-      // Linearly interpolate the delay between the cruise delay and the final (start) delay
-      currentDelay = cruiseDelay + (startDelay - cruiseDelay) * decelProgress;
-    }
-    else
-    {
-      // CONSTANT SPEED (CRUISE) PHASE
-      currentDelay = cruiseDelay;
-    }
+    block->durationSec = fastestMove(block->delta, masterSteps, sCurvePercent, startDelay, cruiseDelay, accelSteps);
+  }
+  else
+  {
+    // Calculate the number of steps for acceleration and deceleration
+    accelSteps = masterSteps * (accelDecelPercent / 2.0);
 
-    // --- MOTOR STEPPING LOGIC (Bresenham) ---
-    // a. Always step the master motor
-    stepMotor(masterAxis);
-    currentPosition[masterAxis] += direction[masterAxis];
+    // Calculate the average delay per step to meet the duration goal.
+    // This is the target delay for the constant speed (cruise) phase.
+    float avgDelayMicroSec = (moveDurationSec * 1000000.0) / masterSteps;
 
-    // b. Check and step slave motors
-    for (int i = 0; i < NUM_AXES; i++)
-    {
-      if (ESTOP_ACTIVE)
-        return; // If E-Stop is active, exit the function immediately
-      if (i == masterAxis)
-        continue;
+    // The delay at the start and end of the move. Must be slower than avg.
+    // For a trapezoidal profile, this is essentially the initial delay before ramping up.
+    float initialDelay = avgDelayMicroSec * (1.0 + accelDecelPercent);
 
-      if (decisionParams[i] >= 0)
-      {
-        stepMotor(i);
-        currentPosition[i] += direction[i];
-        decisionParams[i] -= 2 * masterSteps;
-      }
-      decisionParams[i] += 2 * abs(delta[i]);
-    }
+    // Clamp the calculated delays to sensible, safe hardware limits.
+    cruiseDelay = constrain(avgDelayMicroSec, MIN_SPEED_DELAY, MAX_SPEED_DELAY);
+    startDelay = constrain(initialDelay, cruiseDelay, MAX_SPEED_DELAY);
+  }
 
-    // c. Apply the calculated delay for speed control
-    // Ensure we never delay for less than the minimum safety time
-    delayMicroseconds(max((long)currentDelay, MIN_SPEED_DELAY));
+  // --- 4. Queue the move; the planner works out how fast it can enter and leave it ---
+  planner.pushBlock(startDelay, cruiseDelay, accelSteps, sCurvePercent);
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    currentPosition[i] = target[i];
   }
+  stepEngine.wake();
+  return block->moveId;
+}
 
-  unsigned long loopEndTime = micros();                                    // End timing
-  float actualDuration = (float)(loopEndTime - loopStartTime) / 1000000.0; // Convert to seconds
+bool isMoveInProgress()
+{
+  return stepEngine.isBusy() || !planner.isEmpty();
+}
 
-  Serial.print("Actual loop execution time: ");
-  Serial.print(actualDuration, 3); // Print with 3 decimal places
-  Serial.println(" seconds");
-  Serial.print("Difference from expected: ");
-  Serial.println(actualDuration - moveDurationSec, 3); // Print difference in seconds
-  Serial.println();
-  // Serial.println("Move Complete."); // Removed for performance
+/**
+ * @brief Prints the name of the command that queued a move, as its text reports start with it.
+ */
+void printMoveCommand(const PlannerBlock &block)
+{
+  switch (block.reply)
+  {
+  case MOVE_REPLY_JOINTS:
+    Serial.print("MOVE_JOINTS");
+    break;
+  case MOVE_REPLY_JOINT:
+    Serial.print("MOVE_JOINT ");
+    Serial.print(block.replyArg);
+    break;
+  case MOVE_REPLY_JOINT_BY:
+    Serial.print("MOVE_JOINT_BY ");
+    Serial.print(block.replyArg);
+    break;
+  case MOVE_REPLY_POSE:
+    Serial.print("MOVE_POSE");
+    break;
+  default:
+    break;
+  }
 }
 
-// Helper function to split a String by a delimiter
-int splitString(String input, char delimiter, String outputArray[], int maxItems)
+/**
+ * @brief Tells the host that a move has been queued, started or ended.
+ *
+ * Text commands get `MOVE_JOINTS QUEUED <id>`, `MOVE <id> STARTED` and
+ * `MOVE_JOINTS COMPLETE <id>` (or `ABORTED`), with `MOVE_JOINT <n>` / `MOVE_JOINT_BY <n>`
+ * / `MOVE_POSE` in place of `MOVE_JOINTS`. Binary commands get a `FRAME_EVENT_MOVE` frame, except for
+ * the acknowledgement, which is the reply to the command itself.
+ */
+void reportMoveEvent(const PlannerBlock &block, MoveEvent event)
 {
-  int itemCount = 0;
-  int startIndex = 0;
-  int delimiterIndex = input.indexOf(delimiter);
+  if (block.reply == MOVE_REPLY_NONE)
+    return;
+  if (block.reply == MOVE_REPLY_FRAME)
+  {
+    uint8_t payload[4];
+    payload[0] = event;
+    writeUint16(&payload[1], block.moveId);
+    payload[3] = planner.freeSlots();
+    sendFrame(FRAME_EVENT_MOVE, block.replyArg, payload, sizeof(payload));
+    return;
+  }
 
-  while (delimiterIndex != -1 && itemCount < maxItems)
+  if (event == MOVE_EVENT_STARTED)
   {
-    outputArray[itemCount++] = input.substring(startIndex, delimiterIndex);
-    startIndex = delimiterIndex + 1;
-    delimiterIndex = input.indexOf(delimiter, startIndex);
+    Serial.print("MOVE ");
+    Serial.print(block.moveId);
+    Serial.println(" STARTED");
+    return;
   }
+  printMoveCommand(block);
+  Serial.print(event == MOVE_EVENT_ABORTED ? " ABORTED " : " COMPLETE ");
+  Serial.println(block.moveId);
+}
 
-  // Add the last item (or the entire string if no delimiter was found)
-  if (startIndex < input.length() && itemCount < maxItems)
+/**
+ * @brief Reports the end of a move that has finished. Text commands also get its timing;
+ * binary sessions and moves without a reply get no text.
+ */
+void reportFinishedMove(const PlannerBlock &block)
+{
+  if (block.reply != MOVE_REPLY_FRAME && block.reply != MOVE_REPLY_NONE)
   {
-    outputArray[itemCount++] = input.substring(startIndex);
+    float actualDuration = (float)(block.endMicros - block.startMicros) / 1000000.0; // Convert to seconds
+
+    Serial.print("Actual loop execution time: ");
+    Serial.print(actualDuration, 3); // Print with 3 decimal places
+    Serial.println(" seconds");
+    Serial.print("Difference from expected: ");
+    Serial.println(actualDuration - block.durationSec, 3); // Print difference in seconds
+    Serial.println();
   }
 
-  return itemCount; // Return the number of items split
+  reportMoveEvent(block, block.aborted ? MOVE_EVENT_ABORTED : MOVE_EVENT_COMPLETE);
+}
+
+/**
+ * @brief Reports the moves the step engine has started or finished since the last call.
+ *
+ * The events come out in the order they happened: a move's end is reported before the
+ * start of the move that follows it, even when both happened on the same step.
+ */
+void reportMoveProgress()
+{
+  PROFILE_SCOPE(PROFILE_MOVE_REPORTS);
+  while (true)
+  {
+    PlannerBlock *started = planner.startedBlock();
+    PlannerBlock *finished = planner.finishedBlock();
+    if (finished != nullptr && finished != started)
+    {
+      reportFinishedMove(*finished);
+      planner.discardFinishedBlock();
+    }
+    else if (started != nullptr)
+    {
+      reportMoveEvent(*started, MOVE_EVENT_STARTED);
+      planner.discardStartedBlock();
+    }
+    else
+    {
+      return;
+    }
+  }
 }
 
-// Check if the limit switch for the specified joint is pressed
+/**
+ * @brief Whether the limit switch of a joint at rest is pressed.
+ *
+ * While a joint seeks its limit, the step engine watches the switch instead.
+ */
 bool isLimitSwitchActive(int jointIndex)
 {
-  return limitSwitches[jointIndex].isPressed(); // LOW means pressed
+  return digitalRead(LIMIT_SWITCH_PINS[jointIndex]) == LIMIT_SWITCH_PRESSED;
 }
 
 enum CalibrationPhase
@@ -394,28 +396,75 @@ void startCalibrateJoint(int jointIndex)
   calibrationPhase[jointIndex] = CALIB_IDLE; // Reset phase
   calibrationInProgress[jointIndex] = true;
   stopMotor(jointIndex);
-  currentPosition[jointIndex] = 0;       // Clear software position for safety
+  setJointPosition(jointIndex, 0);       // Clear software position for safety
   isCalibrationDone[jointIndex] = false; // Reset calibration status
 }
 
-// This function will be called repeatedly in loop() for each joint
+/**
+ * @brief Whether a joint of an earlier calibration stage is still homing.
+ */
+bool isWaitingForEarlierStage(int jointIndex)
+{
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    if (calibrationInProgress[i] && CALIBRATION_STAGES[i] < CALIBRATION_STAGES[jointIndex])
+      return true;
+  }
+  return false;
+}
+
+void failCalibration(int jointIndex, const char *reason)
+{
+  Serial.print("Joint ");
+  Serial.print(jointIndex + 1);
+  Serial.print(": ");
+  Serial.println(reason);
+  calibrationPhase[jointIndex] = CALIB_FAILED;
+}
+
+/**
+ * @brief Prints where a seeking joint found its limit switch and how far past it the joint stopped.
+ */
+void printLimitHit(int jointIndex, const char *approach, long limitPosition)
+{
+  Serial.print("Joint ");
+  Serial.print(jointIndex + 1);
+  Serial.print(": Limit switch hit (");
+  Serial.print(approach);
+  Serial.print("), stopped ");
+  Serial.print(abs(stepEngine.position(jointIndex) - limitPosition));
+  Serial.print(" steps past it.");
+}
+
+/**
+ * @brief Advances the homing of a joint. Called from loop() for every joint.
+ *
+ * The moves are jogs of the step engine, so every joint homes at the same time as the
+ * others, and while queued moves run on the calibrated joints. A phase only starts its
+ * move once the previous one is over. The limit switch is watched by the step engine,
+ * which latches the position the switch closed at and stops the joint shortly after, so
+ * the home position depends neither on the seek speed nor on how long loop() takes.
+ */
 void runJointCalibration(int jointIndex)
 {
   if (!calibrationInProgress[jointIndex])
     return; // Only run if calibration is active for this joint
+  if (stepEngine.isJogging(jointIndex) && calibrationPhase[jointIndex] == CALIB_IDLE)
+    return; // Stopping whatever the joint was doing
 
-  // Configure direction based on CALIBRATION_DIRECTION
-  int positiveDirection = CALIBRATION_DIRECTION[jointIndex] ? 1 : -1; // +1 for positive move, -1 for negative move
-  if (INVERT_DIRECTION[jointIndex])
-  {
-    positiveDirection = -positiveDirection; // Invert direction if configured
-  }
+  // The joint seeks its limit in the direction set by CALIBRATION_DIRECTION, and backs away in the other.
+  int seekDirection = CALIBRATION_DIRECTION[jointIndex] ? 1 : -1;
+  float speed = CALIBRATION_SPEEDS[jointIndex];
 
   float backOffDegrees = 15.0; // Back off 15 degrees from the limit
+  int32_t overtravelSteps = LIMIT_OVERTRAVEL_DEGREES * STEPS_PER_DEGREE[jointIndex];
+  long limitPosition;
 
   switch (calibrationPhase[jointIndex])
   {
   case CALIB_IDLE:
+    if (isWaitingForEarlierStage(jointIndex))
+      break;
     // Check if already on limit switch
     if (isLimitSwitchActive(jointIndex))
     {
@@ -423,9 +472,7 @@ void runJointCalibration(int jointIndex)
       Serial.print(jointIndex + 1);
       Serial.println(": Already on limit, moving away.");
       long backOffSteps = (long)(backOffDegrees * STEPS_PER_DEGREE[jointIndex]);
-      steppers[jointIndex].setMaxSpeed(CALIBRATION_SPEEDS[jointIndex]);
-      steppers[jointIndex].setAcceleration(CALIBRATION_SPEEDS[jointIndex] / 2); // Simple acceleration for backoff
-      steppers[jointIndex].move(positiveDirection * backOffSteps);              // Move in the positive (away) direction
+      stepEngine.jog(jointIndex, -seekDirection * backOffSteps, speed, speed / 2); // Simple acceleration for backoff
       calibrationPhase[jointIndex] = CALIB_BACKOFF_FROM_LIMIT;
     }
     else
@@ -434,47 +481,36 @@ void runJointCalibration(int jointIndex)
       Serial.print(jointIndex + 1);
       Serial.println(": Seeking limit fast.");
       long maxTravelSteps = (long)((abs(JOINT_NEGATIVE_LIMITS[jointIndex]) + abs(JOINT_POSITIVE_LIMITS[jointIndex])) * STEPS_PER_DEGREE[jointIndex]); // Max travel
-      steppers[jointIndex].setMaxSpeed(CALIBRATION_SPEEDS[jointIndex]);
-      steppers[jointIndex].setAcceleration(CALIBRATION_SPEEDS[jointIndex] / 2);
-      steppers[jointIndex].move(-positiveDirection * maxTravelSteps); // Move towards limit (negative direction relative to calibration direction)
+      float seekSpeed = CALIBRATION_SEEK_SPEEDS[jointIndex];
+      stepEngine.jogToLimit(jointIndex, seekDirection * maxTravelSteps, seekSpeed, seekSpeed / 2, overtravelSteps);
       calibrationPhase[jointIndex] = CALIB_SEEK_LIMIT_FAST;
     }
     break;
 
   case CALIB_SEEK_LIMIT_FAST:
-    if (isLimitSwitchActive(jointIndex))
+    if (stepEngine.isJogging(jointIndex))
+      break; // Still seeking, or stopping past the switch
+    if (stepEngine.limitHit(jointIndex, limitPosition))
     {
-      stopMotor(jointIndex); // Stop the stepper motor immediately
-      Serial.print("Joint ");
-      Serial.print(jointIndex + 1);
-      Serial.println(": Limit switch hit (fast). Backing off.");
+      printLimitHit(jointIndex, "fast", limitPosition);
+      Serial.println(" Backing off.");
       long backOffSteps = (long)(5 * STEPS_PER_DEGREE[jointIndex]);
-      steppers[jointIndex].setAcceleration(CALIBRATION_SPEEDS[jointIndex] / 2); // Set acceleration for backoff
-      steppers[jointIndex].setMaxSpeed(CALIBRATION_SPEEDS[jointIndex]);         // Keep same speed for backoff
-      steppers[jointIndex].move(positiveDirection * backOffSteps);              // Move away from limit
+      stepEngine.jog(jointIndex, -seekDirection * backOffSteps, speed, speed / 2); // Move away from limit
       calibrationPhase[jointIndex] = CALIB_BACKOFF_FROM_LIMIT;
     }
-    else if (steppers[jointIndex].distanceToGo() == 0)
+    else
     {
       // Moved maximum distance and limit not hit
-      Serial.print("Joint ");
-      Serial.print(jointIndex + 1);
-      Serial.println(": Max travel reached, limit not found. Failed calibration.");
-      calibrationPhase[jointIndex] = CALIB_FAILED;
-      calibrationInProgress[jointIndex] = false;
+      failCalibration(jointIndex, "Max travel reached, limit not found. Failed calibration.");
     }
     break;
 
   case CALIB_BACKOFF_FROM_LIMIT:
-    if (steppers[jointIndex].distanceToGo() == 0)
+    if (!stepEngine.isJogging(jointIndex))
     {
       if (isLimitSwitchActive(jointIndex))
       {
-        Serial.print("Joint ");
-        Serial.print(jointIndex + 1);
-        Serial.println(": Still on limit after backoff. Failed calibration.");
-        calibrationPhase[jointIndex] = CALIB_FAILED;
-        calibrationInProgress[jointIndex] = false;
+        failCalibration(jointIndex, "Still on limit after backoff. Failed calibration.");
       }
       else
       {
@@ -482,23 +518,21 @@ void runJointCalibration(int jointIndex)
         Serial.print(jointIndex + 1);
         Serial.println(": Backed off, now seeking limit slowly.");
         long fineApproachSteps = (long)((backOffDegrees + 5) * STEPS_PER_DEGREE[jointIndex]); // Small distance for fine approach
-        steppers[jointIndex].setMaxSpeed(CALIBRATION_SPEEDS[jointIndex] / 5.0);               // Slower speed
-        steppers[jointIndex].setAcceleration(CALIBRATION_SPEEDS[jointIndex] / 10.0);
-        steppers[jointIndex].move(-positiveDirection * fineApproachSteps); // Move towards limit slowly
+        stepEngine.jogToLimit(jointIndex, seekDirection * fineApproachSteps, speed / 5.0, speed / 10.0, overtravelSteps); // Slower speed
         calibrationPhase[jointIndex] = CALIB_SEEK_LIMIT_SLOW;
       }
     }
     break;
 
   case CALIB_SEEK_LIMIT_SLOW:
-    if (isLimitSwitchActive(jointIndex))
+    if (stepEngine.isJogging(jointIndex))
+      break;
+    if (stepEngine.limitHit(jointIndex, limitPosition))
     {
-      stopMotor(jointIndex);
-      Serial.print("Joint ");
-      Serial.print(jointIndex + 1);
-      Serial.println(": Limit switch hit (slow). Moving to center.");
-      steppers[jointIndex].setCurrentPosition(0); // Set current position to 0 at the limit switch
-      currentPosition[jointIndex] = 0;            // Sync your software position array
+      printLimitHit(jointIndex, "slow", limitPosition);
+      Serial.println(" Moving to center.");
+      // Zero at the step the switch closed on, wherever the joint came to rest.
+      stepEngine.setPosition(jointIndex, stepEngine.position(jointIndex) - limitPosition);
 
       long stepsToCenter = 0;
       if (CALIBRATION_DIRECTION[jointIndex])
@@ -510,35 +544,30 @@ void runJointCalibration(int jointIndex)
         stepsToCenter = (long)((abs(JOINT_NEGATIVE_LIMITS[jointIndex]) + CALIBRATION_OFFSETS[jointIndex]) * STEPS_PER_DEGREE[jointIndex]);
       }
 
-      steppers[jointIndex].setMaxSpeed(JOINT_MAX_SPEEDS[jointIndex]);         // Use max operating speed for center move
-      steppers[jointIndex].setAcceleration(JOINT_MAX_SPEEDS[jointIndex] / 2); // Set appropriate acceleration
-      steppers[jointIndex].move(positiveDirection * stepsToCenter);           // Move to the calculated center
+      // Use max operating speed for center move
+      long centerSteps = -seekDirection * stepsToCenter - stepEngine.position(jointIndex);
+      stepEngine.jog(jointIndex, centerSteps, JOINT_MAX_SPEEDS[jointIndex], JOINT_MAX_SPEEDS[jointIndex] / 2);
       calibrationPhase[jointIndex] = CALIB_MOVE_TO_CENTER;
     }
-    else if (steppers[jointIndex].distanceToGo() == 0)
+    else
     {
-      Serial.print("Joint ");
-      Serial.print(jointIndex + 1);
-      Serial.println(": Fine approach finished, limit not found. Failed calibration.");
-      calibrationPhase[jointIndex] = CALIB_FAILED;
-      calibrationInProgress[jointIndex] = false;
+      failCalibration(jointIndex, "Fine approach finished, limit not found. Failed calibration.");
     }
     break;
 
   case CALIB_MOVE_TO_CENTER:
-    if (steppers[jointIndex].distanceToGo() == 0)
+    if (!stepEngine.isJogging(jointIndex))
     {
       Serial.print("Joint ");
       Serial.print(jointIndex + 1);
       Serial.println(": Moved to center. Calibration successful.");
-      currentPosition[jointIndex] = 0; // Update software position
+      setJointPosition(jointIndex, 0); // Update software position
       calibrationPhase[jointIndex] = CALIB_DONE;
     }
     break;
 
   case CALIB_DONE:
     // Calibration for this joint is complete.
-    stopMotor(jointIndex); // Stop the stepper motor
     Serial.print("Calibration complete for Joint ");
     Serial.println(jointIndex + 1);
     calibrationInProgress[jointIndex] = false; // Reset the calibration state
@@ -548,12 +577,22 @@ void runJointCalibration(int jointIndex)
   case CALIB_FAILED:
     // Calibration for this joint failed.
     // You might want to signal an error or retry.
-    Serial.println("Calibration failed for Joint " + String(jointIndex + 1));
+    Serial.print("Calibration failed for Joint ");
+    Serial.println(jointIndex + 1);
     calibrationInProgress[jointIndex] = false; // Reset the calibration state
     stopMotor(jointIndex);                     // Stop the stepper motor
     break;
   }
-  steppers[jointIndex].run(); // Keep the stepper running in its current state
+}
+
+int calibrationStatus(int jointIndex)
+{
+  int status = 0; // 0 - Not Calibrated
+  if (isCalibrationDone[jointIndex])
+    status = 2; // 2 - Calibrated
+  else if (calibrationInProgress[jointIndex])
+    status = 1; // 1 - In Progress
+  return status;
 }
 
 void printCalibrationStatus()
@@ -561,13 +600,7 @@ void printCalibrationStatus()
   Serial.print("CALIBRATION STATUS: [");
   for (int i = 0; i < NUM_AXES; i++)
   {
-    int status = 0; // 0 - Not Calibrated
-    if (isCalibrationDone[i])
-      status = 2; // 2 - Calibrated
-    else if (calibrationInProgress[i])
-      status = 1; // 1 - In Progress
-
-    Serial.print(status);
+    Serial.print(calibrationStatus(i));
     if (i < NUM_AXES - 1)
       Serial.print(",");
   }
@@ -586,105 +619,106 @@ bool isInRange(int jointIndex, float degrees)
   return (degrees >= JOINT_NEGATIVE_LIMITS[jointIndex] && degrees <= JOINT_POSITIVE_LIMITS[jointIndex]);
 }
 
+/**
+ * @brief E-Stop pin change interrupt: halts the step engine on the spot when it is pressed.
+ *
+ * Nothing else happens here; `handleEstop()` flushes the queue and reports the stop from
+ * the main loop.
+ */
 void onEstopChanged()
 {
-  if (digitalRead(ESTOP_PIN) == LOW)
-  {
-    ESTOP_ACTIVE = true; // E-Stop is pressed
-    Serial.println("E-Stop activated");
-  }
-  else
-  {
-    ESTOP_ACTIVE = false; // E-Stop is released
-    Serial.println("E-Stop released");
-  }
+  ESTOP_ACTIVE = isEstopPressed();
+  if (ESTOP_ACTIVE)
+    stepEngine.emergencyStop();
 }
 
-void handle_MOVE_JOINTS(String input)
-{
-  // MOVE_JOINTS j1_degree,j2_degree,j3_degree,j4_degree,j5_degree,j6_degree,duration_sec,accel_decel_percent
-  // use split
-  String parts[8];
-  splitString(input, ',', parts, 8);
-  if (parts[0].length() > 0 && parts[1].length() > 0 && parts[2].length() > 0 && parts[3].length() > 0 && parts[4].length() > 0 && parts[5].length() > 0 && parts[6].length() > 0 && parts[7].length() > 0)
-  {
-    int targetDegreesInSteps[NUM_AXES];
-    for (int i = 0; i < NUM_AXES; i++)
-    {
-      if (isCalibrationDone[i] == false)
-      {
-        Serial.println("Joint " + String(i + 1) + " is not calibrated. Please calibrate before moving.");
-        return; // Exit if any joint is not calibrated
-      }
+// =================================================================
+//   COMMANDS
+// =================================================================
+// Each command is executed by one function shared by the text and the binary protocol.
+// The text handlers parse their arguments and print the outcome; `handleFrame()` decodes
+// the payload and replies with the status.
 
-      // Check if the joint is within limits
-      float degrees = parts[i].toFloat();
-      if (!isInRange(i, degrees))
-      {
-        Serial.println("Joint " + String(i + 1) + " out of range: " + String(degrees) + " degrees. Valid range: [" + String(JOINT_NEGATIVE_LIMITS[i]) + ", " + String(JOINT_POSITIVE_LIMITS[i]) + "]");
-        return; // Exit if any joint is out of range
-      }
-      targetDegreesInSteps[i] = degreeToSteps(i, parts[i].toFloat());
-    }
-    float moveDurationSec = parts[6].toFloat();
-    float accelDecelPercent = parts[7].toFloat();
-    // Call the move function
-    moveMotorsBresenham(targetDegreesInSteps, moveDurationSec, accelDecelPercent);
-    Serial.println("MOVE_JOINTS COMPLETE");
-  }
-  else
+// Command Hex Codes
+#define CMD_ECHO 0x00
+#define CMD_S 0x01
+#define CMD_STOP_JOINT 0x02
+#define CMD_MOVE_JOINTS 0x03
+#define CMD_CALIBRATE_JOINTS 0x04
+#define CMD_PRINT_POS 0x05
+#define CMD_PRINT_CALIBRATION_STATUS 0x06
+#define CMD_ADD 0x07
+#define CMD_MOVE_JOINT 0x08
+#define CMD_MOVE_JOINT_BY 0x09
+#define CMD_SUBSCRIBE_TELEMETRY 0x0A
+#define CMD_PRINT_PROFILE 0x0B
+#define CMD_MOVE_POSE 0x0C
+#define CMD_FEED_HOLD 0x0D
+#define CMD_FEED_OVERRIDE 0x0E
+
+bool binaryFramesEnabled = false; // Set by the `00 BIN?` handshake
+FrameDecoder frameDecoder;
+
+/**
+ * @brief Validates and queues a move of all joints to absolute angles.
+ * @param cmd Command the move is queued by.
+ * @param failedJoint Index of the joint that made the command fail.
+ * @param moveId Set to the ID of the queued move.
+ */
+CommandStatus executeMoveJoints(const float degrees[NUM_AXES], float moveDurationSec, float accelDecelPercent, float sCurvePercent, MoveReply reply, uint8_t replyArg, uint8_t cmd, int &failedJoint, uint16_t &moveId)
+{
+  int targetDegreesInSteps[NUM_AXES];
+  for (int i = 0; i < NUM_AXES; i++)
   {
-    Serial.println("Invalid MOVE_JOINTS command format. Use: MOVE_JOINTS <j1>,<j2>,<j3>,<j4>,<j5>,<j6>,<duration_sec>,<accel_decel_percent>");
+    failedJoint = i;
+    if (isCalibrationDone[i] == false)
+      return STATUS_NOT_CALIBRATED;
+
+    // Check if the joint is within limits
+    if (!isInRange(i, degrees[i]))
+      return STATUS_OUT_OF_RANGE;
+    targetDegreesInSteps[i] = degreeToSteps(i, degrees[i]);
   }
+  moveId = moveMotorsBresenham(targetDegreesInSteps, moveDurationSec, accelDecelPercent, sCurvePercent, reply, replyArg, cmd);
+  return moveId != 0 ? STATUS_OK : STATUS_QUEUE_FULL;
 }
 
-void handle_MOVE_JOINT(String input)
+/**
+ * @brief Queues a move of the tool flange to `pose`, solved for the joint angles nearest
+ * to where the queued moves leave the joints.
+ * @param failedJoint Index of the joint that made the command fail.
+ * @param moveId Set to the ID of the queued move.
+ */
+CommandStatus executeMovePose(const Pose &pose, float moveDurationSec, float accelDecelPercent, float sCurvePercent, MoveReply reply, uint8_t replyArg, int &failedJoint, uint16_t &moveId)
 {
-  // MOVE_JOINT jointNum,targetDegree,duration_sec,accel_decel_percent
-  String parts[4];
-  splitString(input, ',', parts, 4);
-  int jointIndex = parts[0].toInt() - 1;
-  float targetDegree = parts[1].toFloat();
-  float duration = parts[2].toFloat();
-  float accelDecelPercent = parts[3].toFloat();
-
-  int degreeInSteps = degreeToSteps(jointIndex, targetDegree);
-
-  int targetSteps[NUM_AXES] = {0};
-  for (int idx = 0; idx < NUM_AXES; idx++)
+  float currentDegrees[NUM_AXES];
+  for (int i = 0; i < NUM_AXES; i++)
   {
-    if (idx == jointIndex)
-    {
-      targetSteps[idx] = degreeInSteps;
-    }
-    else
-    {
-      targetSteps[idx] = currentPosition[idx];
-    }
+    currentDegrees[i] = currentPosition[i] / STEPS_PER_DEGREE[i];
   }
-
-  moveMotorsBresenham(targetSteps, duration, accelDecelPercent);
-  Serial.println("MOVE_JOINT " + parts[0] + " COMPLETE");
+  float degrees[NUM_AXES];
+  if (!inverseKinematics(pose, currentDegrees, degrees))
+    return STATUS_UNREACHABLE;
+  return executeMoveJoints(degrees, moveDurationSec, accelDecelPercent, sCurvePercent, reply, replyArg, CMD_MOVE_POSE, failedJoint, moveId);
 }
 
-void handle_MOVE_JOINT_BY(String input)
+/**
+ * @brief Queues a move of one joint, to an absolute angle or by a relative angle.
+ * @param moveId Set to the ID of the queued move.
+ */
+CommandStatus executeMoveJoint(int jointIndex, float degree, bool isRelative, float moveDurationSec, float accelDecelPercent, MoveReply reply, uint8_t replyArg, uint16_t &moveId)
 {
-  // MOVE_JOINT_BY jointNum,degreeDelta,duration_sec,accel_decel_percent
-  String parts[4];
-  splitString(input, ',', parts, 4);
-  int jointIndex = parts[0].toInt() - 1;
-  float degreeDelta = parts[1].toFloat();
-  float duration = parts[2].toFloat();
-  float accelDecelPercent = parts[3].toFloat();
+  if (jointIndex < 0 || jointIndex >= NUM_AXES)
+    return STATUS_INVALID_ARGUMENT;
 
-  int degreeDeltaInSteps = degreeToSteps(jointIndex, degreeDelta);
+  int degreeInSteps = degreeToSteps(jointIndex, degree);
 
   int targetSteps[NUM_AXES] = {0};
   for (int idx = 0; idx < NUM_AXES; idx++)
   {
     if (idx == jointIndex)
     {
-      targetSteps[idx] = currentPosition[idx] + degreeDeltaInSteps;
+      targetSteps[idx] = isRelative ? currentPosition[idx] + degreeInSteps : degreeInSteps;
     }
     else
     {
@@ -692,173 +726,856 @@ void handle_MOVE_JOINT_BY(String input)
     }
   }
 
-  moveMotorsBresenham(targetSteps, duration, accelDecelPercent);
-  Serial.println("MOVE_JOINT_BY " + parts[0] + " COMPLETE");
+  uint8_t cmd = isRelative ? CMD_MOVE_JOINT_BY : CMD_MOVE_JOINT;
+  moveId = moveMotorsBresenham(targetSteps, moveDurationSec, accelDecelPercent, 0, reply, replyArg, cmd);
+  return moveId != 0 ? STATUS_OK : STATUS_QUEUE_FULL;
 }
 
-void handle_S()
+/**
+ * @brief Stops a joint that moves on its own. A calibration in progress fails.
+ */
+void stopJoint(int jointIndex)
 {
-  for (int i = 0; i < NUM_AXES; i++)
+  stopMotor(jointIndex);
+  if (jointIndex >= 0 && jointIndex < NUM_AXES && calibrationInProgress[jointIndex])
   {
-    stopMotor(i); // Stop all motors
-    if (calibrationInProgress[i])
-    {
-      calibrationPhase[i] = CALIB_FAILED;
-    }
+    calibrationPhase[jointIndex] = CALIB_FAILED;
   }
-  Serial.println("All motors stopped.");
 }
 
-void handle_STOP_JOINT(String input)
+void stopAllMotors()
 {
-  // Parse the command
-  // STOP_JOINT 1
-  int jointNum = input.toInt();
-  stopMotor(jointNum - 1);
-  Serial.println("STOP_J " + String(jointNum));
+  abortMotion();
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    stopJoint(i); // Stop all motors
+  }
 }
 
-void handle_CALIBRATE_JOINTS(String input)
+/**
+ * @brief Prints the outcome of a move command: its acknowledgement, or why it was rejected.
+ */
+void printMoveStatus(CommandStatus status, int jointIndex, const char *command, uint16_t moveId)
 {
-  // Parse the command
-  // CALIBRATE_JOINTS 1,2,3
-  // CALIBRATE_JOINTS 4,5,6
-  String axes[NUM_AXES];
-  splitString(input, ',', axes, NUM_AXES);
-  for (int i = 0; i < NUM_AXES; i++)
+  switch (status)
   {
-    if (axes[i].length() > 0)
+  case STATUS_OK:
+    Serial.print(command);
+    if (jointIndex >= 0)
     {
-      int jointIndex = axes[i].toInt() - 1; // Convert to zero-based index
-      if (jointIndex >= 0 && jointIndex < NUM_AXES)
-      {
-        // Call the calibration function
-        startCalibrateJoint(jointIndex);
-        Serial.println("Calibration started for Joint " + String(jointIndex + 1));
-      }
-      else
-      {
-        Serial.println("Invalid joint index: " + String(jointIndex + 1) + ". Use a number between 1 and " + String(NUM_AXES) + ".");
-      }
+      Serial.print(' ');
+      Serial.print(jointIndex + 1);
     }
+    Serial.print(" QUEUED ");
+    Serial.println(moveId);
+    break;
+  case STATUS_INVALID_ARGUMENT:
+    Serial.print("Invalid joint index: ");
+    Serial.print(jointIndex + 1);
+    Serial.print(". Use a number between 1 and ");
+    Serial.print(NUM_AXES);
+    Serial.println(".");
+    break;
+  case STATUS_QUEUE_FULL:
+    Serial.println("Motion queue full. Wait for a move to complete.");
+    break;
+  default:
+    break;
   }
 }
 
-String command = "";
-
-// Command Hex Codes
-#define CMD_ECHO 0x00
-#define CMD_S 0x01
-#define CMD_STOP_JOINT 0x02
-#define CMD_MOVE_JOINTS 0x03
-#define CMD_CALIBRATE_JOINTS 0x04
-#define CMD_PRINT_POS 0x05
-#define CMD_PRINT_CALIBRATION_STATUS 0x06
-#define CMD_ADD 0x07
-#define CMD_MOVE_JOINT 0x08
-#define CMD_MOVE_JOINT_BY 0x09
+void handle_MOVE_JOINTS(char *input)
+{
+  // MOVE_JOINTS j1_degree,j2_degree,j3_degree,j4_degree,j5_degree,j6_degree,duration_sec,accel_decel_percent[,s_curve_percent]
+  // A duration_sec of 0 moves as fast as the joints' speed and acceleration limits allow.
+  char *parts[9];
+  splitFields(input, ',', parts, 9);
+  if (parts[0][0] && parts[1][0] && parts[2][0] && parts[3][0] && parts[4][0] && parts[5][0] && parts[6][0] && parts[7][0])
+  {
+    float degrees[NUM_AXES];
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      degrees[i] = atof(parts[i]);
+    }
+    float moveDurationSec = atof(parts[6]);
+    float accelDecelPercent = atof(parts[7]);
+    float sCurvePercent = atof(parts[8]); // Empty, so 0, when left out
+
+    int i = 0;
+    uint16_t moveId = 0;
+    CommandStatus status = executeMoveJoints(degrees, moveDurationSec, accelDecelPercent, sCurvePercent, MOVE_REPLY_JOINTS, 0, CMD_MOVE_JOINTS, i, moveId);
+    if (status == STATUS_NOT_CALIBRATED)
+    {
+      Serial.print("Joint ");
+      Serial.print(i + 1);
+      Serial.println(" is not calibrated. Please calibrate before moving.");
+    }
+    else if (status == STATUS_OUT_OF_RANGE)
+    {
+      Serial.print("Joint ");
+      Serial.print(i + 1);
+      Serial.print(" out of range: ");
+      Serial.print(degrees[i]);
+      Serial.print(" degrees. Valid range: [");
+      Serial.print(JOINT_NEGATIVE_LIMITS[i]);
+      Serial.print(", ");
+      Serial.print(JOINT_POSITIVE_LIMITS[i]);
+      Serial.println("]");
+    }
+    else
+    {
+      printMoveStatus(status, -1, "MOVE_JOINTS", moveId);
+    }
+  }
+  else
+  {
+    Serial.println("Invalid MOVE_JOINTS command format. Use: MOVE_JOINTS <j1>,<j2>,<j3>,<j4>,<j5>,<j6>,<duration_sec>,<accel_decel_percent>[,<s_curve_percent>]");
+  }
+}
 
-void processSerialCommands()
+void handle_MOVE_POSE(char *input)
+{
+  // MOVE_POSE x_mm,y_mm,z_mm,roll_degree,pitch_degree,yaw_degree,duration_sec,accel_decel_percent[,s_curve_percent]
+  char *parts[9];
+  splitFields(input, ',', parts, 9);
+  if (parts[0][0] && parts[1][0] && parts[2][0] && parts[3][0] && parts[4][0] && parts[5][0] && parts[6][0] && parts[7][0])
+  {
+    Pose pose = {(float)atof(parts[0]), (float)atof(parts[1]), (float)atof(parts[2]),
+                 (float)atof(parts[3]), (float)atof(parts[4]), (float)atof(parts[5])};
+    float moveDurationSec = atof(parts[6]);
+    float accelDecelPercent = atof(parts[7]);
+    float sCurvePercent = atof(parts[8]);
+
+    int i = 0;
+    uint16_t moveId = 0;
+    CommandStatus status = executeMovePose(pose, moveDurationSec, accelDecelPercent, sCurvePercent, MOVE_REPLY_POSE, 0, i, moveId);
+    if (status == STATUS_UNREACHABLE)
+    {
+      Serial.println("Pose out of reach, or only reachable with a joint out of range.");
+    }
+    else if (status == STATUS_NOT_CALIBRATED)
+    {
+      Serial.print("Joint ");
+      Serial.print(i + 1);
+      Serial.println(" is not calibrated. Please calibrate before moving.");
+    }
+    else if (status == STATUS_OUT_OF_RANGE)
+    {
+      // The solver keeps the joints within their limits, so this is not expected; it still gets a reply.
+      Serial.print("Pose only reachable with Joint ");
+      Serial.print(i + 1);
+      Serial.print(" out of range. Valid range: [");
+      Serial.print(JOINT_NEGATIVE_LIMITS[i]);
+      Serial.print(", ");
+      Serial.print(JOINT_POSITIVE_LIMITS[i]);
+      Serial.println("]");
+    }
+    else
+    {
+      printMoveStatus(status, -1, "MOVE_POSE", moveId);
+    }
+  }
+  else
+  {
+    Serial.println("Invalid MOVE_POSE command format. Use: MOVE_POSE <x>,<y>,<z>,<roll>,<pitch>,<yaw>,<duration_sec>,<accel_decel_percent>[,<s_curve_percent>]");
+  }
+}
+
+void handle_MOVE_JOINT(char *input)
+{
+  // MOVE_JOINT jointNum,targetDegree,duration_sec,accel_decel_percent
+  char *parts[4];
+  splitFields(input, ',', parts, 4);
+  int jointIndex = atoi(parts[0]) - 1;
+  float targetDegree = atof(parts[1]);
+  float duration = atof(parts[2]);
+  float accelDecelPercent = atof(parts[3]);
+
+  uint16_t moveId = 0;
+  CommandStatus status = executeMoveJoint(jointIndex, targetDegree, false, duration, accelDecelPercent, MOVE_REPLY_JOINT, jointIndex + 1, moveId);
+  printMoveStatus(status, jointIndex, "MOVE_JOINT", moveId);
+}
+
+void handle_MOVE_JOINT_BY(char *input)
+{
+  // MOVE_JOINT_BY jointNum,degreeDelta,duration_sec,accel_decel_percent
+  char *parts[4];
+  splitFields(input, ',', parts, 4);
+  int jointIndex = atoi(parts[0]) - 1;
+  float degreeDelta = atof(parts[1]);
+  float duration = atof(parts[2]);
+  float accelDecelPercent = atof(parts[3]);
+
+  uint16_t moveId = 0;
+  CommandStatus status = executeMoveJoint(jointIndex, degreeDelta, true, duration, accelDecelPercent, MOVE_REPLY_JOINT_BY, jointIndex + 1, moveId);
+  printMoveStatus(status, jointIndex, "MOVE_JOINT_BY", moveId);
+}
+
+void handle_S()
+{
+  stopAllMotors();
+  Serial.println("All motors stopped.");
+}
+
+void handle_FEED_HOLD(char *input)
 {
-  if (Serial.available())
+  // FEED_HOLD 1 to slow the queued moves down to a stop, FEED_HOLD 0 to resume them
+  if (atoi(input) != 0)
+  {
+    stepEngine.hold();
+    Serial.println("FEED_HOLD ON");
+  }
+  else
   {
-    // Read full line until newline
-    String line = Serial.readStringUntil('\n');
-    line.trim(); // Remove whitespace
+    stepEngine.resume();
+    Serial.println("FEED_HOLD OFF");
+  }
+}
+
+void handle_FEED_OVERRIDE(char *input)
+{
+  // FEED_OVERRIDE 50 to run the queued moves at half their speed, FEED_OVERRIDE alone to print it
+  if (*input != '\0')
+    planner.setFeedOverride(constrain(atoi(input), FEED_OVERRIDE_MIN, FEED_OVERRIDE_MAX));
+  Serial.print("FEED_OVERRIDE ");
+  Serial.println(planner.feedOverride());
+}
 
-    if (line.length() < 2)
-      return; // At least two hex digits
+void handle_STOP_JOINT(char *input)
+{
+  // Parse the command
+  // STOP_JOINT 1
+  int jointNum = atoi(input);
+  stopJoint(jointNum - 1);
+  Serial.print("STOP_J ");
+  Serial.println(jointNum);
+}
 
-    // Extract hex command (first 2 characters)
-    String cmdHex = line.substring(0, 2);
-    int cmd = strtol(cmdHex.c_str(), nullptr, 16);
+void handle_SUBSCRIBE_TELEMETRY(char *input)
+{
+  // SUBSCRIBE_TELEMETRY 100 (frames per second, 0 to stop)
+  if (!binaryFramesEnabled)
+  {
+    Serial.println("Telemetry is sent as binary frames. Send 00 BIN? first.");
+    return;
+  }
+  uint16_t rate = telemetry.subscribe(constrain(atol(input), 0L, 0xFFFFL));
+  Serial.print("TELEMETRY ");
+  Serial.println(rate);
+}
 
-    // Extract arguments (if any)
-    String args = "";
-    if (line.length() > 2 && line.charAt(2) == ' ')
+void handle_PRINT_PROFILE(char *input)
+{
+  // PRINT_PROFILE, or PRINT_PROFILE RESET to start counting afresh
+#ifdef PROFILER
+  if (strcmp(input, "RESET") == 0)
+  {
+    profiler.reset();
+    Serial.println("PROFILE RESET");
+    return;
+  }
+  Serial.println("PROFILE cycles min/avg/max, passes");
+  for (uint8_t i = 0; i < PROFILE_SECTION_COUNT; i++)
+  {
+    SectionStats stats = profiler.sectionStats((ProfileSection)i);
+    if (stats.count == 0)
+      continue;
+    Serial.print(profileSectionName((ProfileSection)i));
+    Serial.print(": ");
+    Serial.print(stats.minCycles);
+    Serial.print('/');
+    Serial.print((uint32_t)(stats.totalCycles / stats.count));
+    Serial.print('/');
+    Serial.print(stats.maxCycles);
+    Serial.print(", ");
+    Serial.println(stats.count);
+  }
+  ProfileCounters counters = profiler.snapshotCounters();
+  Serial.print("step ISR overruns: ");
+  Serial.println(counters.isrOverruns);
+  Serial.print("missed step deadlines: ");
+  Serial.println(counters.missedDeadlines);
+  Serial.print("serial RX overflows: ");
+  Serial.println(counters.rxOverflows);
+  Serial.print("free SRAM low water: ");
+  Serial.println(profiler.freeSramLowWater());
+#else
+  (void)input;
+  Serial.println("The profiler is not built in. Build with -DPROFILER.");
+#endif
+}
+
+void handle_CALIBRATE_JOINTS(char *input)
+{
+  // Parse the command
+  // CALIBRATE_JOINTS 1,2,3
+  // CALIBRATE_JOINTS 4,5,6
+  char *axes[NUM_AXES];
+  splitFields(input, ',', axes, NUM_AXES);
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    if (axes[i][0] != '\0')
     {
-      args = line.substring(3); // Skip space after command
+      int jointIndex = atoi(axes[i]) - 1; // Convert to zero-based index
+      if (jointIndex >= 0 && jointIndex < NUM_AXES && planner.movesAxis(jointIndex))
+      {
+        Serial.print("Cannot calibrate Joint ");
+        Serial.print(jointIndex + 1);
+        Serial.println(" while it is moving.");
+      }
+      else if (jointIndex >= 0 && jointIndex < NUM_AXES)
+      {
+        // Call the calibration function
+        startCalibrateJoint(jointIndex);
+        Serial.print("Calibration started for Joint ");
+        Serial.println(jointIndex + 1);
+      }
+      else
+      {
+        Serial.print("Invalid joint index: ");
+        Serial.print(jointIndex + 1);
+        Serial.print(". Use a number between 1 and ");
+        Serial.print(NUM_AXES);
+        Serial.println(".");
+      }
     }
+  }
+}
+
+/**
+ * @brief Executes a binary command frame and replies to it.
+ *
+ * Payloads (little-endian, angles/durations/ratios in Q16.16; a duration of 0 asks for
+ * the fastest move the joints allow, whatever accel_decel_percent says):
+ *   STOP_JOINT        u8 joint number
+ *   MOVE_JOINTS       6 x angle, duration_sec, accel_decel_percent, optional s_curve_percent
+ *   CALIBRATE_JOINTS  u8 bitmask of joints, bit 0 = joint 1
+ *   ADD               2 x int32
+ *   MOVE_JOINT(_BY)   u8 joint number, angle, duration_sec, accel_decel_percent
+ *   SUBSCRIBE_TELEMETRY  u16 frames per second, 0 to stop
+ *   PRINT_PROFILE     nothing for the counters, u8 section for its cycles, 0xFF to reset
+ *   MOVE_POSE         x, y, z (mm), roll, pitch, yaw, duration_sec, accel_decel_percent,
+ *                     optional s_curve_percent
+ *   FEED_HOLD         u8 1 to slow the queued moves down to a stop, 0 to resume them
+ *   FEED_OVERRIDE     u8 percent of their speed the queued moves run at, 10 to 200
+ *
+ * The reply starts with the status. PRINT_POS adds 6 x int32 positions in steps,
+ * PRINT_CALIBRATION_STATUS 6 x u8 (0 - not calibrated, 1 - in progress, 2 - calibrated)
+ * and ADD the int32 sum. CALIBRATE_JOINTS is refused with BUSY if a queued move still
+ * drives one of the joints. Moves are answered as soon as they are queued, with the u16 move
+ * ID and the number of free queue slots; their start and end follow as `FRAME_EVENT_MOVE`
+ * frames. A rejected move is answered with a second byte holding the offending joint number;
+ * a pose the arm cannot reach is refused with UNREACHABLE alone.
+ * SUBSCRIBE_TELEMETRY is answered with the u16 rate the frames will come at, FEED_OVERRIDE
+ * with the u8 percent in effect. PRINT_PROFILE
+ * adds u32 step ISR overruns, missed step deadlines and serial RX overflows and the u16
+ * free SRAM low water, or u32 min, average and max cycles and u32 passes of a section.
+ * It is refused with UNKNOWN_COMMAND when the profiler is not built in.
+ */
+void handleFrame(const Frame &frame)
+{
+  const uint8_t *payload = frame.payload;
+  uint8_t reply[FRAME_MAX_PAYLOAD];
+  uint8_t replyLength = 1;
+  CommandStatus status = STATUS_OK;
 
-    // Command handling
-    switch (cmd)
+  switch (frame.cmd)
+  {
+  case CMD_ECHO:
+    replyLength = min(frame.length + 1, (int)FRAME_MAX_PAYLOAD);
+    memcpy(&reply[1], payload, replyLength - 1);
+    break;
+
+  case CMD_S:
+    stopAllMotors();
+    break;
+
+  case CMD_STOP_JOINT:
+    if (frame.length != 1 || payload[0] < 1 || payload[0] > NUM_AXES)
+      status = STATUS_INVALID_ARGUMENT;
+    else
+      stopJoint(payload[0] - 1);
+    break;
+
+  case CMD_MOVE_JOINTS:
+  {
+    if (frame.length != 4 * (NUM_AXES + 2) && frame.length != 4 * (NUM_AXES + 3))
     {
-    case CMD_ECHO:
-      Serial.println(args);
+      status = STATUS_INVALID_ARGUMENT;
       break;
-
-    case CMD_S:
-      handle_S();
+    }
+    float degrees[NUM_AXES];
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      degrees[i] = q16ToFloat(readInt32(&payload[4 * i]));
+    }
+    float moveDurationSec = q16ToFloat(readInt32(&payload[4 * NUM_AXES]));
+    float accelDecelPercent = q16ToFloat(readInt32(&payload[4 * NUM_AXES + 4]));
+    float sCurvePercent = frame.length > 4 * (NUM_AXES + 2) ? q16ToFloat(readInt32(&payload[4 * NUM_AXES + 8])) : 0;
+    int failedJoint = 0;
+    uint16_t moveId = 0;
+    status = executeMoveJoints(degrees, moveDurationSec, accelDecelPercent, sCurvePercent, MOVE_REPLY_FRAME, frame.seq, CMD_MOVE_JOINTS, failedJoint, moveId);
+    if (status == STATUS_OK)
+    {
+      writeUint16(&reply[1], moveId);
+      reply[3] = planner.freeSlots();
+      replyLength = 4;
       break;
+    }
+    reply[1] = failedJoint + 1;
+    replyLength = 2;
+    break;
+  }
 
-    case CMD_STOP_JOINT:
-      handle_STOP_JOINT(args);
+  case CMD_MOVE_POSE:
+  {
+    if (frame.length != 4 * 8 && frame.length != 4 * 9)
+    {
+      status = STATUS_INVALID_ARGUMENT;
       break;
-
-    case CMD_MOVE_JOINTS:
-      handle_MOVE_JOINTS(args);
+    }
+    float values[6];
+    for (int i = 0; i < 6; i++)
+    {
+      values[i] = q16ToFloat(readInt32(&payload[4 * i]));
+    }
+    Pose pose = {values[0], values[1], values[2], values[3], values[4], values[5]};
+    float moveDurationSec = q16ToFloat(readInt32(&payload[24]));
+    float accelDecelPercent = q16ToFloat(readInt32(&payload[28]));
+    float sCurvePercent = frame.length > 4 * 8 ? q16ToFloat(readInt32(&payload[32])) : 0;
+    int failedJoint = 0;
+    uint16_t moveId = 0;
+    status = executeMovePose(pose, moveDurationSec, accelDecelPercent, sCurvePercent, MOVE_REPLY_FRAME, frame.seq, failedJoint, moveId);
+    if (status == STATUS_OK)
+    {
+      writeUint16(&reply[1], moveId);
+      reply[3] = planner.freeSlots();
+      replyLength = 4;
       break;
+    }
+    if (status != STATUS_UNREACHABLE)
+    {
+      reply[1] = failedJoint + 1;
+      replyLength = 2;
+    }
+    break;
+  }
 
-    case CMD_MOVE_JOINT:
-      handle_MOVE_JOINT(args);
+  case CMD_MOVE_JOINT:
+  case CMD_MOVE_JOINT_BY:
+  {
+    if (frame.length != 13)
+    {
+      status = STATUS_INVALID_ARGUMENT;
       break;
-
-    case CMD_MOVE_JOINT_BY:
-      handle_MOVE_JOINT_BY(args);
+    }
+    int jointIndex = payload[0] - 1;
+    float degree = q16ToFloat(readInt32(&payload[1]));
+    float moveDurationSec = q16ToFloat(readInt32(&payload[5]));
+    float accelDecelPercent = q16ToFloat(readInt32(&payload[9]));
+    uint16_t moveId = 0;
+    status = executeMoveJoint(jointIndex, degree, frame.cmd == CMD_MOVE_JOINT_BY, moveDurationSec, accelDecelPercent, MOVE_REPLY_FRAME, frame.seq, moveId);
+    if (status == STATUS_OK)
+    {
+      writeUint16(&reply[1], moveId);
+      reply[3] = planner.freeSlots();
+      replyLength = 4;
       break;
+    }
+    reply[1] = jointIndex + 1;
+    replyLength = 2;
+    break;
+  }
 
-    case CMD_CALIBRATE_JOINTS:
-      handle_CALIBRATE_JOINTS(args);
+  case CMD_CALIBRATE_JOINTS:
+    if (frame.length != 1)
+    {
+      status = STATUS_INVALID_ARGUMENT;
       break;
-
-    case CMD_PRINT_POS:
-      printCurrentPosition();
+    }
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      if ((payload[0] & (1 << i)) && planner.movesAxis(i))
+        status = STATUS_BUSY;
+    }
+    if (status != STATUS_OK)
       break;
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      if (payload[0] & (1 << i))
+        startCalibrateJoint(i);
+    }
+    break;
 
-    case CMD_PRINT_CALIBRATION_STATUS:
-      printCalibrationStatus();
+  case CMD_FEED_HOLD:
+    if (frame.length != 1)
+      status = STATUS_INVALID_ARGUMENT;
+    else if (payload[0] != 0)
+      stepEngine.hold();
+    else
+      stepEngine.resume();
+    break;
+
+  case CMD_FEED_OVERRIDE:
+    if (frame.length != 1 || payload[0] < FEED_OVERRIDE_MIN || payload[0] > FEED_OVERRIDE_MAX)
+    {
+      status = STATUS_INVALID_ARGUMENT;
       break;
+    }
+    planner.setFeedOverride(payload[0]);
+    reply[1] = planner.feedOverride();
+    replyLength = 2;
+    break;
 
-    case CMD_ADD:
+  case CMD_PRINT_POS:
+    for (int i = 0; i < NUM_AXES; i++)
     {
-      int commaIndex = args.indexOf(',');
-      if (commaIndex != -1)
-      {
-        String num1 = args.substring(0, commaIndex);
-        String num2 = args.substring(commaIndex + 1);
-        int sum = num1.toInt() + num2.toInt();
-        Serial.println("Sum: " + String(sum));
-      }
-      else
-      {
-        Serial.println("Invalid ADD format. Use: 07 <num1>,<num2>");
-      }
+      writeInt32(&reply[1 + 4 * i], stepEngine.position(i));
+    }
+    replyLength = 1 + 4 * NUM_AXES;
+    break;
+
+  case CMD_PRINT_CALIBRATION_STATUS:
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      reply[1 + i] = calibrationStatus(i);
+    }
+    replyLength = 1 + NUM_AXES;
+    break;
+
+  case CMD_SUBSCRIBE_TELEMETRY:
+    if (frame.length != 2)
+    {
+      status = STATUS_INVALID_ARGUMENT;
       break;
     }
+    writeUint16(&reply[1], telemetry.subscribe(payload[0] | (payload[1] << 8)));
+    replyLength = 3;
+    break;
+
+#ifdef PROFILER
+  case CMD_PRINT_PROFILE:
+    if (frame.length == 0)
+    {
+      ProfileCounters counters = profiler.snapshotCounters();
+      writeInt32(&reply[1], counters.isrOverruns);
+      writeInt32(&reply[5], counters.missedDeadlines);
+      writeInt32(&reply[9], counters.rxOverflows);
+      writeUint16(&reply[13], profiler.freeSramLowWater());
+      replyLength = 15;
+    }
+    else if (frame.length == 1 && payload[0] == 0xFF)
+    {
+      profiler.reset();
+    }
+    else if (frame.length == 1 && payload[0] < PROFILE_SECTION_COUNT)
+    {
+      SectionStats stats = profiler.sectionStats((ProfileSection)payload[0]);
+      bool empty = stats.count == 0;
+      writeInt32(&reply[1], empty ? 0 : stats.minCycles);
+      writeInt32(&reply[5], empty ? 0 : stats.totalCycles / stats.count);
+      writeInt32(&reply[9], stats.maxCycles);
+      writeInt32(&reply[13], stats.count);
+      replyLength = 17;
+    }
+    else
+    {
+      status = STATUS_INVALID_ARGUMENT;
+    }
+    break;
+#endif
 
-    default:
-      Serial.println("Unknown command: " + cmdHex);
+  case CMD_ADD:
+    if (frame.length != 8)
+    {
+      status = STATUS_INVALID_ARGUMENT;
       break;
     }
+    writeInt32(&reply[1], readInt32(&payload[0]) + readInt32(&payload[4]));
+    replyLength = 5;
+    break;
+
+  default:
+    status = STATUS_UNKNOWN_COMMAND;
+    break;
+  }
+
+  reply[0] = status;
+  sendFrame(frame.cmd | FRAME_REPLY_FLAG, frame.seq, reply, replyLength);
+}
+
+/**
+ * @brief Feeds the bytes of a binary frame to the decoder without waiting for the rest of it.
+ * @return true if a frame is being received, so the input must not be read as text.
+ */
+bool processSerialFrames()
+{
+  unsigned long now = millis();
+  frameDecoder.expire(now);
+  while (Serial.available() && (frameDecoder.isReceiving() || Serial.peek() == FRAME_SYNC))
+  {
+    FrameDecoder::Result result = frameDecoder.feed(Serial.read(), now);
+    if (result == FrameDecoder::FRAME_READY)
+    {
+      handleFrame(frameDecoder.frame());
+      return true;
+    }
+    if (result == FrameDecoder::FRAME_INVALID)
+    {
+      sendStatusFrame(FRAME_ERROR, frameDecoder.frame().seq, STATUS_BAD_FRAME);
+    }
   }
+  return frameDecoder.isReceiving();
 }
 
+LineReader commandLine;
+
+/**
+ * @brief Executes one text command, `<hex code> <arguments>`, parsing it in place.
+ */
+void executeCommandLine(char *line)
+{
+  if (strlen(line) < 2)
+    return; // At least two hex digits
+
+  // Extract hex command (first 2 characters)
+  char cmdHex[3] = {line[0], line[1], '\0'};
+  int cmd = strtol(cmdHex, nullptr, 16);
+
+  // Extract arguments (if any)
+  char *args = &line[2];
+  if (*args == ' ')
+  {
+    args++; // Skip space after command
+  }
+  else
+  {
+    args += strlen(args);
+  }
+
+  // Command handling
+  switch (cmd)
+  {
+  case CMD_ECHO:
+    if (strcmp(args, "BIN?") == 0)
+    {
+      // Handshake: the host asks whether binary frames are understood
+      binaryFramesEnabled = true;
+      Serial.print("BIN ");
+      Serial.println(PROTOCOL_VERSION);
+    }
+    else
+    {
+      Serial.println(args);
+    }
+    break;
+
+  case CMD_S:
+    handle_S();
+    break;
+
+  case CMD_STOP_JOINT:
+    handle_STOP_JOINT(args);
+    break;
+
+  case CMD_MOVE_JOINTS:
+    handle_MOVE_JOINTS(args);
+    break;
+
+  case CMD_MOVE_JOINT:
+    handle_MOVE_JOINT(args);
+    break;
+
+  case CMD_MOVE_JOINT_BY:
+    handle_MOVE_JOINT_BY(args);
+    break;
+
+  case CMD_CALIBRATE_JOINTS:
+    handle_CALIBRATE_JOINTS(args);
+    break;
+
+  case CMD_PRINT_POS:
+    printCurrentPosition();
+    break;
+
+  case CMD_PRINT_CALIBRATION_STATUS:
+    printCalibrationStatus();
+    break;
+
+  case CMD_SUBSCRIBE_TELEMETRY:
+    handle_SUBSCRIBE_TELEMETRY(args);
+    break;
+
+  case CMD_PRINT_PROFILE:
+    handle_PRINT_PROFILE(args);
+    break;
+
+  case CMD_MOVE_POSE:
+    handle_MOVE_POSE(args);
+    break;
+
+  case CMD_FEED_HOLD:
+    handle_FEED_HOLD(args);
+    break;
+
+  case CMD_FEED_OVERRIDE:
+    handle_FEED_OVERRIDE(args);
+    break;
+
+  case CMD_ADD:
+  {
+    char *comma = strchr(args, ',');
+    if (comma != nullptr)
+    {
+      *comma = '\0';
+      int sum = atoi(args) + atoi(comma + 1);
+      Serial.print("Sum: ");
+      Serial.println(sum);
+    }
+    else
+    {
+      Serial.println("Invalid ADD format. Use: 07 <num1>,<num2>");
+    }
+    break;
+  }
+
+  default:
+    Serial.print("Unknown command: ");
+    Serial.println(cmdHex);
+    break;
+  }
+}
+
+/**
+ * @brief Reads the bytes that have arrived and executes the text command they complete, if any.
+ *
+ * Never waits for the rest of a line: a partial command stays in `commandLine` until the
+ * next call. At most one command is executed per call, so the loop keeps its pace.
+ */
+void processSerialCommands()
+{
+  PROFILE_SCOPE(PROFILE_SERIAL);
+  PROFILE_SERIAL_RX();
+  if (binaryFramesEnabled && processSerialFrames())
+    return;
+
+  while (Serial.available())
+  {
+    if (binaryFramesEnabled && Serial.peek() == FRAME_SYNC)
+      return; // A frame starts: leave it to `processSerialFrames()`
+
+    LineReader::Result result = commandLine.feed(Serial.read());
+    if (result == LineReader::LINE_OVERFLOW)
+    {
+      Serial.print("Command too long. The limit is ");
+      Serial.print(LINE_BUFFER_SIZE);
+      Serial.println(" characters.");
+    }
+    else if (result == LineReader::LINE_READY)
+    {
+      executeCommandLine(commandLine.line());
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Reports the E-Stop being pressed or released, as text and, to a binary host, as a
+ * `FRAME_EVENT_ESTOP` frame.
+ * @param positions Positions of the joints in steps, latched when the step engine halted.
+ */
+void reportEstop(bool pressed, const long positions[NUM_AXES])
+{
+  Serial.print(pressed ? "E-Stop activated" : "E-Stop released");
+  Serial.print(" at");
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    Serial.print(' ');
+    Serial.print(positions[i]);
+  }
+  Serial.println();
+
+  if (!binaryFramesEnabled)
+    return;
+  uint8_t payload[1 + 4 * NUM_AXES];
+  payload[0] = pressed;
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    writeInt32(&payload[1 + 4 * i], positions[i]);
+  }
+  sendFrame(FRAME_EVENT_ESTOP, 0, payload, sizeof(payload));
+}
+
+/**
+ * @brief Follows up an emergency stop once the main loop gets to it.
+ *
+ * The step engine has already halted, from the E-Stop interrupt or its own ISR. Here the
+ * queued moves are flushed and reported as aborted, homing is called off and the stop is
+ * reported. Moves sent while the E-Stop is held are flushed as they come. Once it is
+ * released, the engine takes moves again.
+ */
 void handleEstop()
 {
-  if (ESTOP_ACTIVE)
+  long positions[NUM_AXES];
+  if (stepEngine.takeEmergencyStop(positions))
+  {
+    abortMotion();
+    reportEstop(true, positions);
+  }
+  if (!stepEngine.isHalted())
+    return;
+
+  abortMotion();
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    calibrationInProgress[i] = false;
+    calibrationPhase[i] = CALIB_FAILED;
+  }
+  if (!isEstopPressed())
   {
-    // If E-Stop is active, stop all motors and ignore commands
+    stepEngine.release();
     for (int i = 0; i < NUM_AXES; i++)
     {
-      stopMotor(i);                       // Stop all motors immediately
-      calibrationInProgress[i] = false;   // Reset calibration state for all joints
-      calibrationPhase[i] = CALIB_FAILED; // Set all joints to failed calibration state
+      positions[i] = currentPosition[i];
     }
+    reportEstop(false, positions);
+  }
+}
+
+/**
+ * @brief Sends a telemetry frame if one is due. See telemetry.h for the layout.
+ */
+void reportTelemetry()
+{
+  PROFILE_SCOPE(PROFILE_TELEMETRY);
+  unsigned long now = micros();
+  telemetry.recordLoop(now);
+  if (!telemetry.isDue(now))
+    return;
+
+  uint8_t *payload = telemetry.payload();
+  uint8_t flags = 0;
+  if (ESTOP_ACTIVE)
+    flags |= TELEMETRY_FLAG_ESTOP;
+  if (stepEngine.isBusy())
+    flags |= TELEMETRY_FLAG_MOVING;
+  if (stepEngine.feedState() != FEED_RUNNING)
+    flags |= TELEMETRY_FLAG_HOLD;
+  payload[TELEMETRY_FLAGS] = flags;
+  payload[TELEMETRY_QUEUE] = BLOCK_BUFFER_SIZE - 1 - planner.freeSlots();
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    writeInt32(&payload[TELEMETRY_POSITIONS + 4 * i], stepEngine.position(i));
+    long rate = constrain(stepEngine.stepRate(i), -32767L, 32767L);
+    writeUint16(&payload[TELEMETRY_RATES + 2 * i], (int16_t)rate);
+    payload[TELEMETRY_CALIBRATION + i] = calibrationPhase[i] | (calibrationStatus(i) << 4);
   }
+  telemetry.send();
 }
 
 void runAllJointCalibrations()
 {
+  PROFILE_SCOPE(PROFILE_CALIBRATION);
   for (int i = 0; i < NUM_AXES; i++)
   {
     runJointCalibration(i);
@@ -870,6 +1587,9 @@ void runAllJointCalibrations()
 // =================================================================
 void setup()
 {
+#ifdef PROFILER
+  profiler.begin();
+#endif
   Serial.begin(115200); // Initialize serial communication at 115200 baud rate
   for (int i = 0; i < NUM_AXES; i++)
   {
@@ -877,13 +1597,13 @@ void setup()
     pinMode(dirPins[i], OUTPUT);
     digitalWrite(stepPins[i], LOW);
   }
+  stepEngine.begin();
 
   // limit switch pins
   setupLimitSwitches();
   pinMode(ESTOP_PIN, INPUT_PULLUP); // Set E-Stop pin as input with pull-up resistor
   attachInterrupt(digitalPinToInterrupt(ESTOP_PIN), onEstopChanged, CHANGE);
-  // ESTOP_ACTIVE = digitalRead(ESTOP_PIN) == HIGH; // Initialize E-Stop state
-  // Serial.println("E-Stop state initialized: " + String(ESTOP_ACTIVE ? "ACTIVE" : "INACTIVE"));
+  onEstopChanged(); // Pressed at power-up: no edge to catch
 }
 
 // =================================================================
@@ -891,8 +1611,11 @@ void setup()
 // =================================================================
 void loop()
 {
-  updateLimitSwitches();
+  PROFILE_SCOPE(PROFILE_LOOP);
   handleEstop();
   processSerialCommands();
+  reportMoveProgress();
   runAllJointCalibrations();
+  if (telemetry.rate() != 0)
+    reportTelemetry();
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+
+// =================================================================
+//   SKETCH
+// =================================================================
+//
+// What main.cpp shares beyond the sketch: the state of the joints and the function that
+// queues a coordinated move. The host benches in bench/ drive the firmware through these.
+
+// Whether each joint has been homed.
+extern bool isCalibrationDone[NUM_AXES];
+
+// Planned position of each joint: where the last queued move ends.
+// The live position, counted while the joints move, is `stepEngine.position()`.
+extern int currentPosition[NUM_AXES];
+
+// How the progress of a queued move is reported.
+enum MoveReply
+{
+  MOVE_REPLY_NONE,
+  MOVE_REPLY_JOINTS,
+  MOVE_REPLY_JOINT,
+  MOVE_REPLY_JOINT_BY,
+  MOVE_REPLY_POSE,
+  MOVE_REPLY_FRAME // Binary command: event frames, the argument is the sequence number
+};
+
+/**
+ * @brief Plans a coordinated line with acceleration and deceleration and queues it. See main.cpp.
+ * @return The ID of the move, or 0 if the queue is full and the move was dropped.
+ */
+uint16_t moveMotorsBresenham(int target[NUM_AXES], float moveDurationSec, float accelDecelPercent, float sCurvePercent, MoveReply reply, uint8_t replyArg, uint8_t replyCmd);
+
+/**
+ * @brief Whether a queued move is still running or waiting to.
+ */
+bool isMoveInProgress();
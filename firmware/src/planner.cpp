@@ -0,0 +1,474 @@
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "planner.h"
+#include "profiler.h"
+#include "stepengine.h"
+
+// Stand-in for "no ramp at all" when a move is requested with a zero acceleration percentage.
+const float UNLIMITED_ACCELERATION = 1e9;
+// Bisection steps when solving for the speeds of S-curve ramps, each halving the interval.
+const uint8_t RAMP_SEARCH_ITERATIONS = 12;
+// Largest S-curve acceleration the step engine can hold in Q24.8, in Q0.32 rate per tick.
+const float MAX_S_CURVE_RATE_CHANGE = 4.0e6;
+
+Planner planner;
+
+PlannerBlock *Planner::nextFreeBlock()
+{
+  if (isFull())
+    return nullptr;
+  return &blocks[head];
+}
+
+/**
+ * @brief Converts a speed along the path of a block into the rate of its master axis.
+ */
+static uint32_t speedToRate(const PlannerBlock &block, float speed)
+{
+  float delayMicroSec = (block.length * 1000000.0) / (speed * block.masterSteps);
+  delayMicroSec = constrain(delayMicroSec, MIN_SPEED_DELAY, MAX_SPEED_DELAY);
+  return RATE_ONE * STEP_TICK_MICROSECONDS / delayMicroSec;
+}
+
+/**
+ * @brief Highest speed at which `block` can follow the most recently queued block.
+ *
+ * At the junction, each joint's speed jumps from `speed * previousUnitVector[i]` to
+ * `speed * unitVector[i]`; the jump must stay below the joint's `JOINT_JUNCTION_JERK`.
+ * The cruise speeds of the two blocks, which follow the feed override, are left to
+ * `recalculate()`: here only their top speeds cap the junction.
+ */
+float Planner::junctionSpeed(const PlannerBlock &block, const float unitVector[NUM_AXES]) const
+{
+  float speed = min(block.maxSpeed, previousMaxSpeed);
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    float change = fabs(unitVector[i] - previousUnitVector[i]);
+    if (change * speed > JOINT_JUNCTION_JERK[i])
+      speed = JOINT_JUNCTION_JERK[i] / change;
+  }
+  return speed;
+}
+
+/**
+ * @brief Cruise speed of `block` under the feed override, never above its top speed.
+ */
+float Planner::cruiseSpeed(const PlannerBlock &block) const
+{
+  return min(block.nominalSpeed * overrideFactor, block.maxSpeed);
+}
+
+/**
+ * @brief Seconds `block` takes to change its speed by `speedChange`.
+ *
+ * At constant acceleration that is the change over the acceleration. With a jerk, the
+ * acceleration first builds up and eases off again, which costs `acceleration / jerk`
+ * more; a change too small to reach the peak acceleration is all build-up and ease-off.
+ */
+float Planner::rampTime(const PlannerBlock &block, float speedChange)
+{
+  if (block.jerk == 0)
+    return speedChange / block.acceleration;
+  float peakTime = block.acceleration / block.jerk;
+  if (speedChange >= block.acceleration * peakTime)
+    return speedChange / block.acceleration + peakTime;
+  return 2 * sqrt(speedChange / block.jerk);
+}
+
+/**
+ * @brief Degrees `block` travels while ramping from one speed to the other.
+ *
+ * Both ramps are symmetric in time, so they run at the mean of the two speeds on average.
+ */
+float Planner::rampLength(const PlannerBlock &block, float fromSpeed, float toSpeed)
+{
+  return (fromSpeed + toSpeed) / 2 * rampTime(block, fabs(toSpeed - fromSpeed));
+}
+
+/**
+ * @brief Highest speed `block` can ramp to from `speed` over its whole length, or down from.
+ */
+float Planner::reachableSpeed(const PlannerBlock &block, float speed)
+{
+  float reachable = sqrt(speed * speed + 2 * block.acceleration * block.length);
+  if (block.jerk == 0)
+    return reachable;
+  // An S-curve gets less far than its peak acceleration would: bisect below that bound.
+  float low = speed;
+  for (uint8_t i = 0; i < RAMP_SEARCH_ITERATIONS; i++)
+  {
+    float middle = (low + reachable) / 2;
+    if (rampLength(block, speed, middle) > block.length)
+      reachable = middle;
+    else
+      low = middle;
+  }
+  return low;
+}
+
+/**
+ * @brief Builds the trapezoid of a block running from `entrySpeed` to `exitSpeed`.
+ *
+ * Speeds below the block's start speed are raised to it, so a block that starts and ends
+ * at rest gets exactly the ramp the move was requested with; a feed override below 100%
+ * scales the start speed along with the cruise speed. When there is not enough
+ * room to reach the cruise speed, the profile becomes a triangle, or for an S-curve the
+ * highest peak whose two ramps still fit.
+ */
+BlockProfile Planner::computeProfile(const PlannerBlock &block, float entrySpeed, float exitSpeed) const
+{
+  BlockProfile profile = {};
+  if (block.masterSteps == 0)
+    return profile;
+
+  float startSpeed = block.startSpeed * min(overrideFactor, (float)1);
+  float entry = max(entrySpeed, startSpeed);
+  float exit = max(exitSpeed, startSpeed);
+  float cruise = cruiseSpeed(block);
+  float twoAccel = 2 * block.acceleration;
+
+  float accelLength = rampLength(block, entry, cruise);
+  float decelLength = rampLength(block, cruise, exit);
+  if (accelLength + decelLength > block.length && block.jerk == 0)
+  {
+    // Triangle: accelerate until the deceleration has to begin.
+    accelLength = (twoAccel * block.length + exit * exit - entry * entry) / (2 * twoAccel);
+    accelLength = constrain(accelLength, 0, block.length);
+    decelLength = block.length - accelLength;
+    cruise = sqrt(entry * entry + twoAccel * accelLength);
+    cruise = max(cruise, max(entry, exit));
+  }
+  else if (accelLength + decelLength > block.length)
+  {
+    float low = max(entry, exit);
+    for (uint8_t i = 0; i < RAMP_SEARCH_ITERATIONS; i++)
+    {
+      float middle = (low + cruise) / 2;
+      if (rampLength(block, entry, middle) + rampLength(block, middle, exit) > block.length)
+        cruise = middle;
+      else
+        low = middle;
+    }
+    cruise = low;
+    accelLength = min(rampLength(block, entry, cruise), block.length);
+    decelLength = min(rampLength(block, cruise, exit), block.length - accelLength);
+  }
+
+  float stepsPerDegree = block.masterSteps / block.length;
+  int32_t accelSteps = accelLength * stepsPerDegree + 0.5;
+  profile.decelStartStep = block.masterSteps - (int32_t)(decelLength * stepsPerDegree + 0.5);
+  profile.decelStartStep = constrain(profile.decelStartStep, accelSteps, block.masterSteps);
+
+  profile.entryRate = speedToRate(block, entry);
+  profile.cruiseRate = speedToRate(block, cruise);
+  profile.exitRate = speedToRate(block, exit);
+  profile.stopRate = speedToRate(block, startSpeed);
+
+  // Master steps per second squared, then rate change per tick.
+  float masterAcceleration = block.acceleration * stepsPerDegree;
+  float rateChange = RATE_ONE * masterAcceleration / ((float)STEP_TICK_HZ * STEP_TICK_HZ);
+  profile.acceleration = constrain(rateChange, 1, 4.0e9);
+  if (block.jerk > 0)
+  {
+    // Master steps per second cubed, then change of the rate change per tick, in Q24.8.
+    float masterJerk = block.jerk * stepsPerDegree;
+    float jerkChange = 256.0 * RATE_ONE * masterJerk / ((float)STEP_TICK_HZ * STEP_TICK_HZ * STEP_TICK_HZ);
+    profile.acceleration = min(profile.acceleration, (uint32_t)MAX_S_CURVE_RATE_CHANGE);
+    profile.jerk = constrain(jerkChange, 1, 256.0 * profile.acceleration);
+  }
+  return profile;
+}
+void Planner::pushBlock(float startDelay, float cruiseDelay, int32_t accelSteps, float sCurvePercent)
+{
+  PROFILE_SCOPE(PROFILE_PLANNER);
+  PlannerBlock &block = blocks[head];
+  block.started = false;
+  block.done = false;
+  block.aborted = false;
+  block.startMicros = 0;
+  block.endMicros = 0;
+
+  // --- Length and direction of the move in joint space ---
+  float unitVector[NUM_AXES];
+  float sumOfSquares = 0;
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    unitVector[i] = block.direction[i] * block.delta[i] / STEPS_PER_DEGREE[i];
+    sumOfSquares += unitVector[i] * unitVector[i];
+  }
+  block.length = sqrt(sumOfSquares);
+
+  // Share of the master rate each axis steps at.
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    float scale = block.masterSteps > 0 ? 65536.0 * block.delta[i] / block.masterSteps : 0;
+    block.rateScale[i] = min(scale + 0.5, 65535.0);
+  }
+
+  // Speeds along the path that give the requested step delays on the master axis.
+  bool queueIsRunning = runIndex != head;
+  if (block.masterSteps > 0)
+  {
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      unitVector[i] /= block.length;
+    }
+    block.nominalSpeed = (block.length * 1000000.0) / (cruiseDelay * block.masterSteps);
+    block.startSpeed = (block.length * 1000000.0) / (startDelay * block.masterSteps);
+    block.acceleration = UNLIMITED_ACCELERATION;
+    block.jerk = 0;
+    if (accelSteps > 0 && block.nominalSpeed > block.startSpeed)
+    {
+      float accelLength = block.length * accelSteps / block.masterSteps;
+      block.acceleration = (block.nominalSpeed * block.nominalSpeed - block.startSpeed * block.startSpeed) / (2 * accelLength);
+      if (sCurvePercent > 0)
+      {
+        // Same ramp time, with `sCurvePercent` of it spent building up and easing off the
+        // acceleration: the peak has to make up for the slower start and end.
+        float rampSec = (block.nominalSpeed - block.startSpeed) / block.acceleration;
+        sCurvePercent = min(sCurvePercent, 1.0);
+        block.acceleration /= 1 - sCurvePercent / 2;
+        block.jerk = block.acceleration / (rampSec * sCurvePercent / 2);
+      }
+    }
+
+    // Top speed for a feed override above 100%: no joint past its maximum, the master
+    // axis no faster than `MIN_SPEED_DELAY`.
+    float topSpeed = (block.length * 1000000.0) / ((float)MIN_SPEED_DELAY * block.masterSteps);
+    for (int i = 0; i < NUM_AXES; i++)
+    {
+      if (unitVector[i] != 0)
+        topSpeed = min(topSpeed, JOINT_MAX_SPEEDS[i] / STEPS_PER_DEGREE[i] / fabs(unitVector[i]));
+    }
+    block.maxSpeed = max(topSpeed, block.nominalSpeed);
+    block.maxEntrySpeed = (queueIsRunning && previousMaxSpeed > 0) ? junctionSpeed(block, unitVector) : 0;
+  }
+  else
+  {
+    // Nothing to move: the block only marks a stop between its neighbours.
+    block.nominalSpeed = 0;
+    block.maxSpeed = 0;
+    block.startSpeed = 0;
+    block.acceleration = 0;
+    block.jerk = 0;
+    block.maxEntrySpeed = 0;
+  }
+
+  for (int i = 0; i < NUM_AXES; i++)
+  {
+    previousUnitVector[i] = unitVector[i];
+  }
+  previousMaxSpeed = block.maxSpeed;
+
+  // Queue the block as if it was the only one, then let the planner raise the junction speeds.
+  block.entrySpeed = 0;
+  block.exitSpeed = 0;
+  block.profile = computeProfile(block, 0, 0);
+  head = nextIndex(head);
+  recalculate(false);
+}
+
+void Planner::setFeedOverride(uint8_t percent)
+{
+  percent = constrain(percent, FEED_OVERRIDE_MIN, FEED_OVERRIDE_MAX);
+  if (percent == overridePercent)
+    return;
+  overridePercent = percent;
+  overrideFactor = percent / 100.0;
+  recalculate(true);
+}
+
+/**
+ * @brief Plans the rest of the block the step engine is executing for the current feed
+ * override, from the step and speed it has reached.
+ *
+ * The exit speed may come down with the cruise speed, never up, and only as far as the
+ * rest of the block can slow down: the next block's entry is planned from it.
+ * @param exitSpeed The exit speed of the block's current profile, set to that of the new one.
+ * @param profile Set to the new profile, its steps counted from the start of the block.
+ * @return false if the step engine is not executing `block`.
+ */
+bool Planner::replanExecutingBlock(const PlannerBlock &block, float &exitSpeed, BlockProfile &profile) const
+{
+  int32_t step;
+  uint32_t rate;
+  if (!stepEngine.blockProgress(&block, step, rate) || step >= block.masterSteps)
+    return false;
+
+  PlannerBlock rest = block;
+  rest.masterSteps = block.masterSteps - step;
+  rest.length = block.length * rest.masterSteps / block.masterSteps;
+  float speed = rate * (STEP_TICK_HZ / RATE_ONE) * block.length / block.masterSteps;
+  float exit = min(exitSpeed, cruiseSpeed(block));
+  float low = max(exit, block.startSpeed * min(overrideFactor, (float)1)); // What the profile exits at
+  if (speed > low && rampLength(rest, speed, low) > rest.length)
+  {
+    // Too close to the end to get down that far: bisect for the lowest exit it can reach.
+    float high = speed;
+    for (uint8_t i = 0; i < RAMP_SEARCH_ITERATIONS; i++)
+    {
+      float middle = (low + high) / 2;
+      if (rampLength(rest, speed, middle) > rest.length)
+        low = middle;
+      else
+        high = middle;
+    }
+    exit = high;
+  }
+
+  profile = computeProfile(rest, speed, exit);
+  profile.decelStartStep += step;
+  exitSpeed = exit;
+  return true;
+}
+
+/**
+ * @brief Recomputes the entry speeds and profiles of the blocks that have not started yet.
+ *
+ * The first block that has not started keeps its entry speed: it is the exit speed of the
+ * block being executed, or rest. The profiles are computed first and then handed over in
+ * one critical section, so the step engine never sees two neighbouring blocks that
+ * disagree on their junction speed. If the step engine starts a new block meanwhile, the
+ * plan is redone from there.
+ *
+ * With `replanExecuting`, the block being executed is replanned as well, from where the
+ * step engine stands. Its new profile is only handed over while the engine has not passed
+ * the new deceleration point yet; otherwise the block runs out on its old plan.
+ */
+void Planner::recalculate(bool replanExecuting)
+{
+  BlockProfile profiles[BLOCK_BUFFER_SIZE];
+  float exitSpeeds[BLOCK_BUFFER_SIZE];
+
+  while (true)
+  {
+    uint8_t first = runIndex;
+    if (first == head)
+      return;
+    uint8_t executing = first;
+    bool replanned = false;
+    float entrySpeed = 0;
+    if (blocks[first].started)
+    {
+      entrySpeed = blocks[first].exitSpeed;
+      if (replanExecuting)
+        replanned = replanExecutingBlock(blocks[executing], entrySpeed, profiles[executing]);
+      exitSpeeds[executing] = entrySpeed;
+      first = nextIndex(first);
+      if (first == head && !replanned)
+        return;
+    }
+
+    if (first != head)
+    {
+      // --- Reverse pass: every block must be able to slow down to the entry speed of the next ---
+      float nextEntrySpeed = 0; // The last block comes to rest
+      for (uint8_t index = prevIndex(head); index != first; index = prevIndex(index))
+      {
+        PlannerBlock &block = blocks[index];
+        float cruise = min(cruiseSpeed(block), cruiseSpeed(blocks[prevIndex(index)]));
+        block.entrySpeed = min(min(block.maxEntrySpeed, cruise), reachableSpeed(block, nextEntrySpeed));
+        nextEntrySpeed = block.entrySpeed;
+      }
+
+      // --- Forward pass: every block must be able to reach the entry speed of the next ---
+      blocks[first].entrySpeed = entrySpeed;
+      for (uint8_t index = first; index != head; index = nextIndex(index))
+      {
+        PlannerBlock &block = blocks[index];
+        uint8_t next = nextIndex(index);
+        float exitSpeed = 0;
+        if (next != head)
+        {
+          blocks[next].entrySpeed = min(blocks[next].entrySpeed, reachableSpeed(block, block.entrySpeed));
+          exitSpeed = blocks[next].entrySpeed;
+        }
+        profiles[index] = computeProfile(block, block.entrySpeed, exitSpeed);
+        exitSpeeds[index] = exitSpeed;
+      }
+    }
+
+    bool applied = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      int32_t step;
+      uint32_t rate;
+      if (replanned && !(stepEngine.blockProgress(&blocks[executing], step, rate) && step < profiles[executing].decelStartStep))
+      {
+        replanExecuting = false; // Too late for this block: plan the rest without it
+      }
+      else if (first == head || !blocks[first].started)
+      {
+        if (replanned)
+        {
+          blocks[executing].profile = profiles[executing];
+          blocks[executing].exitSpeed = exitSpeeds[executing];
+        }
+        for (uint8_t index = first; index != head; index = nextIndex(index))
+        {
+          blocks[index].profile = profiles[index];
+          blocks[index].exitSpeed = exitSpeeds[index];
+        }
+        applied = true;
+      }
+    }
+    if (applied)
+      return;
+  }
+}
+
+bool Planner::movesAxis(uint8_t axis) const
+{
+  for (uint8_t index = runIndex; index != head; index = nextIndex(index))
+  {
+    if (blocks[index].delta[axis] != 0)
+      return true;
+  }
+  return false;
+}
+
+PlannerBlock *Planner::startedBlock()
+{
+  while (startIndex != head && blocks[startIndex].done && !blocks[startIndex].started)
+    startIndex = nextIndex(startIndex);
+  if (startIndex == head || !blocks[startIndex].started)
+    return nullptr;
+  return &blocks[startIndex];
+}
+
+void Planner::discardStartedBlock()
+{
+  if (startedBlock() != nullptr)
+    startIndex = nextIndex(startIndex);
+}
+
+PlannerBlock *Planner::finishedBlock()
+{
+  if (tail == head || !blocks[tail].done)
+    return nullptr;
+  return &blocks[tail];
+}
+
+void Planner::discardFinishedBlock()
+{
+  if (finishedBlock() == nullptr)
+    return;
+  if (startIndex == tail)
+    startIndex = nextIndex(startIndex); // Its start was never asked for
+  tail = nextIndex(tail);
+}
+
+void Planner::flush()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    for (uint8_t index = runIndex; index != head; index = nextIndex(index))
+    {
+      if (blocks[index].started)
+        blocks[index].endMicros = micros(); // Interrupted half-way
+      blocks[index].aborted = true;
+      blocks[index].done = true;
+    }
+    runIndex = head;
+  }
+}
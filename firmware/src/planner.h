@@ -0,0 +1,182 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @struct BlockProfile
+ * @brief The speed profile of a block, expressed the way the step engine consumes it.
+ *
+ * Speeds are rates of the master axis, in master steps per interpolation tick as Q0.32
+ * fractions. The rate moves from `entryRate` towards `cruiseRate` by `acceleration` per
+ * tick, and from the master step `decelStartStep` on towards `exitRate`, so the step
+ * engine ramps with one addition per tick and needs no float.
+ *
+ * With a `jerk`, the ramps are S-curves instead: the change per tick itself grows by
+ * `jerk` per tick up to `acceleration`, and eases off again before the rate reaches its
+ * target, so the joints never see the acceleration jump.
+ *
+ * `stopRate` is the rate of the block's start speed, the one it may start from or stop
+ * at without a ramp; a feed hold slows down to it before stopping.
+ */
+struct BlockProfile
+{
+  int32_t decelStartStep;
+  uint32_t entryRate;
+  uint32_t cruiseRate;
+  uint32_t exitRate;
+  uint32_t stopRate;
+  uint32_t acceleration; // Change of the rate per tick, in Q0.32 master steps per tick
+  uint32_t jerk;         // Change of the acceleration per tick, in Q24.8 fractions of it; 0 for a trapezoid
+};
+
+/**
+ * @struct PlannerBlock
+ * @brief One queued coordinated move.
+ *
+ * Speeds are measured along the path in joint space, in degrees per second, so that two
+ * consecutive blocks can agree on the speed at which they meet whatever their master axis.
+ */
+struct PlannerBlock
+{
+  // --- Filled in by the caller of `nextFreeBlock()` ---
+  int32_t delta[NUM_AXES];    // Absolute number of steps for each axis
+  int8_t direction[NUM_AXES]; // +1, -1 or 0 for each axis
+  int32_t masterSteps;        // Step count of the axis that travels the furthest
+  float durationSec;          // Requested duration, for the report once the block is done
+  uint16_t moveId;            // Number the host knows the move by
+  uint8_t reply;              // Opaque tags the sketch uses to report the progress of the command
+  uint8_t replyArg;
+  uint8_t replyCmd;
+
+  // --- Read by the step engine ---
+  uint16_t rateScale[NUM_AXES]; // delta / masterSteps in Q0.16, set by `pushBlock()`
+  BlockProfile profile;         // Rewritten by the planner while `started` is false, and by a feed override
+  volatile bool started;      // Set by the step engine when it loads the block
+  volatile bool done;         // Set by the step engine after the last step, or by `flush()`
+  bool aborted;               // Set by `flush()` if the block did not run to the end
+  unsigned long startMicros;
+  unsigned long endMicros;
+
+  // --- Planner only ---
+  float length;        // Length of the move in joint space, in degrees
+  float nominalSpeed;  // Cruise speed requested for the move
+  float maxSpeed;      // Fastest the joints allow along the path, or the nominal speed if faster
+  float startSpeed;    // Speed the move may start or stop at without ramping
+  float acceleration;  // Peak acceleration, in degrees per second squared
+  float jerk;          // In degrees per second cubed, 0 for a trapezoid
+  float maxEntrySpeed; // Highest speed allowed at the junction with the previous block
+  float entrySpeed;    // Planned speed at the junction with the previous block
+  float exitSpeed;     // Exit speed of the profile the step engine has been given
+};
+
+/**
+ * @class Planner
+ * @brief Ring buffer of queued moves with a lookahead planner, in the spirit of GRBL's planner.
+ *
+ * Every time a block is added, the junction speeds of the blocks that have not started yet
+ * are recomputed: a reverse pass makes sure every block can still slow down in time for
+ * the ones after it, with the last block coming to rest, and a forward pass limits each
+ * junction to what the previous block can reach. Consecutive moves therefore run through
+ * their junctions without stopping, as long as the joints do not change speed by more
+ * than `JOINT_JUNCTION_JERK` there.
+ *
+ * A feed override scales every block's cruise speed, capped by the joints' maximum speeds.
+ * Changing it replans the queue, and the block being executed from where the step engine
+ * stands in it, so the moves under way speed up or slow down at their own acceleration.
+ *
+ * The sketch adds blocks at the head; the step engine executes them from `currentBlock()`;
+ * executed blocks stay in the buffer until the sketch has reported them.
+ */
+class Planner
+{
+public:
+  bool isEmpty() const { return tail == head; }
+  bool isFull() const { return nextIndex(head) == tail; }
+
+  /**
+   * @brief Slot the next block is built in, or nullptr if the buffer is full.
+   */
+  PlannerBlock *nextFreeBlock();
+
+  /**
+   * @brief Queues the block built in `nextFreeBlock()` and replans the junction speeds.
+   *
+   * @param startDelay Step delay (microseconds) the move may start and stop at without ramping.
+   * @param cruiseDelay Step delay (microseconds) of the cruise phase.
+   * @param accelSteps Master steps needed to ramp between the two delays.
+   * @param sCurvePercent Share of each ramp (0.0 to 1.0) spent building up and easing off
+   * the acceleration; 0 ramps at constant acceleration. The ramps keep their length and
+   * duration either way: an S-curve reaches a higher peak acceleration instead.
+   */
+  void pushBlock(float startDelay, float cruiseDelay, int32_t accelSteps, float sCurvePercent);
+
+  /**
+   * @brief Sets the feed override and replans the queued blocks, the one being executed included.
+   * @param percent Share of their nominal cruise speed the blocks run at, from
+   * `FEED_OVERRIDE_MIN` to `FEED_OVERRIDE_MAX`; out of range values are clamped.
+   */
+  void setFeedOverride(uint8_t percent);
+  uint8_t feedOverride() const { return overridePercent; }
+
+  /**
+   * @brief Whether a block that has not finished yet moves `axis`.
+   */
+  bool movesAxis(uint8_t axis) const;
+
+  /**
+   * @brief Number of blocks that can still be queued.
+   */
+  uint8_t freeSlots() const { return (tail - head - 1) & (BLOCK_BUFFER_SIZE - 1); }
+
+  /**
+   * @brief Oldest block the step engine has started whose start has not been reported yet, or nullptr.
+   *
+   * Blocks flushed before they started are skipped.
+   */
+  PlannerBlock *startedBlock();
+  void discardStartedBlock();
+
+  /**
+   * @brief Oldest block that has finished but has not been reported yet, or nullptr.
+   */
+  PlannerBlock *finishedBlock();
+  void discardFinishedBlock();
+
+  /**
+   * @brief Marks every block that has not finished as done. Call once the step engine has been halted.
+   */
+  void flush();
+
+  // Used by the step engine, with interrupts disabled.
+  PlannerBlock *currentBlock() { return runIndex == head ? nullptr : &blocks[runIndex]; }
+  void advanceCurrentBlock() { runIndex = nextIndex(runIndex); }
+
+private:
+  static uint8_t nextIndex(uint8_t index) { return (index + 1) & (BLOCK_BUFFER_SIZE - 1); }
+  static uint8_t prevIndex(uint8_t index) { return (index - 1) & (BLOCK_BUFFER_SIZE - 1); }
+
+  float junctionSpeed(const PlannerBlock &block, const float unitVector[NUM_AXES]) const;
+  float cruiseSpeed(const PlannerBlock &block) const;
+  static float rampTime(const PlannerBlock &block, float speedChange);
+  static float rampLength(const PlannerBlock &block, float fromSpeed, float toSpeed);
+  static float reachableSpeed(const PlannerBlock &block, float speed);
+  BlockProfile computeProfile(const PlannerBlock &block, float entrySpeed, float exitSpeed) const;
+  bool replanExecutingBlock(const PlannerBlock &block, float &exitSpeed, BlockProfile &profile) const;
+  void recalculate(bool replanExecuting);
+
+  PlannerBlock blocks[BLOCK_BUFFER_SIZE];
+  uint8_t tail = 0;              // Oldest block that has not been reported
+  uint8_t startIndex = 0;        // Oldest block whose start has not been reported
+  volatile uint8_t head = 0;     // Slot of the next block to be queued
+  volatile uint8_t runIndex = 0; // Block the step engine is executing, or will execute next
+
+  // Direction and top speed of the most recently queued block, for the next junction.
+  float previousUnitVector[NUM_AXES];
+  float previousMaxSpeed = 0;
+
+  uint8_t overridePercent = 100;
+  float overrideFactor = 1;
+};
+
+extern Planner planner;
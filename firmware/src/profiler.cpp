@@ -0,0 +1,146 @@
+#include "profiler.h"
+
+#ifdef PROFILER
+
+#include <util/atomic.h>
+
+// Fills the unused SRAM, so that the bytes still holding it have never been used.
+const uint8_t SRAM_PAINT = 0xC5;
+// Bytes below the stack pointer left alone when painting, for the calls still to come.
+const uint16_t SRAM_PAINT_MARGIN = 64;
+
+#ifndef SIMULATION_HAL
+extern char __heap_start; // Both from avr-libc's malloc
+extern char *__brkval;
+
+/**
+ * @brief First byte above the heap.
+ */
+static uint8_t *heapEnd()
+{
+  return (uint8_t *)(__brkval != nullptr ? __brkval : &__heap_start);
+}
+#endif
+
+Profiler profiler;
+
+ISR(TIMER5_OVF_vect)
+{
+  profiler.overflows++;
+}
+
+static const char *const SECTION_NAMES[PROFILE_SECTION_COUNT] = {
+    "loop", "serial", "planner", "move reports", "calibration", "telemetry", "step ISR", "reset ISR"};
+
+const char *profileSectionName(ProfileSection section)
+{
+  return SECTION_NAMES[section];
+}
+
+void Profiler::begin()
+{
+  reset();
+#ifndef SIMULATION_HAL
+  uint8_t top;
+  for (uint8_t *p = heapEnd(); p < &top - SRAM_PAINT_MARGIN; p++)
+  {
+    *p = SRAM_PAINT;
+  }
+#endif
+  noInterrupts();
+  TCCR5A = 0;
+  TCCR5B = (1 << CS50); // Normal mode, no prescaler
+  TCNT5 = 0;
+  overflows = 0;
+  TIFR5 = (1 << TOV5);
+  TIMSK5 = (1 << TOIE5);
+  interrupts();
+}
+
+uint32_t Profiler::cycles() const
+{
+  uint16_t high;
+  uint16_t low;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    low = TCNT5;
+    high = overflows;
+    if ((TIFR5 & (1 << TOV5)) && low < 0x8000)
+      high++; // Wrapped since the overflow ISR last ran
+  }
+  return ((uint32_t)high << 16) | low;
+}
+
+void Profiler::record(ProfileSection section, uint32_t startCycles)
+{
+  uint32_t elapsed = cycles() - startCycles;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    SectionStats &stats = sections[section];
+    if (elapsed < stats.minCycles)
+      stats.minCycles = elapsed;
+    if (elapsed > stats.maxCycles)
+      stats.maxCycles = elapsed;
+    stats.totalCycles += elapsed;
+    stats.count++;
+  }
+}
+
+SectionStats Profiler::sectionStats(ProfileSection section) const
+{
+  SectionStats stats;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    stats = sections[section];
+  }
+  return stats;
+}
+
+ProfileCounters Profiler::snapshotCounters() const
+{
+  ProfileCounters snapshot;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    snapshot = counters;
+  }
+  return snapshot;
+}
+
+void Profiler::checkSerialRx()
+{
+  bool full = Serial.available() >= SERIAL_RX_CAPACITY;
+  if (full && !rxFull)
+    counters.rxOverflows++;
+  rxFull = full;
+}
+
+uint16_t Profiler::freeSramLowWater() const
+{
+#ifdef SIMULATION_HAL
+  return 0; // The host has no SRAM to paint
+#else
+  uint8_t top;
+  uint8_t *p = heapEnd();
+  uint16_t untouched = 0;
+  while (p < &top && *p == SRAM_PAINT)
+  {
+    p++;
+    untouched++;
+  }
+  return untouched;
+#endif
+}
+
+void Profiler::reset()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    for (uint8_t i = 0; i < PROFILE_SECTION_COUNT; i++)
+    {
+      sections[i] = {UINT32_MAX, 0, 0, 0};
+    }
+    counters = {};
+  }
+}
+
+#endif
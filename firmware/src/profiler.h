@@ -0,0 +1,150 @@
+#pragma once
+
+#include <Arduino.h>
+
+// =================================================================
+//   PROFILER
+// =================================================================
+//
+// Built in with `-DPROFILER` (`pio run -e megaatmega2560_profile`); without it the
+// PROFILE_* macros compile to nothing and the `0B` command is refused. When built in,
+// Timer5 counts CPU cycles, free running with no prescaler, and extends itself to
+// 32 bits on overflow. Each section records the cycles between entering and leaving it;
+// sections that nest (loop() holds the others) are measured independently. Alongside:
+//   - step ISR overruns: the next interpolation tick fell due before the step ISR returned,
+//   - missed step deadlines: a tick's pulses went out more than `STEP_DEADLINE_TICKS`
+//     after the compare match,
+//   - serial RX overflows: the loop found HardwareSerial's RX buffer full, so bytes arriving
+//     meanwhile were dropped (the core does not count the dropped bytes themselves),
+//   - free SRAM low water: the SRAM between the heap and the stack is painted at start-up;
+//     the bytes no one has written to since are the smallest the gap has been.
+
+enum ProfileSection : uint8_t
+{
+  PROFILE_LOOP,
+  PROFILE_SERIAL,
+  PROFILE_PLANNER,
+  PROFILE_MOVE_REPORTS,
+  PROFILE_CALIBRATION,
+  PROFILE_TELEMETRY,
+  PROFILE_STEP_ISR,
+  PROFILE_RESET_ISR,
+  PROFILE_SECTION_COUNT
+};
+
+#ifdef PROFILER
+
+// HardwareSerial's 64-byte ring buffer keeps one slot free.
+const int SERIAL_RX_CAPACITY = 63;
+
+struct SectionStats
+{
+  uint32_t minCycles;
+  uint32_t maxCycles;
+  uint64_t totalCycles;
+  uint32_t count;
+};
+
+struct ProfileCounters
+{
+  uint32_t isrOverruns;
+  uint32_t missedDeadlines;
+  uint32_t rxOverflows;
+};
+
+/**
+ * @class Profiler
+ * @brief Cycle counts of the hot sections and counters of the deadlines they miss.
+ */
+class Profiler
+{
+public:
+  /**
+   * @brief Starts the cycle counter and paints the free SRAM. Call first thing in setup().
+   */
+  void begin();
+
+  /**
+   * @brief CPU cycles since `begin()`, wrapping every 268 seconds. Safe to call from an ISR.
+   */
+  uint32_t cycles() const;
+
+  /**
+   * @brief Adds one pass through `section` that started at `startCycles`.
+   */
+  void record(ProfileSection section, uint32_t startCycles);
+
+  /**
+   * @brief Copies the statistics of a section, consistently with the ISRs updating them.
+   */
+  SectionStats sectionStats(ProfileSection section) const;
+  ProfileCounters snapshotCounters() const;
+
+  /**
+   * @brief Counts an RX overflow if the serial RX buffer has just filled up.
+   */
+  void checkSerialRx();
+
+  /**
+   * @brief Bytes of SRAM between the heap and the stack that have never been used. Slow: call on request.
+   */
+  uint16_t freeSramLowWater() const;
+
+  /**
+   * @brief Clears the section statistics and the counters. The SRAM low water is kept.
+   */
+  void reset();
+
+  volatile uint16_t overflows = 0; // High word of the cycle counter
+  ProfileCounters counters = {};
+
+private:
+  SectionStats sections[PROFILE_SECTION_COUNT];
+  bool rxFull = false;
+};
+
+extern Profiler profiler;
+
+const char *profileSectionName(ProfileSection section);
+
+/**
+ * @brief Records the cycles from its construction to the end of the enclosing scope.
+ */
+class ProfileScope
+{
+public:
+  explicit ProfileScope(ProfileSection section) : section(section), start(profiler.cycles()) {}
+  ~ProfileScope() { profiler.record(section, start); }
+
+private:
+  ProfileSection section;
+  uint32_t start;
+};
+
+#define PROFILE_CONCAT_(A, B) A##B
+#define PROFILE_CONCAT(A, B) PROFILE_CONCAT_(A, B)
+#define PROFILE_SCOPE(SECTION) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(SECTION)
+#define PROFILE_COUNT_IF(COUNTER, CONDITION) \
+  do                                         \
+  {                                          \
+    if (CONDITION)                           \
+      profiler.counters.COUNTER++;           \
+  } while (0)
+#define PROFILE_SERIAL_RX() profiler.checkSerialRx()
+
+#else
+
+#define PROFILE_SCOPE(SECTION) \
+  do                           \
+  {                            \
+  } while (0)
+#define PROFILE_COUNT_IF(COUNTER, CONDITION) \
+  do                                         \
+  {                                          \
+  } while (0)
+#define PROFILE_SERIAL_RX() \
+  do                        \
+  {                         \
+  } while (0)
+
+#endif
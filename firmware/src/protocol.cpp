@@ -0,0 +1,139 @@
+#include <Arduino.h>
+#include "protocol.h"
+
+/**
+ * @brief CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF), one byte at a time.
+ */
+uint16_t crc16Update(uint16_t crc, uint8_t byte)
+{
+  crc ^= (uint16_t)byte << 8;
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    if (crc & 0x8000)
+      crc = (crc << 1) ^ 0x1021;
+    else
+      crc <<= 1;
+  }
+  return crc;
+}
+
+FrameDecoder::Result FrameDecoder::feed(uint8_t byte, unsigned long nowMs)
+{
+  lastByteMs = nowMs;
+  switch (state)
+  {
+  case WAIT_SYNC:
+    if (byte == FRAME_SYNC)
+    {
+      crc = 0xFFFF;
+      current.length = 0;
+      current.seq = 0;
+      current.cmd = 0;
+      state = WAIT_LENGTH;
+    }
+    break;
+
+  case WAIT_LENGTH:
+    current.length = byte;
+    crc = crc16Update(crc, byte);
+    state = WAIT_SEQ;
+    break;
+
+  case WAIT_SEQ:
+    current.seq = byte;
+    crc = crc16Update(crc, byte);
+    state = WAIT_CMD;
+    break;
+
+  case WAIT_CMD:
+    current.cmd = byte;
+    crc = crc16Update(crc, byte);
+    if (current.length > FRAME_MAX_PAYLOAD)
+    {
+      // Skip the rest of the frame, so that its bytes are not read as text.
+      skipLeft = current.length + 2;
+      state = SKIP_FRAME;
+      return FRAME_INVALID;
+    }
+    received = 0;
+    state = current.length > 0 ? WAIT_PAYLOAD : WAIT_CRC_LOW;
+    break;
+
+  case WAIT_PAYLOAD:
+    current.payload[received++] = byte;
+    crc = crc16Update(crc, byte);
+    if (received == current.length)
+      state = WAIT_CRC_LOW;
+    break;
+
+  case WAIT_CRC_LOW:
+    expectedCrc = byte;
+    state = WAIT_CRC_HIGH;
+    break;
+
+  case WAIT_CRC_HIGH:
+    expectedCrc |= (uint16_t)byte << 8;
+    state = WAIT_SYNC;
+    return expectedCrc == crc ? FRAME_READY : FRAME_INVALID;
+
+  case SKIP_FRAME:
+    if (--skipLeft == 0)
+      state = WAIT_SYNC;
+    break;
+  }
+  return FRAME_INCOMPLETE;
+}
+
+void FrameDecoder::expire(unsigned long nowMs)
+{
+  if (state != WAIT_SYNC && nowMs - lastByteMs > FRAME_BYTE_TIMEOUT_MS)
+    state = WAIT_SYNC;
+}
+
+void sendFrame(uint8_t cmd, uint8_t seq, const uint8_t *payload, uint8_t length)
+{
+  uint8_t header[4] = {FRAME_SYNC, length, seq, cmd};
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 1; i < sizeof(header); i++)
+  {
+    crc = crc16Update(crc, header[i]);
+  }
+  for (uint8_t i = 0; i < length; i++)
+  {
+    crc = crc16Update(crc, payload[i]);
+  }
+  Serial.write(header, sizeof(header));
+  Serial.write(payload, length);
+  Serial.write((uint8_t)(crc & 0xFF));
+  Serial.write((uint8_t)(crc >> 8));
+}
+
+void sendStatusFrame(uint8_t cmd, uint8_t seq, CommandStatus status)
+{
+  uint8_t payload[1] = {status};
+  sendFrame(cmd, seq, payload, sizeof(payload));
+}
+
+int32_t readInt32(const uint8_t *bytes)
+{
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+void writeUint16(uint8_t *bytes, uint16_t value)
+{
+  bytes[0] = value & 0xFF;
+  bytes[1] = value >> 8;
+}
+
+void writeInt32(uint8_t *bytes, int32_t value)
+{
+  bytes[0] = value & 0xFF;
+  bytes[1] = (value >> 8) & 0xFF;
+  bytes[2] = (value >> 16) & 0xFF;
+  bytes[3] = (value >> 24) & 0xFF;
+}
+
+float q16ToFloat(int32_t value)
+{
+  return value / 65536.0;
+}
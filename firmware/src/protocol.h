@@ -0,0 +1,133 @@
+#pragma once
+
+#include <Arduino.h>
+
+// =================================================================
+//   BINARY FRAMED PROTOCOL
+// =================================================================
+//
+// Once the host has sent the `00 BIN?` handshake, commands may also arrive as frames:
+//
+//   0xA5 | length | seq | cmd | payload (length bytes) | CRC-16 (low byte first)
+//
+// The CRC is CRC-16/CCITT-FALSE over length, seq, cmd and the payload. Multi-byte
+// fields are little-endian; angles, durations and ratios are Q16.16 fixed point.
+// Every frame is answered with a frame carrying `cmd | FRAME_REPLY_FLAG`, the same
+// sequence number and a `CommandStatus` as the first payload byte. Moves are answered as
+// soon as they are queued; their progress follows in `FRAME_EVENT_MOVE` frames carrying
+// the sequence number of the command. A host that subscribed to telemetry also receives
+// `FRAME_EVENT_TELEMETRY` frames at the rate it asked for, and any host a
+// `FRAME_EVENT_ESTOP` frame when the E-Stop is pressed or released. Text commands keep working
+// alongside: text never contains the sync byte, which is outside ASCII.
+
+const uint8_t FRAME_SYNC = 0xA5;
+const uint8_t FRAME_MAX_PAYLOAD = 48;
+const uint8_t FRAME_REPLY_FLAG = 0x80;
+const uint8_t FRAME_ERROR = 0xFF;              // Reply to a frame that could not be decoded
+const uint8_t FRAME_EVENT_MOVE = 0x40;         // Unsolicited: a queued move started or ended
+const uint8_t FRAME_EVENT_TELEMETRY = 0x41;    // Unsolicited: state of the arm, see telemetry.h
+const uint8_t FRAME_EVENT_ESTOP = 0x42;        // Unsolicited: the E-Stop was pressed or released
+const unsigned long FRAME_BYTE_TIMEOUT_MS = 50; // A frame stalled this long is dropped
+const uint8_t PROTOCOL_VERSION = 8;             // 2: moves are acknowledged when queued, 3: telemetry, 4: S-curves, 5: poses, 6: E-Stop events, 7: feed hold, 8: feed override
+
+enum CommandStatus : uint8_t
+{
+  STATUS_OK,
+  STATUS_INVALID_ARGUMENT,
+  STATUS_NOT_CALIBRATED,
+  STATUS_OUT_OF_RANGE,
+  STATUS_QUEUE_FULL,
+  STATUS_BUSY,
+  STATUS_ABORTED,
+  STATUS_UNKNOWN_COMMAND,
+  STATUS_BAD_FRAME,
+  STATUS_UNREACHABLE // A pose out of reach, or only reachable with a joint out of range
+};
+
+// Payload of a `FRAME_EVENT_ESTOP` frame: 1 if pressed, 0 if released, then the position of
+// each joint in steps as i32, latched when stepping halted. Its sequence number is 0.
+
+// Payload of a `FRAME_EVENT_MOVE` frame: event, u16 move ID, free queue slots.
+enum MoveEvent : uint8_t
+{
+  MOVE_EVENT_STARTED,
+  MOVE_EVENT_COMPLETE,
+  MOVE_EVENT_ABORTED
+};
+
+struct Frame
+{
+  uint8_t length;
+  uint8_t seq;
+  uint8_t cmd;
+  uint8_t payload[FRAME_MAX_PAYLOAD];
+};
+
+/**
+ * @class FrameDecoder
+ * @brief Reassembles frames one byte at a time, so the main loop never waits for a whole frame.
+ */
+class FrameDecoder
+{
+public:
+  enum Result
+  {
+    FRAME_INCOMPLETE,
+    FRAME_READY,
+    FRAME_INVALID // Bad CRC or oversized length; `frame().seq` is still valid if it was received.
+                  // The payload and CRC of an oversized frame are then skipped, still as part of it.
+  };
+
+  /**
+   * @brief Consumes one byte received at `nowMs`.
+   */
+  Result feed(uint8_t byte, unsigned long nowMs);
+
+  /**
+   * @brief Drops a partially received frame if no byte has arrived for `FRAME_BYTE_TIMEOUT_MS`.
+   */
+  void expire(unsigned long nowMs);
+
+  /// True while a frame has been started but not completed.
+  bool isReceiving() const { return state != WAIT_SYNC; }
+  const Frame &frame() const { return current; }
+
+private:
+  enum State
+  {
+    WAIT_SYNC,
+    WAIT_LENGTH,
+    WAIT_SEQ,
+    WAIT_CMD,
+    WAIT_PAYLOAD,
+    WAIT_CRC_LOW,
+    WAIT_CRC_HIGH,
+    SKIP_FRAME // Payload and CRC of an oversized frame
+  };
+
+  State state = WAIT_SYNC;
+  Frame current;
+  uint8_t received = 0;
+  uint16_t skipLeft = 0; // Bytes of an oversized frame still to skip
+  uint16_t crc = 0;
+  uint16_t expectedCrc = 0;
+  unsigned long lastByteMs = 0;
+};
+
+uint16_t crc16Update(uint16_t crc, uint8_t byte);
+
+/**
+ * @brief Writes a frame to the serial port.
+ */
+void sendFrame(uint8_t cmd, uint8_t seq, const uint8_t *payload, uint8_t length);
+
+/**
+ * @brief Replies to the frame `cmd`/`seq` with a status and no data.
+ */
+void sendStatusFrame(uint8_t cmd, uint8_t seq, CommandStatus status);
+
+// --- Little-endian payload fields ---
+int32_t readInt32(const uint8_t *bytes);
+void writeUint16(uint8_t *bytes, uint16_t value);
+void writeInt32(uint8_t *bytes, int32_t value);
+float q16ToFloat(int32_t value);
@@ -0,0 +1,726 @@
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "profiler.h"
+#include "stepengine.h"
+
+// Width of the step pulse. Compare match B ends the pulse this many timer ticks after it started.
+const uint16_t STEP_PULSE_TICKS = 4;
+// Latest a tick's pulses may go out after its compare match before the profiler counts a missed deadline.
+const uint16_t STEP_DEADLINE_TICKS = 10 * STEP_TICKS_PER_MICROSECOND;
+// Timer ticks per interpolation tick.
+const uint16_t TIMER_TICKS_PER_STEP_TICK = STEP_TICK_MICROSECONDS * STEP_TICKS_PER_MICROSECOND;
+
+// Ports and bits of the step and direction pins, resolved at compile time.
+static_assert(NUM_AXES == 6, "The pin tables below list six axes");
+constexpr uint16_t STEP_PORTS = usedPorts(stepPins, NUM_AXES);
+constexpr uint16_t DIR_PORTS = usedPorts(dirPins, NUM_AXES);
+constexpr uint8_t STEP_PIN_PORTS[NUM_AXES] = {pinPort(stepPins[0]), pinPort(stepPins[1]), pinPort(stepPins[2]),
+                                              pinPort(stepPins[3]), pinPort(stepPins[4]), pinPort(stepPins[5])};
+constexpr uint8_t STEP_PIN_MASKS[NUM_AXES] = {pinMask(stepPins[0]), pinMask(stepPins[1]), pinMask(stepPins[2]),
+                                              pinMask(stepPins[3]), pinMask(stepPins[4]), pinMask(stepPins[5])};
+constexpr uint8_t DIR_PIN_PORTS[NUM_AXES] = {pinPort(dirPins[0]), pinPort(dirPins[1]), pinPort(dirPins[2]),
+                                             pinPort(dirPins[3]), pinPort(dirPins[4]), pinPort(dirPins[5])};
+constexpr uint8_t DIR_PIN_MASKS[NUM_AXES] = {pinMask(dirPins[0]), pinMask(dirPins[1]), pinMask(dirPins[2]),
+                                             pinMask(dirPins[3]), pinMask(dirPins[4]), pinMask(dirPins[5])};
+constexpr uint16_t LIMIT_PORTS = usedPorts(LIMIT_SWITCH_PINS, NUM_AXES);
+constexpr uint8_t LIMIT_PIN_PORTS[NUM_AXES] = {pinPort(LIMIT_SWITCH_PINS[0]), pinPort(LIMIT_SWITCH_PINS[1]), pinPort(LIMIT_SWITCH_PINS[2]),
+                                               pinPort(LIMIT_SWITCH_PINS[3]), pinPort(LIMIT_SWITCH_PINS[4]), pinPort(LIMIT_SWITCH_PINS[5])};
+constexpr uint8_t LIMIT_PIN_MASKS[NUM_AXES] = {pinMask(LIMIT_SWITCH_PINS[0]), pinMask(LIMIT_SWITCH_PINS[1]), pinMask(LIMIT_SWITCH_PINS[2]),
+                                               pinMask(LIMIT_SWITCH_PINS[3]), pinMask(LIMIT_SWITCH_PINS[4]), pinMask(LIMIT_SWITCH_PINS[5])};
+
+StepEngine stepEngine;
+
+ISR(TIMER1_COMPA_vect)
+{
+  PROFILE_COUNT_IF(missedDeadlines, TCNT1 > STEP_DEADLINE_TICKS);
+  {
+    PROFILE_SCOPE(PROFILE_STEP_ISR);
+    stepEngine.stepISR();
+  }
+  PROFILE_COUNT_IF(isrOverruns, TIFR1 & (1 << OCF1A)); // The next tick is already due
+}
+
+ISR(TIMER1_COMPB_vect)
+{
+  PROFILE_SCOPE(PROFILE_RESET_ISR);
+  stepEngine.resetISR();
+}
+
+void StepEngine::begin()
+{
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = 0; // Clock stopped until a move starts
+  TCNT1 = 0;
+  OCR1A = TIMER_TICKS_PER_STEP_TICK - 1;
+  TIMSK1 = 0;
+  interrupts();
+}
+
+/**
+ * @brief Starts the timer if it is stopped. Call with interrupts disabled.
+ *
+ * No axis steps on the first tick, so direction pins set just before settle for at least a tick.
+ */
+void StepEngine::startTimer()
+{
+  if (timerRunning)
+    return;
+  stepBits = 0;
+  pulsePortBits = {};
+  directionPending = false;
+  finished = false;
+  TCNT1 = 0;
+  TIFR1 = (1 << OCF1A) | (1 << OCF1B);
+  TIMSK1 = (1 << OCIE1A);
+  TCCR1B = (1 << WGM12) | (1 << CS11); // CTC mode, prescaler 8
+  timerRunning = true;
+}
+
+/**
+ * @brief Stops the timer once there is nothing left to step: no block that is not held, no
+ * jog, no pending pulse.
+ */
+void StepEngine::stopTimerIfIdle()
+{
+  if ((busy && feed != FEED_HELD) || jogBits != 0 || stepBits != 0)
+    return;
+  TCCR1B = 0;
+  TIMSK1 = 0;
+  timerRunning = false;
+}
+
+/**
+ * @brief Moves `rate` one tick along `profile`, `step` steps into it: towards the cruise
+ * rate, and from `decelStartStep` on towards the exit rate.
+ */
+static inline uint32_t rampRate(uint32_t rate, const BlockProfile &profile, int32_t step)
+{
+  uint32_t target = step < profile.decelStartStep ? profile.cruiseRate : profile.exitRate;
+  if (rate < target)
+    return target - rate > profile.acceleration ? rate + profile.acceleration : target;
+  return rate - target > profile.acceleration ? rate - profile.acceleration : target;
+}
+
+/**
+ * @brief Moves `rate` one tick along the S-curve of the current block, `step` steps into it.
+ *
+ * The change of the rate per tick is a whole number of jerk steps. Each tick it grows by
+ * one, holds or shrinks by one: the most that still lets it ease off to zero by the time
+ * the rate reaches its target. `easeOffChange` is how far the rate would get while it
+ * does, kept up to date with one addition per tick: growing by a step adds the new
+ * change, shrinking subtracts the old one. A target that moves the other way while the
+ * rate still changes towards the old one is first eased off.
+ */
+void StepEngine::rampSCurve(int32_t step)
+{
+  const BlockProfile &profile = block->profile;
+  uint32_t target = step < profile.decelStartStep ? profile.cruiseRate : profile.exitRate;
+  bool up = target >= rate;
+  uint32_t gap = up ? target - rate : rate - target;
+  int32_t change = up ? rateChange : -rateChange; // Towards the target
+
+  if (change < 0)
+  {
+    easeOffChange -= (uint32_t)-change >> 8;
+    change += (int32_t)profile.jerk;
+  }
+  else
+  {
+    uint32_t grown = change + profile.jerk;
+    if (grown <= profile.acceleration << 8 && easeOffChange <= gap && (grown >> 8) <= gap - easeOffChange)
+    {
+      change = grown;
+      easeOffChange += grown >> 8;
+    }
+    else if (easeOffChange > gap)
+    {
+      easeOffChange -= (uint32_t)change >> 8;
+      change -= (int32_t)profile.jerk;
+    }
+    else if (change == 0)
+    {
+      rate = target; // Closer than a single jerk step
+      return;
+    }
+  }
+
+  rateChange = up ? change : -change;
+  uint32_t magnitude = (uint32_t)(change < 0 ? -change : change) >> 8;
+  rate = (change < 0) != up ? rate + magnitude : rate - magnitude;
+}
+
+/**
+ * @brief Moves the rate one tick down towards a feed hold, and holds once it is down to
+ * the block's stop rate.
+ *
+ * The rate never rises above the plan: the block's own ramps change it by `acceleration`
+ * per tick at most, its peak acceleration with an S-curve.
+ */
+void StepEngine::rampToHold()
+{
+  const BlockProfile &profile = block->profile;
+  if (rate > profile.stopRate + profile.acceleration)
+  {
+    rate -= profile.acceleration;
+    return;
+  }
+  rate = min(rate, profile.stopRate);
+  feed = FEED_HELD;
+}
+
+/**
+ * @brief Sets the direction pins of the axes that move in the current block, one port write per port.
+ *
+ * A direction pin is LOW for the positive direction, unless the axis is inverted.
+ * Call with interrupts disabled or from the Timer1 interrupts.
+ */
+void StepEngine::applyDirections()
+{
+  PortBits mask = {};
+  PortBits levels = {};
+  for (uint8_t i = 0; i < NUM_AXES; i++)
+  {
+    if (block->direction[i] == 0)
+      continue;
+    mask.bits[DIR_PIN_PORTS[i]] |= DIR_PIN_MASKS[i];
+    if ((block->direction[i] > 0) == INVERT_DIRECTION[i])
+      levels.bits[DIR_PIN_PORTS[i]] |= DIR_PIN_MASKS[i];
+  }
+  writePortBits<DIR_PORTS>(mask, levels);
+}
+
+/**
+ * @brief Advances every axis of the block by one tick and returns the axes that step.
+ *
+ * Each axis adds its share of the master rate to its phase and steps when the phase wraps
+ * past a whole step. An axis stops once it has taken all its steps; the rounding of the
+ * shares leaves a slave at most a step behind the master, which it takes on the tick after
+ * the master's last step. The step pins of the axes that step are added by port to
+ * `portBits`, ready to go out together.
+ */
+uint8_t StepEngine::nextStepBits(PortBits &portBits)
+{
+  uint8_t bits = 0;
+  uint16_t speed = rate >> 16;
+  bool masterDone = stepsLeft[masterAxis] == 0;
+  bool stepsRemain = false;
+  for (uint8_t i = 0; i < NUM_AXES; i++)
+  {
+    if (stepsLeft[i] == 0)
+      continue;
+    bool step = masterDone;
+    if (!step)
+    {
+      uint32_t increment = (masterBits & (1 << i)) ? (uint32_t)speed << 16 : (uint32_t)speed * block->rateScale[i];
+      uint32_t phase = phases[i] + increment;
+      step = phase < phases[i]; // Wrapped
+      phases[i] = phase;
+    }
+    if (step)
+    {
+      bits |= (1 << i);
+      portBits.bits[STEP_PIN_PORTS[i]] |= STEP_PIN_MASKS[i];
+      stepsLeft[i]--;
+    }
+    if (stepsLeft[i] != 0)
+      stepsRemain = true;
+  }
+  blockComplete = !stepsRemain;
+  return bits;
+}
+
+/**
+ * @brief Advances every jog by one tick and returns the axes that step.
+ *
+ * A jog ends on the tick after its last step was decided, once that step has gone out.
+ * A jog stopping at its limit switch ends once it is back down to its starting rate.
+ */
+uint8_t StepEngine::nextJogBits(PortBits &portBits)
+{
+  uint8_t bits = 0;
+  for (uint8_t i = 0; i < NUM_AXES; i++)
+  {
+    uint8_t bit = 1 << i;
+    if (!(jogBits & bit))
+      continue;
+    if ((jogStopBits & bit) && jogRates[i] == jogProfiles[i].exitRate)
+      jogStepsLeft[i] = 0;
+    if (jogStepsLeft[i] == 0)
+    {
+      jogBits &= ~bit;
+      jogStopBits &= ~bit;
+      limitWatchBits &= ~bit;
+      continue;
+    }
+    jogRates[i] = rampRate(jogRates[i], jogProfiles[i], jogSteps[i] - jogStepsLeft[i]);
+    uint32_t phase = jogPhases[i] + jogRates[i];
+    if (phase < jogPhases[i]) // Wrapped
+    {
+      bits |= bit;
+      portBits.bits[STEP_PIN_PORTS[i]] |= STEP_PIN_MASKS[i];
+      jogStepsLeft[i]--;
+    }
+    jogPhases[i] = phase;
+  }
+  return bits;
+}
+
+/**
+ * @brief Samples the limit switches of the watching axes and debounces them.
+ *
+ * Runs after the tick's steps went out, so a latched position counts every step taken
+ * before the sample. The position at the first pressed sample is latched; once
+ * `LIMIT_DEBOUNCE_SAMPLES` samples in a row read pressed, it is kept and the axis ramps
+ * down to a stop within its allowance. As many released samples in a row drop the latch.
+ *
+ * None of the limit pins (PA1, PD2, PH1, PE4, PL4, PL7) is on a pin-change interrupt port
+ * of the Mega 2560, so they are sampled here on every tick. No axis steps more than once
+ * per tick, so the sample still resolves the position to the step.
+ */
+void StepEngine::watchLimits()
+{
+  PortBits levels = readPortBits<LIMIT_PORTS>();
+  for (uint8_t i = 0; i < NUM_AXES; i++)
+  {
+    uint8_t bit = 1 << i;
+    if (!(limitWatchBits & bit))
+      continue;
+    bool high = levels.bits[LIMIT_PIN_PORTS[i]] & LIMIT_PIN_MASKS[i];
+    bool pressed = high == (LIMIT_SWITCH_PRESSED == HIGH);
+    if (pressed != (bool)(limitLevelBits & bit))
+    {
+      limitLevelBits ^= bit;
+      limitSamples[i] = 0;
+    }
+    if (limitSamples[i] < LIMIT_DEBOUNCE_SAMPLES)
+      limitSamples[i]++;
+
+    if (pressed && !(limitEdgeBits & bit))
+    {
+      limitEdgeBits |= bit;
+      limitPositions[i] = positions[i];
+    }
+    if (limitSamples[i] < LIMIT_DEBOUNCE_SAMPLES || !(limitEdgeBits & bit))
+      continue;
+    if (!pressed)
+    {
+      limitEdgeBits &= ~bit; // Noise
+      continue;
+    }
+
+    limitHitBits |= bit;
+    limitWatchBits &= ~bit;
+    int32_t travelled = (positions[i] - limitPositions[i]) * stepDirections[i];
+    int32_t stepsLeft = max(jogLimitStopSteps[i] - travelled, (int32_t)0);
+    jogStepsLeft[i] = min(jogStepsLeft[i], stepsLeft);
+    jogProfiles[i].decelStartStep = 0;
+    jogProfiles[i].acceleration = jogStopDecels[i];
+    jogStopBits |= bit;
+  }
+}
+
+/**
+ * @brief Takes the planner's current block and prepares its first tick.
+ *
+ * Blocks without any step are completed on the spot.
+ * @return false if the planner has nothing left to execute.
+ */
+bool StepEngine::loadBlock()
+{
+  block = planner.currentBlock();
+  while (block != nullptr && block->masterSteps == 0)
+  {
+    block->started = true;
+    block->startMicros = block->endMicros = micros();
+    block->done = true;
+    planner.advanceCurrentBlock();
+    block = planner.currentBlock();
+  }
+  if (block == nullptr)
+    return false;
+
+  block->started = true;
+  block->startMicros = micros();
+  masterBits = 0;
+  for (uint8_t i = 0; i < NUM_AXES; i++)
+  {
+    phases[i] = 0;
+    stepsLeft[i] = block->delta[i];
+    if (block->delta[i] != 0)
+      stepDirections[i] = block->direction[i];
+    if (block->delta[i] == block->masterSteps)
+    {
+      masterAxis = i;
+      masterBits |= (1 << i);
+    }
+  }
+  rate = block->profile.entryRate;
+  rateChange = 0;
+  easeOffChange = 0;
+  blockComplete = false;
+  return true;
+}
+
+void StepEngine::wake()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if (!busy && !halted && feed == FEED_RUNNING && loadBlock())
+    {
+      busy = true;
+      applyDirections();
+      startTimer();
+    }
+  }
+}
+
+void StepEngine::abort()
+{
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  TCCR1B = 0;
+  TIMSK1 = 0;
+  timerRunning = false;
+  clearPortBits<STEP_PORTS>(pulsePortBits);
+  pulsePortBits = {};
+  stepBits = 0;
+  block = nullptr;
+  busy = false;
+  finished = false;
+  feed = FEED_RUNNING;
+  jogBits = 0;
+  jogStopBits = 0;
+  limitWatchBits = 0;
+  SREG = oldSREG;
+}
+
+void StepEngine::hold()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if (feed == FEED_RUNNING)
+      feed = busy ? FEED_HOLDING : FEED_HELD;
+  }
+}
+
+/**
+ * @brief Restarts the timer of blocks held at a stop, or starts the queue if the hold
+ * caught the engine between blocks. The S-curve state is dropped: the hold ramped the rate
+ * on its own, and the ramp picks up from the rate it left.
+ */
+void StepEngine::resume()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if (feed != FEED_RUNNING)
+    {
+      bool held = feed == FEED_HELD;
+      feed = FEED_RUNNING;
+      rateChange = 0;
+      easeOffChange = 0;
+      if (held && busy && block != nullptr)
+      {
+        applyDirections();
+        startTimer();
+      }
+    }
+  }
+  wake();
+}
+
+/**
+ * @brief Stops first and latches after: the step pins are low before anything else is done.
+ */
+void StepEngine::emergencyStop()
+{
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  abort();
+  if (!halted)
+  {
+    for (uint8_t i = 0; i < NUM_AXES; i++)
+    {
+      stopPositions[i] = positions[i];
+    }
+    halted = true;
+    stopPending = true;
+  }
+  SREG = oldSREG;
+}
+
+bool StepEngine::takeEmergencyStop(long latched[NUM_AXES])
+{
+  bool pending;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    pending = stopPending;
+    stopPending = false;
+    for (uint8_t i = 0; i < NUM_AXES; i++)
+    {
+      latched[i] = stopPositions[i];
+    }
+  }
+  return pending;
+}
+
+void StepEngine::release()
+{
+  halted = false;
+}
+
+bool StepEngine::jog(uint8_t axis, int32_t steps, float speed, float acceleration)
+{
+  return startJog(axis, steps, speed, acceleration, IGNORE_LIMIT);
+}
+
+bool StepEngine::jogToLimit(uint8_t axis, int32_t steps, float speed, float acceleration, int32_t overtravelSteps)
+{
+  return startJog(axis, steps, speed, acceleration, max(overtravelSteps, (int32_t)0));
+}
+
+/**
+ * @brief Starts a jog of `axis`; unless `limitStopSteps` is `IGNORE_LIMIT`, one that stops
+ * within that many steps of where the limit switch closed.
+ */
+bool StepEngine::startJog(uint8_t axis, int32_t steps, float speed, float acceleration, int32_t limitStopSteps)
+{
+  if (halted)
+    return false;
+  if (isJogging(axis))
+    return false; // Its last pulse may still be on the way, in the old direction
+  if (steps == 0)
+    return true;
+
+  // Ramp from the speed of the first step off rest, symmetrically at both ends.
+  int32_t length = abs(steps);
+  speed = min(speed, 1000000.0 / MIN_SPEED_DELAY);
+  float startSpeed = min(sqrt(2 * acceleration), speed);
+  int32_t rampSteps = (speed * speed - startSpeed * startSpeed) / (2 * acceleration) + 0.5;
+  BlockProfile profile;
+  profile.decelStartStep = length - min(rampSteps, length / 2);
+  profile.entryRate = RATE_ONE * startSpeed / STEP_TICK_HZ;
+  profile.cruiseRate = RATE_ONE * speed / STEP_TICK_HZ;
+  profile.exitRate = profile.entryRate;
+  profile.stopRate = profile.entryRate;
+  profile.acceleration = constrain(RATE_ONE * acceleration / ((float)STEP_TICK_HZ * STEP_TICK_HZ), 1, 4.0e9);
+  // Deceleration that brings the cruise rate down within the allowance past the switch.
+  float stopDecel = (float)profile.cruiseRate * profile.cruiseRate / (2.0 * max(limitStopSteps, (int32_t)1) * RATE_ONE);
+  uint32_t stopDecelRate = constrain(max(stopDecel, (float)profile.acceleration), 1, 4.0e9);
+
+  int8_t direction = steps > 0 ? 1 : -1;
+  PortBits mask = {};
+  PortBits levels = {};
+  mask.bits[DIR_PIN_PORTS[axis]] = DIR_PIN_MASKS[axis];
+  if ((direction > 0) == INVERT_DIRECTION[axis])
+    levels.bits[DIR_PIN_PORTS[axis]] = DIR_PIN_MASKS[axis];
+
+  uint8_t bit = 1 << axis;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    writePortBits<DIR_PORTS>(mask, levels);
+    stepDirections[axis] = direction;
+    jogSteps[axis] = length;
+    jogStepsLeft[axis] = length;
+    jogRates[axis] = profile.entryRate;
+    jogPhases[axis] = 0;
+    jogProfiles[axis] = profile;
+    jogStopBits &= ~bit;
+    jogStopDecels[axis] = stopDecelRate;
+    jogLimitStopSteps[axis] = limitStopSteps;
+    limitHitBits &= ~bit;
+    limitEdgeBits &= ~bit;
+    limitLevelBits &= ~bit;
+    limitSamples[axis] = 0;
+    if (limitStopSteps != IGNORE_LIMIT)
+      limitWatchBits |= bit;
+    jogBits |= bit;
+    startTimer();
+  }
+  return true;
+}
+
+void StepEngine::stopJog(uint8_t axis)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    jogStepsLeft[axis] = 0;
+    limitWatchBits &= ~(1 << axis);
+  }
+}
+
+bool StepEngine::limitHit(uint8_t axis, long &position) const
+{
+  bool hit;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    hit = limitHitBits & (1 << axis);
+    position = limitPositions[axis];
+  }
+  return hit;
+}
+
+bool StepEngine::blockProgress(const PlannerBlock *of, int32_t &step, uint32_t &masterRate) const
+{
+  bool executing;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    executing = busy && block == of && !of->done;
+    if (executing)
+    {
+      step = block->masterSteps - stepsLeft[masterAxis];
+      masterRate = rate;
+    }
+  }
+  return executing;
+}
+
+long StepEngine::position(int axis) const
+{
+  long steps;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    steps = positions[axis];
+  }
+  return steps;
+}
+
+long StepEngine::stepRate(int axis) const
+{
+  uint8_t bit = 1 << axis;
+  uint32_t axisRate = 0;
+  int8_t direction;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if (jogBits & bit)
+      axisRate = jogRates[axis];
+    else if (block != nullptr && stepsLeft[axis] != 0)
+      axisRate = (masterBits & bit) ? rate : (rate >> 16) * block->rateScale[axis];
+    direction = stepDirections[axis];
+  }
+  return direction * (long)(axisRate * (STEP_TICK_HZ / RATE_ONE));
+}
+
+void StepEngine::setPosition(int axis, long steps)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    positions[axis] = steps;
+  }
+}
+
+/**
+ * @brief Timer1 compare match A: emits the steps of one tick and works out the next.
+ *
+ * The pulses decided on the previous tick go out first, so that the step edges keep the
+ * tick's timing whatever the computation costs, unless the E-Stop reads pressed: then the
+ * engine halts and they never go out. The limit switches being watched are sampled next.
+ * The master rate then moves one tick along the block's profile, or down towards a feed
+ * hold, and each jog along its own. After the last step of a block the next queued block
+ * is loaded right away.
+ */
+void StepEngine::stepISR()
+{
+  if (isEstopPressed())
+  {
+    emergencyStop();
+    return;
+  }
+
+  bool pulsed = stepBits != 0;
+  if (pulsed)
+  {
+    setPortBits<STEP_PORTS>(stepPortBits);
+    pulsePortBits = stepPortBits;
+    OCR1B = TCNT1 + STEP_PULSE_TICKS;
+    TIFR1 = (1 << OCF1B);
+    TIMSK1 |= (1 << OCIE1B);
+    for (uint8_t i = 0; i < NUM_AXES; i++)
+    {
+      if (stepBits & (1 << i))
+        positions[i] += stepDirections[i];
+    }
+  }
+
+  if (limitWatchBits != 0)
+    watchLimits();
+
+  uint8_t bits = 0;
+  PortBits portBits = {};
+  if (block != nullptr)
+  {
+    if (blockComplete)
+    {
+      uint32_t lastRate = rate;
+      block->endMicros = micros();
+      block->done = true;
+      planner.advanceCurrentBlock();
+      if (loadBlock())
+      {
+        directionPending = true;
+        if (feed != FEED_RUNNING)
+          rate = min(rate, lastRate); // Keep slowing down from where the last block left off
+      }
+      else
+      {
+        finished = true; // Compare match B ends the last pulse and settles what comes next
+      }
+    }
+    if (block != nullptr)
+    {
+      int32_t step = block->masterSteps - stepsLeft[masterAxis];
+      if (feed != FEED_RUNNING)
+        rampToHold();
+      else if (block->profile.jerk != 0)
+        rampSCurve(step);
+      else
+        rate = rampRate(rate, block->profile, step);
+      if (feed != FEED_HELD)
+        bits = nextStepBits(portBits);
+    }
+  }
+  if (jogBits != 0)
+    bits |= nextJogBits(portBits);
+  stepBits = bits;
+  stepPortBits = portBits;
+
+  if (!pulsed)
+    stopTimerIfIdle();
+}
+
+/**
+ * @brief Timer1 compare match B: ends the step pulse, and sets up what comes after a block.
+ *
+ * The direction pins of a newly loaded block only change once the last pulse of the
+ * previous block is over; its first step is at least a tick away. When the queue ran dry
+ * on the last step, a block queued since then is picked up here, unless a feed hold is on. The timer stops once
+ * neither blocks nor jogs are left.
+ */
+void StepEngine::resetISR()
+{
+  clearPortBits<STEP_PORTS>(pulsePortBits);
+  pulsePortBits = {};
+  TIMSK1 &= ~(1 << OCIE1B);
+
+  if (directionPending)
+  {
+    applyDirections();
+    directionPending = false;
+  }
+
+  if (finished)
+  {
+    finished = false;
+    if (feed == FEED_RUNNING && loadBlock())
+    {
+      applyDirections();
+    }
+    else
+    {
+      busy = false;
+      if (feed == FEED_HOLDING)
+        feed = FEED_HELD; // The queue ran out first
+    }
+  }
+  stopTimerIfIdle();
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+#include "fastio.h"
+#include "planner.h"
+
+// Timer1 runs from the 16 MHz clock with a /8 prescaler, so one tick is 0.5 microseconds.
+const uint8_t STEP_TICKS_PER_MICROSECOND = 2;
+
+// The interpolator runs at a fixed rate: a tick every 40 microseconds, 25 kHz. No axis
+// steps more than once per tick, which `MIN_SPEED_DELAY` keeps well clear of.
+const uint32_t STEP_TICK_HZ = 25000;
+const uint8_t STEP_TICK_MICROSECONDS = 1000000 / STEP_TICK_HZ;
+
+// One step per tick, in the Q0.32 unit of the rates.
+const float RATE_ONE = 4294967296.0;
+
+// Where the queued blocks stand with respect to a feed hold.
+enum FeedState : uint8_t
+{
+  FEED_RUNNING,
+  FEED_HOLDING, // Slowing down to a stop along the path
+  FEED_HELD     // Stopped part way, the rest of the block and the queue kept
+};
+
+/**
+ * @class StepEngine
+ * @brief Emits the step pulses of the planner's blocks from the Timer1 interrupts.
+ *
+ * Moves run in the background: compare match A fires on every interpolation tick, outputs
+ * the pulses decided on the previous tick, then advances the ramp and the axes. Each axis
+ * adds its own share of the master rate to a phase accumulator and steps when the phase
+ * wraps, so every joint steps at its own rate, to within a tick, rather than on the steps
+ * of the master axis. Compare match B pulls the step pins low again, so the pulse width
+ * never depends on how long the main loop takes. The step and direction pins are written
+ * straight to their ports, all the axes of a port in one access. When a block ends, the
+ * next queued block is loaded on the same tick and the joints carry on at the planned
+ * junction speed.
+ *
+ * A feed hold brings the blocks to a stop part way: the master rate ramps down to zero at
+ * the block's acceleration, so every axis slows down along the same path, and the engine
+ * then waits with the rest of the block and the queue untouched. On resuming, the rate
+ * ramps back up into the plan from where it stopped.
+ *
+ * The planner may rewrite the profile of the block being executed, when the feed override
+ * changes: the rate then ramps from where it is towards the new cruise rate.
+ *
+ * Alongside the blocks, any joint they leave alone can be jogged on its own, with its own
+ * rate and ramp on the same ticks; this is how the joints home, all at once. While a
+ * jogging joint watches its limit switch, the switch is sampled on every tick. The
+ * position at the first pressed sample is latched, to the step, and kept once the switch
+ * has been debounced on the following samples; the joint then ramps down to a stop.
+ */
+class StepEngine
+{
+public:
+  void begin();
+
+  /**
+   * @brief Starts executing the queued blocks if the engine is idle. Call after queuing a block.
+   */
+  void wake();
+
+  /**
+   * @brief Halts stepping immediately, without deceleration. Safe to call from an ISR.
+   *
+   * The blocks are left in the planner; flush them once the main loop regains control.
+   */
+  void abort();
+
+  /**
+   * @brief Halts stepping on the spot, like `abort()`, and stays halted until `release()`.
+   * Safe to call from an ISR.
+   *
+   * The positions of the axes at the stop are latched for `takeEmergencyStop()`. While the
+   * engine is halted, neither queued blocks nor jogs start. The step ISR also reads the
+   * E-Stop pin before each tick's pulses and stops itself when it reads pressed, so no
+   * pulse starts once the pin is low, whatever happens to the pin's interrupt.
+   */
+  void emergencyStop();
+
+  /**
+   * @brief Whether an emergency stop has halted the engine since the last `release()`.
+   */
+  bool isHalted() const { return halted; }
+
+  /**
+   * @brief Reports each emergency stop once.
+   * @param latched Set to the positions of the axes at the stop, in steps.
+   * @return false if there was no stop since the last call.
+   */
+  bool takeEmergencyStop(long latched[NUM_AXES]);
+
+  /**
+   * @brief Lets blocks and jogs start again after an emergency stop. Flush the planner first.
+   */
+  void release();
+
+  /**
+   * @brief Starts a feed hold: the blocks slow down to a stop at their acceleration, and
+   * no block starts until `resume()`. Jogs carry on.
+   */
+  void hold();
+
+  /**
+   * @brief Ends a feed hold, from a stop or while still slowing down.
+   */
+  void resume();
+
+  FeedState feedState() const { return feed; }
+
+  /**
+   * @brief Whether planner blocks are being executed, or held part way. Jogs do not count.
+   */
+  bool isBusy() const { return busy; }
+
+  /**
+   * @brief Where the engine stands in `of`, for the planner to replan the rest of it.
+   * @param step Set to the master steps decided so far.
+   * @param masterRate Set to the master rate, in Q0.32 master steps per tick.
+   * @return false if the engine is not executing that block.
+   */
+  bool blockProgress(const PlannerBlock *of, int32_t &step, uint32_t &masterRate) const;
+
+  /**
+   * @brief Moves one axis by `steps` on its own, alongside the queued blocks and the other jogs.
+   *
+   * The axis ramps from rest up to `speed` at `acceleration` (steps per second, and per
+   * second squared) and back down to stop on its last step. The queued blocks must not
+   * move it. The limit switch is not watched.
+   * @return false if the axis is still jogging: stop it and wait for `isJogging()` to clear.
+   * Also false while an emergency stop halts the engine.
+   */
+  bool jog(uint8_t axis, int32_t steps, float speed, float acceleration);
+
+  /**
+   * @brief Jogs like `jog()`, watching the axis's limit switch: once it is pressed, the axis
+   * comes to rest within `overtravelSteps` of where it closed. See `limitHit()`.
+   */
+  bool jogToLimit(uint8_t axis, int32_t steps, float speed, float acceleration, int32_t overtravelSteps);
+  bool jogToLimit(uint8_t axis, int32_t steps, float speed, float acceleration, bool) = delete; // Not a flag: the steps past the switch
+
+  /**
+   * @brief Stops a jog on the spot. The axis counts as jogging until its last pulse is out.
+   */
+  void stopJog(uint8_t axis);
+  bool isJogging(uint8_t axis) const { return jogBits & (1 << axis); }
+
+  /**
+   * @brief Whether the last jog of `axis` that watched its limit switch saw it pressed.
+   * @param position Set to the position of the axis on the first tick the switch read pressed.
+   */
+  bool limitHit(uint8_t axis, long &position) const;
+
+  /**
+   * @brief The live position of an axis in steps, as counted by the ISR.
+   */
+  long position(int axis) const;
+  void setPosition(int axis, long steps);
+
+  /**
+   * @brief The rate an axis steps at right now, in steps per second, signed by its direction.
+   */
+  long stepRate(int axis) const;
+
+  // Called from the Timer1 interrupts only.
+  void stepISR();
+  void resetISR();
+
+private:
+  // `limitStopSteps` of a jog that ignores the limit switch.
+  static const int32_t IGNORE_LIMIT = -1;
+
+  bool startJog(uint8_t axis, int32_t steps, float speed, float acceleration, int32_t limitStopSteps);
+  void startTimer();
+  void stopTimerIfIdle();
+  void applyDirections();
+  bool loadBlock();
+  void rampSCurve(int32_t step);
+  void rampToHold();
+  uint8_t nextStepBits(PortBits &portBits);
+  uint8_t nextJogBits(PortBits &portBits);
+  void watchLimits();
+
+  PlannerBlock *block = nullptr;       // Block being executed
+  uint32_t rate;                       // Master steps per tick, in Q0.32
+  int32_t rateChange;                  // S-curve blocks: change of the rate per tick, in Q24.8
+  uint32_t easeOffChange;              // How much the rate still changes if `rateChange` eases off from now
+  uint32_t phases[NUM_AXES];           // Progress of each axis towards its next step, in Q0.32
+  int32_t stepsLeft[NUM_AXES];         // Steps each axis has yet to take in the block
+  uint8_t masterAxis;                  // An axis that travels `masterSteps`
+  uint8_t masterBits;                  // Every such axis, which steps at the full rate
+
+  // Jogs, one per axis, each with its own rate and its own ramp.
+  volatile uint8_t jogBits = 0;        // Axes being jogged
+  int32_t jogSteps[NUM_AXES];          // Length of the jog
+  int32_t jogStepsLeft[NUM_AXES];      // Steps the jog has yet to take
+  uint32_t jogRates[NUM_AXES];         // Steps per tick, in Q0.32
+  uint32_t jogPhases[NUM_AXES];        // Progress towards the next step, in Q0.32
+  BlockProfile jogProfiles[NUM_AXES];  // Ramp of the jog, in the axis's own steps
+  uint8_t jogStopBits = 0;             // Jogs ramping down to a stop at their limit switch
+  uint32_t jogStopDecels[NUM_AXES];    // Rate change per tick that stops them in time
+  int32_t jogLimitStopSteps[NUM_AXES]; // Steps they may take past the switch
+
+  uint8_t limitWatchBits = 0;          // Jogging axes that stop at their limit switch
+  uint8_t limitEdgeBits = 0;           // Watched axes whose switch has read pressed, not yet debounced
+  uint8_t limitLevelBits = 0;          // Watched axes whose switch read pressed on the last sample
+  uint8_t limitSamples[NUM_AXES];      // Samples in a row at that level
+  volatile uint8_t limitHitBits = 0;   // Axes whose limit switch stopped their last jog
+  int32_t limitPositions[NUM_AXES];    // Where they were on the switch's first pressed sample
+
+  uint8_t stepBits = 0;                // Axes to step on the next tick, in blocks or jogs
+  PortBits stepPortBits;               // Their step pins, by port
+  int8_t stepDirections[NUM_AXES];     // Direction each axis steps in
+  PortBits pulsePortBits;              // Step pins currently HIGH, by port
+  bool blockComplete;                  // The steps of the next tick are the last of the block
+  bool directionPending = false;       // A new block was loaded: set its directions once the pulse is over
+  bool timerRunning = false;
+  volatile bool busy = false;
+  volatile FeedState feed = FEED_RUNNING;
+  volatile bool finished = false;      // The queue ran dry on the last step: settled once the pulse is over
+  volatile int32_t positions[NUM_AXES] = {0};
+
+  volatile bool halted = false;        // Stopped by the E-Stop, until `release()`
+  volatile bool stopPending = false;   // An emergency stop `takeEmergencyStop()` has not reported yet
+  int32_t stopPositions[NUM_AXES];     // Positions latched by the last emergency stop
+};
+
+/**
+ * @brief Whether the E-Stop is pressed, from a single read of its port. Safe from an ISR.
+ */
+inline bool isEstopPressed()
+{
+  bool high = readPortBits<1 << pinPort(ESTOP_PIN)>().bits[pinPort(ESTOP_PIN)] & pinMask(ESTOP_PIN);
+  return high == (ESTOP_PRESSED == HIGH);
+}
+
+extern StepEngine stepEngine;
@@ -1,18 +1,11 @@
 #include "Arduino.h"
-
-#pragma push_macro("abs")
-#undef abs
-
-#include "stepperbase.h" // Assuming this is the refactored header file
-#include <algorithm>
+#include "stepperbase.h"
 
 namespace TS4
 {
     // Constructor
     StepperBase::StepperBase(int _stepPin, int _dirPin)
         : steps_traveled(0),
-          current_velocity(0),
-          current_velocity_sqr(0),
           stepPin(_stepPin),
           dirPin(_dirPin)
     {
@@ -20,6 +13,21 @@ namespace TS4
         pinMode(dirPin, OUTPUT);
     }
 
+    void StepperBase::stepCallback(void *context)
+    {
+        static_cast<StepperBase *>(context)->stepISR();
+    }
+
+    void StepperBase::rotCallback(void *context)
+    {
+        static_cast<StepperBase *>(context)->rotISR();
+    }
+
+    void StepperBase::resetCallback(void *context)
+    {
+        static_cast<StepperBase *>(context)->resetISR();
+    }
+
     /**
      * @brief Starts a continuous rotation, accelerating to a target velocity.
      * @param target_velocity The desired final velocity in steps/sec. Can be negative for reverse.
@@ -27,66 +35,84 @@ namespace TS4
      */
     void StepperBase::startRotate(int32_t target_velocity, uint32_t acceleration)
     {
-        this->target_velocity = target_velocity;
         this->target_velocity_original = target_velocity;
-        // Calculate the signed square of the target velocity. Multiplying by signum preserves direction.
-        this->target_velocity_sqr = (int64_t)signum(target_velocity) * target_velocity * target_velocity;
+        this->acceleration = acceleration;
+        setRotateTarget(target_velocity);
 
-        // Determine if we need to accelerate (+1) or decelerate (-1).
-        this->velocity_change_direction = (int32_t)signum(this->target_velocity_sqr - this->current_velocity_sqr);
-        this->two_times_acceleration = 2 * acceleration;
-
-        if (!isMoving)
+        if (!isMoving && target_velocity != 0)
         {
             step_timer = TimerFactory::makeTimer();
+            if (step_timer == nullptr)
+                return; // Every step timer is taken
             step_timer->setPulseParams(8, stepPin); // 8 microsecond pulse width
-            step_timer->attachCallbacks([this]
-                                        { rotISR(); }, [this]
-                                        { resetISR(); });
+            step_timer->attachCallbacks(rotCallback, resetCallback, this);
+
+            direction_multiplier = target_direction;
+            digitalWriteFast(dirPin, direction_multiplier > 0 ? HIGH : LOW);
+            dir_pin_multiplier = direction_multiplier;
+            delayMicroseconds(5); // Allow time for the direction pin to settle.
 
-            // Set an initial "kick-start" velocity to get the motor moving immediately.
-            // This avoids a division by zero if starting from a standstill.
-            current_velocity_sqr = velocity_change_direction * 200 * 200; // TODO: Use a named constant
+            // Start from the "kick-start" velocity rather than with a long first step from rest.
+            speed_step = StepRamp::stepsFromRest(smaller(KICK_START_VELOCITY, (uint32_t)magnitude(target_velocity)), acceleration);
+            ramp.start(StepRamp::periodOfStep(TIMER_TICKS_PER_SECOND, acceleration, speed_step), speed_step);
+            step_timer->updatePeriod(speed_step < target_speed_step ? ramp.period() : cruise_period);
 
             move_mode = move_mode_t::ROTATE_CONTINUOUS;
-            step_timer->start();
             isMoving = true;
+            step_timer->start();
         }
     }
 
+    /**
+     * @brief Sets the velocity a rotation runs at, converted to a ramp step and a period here
+     * so that rotISR does not have to.
+     */
+    void StepperBase::setRotateTarget(int32_t velocity)
+    {
+        uint32_t speed = magnitude(velocity);
+        int32_t step = StepRamp::stepsFromRest(speed, acceleration);
+        uint32_t period = TIMER_TICKS_PER_SECOND / larger(speed, (uint32_t)1);
+
+        // Disable interrupts so that rotISR never sees half of the new target.
+        uint8_t oldSREG = SREG;
+        noInterrupts();
+        target_velocity = velocity;
+        target_direction = signum(velocity);
+        target_speed_step = step;
+        cruise_period = period;
+        SREG = oldSREG;
+    }
+
     /**
      * @brief Plans and starts a move to an absolute target position.
      * @param target_position The absolute target position in steps.
      * @param v_e The end velocity (typically 0).
      * @param max_velocity The maximum cruise velocity for the move in steps/sec.
      * @param acceleration The acceleration for the move in steps/sec^2.
+     * @return False when the stepper was standing and no step timer was free, so it did not start.
      */
-    void StepperBase::startMoveTo(int32_t target_position, int32_t v_e, uint32_t max_velocity, uint32_t acceleration)
+    bool StepperBase::startMoveTo(int32_t target_position, int32_t v_e, uint32_t max_velocity, uint32_t acceleration)
     {
         steps_traveled = 0;
-        int32_t distance_to_travel_steps = std::abs(target_position - current_position_steps);
+        int32_t distance_to_travel_steps = magnitude(target_position - current_position_steps);
         this->total_steps_for_move = distance_to_travel_steps;
 
         // Set the motor's physical direction pin based on the target.
         direction_multiplier = signum(target_position - current_position_steps);
         digitalWriteFast(dirPin, direction_multiplier > 0 ? HIGH : LOW);
+        dir_pin_multiplier = direction_multiplier;
         delayMicroseconds(5); // Allow time for the direction pin to settle.
 
-        two_times_acceleration = 2 * acceleration;
-        current_velocity_sqr = 0; // Start move from a standstill.
-        current_velocity = 0;
-
+        this->acceleration = acceleration;
         target_velocity_original = max_velocity;
-        target_velocity_sqr = (int64_t)max_velocity * max_velocity;
 
         /*
          * === Calculate Acceleration Distance ===
-         * Derives the number of steps required to accelerate to max_velocity using the
-         * kinematic formula: v_f^2 = v_i^2 + 2ad
-         * Rearranging for distance (d): d = (v_f^2 - v_i^2) / 2a
-         * Here, v_f^2 is target_velocity_sqr, v_i^2 is current_velocity_sqr, and 2a is two_times_acceleration.
+         * The number of steps required to accelerate from a standstill to max_velocity,
+         * from the kinematic formula v_f^2 = v_i^2 + 2ad: d = v_f^2 / 2a.
          */
-        int64_t acceleration_distance = (target_velocity_sqr - current_velocity_sqr) / two_times_acceleration + 1;
+        int32_t acceleration_distance = StepRamp::stepsFromRest(max_velocity, acceleration) + 1;
+        bool reaches_cruise_at_once = acceleration_distance <= 1;
 
         // --- Check for Trapezoid vs. Triangle Profile ---
         // If the calculated acceleration distance is more than half the total travel distance,
@@ -101,21 +127,27 @@ namespace TS4
         acceleration_end_step = acceleration_distance - 1;
         deceleration_start_step = total_steps_for_move - acceleration_distance;
 
+        // The step periods: the ramp starts from the kick-start velocity, or straight at the
+        // cruise velocity when it is reached within a step.
+        cruise_period = TIMER_TICKS_PER_SECOND / larger(max_velocity, (uint32_t)1);
+        uint32_t start_velocity = reaches_cruise_at_once ? max_velocity : smaller(KICK_START_VELOCITY, max_velocity);
+        int32_t start_step = StepRamp::stepsFromRest(start_velocity, acceleration);
+        ramp.start(StepRamp::periodOfStep(TIMER_TICKS_PER_SECOND, acceleration, start_step), start_step);
+
         if (!isMoving)
         {
             step_timer = TimerFactory::makeTimer();
-            step_timer->attachCallbacks([this]
-                                        { stepISR(); }, [this]
-                                        { resetISR(); });
+            if (step_timer == nullptr)
+                return false; // Every step timer is taken
+            step_timer->attachCallbacks(stepCallback, resetCallback, this);
             step_timer->setPulseParams(8, stepPin); // 8 microsecond pulse width
+            step_timer->updatePeriod(ramp.period());
 
             isMoving = true;
-            // Set an initial "kick-start" velocity to get the motor moving immediately.
-            current_velocity_sqr = 200 * 200; // TODO: Use a named constant
-
             move_mode = move_mode_t::TARGET_POSITION;
             step_timer->start();
         }
+        return true;
     }
 
     /**
@@ -150,9 +182,10 @@ namespace TS4
             step_timer->stop();
             TimerFactory::returnTimer(step_timer);
             step_timer = nullptr;
+            resetISR(); // A pulse cut short by the stop would stay high
         }
         isMoving = false;
-        current_velocity_sqr = 0;
+        speed_step = 0;
     }
 
     /**
@@ -162,16 +195,6 @@ namespace TS4
     void StepperBase::overrideSpeed(float factor)
     {
         if (move_mode == move_mode_t::ROTATE_CONTINUOUS)
-        {
-            // Disable interrupts to ensure the following shared variables are updated atomically.
-            // This prevents the ISR from reading a partially updated state (a race condition).
-            noInterrupts();
-            target_velocity = target_velocity_original * factor;
-            target_velocity_sqr = (int64_t)signum(target_velocity) * target_velocity * target_velocity;
-            velocity_change_direction = (int32_t)signum(target_velocity_sqr - current_velocity_sqr);
-            interrupts();
-        }
+            setRotateTarget(target_velocity_original * factor);
     }
-}
-
-#pragma pop_macro("abs")
\ No newline at end of file
+}
\ No newline at end of file
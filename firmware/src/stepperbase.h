@@ -1,24 +1,55 @@
 #pragma once
 
 #include "Arduino.h"
-#pragma push_macro("abs")
-#undef abs
-
+#include "fastio.h"
 #include "timers/interfaces.h"
 #include "timers/timerfactory.h"
-#include <algorithm>
-#include <cstdint>
-#include <string>
+#include <StepRamp.h>
+#include <stdint.h>
 
 namespace TS4
 {
+    /// Speed (steps/sec) a move starts at, so that the first step is not a long wait from standstill.
+    const uint32_t KICK_START_VELOCITY = 200;
+
+    /// @brief -1, 0 or 1 according to the sign of `value`.
+    template <typename T>
+    inline int signum(T value)
+    {
+        return (T(0) < value) - (value < T(0));
+    }
+
+    // The AVR core's min(), max() and abs() are macros that evaluate their arguments twice,
+    // which must not happen to `ramp.next()`.
+
+    /// @brief The larger of `a` and `b`.
+    template <typename T>
+    inline T larger(T a, T b)
+    {
+        return a < b ? b : a;
+    }
+
+    /// @brief The smaller of `a` and `b`.
+    template <typename T>
+    inline T smaller(T a, T b)
+    {
+        return b < a ? b : a;
+    }
+
+    /// @brief The absolute value of `value`.
+    template <typename T>
+    inline T magnitude(T value)
+    {
+        return value < T(0) ? -value : value;
+    }
+
     /**
      * @class StepperBase
      * @brief Manages the motion of a single stepper motor or a group of synchronized steppers.
      *
      * This class implements a trapezoidal velocity profile for point-to-point moves,
-     * ensuring smooth acceleration and deceleration. It uses an efficient kinematic equation
-     * to calculate step timings without requiring floating-point arithmetic in the ISR.
+     * ensuring smooth acceleration and deceleration. The step periods of the ramps come from
+     * the integer `StepRamp` recurrence, without floating-point arithmetic in the ISR.
      *
      * Multi-motor synchronization is achieved using a linked list and a Bresenham-like
      * algorithm, allowing for coordinated linear motion.
@@ -26,8 +57,8 @@ namespace TS4
     class StepperBase
     {
     public:
-        std::string name;
-        bool isMoving = false;
+        const char *name = "";
+        volatile bool isMoving = false;
         void emergencyStop();
         void overrideSpeed(float factor);
 
@@ -35,15 +66,14 @@ namespace TS4
         StepperBase(const int stepPin, const int dirPin);
 
         // Motion planning methods
-        void startMoveTo(int32_t target_steps, int32_t end_velocity, uint32_t max_velocity, uint32_t acceleration);
+        bool startMoveTo(int32_t target_steps, int32_t end_velocity, uint32_t max_velocity, uint32_t acceleration);
         void startRotate(int32_t target_velocity, uint32_t acceleration);
         void startStopping(int32_t end_velocity_for_stop, uint32_t acceleration);
 
         inline void setDirection(int d);
 
         // Core kinematic variables
-        int32_t direction_multiplier;      // -1 for reverse, 1 for forward
-        int32_t velocity_change_direction; // -1 for decelerating, 1 for accelerating
+        int32_t direction_multiplier; // -1 for reverse, 1 for forward
 
         volatile int32_t current_position_steps = 0; // Absolute position in steps from origin
         volatile int32_t target_position_steps;      // The final absolute position for the move
@@ -52,16 +82,21 @@ namespace TS4
         int32_t total_steps_for_move;     // Total steps in the current movement
         int32_t target_velocity;          // The cruise velocity for the move (steps/sec)
         int32_t target_velocity_original; // Stored original target velocity before any overrides
-        int64_t target_velocity_sqr;      // Square of the cruise velocity
 
-        int32_t two_times_acceleration;  // Pre-calculated 2 * acceleration for kinematic formula
+        uint32_t acceleration;           // Acceleration of the current move (steps/sec^2)
         int32_t deceleration_start_step; // The step count at which deceleration should begin
         int32_t acceleration_end_step;   // The step count at which acceleration phase ends
+        uint32_t cruise_period;          // Timer ticks between steps at the cruise velocity
+        StepRamp ramp;                   // Step periods of the acceleration and deceleration phases
+
+        // Continuous rotation: a speed is the index of the `ramp` step that runs at it
+        int32_t target_speed_step = 0;  // Ramp step of the target velocity
+        int32_t target_direction = 0;   // Sign of the target velocity
+        void setRotateTarget(int32_t velocity);
 
         // Volatile state variables updated inside ISR
-        volatile int32_t steps_traveled;       // Number of steps taken in the current move
-        volatile int32_t current_velocity;     // Current velocity in steps/sec
-        volatile int64_t current_velocity_sqr; // Square of the current velocity
+        volatile int32_t steps_traveled;    // Number of steps taken in the current move
+        volatile int32_t speed_step = 0;    // Ramp step of the current rotation speed
 
         inline void doStep();
 
@@ -72,6 +107,18 @@ namespace TS4
         inline void stepISR();  // ISR for position-based moves (Trapezoidal Profile)
         inline void rotISR();   // ISR for velocity-based moves (Rotate)
         inline void resetISR(); // ISR to reset step pins to LOW
+        inline void endMove();  // Hands the timer back and undoes the sync group
+
+        // Timer callbacks, `context` being the stepper
+        static void stepCallback(void *context);
+        static void rotCallback(void *context);
+        static void resetCallback(void *context);
+
+        int32_t dir_pin_multiplier = 0; // The direction the dir pin is set to, 0 before the first move
+
+        // Called from stepISR when a move to a target position has ended
+        TimerCallback finished_callback = nullptr;
+        void *finished_context = nullptr;
 
         enum class move_mode_t
         {
@@ -130,18 +177,16 @@ namespace TS4
     /**
      * @brief Interrupt Service Routine (ISR) for position-controlled moves.
      *
-     * Implements a trapezoidal velocity profile using a kinematic equation.
-     * The formula v_f^2 = v_i^2 + 2*a*d is used to update velocity.
-     * Since distance 'd' is always 1 step, the formula simplifies to:
-     * new_v_sqr = old_v_sqr + 2*a
-     *
-     * This avoids costly square root operations on every step, only requiring it
-     * once per step to set the timer frequency.
+     * Implements a trapezoidal velocity profile at constant acceleration. Rather than
+     * updating the velocity with v_f^2 = v_i^2 + 2*a*d and taking its square root to set
+     * the timer frequency, the ISR takes the next step period straight from `ramp`, in
+     * integer arithmetic.
      *
      * The move is divided into three phases:
      * 1. Acceleration: Velocity increases until it reaches max_velocity or the halfway point.
-     * 2. Constant Speed: Motor runs at max_velocity.
-     * 3. Deceleration: Velocity decreases to reach zero at the target position.
+     * 2. Constant Speed: Motor runs at max_velocity; the timer keeps its period.
+     * 3. Deceleration: Velocity decreases to reach zero at the target position. The ramp is
+     *    scaled so that it reaches rest on the last step, whatever the speed it starts from.
      */
     void StepperBase::stepISR()
     {
@@ -166,39 +211,25 @@ namespace TS4
         // --- Trapezoidal Motion Profile ---
         if (steps_traveled < acceleration_end_step) // 1. Acceleration Phase
         {
-            current_velocity_sqr += two_times_acceleration;
-            current_velocity = signum(current_velocity_sqr) * sqrtf(std::abs(current_velocity_sqr));
-            step_timer->updateFrequency(std::abs(current_velocity));
+            step_timer->updatePeriod(larger(ramp.next(), cruise_period));
             doStep();
         }
         else if (steps_traveled < deceleration_start_step) // 2. Constant Speed (Cruise) Phase
         {
-            current_velocity = std::min(sqrtf(current_velocity_sqr), sqrtf(target_velocity_sqr));
-            step_timer->updateFrequency(current_velocity);
             doStep();
         }
         else if (steps_traveled < total_steps_for_move) // 3. Deceleration Phase
         {
-            current_velocity_sqr -= two_times_acceleration;
-            current_velocity = signum(current_velocity_sqr) * sqrtf(std::abs(current_velocity_sqr));
-            step_timer->updateFrequency(std::abs(current_velocity));
+            if (ramp.step() >= 0) // First step of the deceleration
+                ramp.start(larger(ramp.period(), cruise_period), -(total_steps_for_move - steps_traveled) - 1);
+            step_timer->updatePeriod(ramp.next());
             doStep();
         }
         else // Target Reached
         {
-            step_timer->stop();
-            TimerFactory::returnTimer(step_timer);
-            step_timer = nullptr;
-
-            // Clean up the linked list of slave motors.
-            auto *cur = this;
-            while (cur != nullptr)
-            {
-                auto *tmp = cur->next_stepper;
-                cur->next_stepper = nullptr;
-                cur = tmp;
-            }
-            isMoving = false;
+            endMove();
+            if (finished_callback != nullptr)
+                finished_callback(finished_context);
         }
     }
 
@@ -206,58 +237,75 @@ namespace TS4
      * @brief Interrupt Service Routine (ISR) for velocity-controlled (continuous rotation) moves.
      *
      * This ISR accelerates or decelerates the motor to a target velocity and maintains it.
-     * It uses the same v_f^2 = v_i^2 + 2ad kinematic equation as stepISR.
+     * Speeds are steps of the same `ramp` as stepISR's: accelerating runs it forward, and
+     * decelerating runs it backward from the current step, so a step costs at most one
+     * integer division, and none at the target velocity, where the timer keeps its period.
+     *
+     * Reversing decelerates to rest first. At rest, the dir pin is switched and that tick's
+     * step is left out, which gives the driver a whole period of setup time instead of a
+     * busy wait in the ISR.
      */
     void StepperBase::rotISR()
     {
         move_mode = move_mode_t::ROTATE_CONTINUOUS;
-        int32_t velocity_absolute;
+        bool towards_target = direction_multiplier == target_direction;
 
-        // Check if target speed has been reached
-        if (std::abs(current_velocity_sqr - target_velocity_sqr) > two_times_acceleration)
+        if (towards_target && speed_step < target_speed_step) // Accelerate
         {
-            // Accelerate or decelerate towards the target velocity
-            current_velocity_sqr += velocity_change_direction * two_times_acceleration;
-
-            direction_multiplier = signum(current_velocity_sqr);
-            digitalWriteFast(dirPin, direction_multiplier > 0 ? HIGH : LOW);
-            delayMicroseconds(5); // Delay for direction pin to settle
-
-            velocity_absolute = sqrtf(std::abs(current_velocity_sqr));
-            step_timer->updateFrequency(velocity_absolute);
-            doStep();
+            if (ramp.step() < 0) // Was decelerating
+                ramp.start(ramp.period(), speed_step);
+            speed_step = speed_step + 1;
+            uint32_t period = ramp.next();
+            step_timer->updatePeriod(speed_step < target_speed_step ? period : cruise_period);
         }
-        else // Target velocity reached
+        else if (!towards_target || speed_step > target_speed_step) // Decelerate
         {
-            direction_multiplier = signum(current_velocity_sqr);
-            digitalWriteFast(dirPin, direction_multiplier > 0 ? HIGH : LOW);
-            delayMicroseconds(5);
-
-            if (target_velocity != 0)
-            {
-                // Maintain constant velocity
-                velocity_absolute = sqrtf(std::abs(current_velocity_sqr));
-                step_timer->updateFrequency(velocity_absolute);
-                doStep();
-            }
-            else // Target velocity is 0, so stop the motor.
+            if (speed_step == 0) // At rest
             {
-                step_timer->stop();
-                TimerFactory::returnTimer(step_timer);
-                step_timer = nullptr;
-                current_velocity_sqr = 0;
-
-                // Clean up the linked list of slave motors.
-                auto *cur = this;
-                while (cur != nullptr)
+                if (target_direction == 0)
                 {
-                    auto *tmp = cur->next_stepper;
-                    cur->next_stepper = nullptr;
-                    cur = tmp;
+                    endMove();
+                    return;
                 }
-                isMoving = false;
+                // Reversing: set the dir pin now and step on the next tick.
+                direction_multiplier = target_direction;
+                digitalWriteFast(dirPin, direction_multiplier > 0 ? HIGH : LOW);
+                dir_pin_multiplier = direction_multiplier;
+                ramp.start(ramp.period(), 0);
+                return;
             }
+            if (ramp.step() >= 0) // Was accelerating or cruising
+                ramp.start(ramp.period(), -speed_step - 1);
+            speed_step = speed_step - 1;
+            uint32_t period = ramp.next();
+            step_timer->updatePeriod(!towards_target || speed_step > target_speed_step ? period : cruise_period);
+        }
+        doStep();
+    }
+
+    /**
+     * @brief Stops the timer, hands it back and releases the slave motors.
+     *
+     * The end of the last pulse may be due on the very tick that ends the move, and a
+     * stopped timer no longer delivers it, so the step pins are pulled low here.
+     */
+    void StepperBase::endMove()
+    {
+        step_timer->stop();
+        TimerFactory::returnTimer(step_timer);
+        step_timer = nullptr;
+        speed_step = 0;
+        resetISR();
+
+        // Clean up the linked list of slave motors.
+        auto *cur = this;
+        while (cur != nullptr)
+        {
+            auto *tmp = cur->next_stepper;
+            cur->next_stepper = nullptr;
+            cur = tmp;
         }
+        isMoving = false;
     }
 
     /**
@@ -274,5 +322,4 @@ namespace TS4
             stepper = stepper->next_stepper;
         }
     }
-}
-#pragma pop_macro("abs")
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "Arduino.h"
+#include "steppergroup.h"
+
+namespace TS4
+{
+    bool StepperGroupBase::add(StepperBase &stepper)
+    {
+        if (count == MAX_GROUP_STEPPERS || isMoving())
+            return false;
+        steppers[count++] = &stepper;
+        return true;
+    }
+
+    void StepperGroupBase::onFinished(TimerCallback callback, void *context)
+    {
+        uint8_t oldSREG = SREG;
+        noInterrupts();
+        finished_callback = callback;
+        finished_context = context;
+        SREG = oldSREG;
+    }
+
+    /**
+     * @brief Sets up the Bresenham chain behind the master and starts the master's move.
+     *
+     * With A_m and A_s the distances of the master and of a slave, the slave's terms are
+     * doubled (A = 2 * A_s) and its error starts at 2 * A_s - A_m, so that its steps fall
+     * midway between the master steps they round to and it makes exactly A_s of them.
+     */
+    bool StepperGroupBase::startMoveTo(const int32_t targets[], uint32_t speed, uint32_t acceleration)
+    {
+        if (count == 0 || isMoving())
+            return false;
+
+        uint8_t longest = 0;
+        int32_t longest_distance = 0;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            int32_t distance = magnitude(targets[i] - steppers[i]->current_position_steps);
+            if (distance > longest_distance)
+            {
+                longest = i;
+                longest_distance = distance;
+            }
+        }
+        if (longest_distance == 0)
+            return true; // Already there
+
+        master = steppers[longest];
+        master->bresenham_A = 2 * longest_distance;
+        StepperBase *last = master;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            StepperBase *stepper = steppers[i];
+            if (stepper == master)
+                continue;
+            int32_t delta = targets[i] - stepper->current_position_steps;
+            if (delta == 0)
+                continue;
+            stepper->direction_multiplier = signum(delta);
+            if (stepper->direction_multiplier != stepper->dir_pin_multiplier)
+            {
+                digitalWriteFast(stepper->dirPin, stepper->direction_multiplier > 0 ? HIGH : LOW);
+                stepper->dir_pin_multiplier = stepper->direction_multiplier;
+            }
+            stepper->bresenham_A = 2 * magnitude(delta);
+            stepper->bresenham_B = stepper->bresenham_A - longest_distance;
+            stepper->next_stepper = nullptr;
+            last->next_stepper = stepper;
+            last = stepper;
+        }
+        last->next_stepper = nullptr;
+
+        // The master's startMoveTo() lets the dir pins settle before its first step.
+        master->finished_callback = finished;
+        master->finished_context = this;
+        if (!master->startMoveTo(targets[longest], 0, speed, acceleration))
+        {
+            unlink();
+            master = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    void StepperGroupBase::stop()
+    {
+        if (isMoving())
+            master->startStopping(0, master->acceleration);
+    }
+
+    void StepperGroupBase::emergencyStop()
+    {
+        if (master == nullptr)
+            return;
+        master->emergencyStop(); // Also ends a pulse the stop cut short
+        unlink();
+    }
+
+    void StepperGroupBase::unlink()
+    {
+        StepperBase *stepper = master;
+        while (stepper != nullptr)
+        {
+            StepperBase *next = stepper->next_stepper;
+            stepper->next_stepper = nullptr;
+            stepper = next;
+        }
+        master->finished_callback = nullptr;
+    }
+
+    /**
+     * @brief Runs in the master's stepISR once the move has ended and the chain is undone.
+     */
+    void StepperGroupBase::finished(void *context)
+    {
+        StepperGroupBase *group = static_cast<StepperGroupBase *>(context);
+        group->master->finished_callback = nullptr;
+        if (group->finished_callback != nullptr)
+            group->finished_callback(group->finished_context);
+    }
+}
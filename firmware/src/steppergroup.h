@@ -0,0 +1,94 @@
+#pragma once
+
+#include "stepperbase.h"
+
+namespace TS4
+{
+    /// Most steppers a group holds: the arm's six joints.
+    const uint8_t MAX_GROUP_STEPPERS = 6;
+
+    /**
+     * @class StepperGroupBase
+     * @brief Moves a set of steppers along a straight line in joint space, on one step timer.
+     *
+     * The stepper with the longest distance to go is the master: it runs its own trapezoidal
+     * move on a step timer, and the others are chained behind it (`next_stepper`) and stepped
+     * from its ISR by the Bresenham terms in `doStep()`. Every stepper therefore starts and
+     * arrives together, and a whole move costs one timer and one ISR per master step.
+     *
+     * A stepper belongs to at most one moving group at a time, and does not move on its own
+     * while its group does.
+     */
+    class StepperGroupBase
+    {
+    public:
+        /**
+         * @brief Adds `stepper` to the group.
+         * @return False when the group is full or moving.
+         */
+        bool add(StepperBase &stepper);
+
+        /**
+         * @brief Moves every stepper of the group to its target, in the order they were added.
+         *
+         * `speed` and `acceleration` are those of the stepper with the longest move, in
+         * steps/sec and steps/sec^2; the others scale with their distance. When no stepper
+         * has anywhere to go, nothing starts.
+         * @return False when the group is already moving or no step timer is free.
+         */
+        bool startMoveTo(const int32_t targets[], uint32_t speed, uint32_t acceleration);
+
+        /**
+         * @brief Decelerates the group to a stop along its line, at the acceleration of its move.
+         */
+        void stop();
+
+        /**
+         * @brief Halts the group at once, without deceleration.
+         */
+        void emergencyStop();
+
+        bool isMoving() const { return master != nullptr && master->isMoving; }
+
+        /**
+         * @brief Has `callback` called with `context` whenever a move of the group ends.
+         *
+         * The callback runs in the step timer's ISR: keep it short.
+         */
+        void onFinished(TimerCallback callback, void *context);
+
+        uint8_t size() const { return count; }
+
+    protected:
+        StepperGroupBase() = default;
+
+    private:
+        static void finished(void *context);
+        void unlink();
+
+        StepperBase *steppers[MAX_GROUP_STEPPERS];
+        uint8_t count = 0;
+        StepperBase *master = nullptr;
+        TimerCallback finished_callback = nullptr;
+        void *finished_context = nullptr;
+    };
+
+    /**
+     * @class StepperGroup
+     * @brief A `StepperGroupBase` filled from a list of steppers.
+     */
+    class StepperGroup : public StepperGroupBase
+    {
+    public:
+        StepperGroup() = default;
+
+        /// The first `MAX_GROUP_STEPPERS` of the `count` steppers.
+        StepperGroup(StepperBase *const steppers[], uint8_t count)
+        {
+            for (uint8_t i = 0; i < count; i++)
+            {
+                add(*steppers[i]);
+            }
+        }
+    };
+}
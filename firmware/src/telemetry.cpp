@@ -0,0 +1,78 @@
+#include <Arduino.h>
+#include "telemetry.h"
+
+Telemetry telemetry;
+
+Telemetry::Telemetry()
+{
+  frame[0] = FRAME_SYNC;
+  frame[1] = TELEMETRY_LENGTH;
+  frame[2] = 0;
+  frame[3] = FRAME_EVENT_TELEMETRY;
+}
+
+uint16_t Telemetry::subscribe(uint16_t rateHz)
+{
+  hz = min(rateHz, TELEMETRY_MAX_HZ);
+  if (hz == 0)
+    return 0;
+  unsigned long now = micros();
+  periodMicros = 1000000UL / hz;
+  nextMicros = now;
+  skipped = false;
+  lastLoopMicros = now;
+  loopTotalMicros = 0;
+  loopCount = 0;
+  loopMaxMicros = 0;
+  return hz;
+}
+
+void Telemetry::recordLoop(unsigned long nowMicros)
+{
+  uint32_t elapsed = nowMicros - lastLoopMicros;
+  lastLoopMicros = nowMicros;
+  loopTotalMicros += elapsed;
+  loopCount++;
+  if (elapsed > loopMaxMicros)
+    loopMaxMicros = elapsed;
+}
+
+bool Telemetry::isDue(unsigned long nowMicros)
+{
+  if (hz == 0 || (long)(nowMicros - nextMicros) < 0)
+    return false;
+  nextMicros += periodMicros;
+  if ((long)(nowMicros - nextMicros) >= 0)
+    nextMicros = nowMicros + periodMicros; // Fell behind: keep the period from now on
+  if (Serial.availableForWrite() < (int)sizeof(frame))
+  {
+    skipped = true;
+    return false;
+  }
+  return true;
+}
+
+void Telemetry::send()
+{
+  uint8_t *fields = payload();
+  uint32_t average = loopCount > 0 ? loopTotalMicros / loopCount : 0;
+  writeUint16(&fields[TELEMETRY_LOOP_AVERAGE], min(average, (uint32_t)0xFFFF));
+  writeUint16(&fields[TELEMETRY_LOOP_MAX], min(loopMaxMicros, (uint32_t)0xFFFF));
+  if (skipped)
+    fields[TELEMETRY_FLAGS] |= TELEMETRY_FLAG_SKIPPED;
+
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 1; i < TELEMETRY_LENGTH + 4; i++)
+  {
+    crc = crc16Update(crc, frame[i]);
+  }
+  frame[TELEMETRY_LENGTH + 4] = crc & 0xFF;
+  frame[TELEMETRY_LENGTH + 5] = crc >> 8;
+  Serial.write(frame, sizeof(frame));
+
+  frame[2]++; // Sequence number
+  skipped = false;
+  loopTotalMicros = 0;
+  loopCount = 0;
+  loopMaxMicros = 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+#include "protocol.h"
+
+// =================================================================
+//   TELEMETRY
+// =================================================================
+//
+// A host that subscribed with `0A <hz>` receives a `FRAME_EVENT_TELEMETRY` frame at that
+// rate instead of polling positions and calibration status. The payload has a fixed
+// layout; its sequence number counts the frames, so the host can tell when one is lost.
+//
+//   offset  size          field
+//   0       u8            flags, `TELEMETRY_FLAG_*`
+//   1       u8            blocks held in the planner's queue
+//   2       6 x int32     positions, in steps
+//   26      6 x int16     step rates, in steps per second, signed by direction
+//   38      6 x u8        calibration: phase in the low nibble, status (0 - not calibrated,
+//                         1 - in progress, 2 - calibrated) in the high nibble
+//   44      u16           average loop() time since the last frame, in microseconds
+//   46      u16           longest loop() time since the last frame, in microseconds
+//
+// A frame is only written when the serial TX buffer has room for all of it, so the main
+// loop never waits on the port; a frame that does not fit is skipped and the next one
+// carries `TELEMETRY_FLAG_SKIPPED`. At 115200 baud 200 frames per second fill most of the
+// link, so other output costs frames at the top rate.
+
+const uint16_t TELEMETRY_MAX_HZ = 200;
+
+enum TelemetryField : uint8_t
+{
+  TELEMETRY_FLAGS = 0,
+  TELEMETRY_QUEUE = 1,
+  TELEMETRY_POSITIONS = 2,
+  TELEMETRY_RATES = TELEMETRY_POSITIONS + 4 * NUM_AXES,
+  TELEMETRY_CALIBRATION = TELEMETRY_RATES + 2 * NUM_AXES,
+  TELEMETRY_LOOP_AVERAGE = TELEMETRY_CALIBRATION + NUM_AXES,
+  TELEMETRY_LOOP_MAX = TELEMETRY_LOOP_AVERAGE + 2,
+  TELEMETRY_LENGTH = TELEMETRY_LOOP_MAX + 2
+};
+
+const uint8_t TELEMETRY_FLAG_ESTOP = 0x01;   // The E-Stop is pressed
+const uint8_t TELEMETRY_FLAG_MOVING = 0x02;  // Queued moves are being executed
+const uint8_t TELEMETRY_FLAG_SKIPPED = 0x04; // Frames were skipped since the last one
+const uint8_t TELEMETRY_FLAG_HOLD = 0x08;    // A feed hold is on: the queued moves are stopping or stopped
+
+/**
+ * @class Telemetry
+ * @brief Paces the telemetry frames and writes them from a buffer laid out once.
+ *
+ * The sync byte, length and command of the frame never change; each frame only fills in
+ * the payload, the sequence number and the CRC, then goes to the port in one write.
+ */
+class Telemetry
+{
+public:
+  Telemetry();
+
+  /**
+   * @brief Sends a frame every `1 / rateHz` seconds from now on, or none if `rateHz` is 0.
+   *
+   * Rates above `TELEMETRY_MAX_HZ` are lowered to it.
+   * @return The rate frames are sent at.
+   */
+  uint16_t subscribe(uint16_t rateHz);
+  uint16_t rate() const { return hz; }
+
+  /**
+   * @brief Times the main loop. Call once per loop() while subscribed.
+   */
+  void recordLoop(unsigned long nowMicros);
+
+  /**
+   * @brief Whether a frame is due at `nowMicros` and fits in the TX buffer.
+   *
+   * When it is due but does not fit, the frame is skipped.
+   */
+  bool isDue(unsigned long nowMicros);
+
+  /**
+   * @brief The payload of the next frame, to fill in before `send()`. The loop times are set by `send()`.
+   */
+  uint8_t *payload() { return &frame[4]; }
+
+  void send();
+
+private:
+  uint8_t frame[TELEMETRY_LENGTH + 6];
+  uint16_t hz = 0;
+  unsigned long periodMicros = 0;
+  unsigned long nextMicros = 0;
+  bool skipped = false;
+
+  unsigned long lastLoopMicros = 0;
+  uint32_t loopTotalMicros = 0;
+  uint32_t loopCount = 0;
+  uint32_t loopMaxMicros = 0;
+};
+
+extern Telemetry telemetry;
@@ -0,0 +1,286 @@
+#include <Arduino.h>
+
+// The Mega 2560's own step timers. The simulator models the 16-bit timers at register
+// level, so the native build can run this backend too when built with AVR_TIMER_POOL.
+#if !defined(SIMULATION_HAL) || defined(AVR_TIMER_POOL)
+#include "timerfactory.h"
+
+namespace TS4
+{
+    namespace
+    {
+        /// Timer ticks per microsecond at the /8 prescaler.
+        const uint32_t TICKS_PER_MICROSECOND = TIMER_TICKS_PER_SECOND / 1000000;
+
+        /// Periods up to this many ticks are counted with the /8 prescaler, longer ones with /64.
+        const uint32_t MAX_FAST_PERIOD = 0x10000;
+        const uint32_t MAX_SLOW_PERIOD = 8 * MAX_FAST_PERIOD - 1;
+
+        /// Shortest period, 20 microseconds: room for a pulse callback and the pulse after it.
+        const uint32_t MIN_PERIOD = 20 * TICKS_PER_MICROSECOND;
+
+// Register access of Timer`N`. Timers 1, 3, 4 and 5 share their layout and bit positions.
+#define AVR_TIMER_REGISTERS(N)                                          \
+    struct Timer##N##Registers                                          \
+    {                                                                   \
+        static const uint8_t CLOCK_DIV_8 = _BV(CS##N##1);               \
+        static const uint8_t CLOCK_DIV_64 = _BV(CS##N##1) | _BV(CS##N##0); \
+        static void setClock(uint8_t clock)                             \
+        {                                                               \
+            TCCR##N##A = 0;                                             \
+            TCCR##N##B = _BV(WGM##N##2) | clock; /* CTC, top in OCRnA */ \
+        }                                                               \
+        static uint16_t count() { return TCNT##N; }                     \
+        static void setCount(uint16_t count) { TCNT##N = count; }       \
+        static void setTop(uint16_t top) { OCR##N##A = top; }           \
+        static void enablePulses()                                      \
+        {                                                               \
+            TIFR##N = _BV(OCF##N##A) | _BV(OCF##N##B);                  \
+            TIMSK##N = _BV(OCIE##N##A);                                 \
+        }                                                               \
+        static void disable()                                           \
+        {                                                               \
+            TCCR##N##B = 0;                                             \
+            TIMSK##N = 0;                                               \
+        }                                                               \
+        static void armPulseEnd(uint16_t count)                         \
+        {                                                               \
+            OCR##N##B = count;                                          \
+            TIFR##N = _BV(OCF##N##B);                                   \
+            TIMSK##N |= _BV(OCIE##N##B);                                \
+        }                                                               \
+        static void disarmPulseEnd() { TIMSK##N &= ~_BV(OCIE##N##B); }  \
+    };
+
+#if POOL_TIMER3
+        AVR_TIMER_REGISTERS(3)
+#endif
+#if POOL_TIMER4
+        AVR_TIMER_REGISTERS(4)
+#endif
+#if POOL_TIMER5
+        AVR_TIMER_REGISTERS(5)
+#endif
+#undef AVR_TIMER_REGISTERS
+
+        /**
+         * @class AvrTimer
+         * @brief Step timer on one of the Mega's 16-bit timers, in CTC mode.
+         *
+         * Compare match A fires every period and runs the pulse callback; the period is the
+         * match value, so a new period written from the callback applies to the next pulse.
+         * When the callback returns, compare match B is armed one pulse width later and runs
+         * the reset callback, so the pulse is never shorter than its width, however long the
+         * callback took, and no ISR waits it out. Periods too long for the /8 prescaler are
+         * counted with /64, at 4 microseconds per count.
+         */
+        template <typename REGISTERS>
+        class AvrTimer : public ITimer
+        {
+        public:
+            void attachCallbacks(TimerCallback pulseCallback, TimerCallback resetCallback, void *context) override
+            {
+                uint8_t oldSREG = SREG;
+                noInterrupts();
+                pulse = pulseCallback;
+                reset = resetCallback;
+                callbackContext = context;
+                SREG = oldSREG;
+            }
+
+            void setPulseParams(uint32_t pulseWidth, int) override
+            {
+                pulseTicks = pulseWidth * TICKS_PER_MICROSECOND;
+            }
+
+            void updateFrequency(uint32_t frequency) override
+            {
+                if (frequency > 0)
+                    updatePeriod(TIMER_TICKS_PER_SECOND / frequency);
+            }
+
+            void updatePeriod(uint32_t period) override
+            {
+                if (period < MIN_PERIOD)
+                    period = MIN_PERIOD;
+                if (period > MAX_SLOW_PERIOD)
+                    period = MAX_SLOW_PERIOD;
+                bool slow = period > MAX_FAST_PERIOD;
+                uint16_t newTop = (slow ? period / 8 : period) - 1;
+                uint8_t newClock = slow ? REGISTERS::CLOCK_DIV_64 : REGISTERS::CLOCK_DIV_8;
+
+                uint8_t oldSREG = SREG;
+                noInterrupts();
+                top = newTop;
+                if (running)
+                {
+                    REGISTERS::setTop(top);
+                    if (newClock != clock)
+                        REGISTERS::setClock(newClock);
+                    if (REGISTERS::count() >= top)
+                        REGISTERS::setCount(top - 1); // Already past the new period: pulse now
+                }
+                clock = newClock;
+                SREG = oldSREG;
+            }
+
+            void start() override
+            {
+                uint8_t oldSREG = SREG;
+                noInterrupts();
+                running = true;
+                REGISTERS::setClock(0);
+                REGISTERS::setTop(top);
+                REGISTERS::setCount(top - 1); // First pulse on the next count
+                REGISTERS::enablePulses();
+                REGISTERS::setClock(clock);
+                SREG = oldSREG;
+            }
+
+            void stop() override
+            {
+                uint8_t oldSREG = SREG;
+                noInterrupts();
+                running = false;
+                REGISTERS::disable();
+                SREG = oldSREG;
+            }
+
+            void onCompareA()
+            {
+                if (pulse != nullptr)
+                    pulse(callbackContext);
+                if (!running)
+                    return; // Stopped from the callback
+                uint16_t width = clock == REGISTERS::CLOCK_DIV_8 ? pulseTicks : (pulseTicks + 7) / 8;
+                uint16_t end = REGISTERS::count() + width;
+                REGISTERS::armPulseEnd(end < top ? end : top);
+            }
+
+            void onCompareB()
+            {
+                REGISTERS::disarmPulseEnd();
+                if (reset != nullptr)
+                    reset(callbackContext);
+            }
+
+            bool inUse = false;
+
+        private:
+            TimerCallback pulse = nullptr;
+            TimerCallback reset = nullptr;
+            void *callbackContext = nullptr;
+            uint16_t pulseTicks = 8 * TICKS_PER_MICROSECOND;
+            uint16_t top = MAX_FAST_PERIOD / 2 - 1; // 1 kHz until told otherwise
+            uint8_t clock = REGISTERS::CLOCK_DIV_8;
+            volatile bool running = false;
+        };
+
+        // Timer1 runs the step engine.
+#if POOL_TIMER3
+        AvrTimer<Timer3Registers> timer3;
+#endif
+#if POOL_TIMER4
+        AvrTimer<Timer4Registers> timer4;
+#endif
+#if POOL_TIMER5
+        AvrTimer<Timer5Registers> timer5;
+#endif
+
+        /// Claims `timer` if it is free.
+        template <typename TIMER>
+        ITimer *claim(TIMER &timer)
+        {
+            if (timer.inUse)
+                return nullptr;
+            timer.inUse = true;
+            return &timer;
+        }
+
+        template <typename TIMER>
+        bool release(TIMER &timer, ITimer *returned)
+        {
+            if (returned != &timer)
+                return false;
+            timer.stop();
+            timer.inUse = false;
+            return true;
+        }
+    }
+
+    ITimer *TimerFactory::makeTimer()
+    {
+        uint8_t oldSREG = SREG;
+        noInterrupts();
+        ITimer *timer = nullptr;
+#if POOL_TIMER3
+        timer = claim(timer3);
+#endif
+#if POOL_TIMER4
+        if (timer == nullptr)
+            timer = claim(timer4);
+#endif
+#if POOL_TIMER5
+        if (timer == nullptr)
+            timer = claim(timer5);
+#endif
+        SREG = oldSREG;
+        return timer;
+    }
+
+    void TimerFactory::returnTimer(ITimer *timer)
+    {
+        if (timer == nullptr)
+            return;
+        uint8_t oldSREG = SREG;
+        noInterrupts();
+#if POOL_TIMER3
+        release(timer3, timer);
+#endif
+#if POOL_TIMER4
+        release(timer4, timer);
+#endif
+#if POOL_TIMER5
+        release(timer5, timer);
+#endif
+        SREG = oldSREG;
+    }
+}
+
+#if POOL_TIMER3
+ISR(TIMER3_COMPA_vect)
+{
+    TS4::timer3.onCompareA();
+}
+
+ISR(TIMER3_COMPB_vect)
+{
+    TS4::timer3.onCompareB();
+}
+#endif
+
+#if POOL_TIMER4
+ISR(TIMER4_COMPA_vect)
+{
+    TS4::timer4.onCompareA();
+}
+
+ISR(TIMER4_COMPB_vect)
+{
+    TS4::timer4.onCompareB();
+}
+#endif
+
+#if POOL_TIMER5
+ISR(TIMER5_COMPA_vect)
+{
+    TS4::timer5.onCompareA();
+}
+
+ISR(TIMER5_COMPB_vect)
+{
+    TS4::timer5.onCompareB();
+}
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace TS4
+{
+    /// Step timers count periods in ticks of 0.5 microseconds, like the 16-bit timers of
+    /// the Mega 2560 with a /8 prescaler.
+    const uint32_t TIMER_TICKS_PER_SECOND = 2000000;
+
+    /// Called from the timer's interrupts with the context it was attached with.
+    typedef void (*TimerCallback)(void *context);
+
+    /**
+     * @class ITimer
+     * @brief A periodic step timer as used by `StepperBase`.
+     *
+     * Once started, the pulse callback runs at the programmed frequency and the reset
+     * callback runs one pulse width after each pulse callback has returned, so the step
+     * pins can be lowered without waiting inside the pulse callback.
+     */
+    class ITimer
+    {
+    public:
+        virtual ~ITimer() {}
+
+        virtual void attachCallbacks(TimerCallback pulseCallback, TimerCallback resetCallback, void *context) = 0;
+
+        /// @param pulseWidth Microseconds between a pulse callback and its reset callback.
+        virtual void setPulseParams(uint32_t pulseWidth, int stepPin) = 0;
+
+        /// @brief Sets the pulse frequency in Hz, taking effect from the next pulse.
+        virtual void updateFrequency(uint32_t frequency) = 0;
+
+        /// @brief Sets the time between pulses in timer ticks, taking effect from the next pulse.
+        virtual void updatePeriod(uint32_t period) = 0;
+
+        /// @brief Starts the timer. The first pulse callback runs straight away.
+        virtual void start() = 0;
+        virtual void stop() = 0;
+    };
+}
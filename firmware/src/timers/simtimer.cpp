@@ -0,0 +1,126 @@
+#include <Arduino.h>
+
+// The native build schedules its step timers on the simulator's clock, unless it is
+// built with AVR_TIMER_POOL to run the register-level backend of avrtimer.cpp instead.
+// Either way it has no more timers than the board, so what fails to start there fails here.
+#if defined(SIMULATION_HAL) && !defined(AVR_TIMER_POOL)
+#include <sim.h>
+#include "timerfactory.h"
+
+namespace TS4
+{
+    namespace
+    {
+        const int NUM_SIM_TIMERS = POOL_TIMERS;
+
+        /**
+         * @class SimTimer
+         * @brief Step timer of the native build, scheduled on the simulator's virtual clock.
+         */
+        class SimTimer : public ITimer
+        {
+        public:
+            SimTimer()
+            {
+                pulseInterrupt = {onPulse, this, 0, false};
+                resetInterrupt = {onReset, this, 0, false};
+            }
+
+            void attachCallbacks(TimerCallback pulseCallback, TimerCallback resetCallback, void *context) override
+            {
+                pulse = pulseCallback;
+                reset = resetCallback;
+                callbackContext = context;
+            }
+
+            void setPulseParams(uint32_t pulseWidth, int) override
+            {
+                pulseCycles = pulseWidth * sim::CYCLES_PER_MICROSECOND;
+            }
+
+            void updateFrequency(uint32_t frequency) override
+            {
+                if (frequency > 0)
+                    periodCycles = sim::CPU_HZ / frequency;
+            }
+
+            void updatePeriod(uint32_t period) override
+            {
+                if (period > 0)
+                    periodCycles = period * (sim::CPU_HZ / TIMER_TICKS_PER_SECOND);
+            }
+
+            void start() override
+            {
+                running = true;
+                sim::armInterrupt(pulseInterrupt, sim::cycles());
+            }
+
+            void stop() override
+            {
+                running = false;
+                sim::disarmInterrupt(pulseInterrupt);
+                sim::disarmInterrupt(resetInterrupt);
+            }
+
+            bool inUse = false;
+
+        private:
+            static void onPulse(void *context)
+            {
+                SimTimer *timer = static_cast<SimTimer *>(context);
+                uint64_t firedAt = timer->pulseInterrupt.due;
+                if (timer->pulse)
+                    timer->pulse(timer->callbackContext);
+                if (!timer->running)
+                    return;
+                // Like the AVR timers, the pulse ends a pulse width after the callback raised
+                // it, and at the latest when the next period starts.
+                uint64_t nextPulse = firedAt + timer->periodCycles;
+                uint64_t pulseEnd = sim::cycles() + timer->pulseCycles;
+                sim::armInterrupt(timer->resetInterrupt, pulseEnd < nextPulse ? pulseEnd : nextPulse);
+                sim::armInterrupt(timer->pulseInterrupt, nextPulse);
+            }
+
+            static void onReset(void *context)
+            {
+                SimTimer *timer = static_cast<SimTimer *>(context);
+                if (timer->reset)
+                    timer->reset(timer->callbackContext);
+            }
+
+            TimerCallback pulse = nullptr;
+            TimerCallback reset = nullptr;
+            void *callbackContext = nullptr;
+            sim::SoftInterrupt pulseInterrupt;
+            sim::SoftInterrupt resetInterrupt;
+            uint32_t periodCycles = sim::CPU_HZ / 1000;
+            uint32_t pulseCycles = 8 * sim::CYCLES_PER_MICROSECOND;
+            bool running = false;
+        };
+
+        SimTimer timers[NUM_SIM_TIMERS];
+    }
+
+    ITimer *TimerFactory::makeTimer()
+    {
+        for (SimTimer &timer : timers)
+        {
+            if (!timer.inUse)
+            {
+                timer.inUse = true;
+                return &timer;
+            }
+        }
+        return nullptr;
+    }
+
+    void TimerFactory::returnTimer(ITimer *timer)
+    {
+        if (timer == nullptr)
+            return;
+        timer->stop();
+        static_cast<SimTimer *>(timer)->inUse = false;
+    }
+}
+#endif
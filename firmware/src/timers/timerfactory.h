@@ -0,0 +1,41 @@
+#pragma once
+
+#include "interfaces.h"
+
+// The 16-bit timers in the step timer pool, 1 or 0. Timer1 runs the step engine, Timer5
+// counts cycles for the profiler when it is built in, and MyAccelStepper's scheduler takes
+// the timer given by MY_ACCEL_STEPPER_TIMER; the pool has the others. The native build's
+// pool has as many timers as the board's.
+#if MY_ACCEL_STEPPER_TIMER == 3
+#define POOL_TIMER3 0
+#else
+#define POOL_TIMER3 1
+#endif
+#if MY_ACCEL_STEPPER_TIMER == 4
+#define POOL_TIMER4 0
+#else
+#define POOL_TIMER4 1
+#endif
+#if defined(PROFILER) || MY_ACCEL_STEPPER_TIMER == 5
+#define POOL_TIMER5 0
+#else
+#define POOL_TIMER5 1
+#endif
+#define POOL_TIMERS (POOL_TIMER3 + POOL_TIMER4 + POOL_TIMER5)
+
+namespace TS4
+{
+    /**
+     * @class TimerFactory
+     * @brief Hands out the step timers of the platform the firmware is built for.
+     */
+    class TimerFactory
+    {
+    public:
+        /// @return A free timer, or nullptr if they are all in use.
+        static ITimer *makeTimer();
+
+        /// @brief Stops `timer` and makes it available again.
+        static void returnTimer(ITimer *timer);
+    };
+}
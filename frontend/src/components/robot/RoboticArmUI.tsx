@@ -3,6 +3,8 @@ import { useEffect, useState } from "react";
 import { useHotkeys } from "react-hotkeys-hook";
 import { Button } from "@/components/ui/button";
 import { Card } from "@/components/ui/card";
+import { Slider } from "@/components/ui/slider";
+import { FEED_OVERRIDE_MAX, FEED_OVERRIDE_MIN } from "@/lib/robot/commands";
 import { JOINT_CONFIGS } from "@/lib/robot/config";
 import { anglesArray } from "@/lib/robot/robot-store";
 import RoboticArm, {
@@ -15,6 +17,8 @@ export const arm = RoboticArm.create();
 
 export default function RoboticArmUI() {
 	const [connected, setConnected] = useState(false);
+	const [held, setHeld] = useState(false);
+	const [feedOverride, setFeedOverride] = useState(100);
 	const [angles, setAngles] = useState<number[]>([0, 0, 0, 0, 0, 0]);
 	const inputs = useStore(anglesArray);
 	const [status, setStatus] = useState<CalibrationStatus[]>([
@@ -59,6 +63,16 @@ export default function RoboticArmUI() {
 
 	const stopAll = async () => {
 		await arm.stopAllJoint();
+		setHeld(false);
+	};
+
+	const toggleHold = async () => {
+		await arm.feedHold(!held);
+		setHeld(!held);
+	};
+
+	const commitFeedOverride = async (percent: number) => {
+		setFeedOverride(await arm.setFeedOverride(percent));
 	};
 
 	useEffect(() => {
@@ -74,7 +88,7 @@ export default function RoboticArmUI() {
 	}, []);
 
 	useHotkeys("s", () => {
-		arm.stopAllJoint();
+		stopAll();
 	});
 	return (
 		<div className="max-w-5xl mx-auto mt-10">
@@ -90,11 +104,27 @@ export default function RoboticArmUI() {
 					<Button onClick={disconnect} disabled={!connected}>
 						Disconnect
 					</Button>
+					<Button onClick={toggleHold} disabled={!connected} variant="outline">
+						{held ? "Resume" : "Hold"}
+					</Button>
 					<Button onClick={stopAll} variant="destructive">
 						Stop All
 					</Button>
 				</div>
 
+				<div className="flex items-center gap-4">
+					<span className="text-sm w-24">Feed {feedOverride}%</span>
+					<Slider
+						min={FEED_OVERRIDE_MIN}
+						max={FEED_OVERRIDE_MAX}
+						step={5}
+						value={[feedOverride]}
+						disabled={!connected}
+						onValueChange={(value) => setFeedOverride(value[0])}
+						onValueCommit={(value) => commitFeedOverride(value[0])}
+					/>
+				</div>
+
 				<div>
 					{Object.values(JOINT_CONFIGS).map((config, jointIndex) => (
 						<JointControlRow
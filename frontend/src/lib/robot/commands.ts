@@ -9,8 +9,233 @@ const COMMANDS = {
 	ADD: "07",
 	MOVE_JOINT: "08",
 	MOVE_JOINT_BY: "09",
+	SUBSCRIBE_TELEMETRY: "0A",
+	PRINT_PROFILE: "0B",
+	MOVE_POSE: "0C",
+	FEED_HOLD: "0D",
+	FEED_OVERRIDE: "0E",
 } as const;
 
 export type Command = keyof typeof COMMANDS;
 
+// --- Binary framed protocol (see firmware/src/protocol.h) ---
+// 0xA5 | length | seq | cmd | payload | CRC-16/CCITT-FALSE (low byte first)
+
+export const FRAME_SYNC = 0xa5;
+export const FRAME_MAX_PAYLOAD = 48;
+export const FRAME_REPLY_FLAG = 0x80;
+export const FRAME_ERROR = 0xff;
+// Unsolicited frame: a queued move started or ended. Carries the sequence
+// number of the command that queued it.
+export const FRAME_EVENT_MOVE = 0x40;
+// Firmware from this protocol version on acknowledges moves as soon as they are
+// queued, then reports their start and end as events.
+export const PROTOCOL_ASYNC_MOVES = 2;
+// Unsolicited frame sent at the rate asked for with SUBSCRIBE_TELEMETRY. The
+// sequence number counts the frames.
+export const FRAME_EVENT_TELEMETRY = 0x41;
+// Firmware from this protocol version on streams telemetry.
+export const PROTOCOL_TELEMETRY = 3;
+// Firmware from this protocol version on takes an S-curve share on MOVE_JOINTS.
+export const PROTOCOL_S_CURVE = 4;
+// Firmware from this protocol version on solves the arm's kinematics and takes
+// MOVE_POSE.
+export const PROTOCOL_POSES = 5;
+// Unsolicited frame: the E-Stop was pressed or released. Carries the positions
+// the joints stopped at.
+export const FRAME_EVENT_ESTOP = 0x42;
+// Firmware from this protocol version on reports the E-Stop with event frames.
+export const PROTOCOL_ESTOP_EVENTS = 6;
+// Firmware from this protocol version on can hold the queued moves part way.
+export const PROTOCOL_FEED_HOLD = 7;
+// Firmware from this protocol version on scales the speed of the queued moves
+// with FEED_OVERRIDE while they run.
+export const PROTOCOL_FEED_OVERRIDE = 8;
+export const FEED_OVERRIDE_MIN = 10;
+export const FEED_OVERRIDE_MAX = 200;
+
+export const TELEMETRY_FLAG = {
+	ESTOP: 0x01,
+	MOVING: 0x02,
+	SKIPPED: 0x04, // Frames were dropped since the previous one
+	HOLD: 0x08, // A feed hold is on: the queued moves are stopping or stopped
+} as const;
+
+export const MOVE_EVENT = {
+	STARTED: 0,
+	COMPLETE: 1,
+	ABORTED: 2,
+} as const;
+
+export const STATUS = {
+	OK: 0,
+	INVALID_ARGUMENT: 1,
+	NOT_CALIBRATED: 2,
+	OUT_OF_RANGE: 3,
+	QUEUE_FULL: 4,
+	BUSY: 5,
+	ABORTED: 6,
+	UNKNOWN_COMMAND: 7,
+	BAD_FRAME: 8,
+	UNREACHABLE: 9, // No joint angles within the limits reach the pose
+} as const;
+
+export type Status = (typeof STATUS)[keyof typeof STATUS];
+
+export type Frame = {
+	seq: number;
+	cmd: number;
+	payload: Uint8Array;
+};
+
+export function commandCode(command: Command): number {
+	return Number.parseInt(COMMANDS[command], 16);
+}
+
+export function crc16(bytes: Uint8Array, crc = 0xffff): number {
+	for (const byte of bytes) {
+		crc ^= byte << 8;
+		for (let i = 0; i < 8; i++) {
+			crc = crc & 0x8000 ? ((crc << 1) ^ 0x1021) & 0xffff : (crc << 1) & 0xffff;
+		}
+	}
+	return crc;
+}
+
+export function encodeFrame(seq: number, cmd: number, payload: Uint8Array): Uint8Array {
+	const bytes = new Uint8Array(payload.length + 6);
+	bytes.set([FRAME_SYNC, payload.length, seq, cmd]);
+	bytes.set(payload, 4);
+	const crc = crc16(bytes.subarray(1, payload.length + 4));
+	bytes[payload.length + 4] = crc & 0xff;
+	bytes[payload.length + 5] = crc >> 8;
+	return bytes;
+}
+
+// Angles, durations and ratios travel as little-endian Q16.16 fixed point.
+function writeQ16(view: DataView, offset: number, value: number) {
+	view.setInt32(offset, Math.round(value * 65536), true);
+}
+
+// `sCurvePercent` (0 to 1) is the share of each ramp spent building up and
+// easing off the acceleration; left out, the move ramps at constant acceleration.
+export function encodeMoveJoints(
+	degrees: number[],
+	durationSec: number,
+	accelDecelPercent: number,
+	sCurvePercent?: number,
+): Uint8Array {
+	const fields = degrees.length + (sCurvePercent === undefined ? 2 : 3);
+	const payload = new Uint8Array(4 * fields);
+	const view = new DataView(payload.buffer);
+	degrees.forEach((degree, i) => writeQ16(view, 4 * i, degree));
+	writeQ16(view, 4 * degrees.length, durationSec);
+	writeQ16(view, 4 * degrees.length + 4, accelDecelPercent);
+	if (sCurvePercent !== undefined) {
+		writeQ16(view, 4 * degrees.length + 8, sCurvePercent);
+	}
+	return payload;
+}
+
+// Position of the tool flange in millimetres, orientation in degrees as roll,
+// pitch and yaw about the base's x, y and z axes.
+export type Pose = {
+	x: number;
+	y: number;
+	z: number;
+	roll: number;
+	pitch: number;
+	yaw: number;
+};
+
+export function encodeMovePose(
+	pose: Pose,
+	durationSec: number,
+	accelDecelPercent: number,
+	sCurvePercent?: number,
+): Uint8Array {
+	const { x, y, z, roll, pitch, yaw } = pose;
+	return encodeMoveJoints(
+		[x, y, z, roll, pitch, yaw],
+		durationSec,
+		accelDecelPercent,
+		sCurvePercent,
+	);
+}
+
+export function encodeMoveJoint(
+	jointNum: number,
+	degree: number,
+	durationSec: number,
+	accelDecelPercent: number,
+): Uint8Array {
+	const payload = new Uint8Array(13);
+	const view = new DataView(payload.buffer);
+	payload[0] = jointNum;
+	writeQ16(view, 1, degree);
+	writeQ16(view, 5, durationSec);
+	writeQ16(view, 9, accelDecelPercent);
+	return payload;
+}
+
+export function decodeInt32s(payload: Uint8Array, offset: number, count: number): number[] {
+	const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+	return Array.from({ length: count }, (_, i) => view.getInt32(offset + 4 * i, true));
+}
+
+// Reply to a queued move and payload of a move event: the move ID, little-endian,
+// and the number of moves the firmware can still queue.
+export function decodeMoveAck(payload: Uint8Array): {
+	moveId: number;
+	freeSlots: number;
+} {
+	return { moveId: payload[1] | (payload[2] << 8), freeSlots: payload[3] };
+}
+
+export function decodeMoveEvent(payload: Uint8Array): {
+	event: number;
+	moveId: number;
+	freeSlots: number;
+} {
+	return { event: payload[0], ...decodeMoveAck(payload) };
+}
+
+export function decodeEstopEvent(payload: Uint8Array): {
+	pressed: boolean;
+	positions: number[]; // Steps
+} {
+	return { pressed: payload[0] !== 0, positions: decodeInt32s(payload, 1, 6) };
+}
+
+export function encodeUint16(value: number): Uint8Array {
+	return Uint8Array.of(value & 0xff, (value >> 8) & 0xff);
+}
+
+export type Telemetry = {
+	flags: number;
+	queuedMoves: number;
+	positions: number[]; // Steps
+	stepRates: number[]; // Steps per second, signed by direction
+	calibrationPhases: number[];
+	calibrationStatuses: number[]; // 0 - not calibrated, 1 - in progress, 2 - calibrated
+	loopAverageMicros: number;
+	loopMaxMicros: number;
+};
+
+// Payload of a telemetry frame, see firmware/src/telemetry.h.
+export function decodeTelemetry(payload: Uint8Array): Telemetry {
+	const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+	const calibration = Array.from(payload.slice(38, 44));
+	return {
+		flags: payload[0],
+		queuedMoves: payload[1],
+		positions: decodeInt32s(payload, 2, 6),
+		stepRates: Array.from({ length: 6 }, (_, i) => view.getInt16(26 + 2 * i, true)),
+		calibrationPhases: calibration.map((byte) => byte & 0x0f),
+		calibrationStatuses: calibration.map((byte) => byte >> 4),
+		loopAverageMicros: view.getUint16(44, true),
+		loopMaxMicros: view.getUint16(46, true),
+	};
+}
+
 export default COMMANDS;
@@ -1,4 +1,31 @@
-import COMMANDS, { type Command } from "./commands";
+import COMMANDS, {
+	type Command,
+	commandCode,
+	decodeEstopEvent,
+	decodeInt32s,
+	decodeMoveAck,
+	decodeMoveEvent,
+	decodeTelemetry,
+	encodeMoveJoint,
+	encodeMoveJoints,
+	encodeMovePose,
+	encodeUint16,
+	FEED_OVERRIDE_MAX,
+	FEED_OVERRIDE_MIN,
+	FRAME_EVENT_ESTOP,
+	FRAME_EVENT_MOVE,
+	FRAME_EVENT_TELEMETRY,
+	type Frame,
+	MOVE_EVENT,
+	type Pose,
+	PROTOCOL_ASYNC_MOVES,
+	PROTOCOL_FEED_HOLD,
+	PROTOCOL_FEED_OVERRIDE,
+	PROTOCOL_POSES,
+	PROTOCOL_TELEMETRY,
+	STATUS,
+	type Telemetry,
+} from "./commands";
 import { JOINT_CONFIGS } from "./config";
 import { WebSerial } from "./web-serial";
 
@@ -21,8 +48,23 @@ type RoboticArmEventMap = {
 		CalibrationStatus,
 	];
 	degreesChanged: [number, number, number, number, number, number];
+	moveStarted: [moveId: number];
+	moveFinished: [moveId: number, completed: boolean];
+	telemetry: [telemetry: Telemetry];
+	estop: [pressed: boolean, positions: number[]];
 };
 
+// Longest a joint may take to home.
+const CALIBRATION_TIMEOUT_SECONDS = 90;
+
+// Outcomes of moves nobody has waited for yet that are kept around.
+const MAX_UNCLAIMED_MOVE_RESULTS = 32;
+
+// Telemetry frames per second asked for on connecting.
+const TELEMETRY_HZ = 50;
+// Telemetry is taken to have stopped after this long without a frame.
+const TELEMETRY_MAX_AGE_MS = 250;
+
 interface Arm {
 	rotateBy(jointNum: JointNum, degree: number): Promise<boolean>;
 	rotateTo(jointNum: JointNum, targetDegree: number): Promise<boolean>;
@@ -34,12 +76,20 @@ interface Arm {
 		joint5Degree: number,
 		joint6Degree: number,
 	): Promise<boolean>;
+	queueAllTo(degrees: number[]): Promise<number>;
+	queueTo(jointNum: JointNum, targetDegree: number): Promise<number>;
+	queueBy(jointNum: JointNum, degree: number): Promise<number>;
+	waitForMove(moveId: number): Promise<boolean>;
 	stopJoint(jointNum: JointNum): Promise<void>;
 	stopAllJoint(): Promise<void>;
+	feedHold(hold: boolean): Promise<void>;
+	setFeedOverride(percent: number): Promise<number>;
 	calibrateJoint(jointNum: JointNum): Promise<boolean>;
+	calibrateJoints(jointNums: JointNum[]): Promise<boolean>;
 	calibrateAll(): Promise<boolean>;
 	getDegrees(): Promise<number[]>;
 	getCalibrationStatus(): Promise<CalibrationStatus[]>;
+	subscribeTelemetry(hz: number): Promise<number>;
 
 	addEventListener<K extends keyof RoboticArmEventMap>(
 		event: K,
@@ -59,10 +109,19 @@ export default class RoboticArm implements Arm {
 	private _eventListeners: Map<keyof RoboticArmEventMap, Set<Function>> =
 		new Map();
 
+	// Queued moves someone waits for, and the outcome of the ones that ended first.
+	private _moveWaiters: Map<number, (completed: boolean) => void> = new Map();
+	private _moveResults: Map<number, boolean> = new Map();
+
+	// Latest telemetry frame and when it arrived.
+	private _telemetry: Telemetry | null = null;
+	private _telemetryAt = 0;
+
 	constructor(serial: WebSerial) {
 		this._serial = serial;
 		this._moveDuration = 2;
 		this._acceleration = 0.4;
+		this._serial.addFrameListener((frame) => this._receiveFrame(frame));
 	}
 
 	static create(): RoboticArm {
@@ -73,13 +132,39 @@ export default class RoboticArm implements Arm {
 
 	async connect() {
 		await this._serial.connect();
-		return new Promise((resolve) => setTimeout(resolve, 2000));
+		await new Promise((resolve) => setTimeout(resolve, 2000));
+		// Older firmware only speaks text; keep using it there.
+		await this._serial.negotiateBinary();
+		if (this.streamsTelemetry) {
+			await this.subscribeTelemetry(TELEMETRY_HZ);
+		}
 	}
 
 	disconnect() {
+		for (const resolve of this._moveWaiters.values()) {
+			resolve(false);
+		}
+		this._moveWaiters.clear();
+		this._moveResults.clear();
+		this._telemetry = null;
 		return this._serial.disconnect();
 	}
 
+	/** True if the firmware acknowledges moves as soon as they are queued. */
+	get queuesMoves(): boolean {
+		return this._serial.protocolVersion >= PROTOCOL_ASYNC_MOVES;
+	}
+
+	/** True if the firmware can push its state without being asked. */
+	get streamsTelemetry(): boolean {
+		return this._serial.protocolVersion >= PROTOCOL_TELEMETRY;
+	}
+
+	/** True if the firmware can move the tool to a Cartesian pose. */
+	get movesToPoses(): boolean {
+		return this._serial.protocolVersion >= PROTOCOL_POSES;
+	}
+
 	addEventListener<K extends keyof RoboticArmEventMap>(
 		event: K,
 		listener: (data: RoboticArmEventMap[K]) => void,
@@ -121,35 +206,272 @@ export default class RoboticArm implements Arm {
 		);
 	}
 
+	/**
+	 * Sends a binary frame and resolves with its reply, or rejects if the
+	 * firmware answered with anything other than `STATUS.OK`.
+	 */
+	private async _sendFrame(
+		command: Command,
+		payload: Uint8Array,
+		timeoutSeconds: number,
+	): Promise<Frame> {
+		const reply = await this._serial.sendFrame(
+			commandCode(command),
+			payload,
+			timeoutSeconds,
+		);
+		if (reply.payload[0] !== STATUS.OK) {
+			throw new Error(`${command} failed with status ${reply.payload[0]}`);
+		}
+		return reply;
+	}
+
+	private _receiveFrame(frame: Frame) {
+		if (frame.cmd === FRAME_EVENT_TELEMETRY) {
+			this._receiveTelemetry(decodeTelemetry(frame.payload));
+			return;
+		}
+		if (frame.cmd === FRAME_EVENT_ESTOP) {
+			const { pressed, positions } = decodeEstopEvent(frame.payload);
+			this._emit("estop", [pressed, positions]);
+			return;
+		}
+		if (frame.cmd !== FRAME_EVENT_MOVE) return;
+		const { event, moveId } = decodeMoveEvent(frame.payload);
+		if (event === MOVE_EVENT.STARTED) {
+			this._emit("moveStarted", [moveId]);
+			return;
+		}
+
+		const completed = event === MOVE_EVENT.COMPLETE;
+		this._emit("moveFinished", [moveId, completed]);
+		const resolve = this._moveWaiters.get(moveId);
+		if (resolve) {
+			this._moveWaiters.delete(moveId);
+			resolve(completed);
+			return;
+		}
+		this._moveResults.set(moveId, completed);
+		if (this._moveResults.size > MAX_UNCLAIMED_MOVE_RESULTS) {
+			const oldest = this._moveResults.keys().next().value as number;
+			this._moveResults.delete(oldest);
+		}
+	}
+
+	private _receiveTelemetry(telemetry: Telemetry) {
+		this._telemetry = telemetry;
+		this._telemetryAt = performance.now();
+		this._emit("telemetry", [telemetry]);
+		this._emit(
+			"degreesChanged",
+			RoboticArm._telemetryDegrees(
+				telemetry,
+			) as RoboticArmEventMap["degreesChanged"],
+		);
+		this._emit(
+			"calibrationStatusChanged",
+			RoboticArm._telemetryCalibrationStatus(
+				telemetry,
+			) as RoboticArmEventMap["calibrationStatusChanged"],
+		);
+	}
+
+	/**
+	 * Resolves with the next telemetry frame, so that it reflects everything
+	 * sent before. Resolves with null if the frames have stopped coming.
+	 */
+	private _nextTelemetry(): Promise<Telemetry | null> {
+		if (
+			!this._telemetry ||
+			performance.now() - this._telemetryAt > TELEMETRY_MAX_AGE_MS
+		) {
+			return Promise.resolve(null);
+		}
+		return new Promise((resolve) => {
+			const timeout = setTimeout(() => {
+				this.removeEventListener("telemetry", listener);
+				resolve(null);
+			}, TELEMETRY_MAX_AGE_MS);
+			const listener = ([telemetry]: [Telemetry]) => {
+				clearTimeout(timeout);
+				this.removeEventListener("telemetry", listener);
+				resolve(telemetry);
+			};
+			this.addEventListener("telemetry", listener);
+		});
+	}
+
+	private static _telemetryDegrees(telemetry: Telemetry): number[] {
+		return telemetry.positions.map((steps, i) =>
+			RoboticArm.stepsToDegrees((i + 1) as JointNum, steps),
+		);
+	}
+
+	private static _telemetryCalibrationStatus(
+		telemetry: Telemetry,
+	): CalibrationStatus[] {
+		return telemetry.calibrationStatuses.map(
+			(num) => CALIBRATION_NUM_TO_STATUS[`${num}` as "0" | "1" | "2"],
+		);
+	}
+
+	/**
+	 * Asks the firmware to push its state `hz` times per second, or to stop
+	 * with 0. While the frames arrive, `getDegrees()` and
+	 * `getCalibrationStatus()` answer from them, and the change events fire on
+	 * every frame. Resolves with the rate the firmware settled on.
+	 */
+	async subscribeTelemetry(hz: number): Promise<number> {
+		if (!this.streamsTelemetry) {
+			throw new Error("The firmware does not stream telemetry");
+		}
+		const reply = await this._sendFrame(
+			"SUBSCRIBE_TELEMETRY",
+			encodeUint16(hz),
+			1,
+		);
+		if (hz === 0) {
+			this._telemetry = null;
+		}
+		return reply.payload[1] | (reply.payload[2] << 8);
+	}
+
+	/**
+	 * Sends a move and resolves with its ID as soon as the firmware has queued
+	 * it. Rejects if the move was refused, e.g. because the queue is full.
+	 */
+	private async _queueMove(
+		command: "MOVE_JOINTS" | "MOVE_JOINT" | "MOVE_JOINT_BY" | "MOVE_POSE",
+		payload: Uint8Array,
+	): Promise<number> {
+		if (!this.queuesMoves) {
+			throw new Error("The firmware does not acknowledge queued moves");
+		}
+		const reply = await this._sendFrame(command, payload, 1);
+		return decodeMoveAck(reply.payload).moveId;
+	}
+
+	/**
+	 * Resolves once the queued move `moveId` has ended: true if it ran to the
+	 * end, false if it was aborted.
+	 */
+	waitForMove(moveId: number): Promise<boolean> {
+		const completed = this._moveResults.get(moveId);
+		if (completed !== undefined) {
+			this._moveResults.delete(moveId);
+			return Promise.resolve(completed);
+		}
+		return new Promise((resolve) => this._moveWaiters.set(moveId, resolve));
+	}
+
+	/**
+	 * Queues a move of all joints without waiting for it, so that several moves
+	 * can be sent ahead and blended by the firmware. Resolves with the move ID.
+	 */
+	queueAllTo(degrees: number[]): Promise<number> {
+		return this._queueMove(
+			"MOVE_JOINTS",
+			encodeMoveJoints(degrees, this._moveDuration, this._acceleration),
+		);
+	}
+
+	/** Queues a move of one joint to an angle; see `queueAllTo()`. */
+	queueTo(jointNum: JointNum, targetDegree: number): Promise<number> {
+		return this._queueMove(
+			"MOVE_JOINT",
+			encodeMoveJoint(
+				jointNum,
+				targetDegree,
+				this._moveDuration,
+				this._acceleration,
+			),
+		);
+	}
+
+	/** Queues a move of one joint by an angle; see `queueAllTo()`. */
+	queueBy(jointNum: JointNum, degree: number): Promise<number> {
+		return this._queueMove(
+			"MOVE_JOINT_BY",
+			encodeMoveJoint(jointNum, degree, this._moveDuration, this._acceleration),
+		);
+	}
+
+	/**
+	 * Queues a move of the tool flange to `pose`; see `queueAllTo()`. The
+	 * firmware works out the joint angles, and rejects the move if no angles
+	 * within the joints' limits reach the pose.
+	 */
+	queuePoseTo(pose: Pose): Promise<number> {
+		if (!this.movesToPoses) {
+			throw new Error("The firmware does not move to poses");
+		}
+		return this._queueMove(
+			"MOVE_POSE",
+			encodeMovePose(pose, this._moveDuration, this._acceleration),
+		);
+	}
+
 	async calibrateJoint(jointNum: JointNum): Promise<boolean> {
-		await this.sendCommand("CALIBRATE_JOINTS", jointNum);
+		return this.calibrateJoints([jointNum]);
+	}
+
+	/**
+	 * Homes the joints together: the firmware runs their calibrations side by
+	 * side and only holds back joints that must wait for others. Resolves with
+	 * false if any of them failed.
+	 */
+	async calibrateJoints(jointNums: JointNum[]): Promise<boolean> {
+		const outcomes = jointNums.map((jointNum) =>
+			this._serial
+				.listenFor(
+					[
+						`Calibration complete for Joint ${jointNum}`,
+						`Calibration failed for Joint ${jointNum}`,
+						`Cannot calibrate Joint ${jointNum}`,
+					],
+					CALIBRATION_TIMEOUT_SECONDS,
+				)
+				.then(
+					(line) => line.includes("complete"),
+					(e: any) => {
+						console.error(e.message);
+						return false;
+					},
+				),
+		);
+		await this.sendCommand("CALIBRATE_JOINTS", ...jointNums);
 		await this.getCalibrationStatus();
-		try {
-			await this._serial.listenFor(
-				`Calibration complete for Joint ${jointNum}`,
-				90,
-			);
-		} catch (e: any) {
-			console.error(e.message);
-			return false;
-		}
+		const results = await Promise.all(outcomes);
 		await this.getCalibrationStatus();
-		return true;
+		return !results.includes(false);
 	}
 
 	async calibrateAll(): Promise<boolean> {
-		// calibrate first 3 joints then the rest
-		const results = await Promise.all(
-			[1, 2, 3].map((jointNum) => this.calibrateJoint(jointNum as JointNum)),
-		);
-		if (results.includes(false)) return false;
-		const upperResults = await Promise.all(
-			[4, 5, 6].map((jointNum) => this.calibrateJoint(jointNum as JointNum)),
-		);
-		return !upperResults.includes(false);
+		return this.calibrateJoints([1, 2, 3, 4, 5, 6]);
 	}
 
 	async getCalibrationStatus(): Promise<CalibrationStatus[]> {
+		const telemetry = await this._nextTelemetry();
+		if (telemetry) {
+			return RoboticArm._telemetryCalibrationStatus(telemetry);
+		}
+
+		if (this._serial.binaryFrames) {
+			const reply = await this._sendFrame(
+				"PRINT_CALIBRATION_STATUS",
+				new Uint8Array(),
+				1,
+			);
+			const statusArray = Array.from(reply.payload.slice(1, 7)).map(
+				(num) => CALIBRATION_NUM_TO_STATUS[`${num}` as "0" | "1" | "2"],
+			);
+			this._emit(
+				"calibrationStatusChanged",
+				statusArray as RoboticArmEventMap["calibrationStatusChanged"],
+			);
+			return statusArray;
+		}
+
 		await this.sendCommand("PRINT_CALIBRATION_STATUS");
 		const line = await this._serial.listenFor("CALIBRATION STATUS", 1);
 		const statusString = line.split(":").pop()?.trim() || "";
@@ -169,6 +491,23 @@ export default class RoboticArm implements Arm {
 	}
 
 	async getDegrees(): Promise<number[]> {
+		const telemetry = await this._nextTelemetry();
+		if (telemetry) {
+			return RoboticArm._telemetryDegrees(telemetry);
+		}
+
+		if (this._serial.binaryFrames) {
+			const reply = await this._sendFrame("PRINT_POS", new Uint8Array(), 1);
+			const positionsInDegrees = decodeInt32s(reply.payload, 1, 6).map(
+				(steps, i) => RoboticArm.stepsToDegrees((i + 1) as JointNum, steps),
+			);
+			this._emit(
+				"degreesChanged",
+				positionsInDegrees as RoboticArmEventMap["degreesChanged"],
+			);
+			return positionsInDegrees;
+		}
+
 		await this.sendCommand("PRINT_POS");
 		const line = await this._serial.listenFor("CURRENT POSITIONS", 1);
 		const positionsString = line.split(":").pop()?.trim() || "";
@@ -188,17 +527,65 @@ export default class RoboticArm implements Arm {
 	}
 
 	async stopJoint(jointNum: JointNum): Promise<void> {
-		await this.sendCommand("STOP_JOINT", jointNum);
-		await this._serial.listenFor(`STOP_J ${jointNum}`, 1);
+		if (this._serial.binaryFrames) {
+			await this._sendFrame("STOP_JOINT", Uint8Array.of(jointNum), 1);
+		} else {
+			await this.sendCommand("STOP_JOINT", jointNum);
+			await this._serial.listenFor(`STOP_J ${jointNum}`, 1);
+		}
 		await this.getCalibrationStatus();
 	}
 
 	async stopAllJoint(): Promise<void> {
-		await this.sendCommand("S");
-		await this._serial.listenFor("All motors stopped", 2);
+		if (this._serial.binaryFrames) {
+			await this._sendFrame("S", new Uint8Array(), 2);
+		} else {
+			await this.sendCommand("S");
+			await this._serial.listenFor("All motors stopped", 2);
+		}
 		await this.getCalibrationStatus();
 	}
 
+	/**
+	 * Slows the queued moves down to a stop along their path, keeping the rest of
+	 * them queued, or with `hold` false resumes them.
+	 */
+	async feedHold(hold: boolean): Promise<void> {
+		if (this._serial.protocolVersion < PROTOCOL_FEED_HOLD) {
+			throw new Error("The firmware does not hold moves");
+		}
+		if (this._serial.binaryFrames) {
+			await this._sendFrame("FEED_HOLD", Uint8Array.of(hold ? 1 : 0), 1);
+		} else {
+			await this.sendCommand("FEED_HOLD", hold ? 1 : 0);
+			await this._serial.listenFor(`FEED_HOLD ${hold ? "ON" : "OFF"}`, 1);
+		}
+	}
+
+	/**
+	 * Runs the queued moves, the ones under way included, at `percent` of their
+	 * speed, 10 to 200. Resolves with the percent the firmware applied.
+	 */
+	async setFeedOverride(percent: number): Promise<number> {
+		if (this._serial.protocolVersion < PROTOCOL_FEED_OVERRIDE) {
+			throw new Error("The firmware does not override the feed");
+		}
+		const clamped = Math.round(
+			Math.min(Math.max(percent, FEED_OVERRIDE_MIN), FEED_OVERRIDE_MAX),
+		);
+		if (this._serial.binaryFrames) {
+			const reply = await this._sendFrame(
+				"FEED_OVERRIDE",
+				Uint8Array.of(clamped),
+				1,
+			);
+			return reply.payload[1];
+		}
+		await this.sendCommand("FEED_OVERRIDE", clamped);
+		const line = await this._serial.listenFor("FEED_OVERRIDE", 1);
+		return Number.parseInt(line.split(" ").pop() ?? "", 10);
+	}
+
 	async rotateAllTo(
 		joint1Degree: number,
 		joint2Degree: number,
@@ -207,6 +594,41 @@ export default class RoboticArm implements Arm {
 		joint5Degree: number,
 		joint6Degree: number,
 	): Promise<boolean> {
+		if (this.queuesMoves) {
+			return this.queueAllTo([
+				joint1Degree,
+				joint2Degree,
+				joint3Degree,
+				joint4Degree,
+				joint5Degree,
+				joint6Degree,
+			]).then(
+				(moveId) => this.waitForMove(moveId),
+				() => false,
+			);
+		}
+		if (this._serial.binaryFrames) {
+			return this._sendFrame(
+				"MOVE_JOINTS",
+				encodeMoveJoints(
+					[
+						joint1Degree,
+						joint2Degree,
+						joint3Degree,
+						joint4Degree,
+						joint5Degree,
+						joint6Degree,
+					],
+					this._moveDuration,
+					this._acceleration,
+				),
+				this._moveDuration + 5,
+			).then(
+				() => true,
+				() => false,
+			);
+		}
+
 		// MOVE_JOINTS j1_degree,j2_degree,j3_degree,j4_degree,j5_degree,j6_degree,duration_sec,accel_decel_percent
 		await this.sendCommand(
 			"MOVE_JOINTS",
@@ -230,6 +652,28 @@ export default class RoboticArm implements Arm {
 
 	async rotateTo(jointNum: JointNum, targetDegree: number): Promise<boolean> {
 		// MOVE_JOINT joint_num,targetDegrees
+		if (this.queuesMoves) {
+			return this.queueTo(jointNum, targetDegree).then(
+				(moveId) => this.waitForMove(moveId),
+				() => false,
+			);
+		}
+		if (this._serial.binaryFrames) {
+			return this._sendFrame(
+				"MOVE_JOINT",
+				encodeMoveJoint(
+					jointNum,
+					targetDegree,
+					this._moveDuration,
+					this._acceleration,
+				),
+				20,
+			).then(
+				() => true,
+				() => false,
+			);
+		}
+
 		let success = true;
 
 		await this.sendCommand(
@@ -249,6 +693,22 @@ export default class RoboticArm implements Arm {
 
 	async rotateBy(jointNum: JointNum, degree: number): Promise<boolean> {
 		// MOVE_JOINT_BY joint_num, degree
+		if (this.queuesMoves) {
+			return this.queueBy(jointNum, degree).then(
+				(moveId) => this.waitForMove(moveId),
+				() => false,
+			);
+		}
+		if (this._serial.binaryFrames) {
+			return this._sendFrame(
+				"MOVE_JOINT_BY",
+				encodeMoveJoint(jointNum, degree, this._moveDuration, this._acceleration),
+				20,
+			).then(
+				() => true,
+				() => false,
+			);
+		}
 
 		let success = true;
 
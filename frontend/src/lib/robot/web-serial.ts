@@ -1,17 +1,37 @@
+import {
+	encodeFrame,
+	FRAME_ERROR,
+	FRAME_MAX_PAYLOAD,
+	FRAME_REPLY_FLAG,
+	FRAME_SYNC,
+	type Frame,
+	crc16,
+} from "./commands";
+
 export class WebSerial {
 	private port: SerialPort | null = null;
-	private reader: ReadableStreamDefaultReader<string> | null = null;
-	private readStreamClosed: Promise<void> | undefined = undefined;
-
-	private writer: WritableStreamDefaultWriter<string> | null = null;
-	private writeStreamClosed: Promise<void> | undefined = undefined;
+	private reader: ReadableStreamDefaultReader<Uint8Array> | null = null;
 
-	// private textEncoder: TextEncoderStream | null = null;
+	private writer: WritableStreamDefaultWriter<Uint8Array> | null = null;
+	private textEncoder = new TextEncoder();
 
 	private isReading = false;
 	private receiveCallbacks: Set<(data: string) => void> = new Set();
+	private frameCallbacks: Set<(frame: Frame) => void> = new Set();
+	private splitter = new StreamSplitter(
+		(line) => this.receiveLine(line),
+		(frame) => this.receiveFrame(frame),
+	);
+
+	// Replies the firmware owes us, by sequence number.
+	private pendingFrames: Map<number, (frame: Frame) => void> = new Map();
+	private nextSeq = 0;
 
 	public isConnected = false;
+	// True once the firmware has accepted the `00 BIN?` handshake.
+	public binaryFrames = false;
+	// Protocol version the firmware announced in the handshake, 0 for text only.
+	public protocolVersion = 0;
 
 	private async readLoop(): Promise<void> {
 		if (!this.reader) return;
@@ -23,15 +43,7 @@ export class WebSerial {
 				const { value, done } = await this.reader.read();
 				if (done) break;
 				if (value) {
-					console.log(
-						`%c[${new Date().toLocaleTimeString()}] %cReceived: %c${value}`,
-						"color: gray; font-weight: normal;", // timestamp style
-						"color: purple; font-weight: bold;", // "Received:" label style
-						"color: black;", // value style
-					);
-					for (const callback of this.receiveCallbacks) {
-						callback(value);
-					}
+					this.splitter.push(value);
 				}
 			}
 		} catch (error) {
@@ -39,27 +51,45 @@ export class WebSerial {
 		}
 	}
 
+	private receiveLine(value: string) {
+		console.log(
+			`%c[${new Date().toLocaleTimeString()}] %cReceived: %c${value}`,
+			"color: gray; font-weight: normal;", // timestamp style
+			"color: purple; font-weight: bold;", // "Received:" label style
+			"color: black;", // value style
+		);
+		for (const callback of this.receiveCallbacks) {
+			callback(value);
+		}
+	}
+
+	private receiveFrame(frame: Frame) {
+		if (frame.cmd & FRAME_REPLY_FLAG) {
+			const resolve = this.pendingFrames.get(frame.seq);
+			if (resolve) {
+				this.pendingFrames.delete(frame.seq);
+				resolve(frame);
+			}
+		}
+		for (const callback of this.frameCallbacks) {
+			callback(frame);
+		}
+	}
+
 	public async connect(baudRate = 115200): Promise<void> {
 		try {
 			this.port = await navigator.serial.requestPort();
 			await this.port.open({ baudRate, dataBits: 8, stopBits: 1 });
 			if (!this.port || !this.port.writable || !this.port.readable) return;
-			const textDecoder = new TextDecoderStream();
-			const lineTransformer = new TransformStream(new LineBreakTransformer());
-
-			// Pipe raw stream → text decoder → line splitter
-			this.readStreamClosed = this.port.readable
-				.pipeTo(textDecoder.writable)
-				.catch(() => {});
-
-			const lineReadable = textDecoder.readable.pipeThrough(lineTransformer);
-
-			this.reader = lineReadable.getReader();
-
-			// Writer
-			const textEncoder = new TextEncoderStream();
-			this.writeStreamClosed = textEncoder.readable.pipeTo(this.port.writable);
-			this.writer = textEncoder.writable.getWriter();
+			// Raw bytes: text lines and binary frames share the port
+			this.reader = this.port.readable.getReader();
+			this.writer = this.port.writable.getWriter();
+			this.splitter = new StreamSplitter(
+				(line) => this.receiveLine(line),
+				(frame) => this.receiveFrame(frame),
+			);
+			this.binaryFrames = false;
+			this.protocolVersion = 0;
 
 			this.isConnected = true;
 
@@ -76,19 +106,16 @@ export class WebSerial {
 
 		try {
 			await this.reader?.cancel();
+			this.reader?.releaseLock();
 			await this.writer?.close();
 		} catch (_) {}
 
-		try {
-			await this.readStreamClosed;
-			await this.writeStreamClosed;
-		} catch (_) {}
-
 		this.reader = null;
 		this.writer = null;
-		this.readStreamClosed = undefined;
-		this.writeStreamClosed = undefined;
+		this.pendingFrames.clear();
 		this.isConnected = false;
+		this.binaryFrames = false;
+		this.protocolVersion = 0;
 	}
 
 	public async disconnect(): Promise<void> {
@@ -109,12 +136,72 @@ export class WebSerial {
 		if (!this.writer) return;
 
 		try {
-			await this.writer.write(command + "\n");
+			await this.writer.write(this.textEncoder.encode(command + "\n"));
 		} catch (error) {
 			console.error("Write error:", error);
 		}
 	}
 
+	/**
+	 * Asks the firmware whether it understands binary frames. Firmware that
+	 * predates them simply echoes the question back.
+	 */
+	public async negotiateBinary(timeoutSeconds = 1): Promise<boolean> {
+		const answer = this.listenFor("BIN", timeoutSeconds);
+		await this.sendCommand("00 BIN?");
+		try {
+			const match = (await answer).trim().match(/^BIN (\d+)/);
+			this.protocolVersion = match ? Number(match[1]) : 0;
+		} catch (_) {
+			this.protocolVersion = 0;
+		}
+		this.binaryFrames = this.protocolVersion >= 1;
+		return this.binaryFrames;
+	}
+
+	/**
+	 * Sends a frame and resolves with its reply, whose first payload byte is the
+	 * command status. From protocol version 2 on, moves are answered as soon as
+	 * they are queued; before that, once they have finished.
+	 */
+	public sendFrame(
+		cmd: number,
+		payload: Uint8Array,
+		timeoutSeconds: number,
+	): Promise<Frame> {
+		const writer = this.writer;
+		if (!writer) return Promise.reject(new Error("Not connected"));
+
+		const seq = this.nextSeq;
+		this.nextSeq = (this.nextSeq + 1) & 0xff;
+
+		return new Promise((resolve, reject) => {
+			const timer = setTimeout(() => {
+				this.pendingFrames.delete(seq);
+				reject(
+					new Error(
+						`Timeout: no reply to frame ${cmd} within ${timeoutSeconds}s`,
+					),
+				);
+			}, timeoutSeconds * 1000);
+
+			this.pendingFrames.set(seq, (frame) => {
+				clearTimeout(timer);
+				if (frame.cmd === FRAME_ERROR) {
+					reject(new Error(`Frame ${cmd} was corrupted on the way`));
+				} else {
+					resolve(frame);
+				}
+			});
+
+			writer.write(encodeFrame(seq, cmd, payload)).catch((error) => {
+				clearTimeout(timer);
+				this.pendingFrames.delete(seq);
+				reject(error);
+			});
+		});
+	}
+
 	// Add/remove listeners
 	public addReceiveListener(callback: (resp: string) => void): void {
 		this.receiveCallbacks.add(callback);
@@ -124,11 +211,23 @@ export class WebSerial {
 		this.receiveCallbacks.delete(callback);
 	}
 
-	// Wait for specific line with timeout
-	public listenFor(line: string, timeoutSeconds: number): Promise<string> {
+	public addFrameListener(callback: (frame: Frame) => void): void {
+		this.frameCallbacks.add(callback);
+	}
+
+	public removeFrameListener(callback: (frame: Frame) => void): void {
+		this.frameCallbacks.delete(callback);
+	}
+
+	// Wait for specific line, or the first of several, with timeout
+	public listenFor(
+		line: string | string[],
+		timeoutSeconds: number,
+	): Promise<string> {
+		const lines = Array.isArray(line) ? line : [line];
 		return new Promise((resolve, reject) => {
 			const onData = (data: string) => {
-				if (data.includes(line)) {
+				if (lines.some((expected) => data.includes(expected))) {
 					this.removeReceiveListener(onData);
 					clearTimeout(timer);
 					resolve(data);
@@ -139,7 +238,7 @@ export class WebSerial {
 				this.removeReceiveListener(onData);
 				reject(
 					new Error(
-						`Timeout: "${line}" not received within ${timeoutSeconds}s`,
+						`Timeout: "${lines.join('" or "')}" not received within ${timeoutSeconds}s`,
 					),
 				);
 			}, timeoutSeconds * 1000);
@@ -149,26 +248,60 @@ export class WebSerial {
 	}
 }
 
-// 🧱 LineBreakTransformer: splits incoming stream into lines
-class LineBreakTransformer implements Transformer<string, string> {
+// 🧱 StreamSplitter: splits incoming bytes into text lines and binary frames.
+// Text is plain ASCII, so the sync byte can only start a frame.
+class StreamSplitter {
+	private textDecoder = new TextDecoder();
 	private buffer = "";
+	private frame: number[] | null = null;
+
+	constructor(
+		private onLine: (line: string) => void,
+		private onFrame: (frame: Frame) => void,
+	) {}
+
+	push(chunk: Uint8Array) {
+		let textStart = 0;
+		for (let i = 0; i < chunk.length; i++) {
+			if (this.frame) {
+				this.frame.push(chunk[i]);
+				this.checkFrame();
+				textStart = i + 1;
+			} else if (chunk[i] === FRAME_SYNC) {
+				this.pushText(chunk.subarray(textStart, i));
+				this.frame = [];
+				textStart = i + 1;
+			}
+		}
+		this.pushText(chunk.subarray(textStart));
+	}
 
-	transform(
-		chunk: string,
-		controller: TransformStreamDefaultController<string>,
-	) {
-		this.buffer += chunk;
+	private pushText(bytes: Uint8Array) {
+		if (bytes.length === 0) return;
+		this.buffer += this.textDecoder.decode(bytes, { stream: true });
 		const lines = this.buffer.split(/\r?\n/);
 		this.buffer = lines.pop() || "";
 		for (const line of lines) {
-			controller.enqueue(line);
+			this.onLine(line);
 		}
 	}
 
-	flush(controller: TransformStreamDefaultController<string>) {
-		if (this.buffer) {
-			controller.enqueue(this.buffer);
-			this.buffer = "";
+	private checkFrame() {
+		const bytes = this.frame as number[];
+		const length = bytes[0];
+		if (length > FRAME_MAX_PAYLOAD) {
+			this.frame = null; // Not a frame after all
+			return;
+		}
+		if (bytes.length < length + 5) return;
+
+		this.frame = null;
+		const body = Uint8Array.from(bytes.slice(0, length + 3));
+		const crc = bytes[length + 3] | (bytes[length + 4] << 8);
+		if (crc16(body) !== crc) {
+			console.error("Dropped a frame with a bad CRC");
+			return;
 		}
+		this.onFrame({ seq: body[1], cmd: body[2], payload: body.slice(3) });
 	}
 }